@@ -0,0 +1,2187 @@
+//go:build linux && amd64
+
+package bindings
+
+// Wrappers over the faiss_go_ext C API (c_api_ext/faiss_go_ext.h), used by
+// the tests to exercise the extensions through the shipped archives.
+//
+// They are built only where lib/<platform>/libfaiss_go_ext.a has been
+// regenerated with the current extensions (make -C c_api_ext install).
+// The archives of the other platforms predate them and would leave these
+// symbols undefined at link time; add a platform to the build constraint
+// once its archive is rebuilt.
+
+/*
+#include <stdlib.h>
+#include <stdint.h>
+
+typedef void* FaissIndex;
+typedef void* FaissIDSelector;
+typedef void* FaissSearchParameters;
+typedef void* FaissRangeSearchResult;
+
+// ==== FAISS C API ====
+extern int faiss_index_factory(FaissIndex* p_index, int d, const char* description, int metric_type);
+extern int faiss_Index_train(FaissIndex index, int64_t n, const float* x);
+extern int faiss_Index_add(FaissIndex index, int64_t n, const float* x);
+extern int faiss_Index_add_with_ids(FaissIndex index, int64_t n, const float* x, const int64_t* ids);
+extern int faiss_Index_search(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_Index_search_with_params(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_Index_reconstruct(FaissIndex index, int64_t key, float* recons);
+extern void faiss_Index_free(FaissIndex index);
+extern int faiss_Index_remove_ids(FaissIndex index, FaissIDSelector sel, size_t* n_removed);
+extern int faiss_clone_index(FaissIndex index, FaissIndex* p_out);
+extern int faiss_write_index_fname(FaissIndex idx, const char* fname);
+extern int faiss_IDSelectorRange_new(FaissIDSelector* p_sel, int64_t imin, int64_t imax);
+extern int faiss_IDSelectorBatch_new(FaissIDSelector* p_sel, size_t n, const int64_t* indices);
+extern void faiss_IDSelector_free(FaissIDSelector sel);
+extern int faiss_SearchParameters_new(FaissSearchParameters* p_params, FaissIDSelector sel);
+extern void faiss_SearchParameters_free(FaissSearchParameters params);
+extern int faiss_SearchParametersIVF_new_with(FaissSearchParameters* p_params, FaissIDSelector sel, size_t nprobe, size_t max_codes);
+extern const char* faiss_get_last_error(void);
+extern int faiss_IndexScalarQuantizer_new_with(FaissIndex* p_index, int64_t d, int qtype, int metric_type);
+extern int faiss_IndexIVFScalarQuantizer_new_with_metric(FaissIndex* p_index, FaissIndex quantizer, size_t d, size_t nlist, int qtype, int metric_type, int encode_residual);
+extern void faiss_IndexIVFScalarQuantizer_set_own_fields(FaissIndex index, int own_fields);
+extern void faiss_IndexIVF_set_nprobe(FaissIndex index, size_t nprobe);
+extern int faiss_IndexIVF_make_direct_map(FaissIndex index, int new_maintain_direct_map);
+
+// ==== SIMD Dispatch ====
+extern int faiss_get_simd_level(int* level);
+extern const char* faiss_simd_level_name(int level);
+extern int faiss_set_simd_level(int level);
+extern int faiss_simd_level_supported(int level, int* supported);
+extern int faiss_IndexScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_IndexIVFScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_IndexPQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_fvec_L2sqr_ny_ext(float* dis, const float* x, const float* y, size_t d, size_t ny);
+extern int faiss_fvec_inner_products_ny_ext(float* ip, const float* x, const float* y, size_t d, size_t ny);
+extern int faiss_fvec_L2sqr_nn_ext(const float* x, const float* y, size_t d, size_t nx, size_t ny, float* distances, int64_t* labels);
+extern int faiss_hamming_distances_ext(const uint8_t* a, const uint8_t* b, size_t na, size_t nb, size_t code_size, int32_t* distances);
+
+// ==== Fast-Scan ====
+extern int faiss_IndexFastScan_set_implem(FaissIndex index, int implem);
+extern int faiss_IndexFastScan_get_implem(FaissIndex index, int* implem);
+extern int faiss_IndexFastScan_set_qbs(FaissIndex index, int qbs);
+extern int faiss_IndexFastScan_get_qbs(FaissIndex index, int* qbs);
+extern int faiss_IndexFastScan_get_bbs(FaissIndex index, int* bbs);
+extern int faiss_IndexFastScan_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int implem, int qbs, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_IndexFastScan_autotune_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int nrep, int apply, int* best_implem, int* best_qbs, double* best_ms, double* default_ms);
+
+// ==== RaBitQ ====
+typedef struct FaissRaBitQSearchParams {
+    int qb;
+    int centered;
+    size_t nprobe;
+    float k_factor;
+} FaissRaBitQSearchParams;
+extern void faiss_RaBitQSearchParams_init(FaissRaBitQSearchParams* params);
+extern int faiss_RaBitQ_get_query_params(FaissIndex index, int* qb, int* centered);
+extern int faiss_RaBitQ_set_query_params(FaissIndex index, int qb, int centered);
+extern int faiss_RaBitQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissRaBitQSearchParams* params, float* distances, int64_t* labels);
+extern int faiss_RaBitQ_get_nb_bits(FaissIndex index, int* nb_bits);
+extern int faiss_RaBitQStats_get(size_t* n_1bit_evaluations, size_t* n_multibit_evaluations, double* skip_percentage);
+extern void faiss_RaBitQStats_reset(void);
+extern void faiss_IndexRefineFlat_set_k_factor(FaissIndex index, float k_factor);
+
+// ==== Panorama ====
+extern int faiss_IndexFlatL2Panorama_new(FaissIndex* p_index, int64_t d, int n_levels, int64_t batch_size);
+extern int faiss_Panorama_get_n_levels(FaissIndex index, int* n_levels);
+extern int faiss_Panorama_get_batch_size(FaissIndex index, int64_t* batch_size);
+extern int faiss_Index_to_panorama_ext(FaissIndex* p_index, int n_levels);
+extern int faiss_PanoramaStats_get(uint64_t* total_dims_scanned, uint64_t* total_dims, float* ratio_dims_scanned);
+extern void faiss_PanoramaStats_reset(void);
+
+// ==== Flat Search ====
+extern int faiss_IndexFlat_search_fused_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int64_t query_bs, int64_t db_bs, float* distances, int64_t* labels);
+
+// ==== BLAS Parameters ====
+typedef struct FaissBlasParams {
+    int blas_threshold;
+    int query_bs;
+    int database_bs;
+    int min_k_reservoir;
+} FaissBlasParams;
+extern void faiss_BlasParams_init(FaissBlasParams* params);
+extern int faiss_get_blas_params(FaissBlasParams* params);
+extern int faiss_set_blas_params(const FaissBlasParams* params);
+extern int faiss_IndexFlat_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_IndexIVF_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_blas_calibrate_ext(int64_t d, int install, FaissBlasParams* result);
+
+// ==== IndexShards ====
+extern int faiss_IndexShards_new(FaissIndex* p_index, int64_t d);
+extern int faiss_IndexShards_add_shard(FaissIndex index, FaissIndex shard);
+extern int faiss_IndexShards_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int n_threads, double deadline_ms, float* distances, int64_t* labels, int* n_completed, int* partial);
+extern int faiss_IndexShards_wait_ext(FaissIndex index);
+
+// ==== Replica Routing ====
+typedef void* FaissReplicaRouter;
+extern int faiss_IndexReplicas_new(FaissIndex* p_index, int64_t d);
+extern int faiss_IndexReplicas_add_replica(FaissIndex index, FaissIndex replica);
+extern int faiss_numa_num_nodes(int* n_nodes);
+extern int faiss_ReplicaRouter_new(FaissReplicaRouter* p_router, FaissIndex replicas, int64_t small_batch, const int* nodes);
+extern int faiss_ReplicaRouter_search(FaissReplicaRouter router, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_ReplicaRouter_queue_depth(FaissReplicaRouter router, int replica, int* depth);
+extern void faiss_ReplicaRouter_free(FaissReplicaRouter router);
+
+// ==== NUMA Placement ====
+extern int faiss_Index_numa_place_ext(FaissIndex index, int policy, const int* nodes, int n_nodes, int64_t* n_bytes, int* used_mbind);
+extern int faiss_Index_numa_pages_ext(FaissIndex index, int64_t* pages_per_node, int max_nodes, int* n_nodes);
+extern int faiss_Index_search_on_node_ext(FaissIndex index, int node, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_Index_replicate_per_node_ext(FaissIndex index, FaissIndex* p_replicas);
+extern int faiss_read_index_per_node_ext(const char* fname, int io_flags, FaissIndex* p_replicas);
+
+// ==== IDMap3 ====
+extern int faiss_IndexIDMap3_get_index(FaissIndex index, FaissIndex* p_sub_index);
+extern int faiss_index_factory_ext(FaissIndex* p_index, int d, const char* description, int metric_type);
+extern int faiss_write_index_ext(FaissIndex index, const char* fname);
+extern int faiss_read_index_ext(const char* fname, int io_flags, FaissIndex* p_index);
+
+// ==== IVF Id Table ====
+typedef void* FaissIVFIdTable;
+extern int faiss_IndexIVF_make_direct_map_ext(FaissIndex index, int type, double* build_ms);
+extern int faiss_IVFIdTable_new(FaissIVFIdTable* p_table, FaissIndex index, double* build_ms);
+extern int faiss_IVFIdTable_lookup(FaissIVFIdTable table, int64_t n, const int64_t* ids, int64_t* list_nos, int64_t* offsets);
+extern int faiss_IVFIdTable_reconstruct(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, float* recons);
+extern int faiss_IVFIdTable_add_with_ids(FaissIVFIdTable table, FaissIndex index, int64_t n, const float* x, const int64_t* ids);
+extern int faiss_IVFIdTable_update_vectors(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, const float* x);
+extern int faiss_IVFIdTable_stats(FaissIVFIdTable table, int64_t* size, int64_t* capacity, int64_t* bytes);
+extern int faiss_IVFIdTable_write(FaissIVFIdTable table, const char* fname);
+extern int faiss_IVFIdTable_read(FaissIVFIdTable* p_table, const char* fname, int mmap);
+extern void faiss_IVFIdTable_free(FaissIVFIdTable table);
+
+// ==== IVF Tombstones ====
+typedef void* FaissIVFTombstones;
+extern int faiss_IVFTombstones_new(FaissIVFTombstones* p_ts, FaissIndex index);
+extern int faiss_IVFTombstones_delete(FaissIVFTombstones ts, int64_t n, const int64_t* ids, int64_t* n_deleted);
+extern int faiss_IVFTombstones_search(FaissIVFTombstones ts, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_IVFTombstones_compact(FaissIVFTombstones ts, int64_t lists_per_batch, int64_t* n_removed);
+extern int faiss_IVFTombstones_stats(FaissIVFTombstones ts, int64_t* n_pending, int64_t* n_dirty_lists, int64_t* n_compacted, double* last_compact_ms);
+extern void faiss_IVFTombstones_free(FaissIVFTombstones ts);
+
+// ==== Range Search Arena ====
+typedef void* FaissRangeSearchArena;
+extern int faiss_RangeSearchResult_new(FaissRangeSearchResult* p_rsr, int64_t nq);
+extern void faiss_RangeSearchResult_free(FaissRangeSearchResult result);
+extern int faiss_RangeSearchResult_get(FaissRangeSearchResult result, int64_t** lims, int64_t** labels, float** distances);
+extern int faiss_Index_range_search(FaissIndex index, int64_t n, const float* x, float radius, FaissRangeSearchResult result);
+extern int faiss_RangeSearchArena_new(FaissRangeSearchArena* p_arena);
+extern int faiss_RangeSearchArena_reserve(FaissRangeSearchArena arena, int64_t n);
+extern int faiss_Index_range_search_arena_ext(FaissIndex index, int64_t n, const float* x, float radius, FaissSearchParameters params, int64_t max_per_query, FaissRangeSearchArena arena, int64_t* labels, float* distances, int64_t capacity, int64_t* total, int* in_output);
+extern int faiss_RangeSearchArena_get(FaissRangeSearchArena arena, int64_t* nq, int64_t** lims, int64_t** labels, float** distances);
+extern int faiss_RangeSearchArena_copy_to(FaissRangeSearchArena arena, int64_t* lims, int64_t* labels, float* distances);
+extern int faiss_RangeSearchArena_stats(FaissRangeSearchArena arena, int64_t* capacity, int64_t* n_allocations);
+extern void faiss_RangeSearchArena_free(FaissRangeSearchArena arena);
+
+// ==== Search Context ====
+typedef void* FaissSearchContext;
+extern int faiss_SearchContext_new(FaissSearchContext* p_ctx);
+extern int faiss_Index_search_ctx_ext(FaissIndex index, FaissSearchContext ctx, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+extern int faiss_SearchContext_stats(FaissSearchContext ctx, int64_t* bytes, int64_t* n_grows, int64_t* n_searches);
+extern int faiss_SearchContext_reset(FaissSearchContext ctx);
+extern void faiss_SearchContext_free(FaissSearchContext ctx);
+
+// ==== Graph Search ====
+extern int faiss_SearchParametersGraph_new(FaissSearchParameters* p_params, int ef, int visited_mode);
+extern void faiss_SearchParametersGraph_free(FaissSearchParameters params);
+extern int faiss_Index_search_graph_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+
+// ==== Parallel Explore ====
+typedef void* FaissParameterSpace;
+typedef void* FaissOperatingPoints;
+extern int faiss_ParameterSpace_new_ext(FaissParameterSpace* p_space, FaissIndex index);
+extern int faiss_ParameterSpace_set_range_ext(FaissParameterSpace space, const char* name, const double* values, size_t n);
+extern void faiss_ParameterSpace_free_ext(FaissParameterSpace space);
+extern int faiss_ParameterSpace_explore_ext(FaissParameterSpace space, FaissIndex index, int64_t nq, const float* xq, int64_t gt_k, const int64_t* gt_I, int criterion, int64_t R, int n_threads, int64_t n_subset, FaissOperatingPoints* p_ops, int64_t* n_pruned);
+extern int faiss_OperatingPoints_size(FaissOperatingPoints ops, int only_optimal, size_t* n);
+extern int faiss_OperatingPoints_get(FaissOperatingPoints ops, int only_optimal, size_t i, double* perf, double* t, int64_t* cno, char* key, size_t key_size);
+extern void faiss_OperatingPoints_free(FaissOperatingPoints ops);
+
+// ==== Search Controller ====
+typedef void* FaissSearchController;
+extern int faiss_SearchController_new(FaissSearchController* p_ctrl, FaissIndex index, double target_p95_ms, FaissParameterSpace space, FaissOperatingPoints ops);
+extern int faiss_SearchController_search(FaissSearchController ctrl, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_SearchController_get_state(FaissSearchController ctrl, int* level, int* n_levels, double* p95_ms, char* key, size_t key_size);
+extern int faiss_SearchController_set_target(FaissSearchController ctrl, double target_p95_ms);
+extern int faiss_SearchController_history_size(FaissSearchController ctrl, size_t* n);
+extern int faiss_SearchController_get_history(FaissSearchController ctrl, size_t i, int64_t* call, double* time_ms, int* from, int* to, double* p95_ms);
+extern void faiss_SearchController_free(FaissSearchController ctrl);
+
+// ==== Compiled Factory ====
+typedef void* FaissCompiledFactory;
+typedef struct FaissIndexNode {
+    int parent;
+    char role[16];
+    char type[48];
+    int64_t d;
+    int64_t ntotal;
+    size_t code_size;
+    int metric_type;
+    int is_trained;
+    int owned;
+    size_t nlist;
+    int M;
+    int nbits;
+    char qtype[24];
+} FaissIndexNode;
+extern int faiss_CompiledFactory_new(FaissCompiledFactory* p_factory, int d, const char* description, int metric_type);
+extern int faiss_CompiledFactory_from_index(FaissCompiledFactory* p_factory, FaissIndex index);
+extern int faiss_CompiledFactory_instantiate(FaissCompiledFactory factory, FaissIndex* p_index);
+extern void faiss_CompiledFactory_free(FaissCompiledFactory factory);
+extern int faiss_reverse_index_factory_ext(FaissIndex index, char* description, size_t size, size_t* length);
+extern int faiss_Index_describe_ext(FaissIndex index, FaissIndexNode* nodes, size_t max_nodes, size_t* n_nodes);
+
+// ==== Snapshot Index ====
+typedef void* FaissSnapshotIndex;
+extern int faiss_SnapshotIndex_new(FaissSnapshotIndex* p_snap, FaissIndex index);
+extern int faiss_SnapshotIndex_add(FaissSnapshotIndex snap, int64_t n, const float* x);
+extern int faiss_SnapshotIndex_add_with_ids(FaissSnapshotIndex snap, int64_t n, const float* x, const int64_t* ids);
+extern int faiss_SnapshotIndex_search(FaissSnapshotIndex snap, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_SnapshotIndex_acquire(FaissSnapshotIndex snap, FaissIndex* p_index, uint64_t* version);
+extern int faiss_SnapshotIndex_ntotal(FaissSnapshotIndex snap, int64_t* ntotal);
+extern void faiss_SnapshotIndex_free(FaissSnapshotIndex snap);
+
+// ==== Segmented Index ====
+typedef void* FaissSegmentedIndex;
+typedef struct FaissSegmentInfo {
+    uint64_t number;
+    int state;
+    int64_t ntotal;
+    int64_t n_deleted;
+} FaissSegmentInfo;
+extern int faiss_SegmentedIndex_new(FaissSegmentedIndex* p_index, FaissIndex write_template, FaissIndex segment_template, int64_t write_capacity, size_t max_segments, size_t merge_factor, double purge_fraction, int background);
+extern int faiss_SegmentedIndex_add_with_ids(FaissSegmentedIndex index, int64_t n, const float* x, const int64_t* ids);
+extern int faiss_SegmentedIndex_remove(FaissSegmentedIndex index, int64_t n, const int64_t* ids, size_t* n_removed);
+extern int faiss_SegmentedIndex_search(FaissSegmentedIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+extern int faiss_SegmentedIndex_set_search_params(FaissSegmentedIndex index, int nprobe, int efSearch);
+extern int faiss_SegmentedIndex_flush(FaissSegmentedIndex index);
+extern int faiss_SegmentedIndex_ntotal(FaissSegmentedIndex index, int64_t* ntotal);
+extern int faiss_SegmentedIndex_segments(FaissSegmentedIndex index, FaissSegmentInfo* infos, size_t max_infos, size_t* n_segments);
+extern void faiss_SegmentedIndex_free(FaissSegmentedIndex index);
+
+// ==== Parallel Clone ====
+extern int faiss_IndexIVF_merge_from(FaissIndex index, FaissIndex other, int64_t add_id);
+extern int faiss_clone_index_parallel(FaissIndex index, FaissIndex* p_out, int n_threads);
+extern int faiss_clone_index_shallow(FaissIndex index, FaissIndex* p_out);
+extern int faiss_merge_into_parallel(FaissIndex dst, const FaissIndex* srcs, size_t n, int shift_ids, int n_threads);
+
+// ==== Binary Indexes ====
+typedef void* FaissIndexBinary;
+extern int faiss_IndexBinary_train(FaissIndexBinary index, int64_t n, const uint8_t* x);
+extern int faiss_IndexBinary_add(FaissIndexBinary index, int64_t n, const uint8_t* x);
+extern int faiss_IndexBinary_search(FaissIndexBinary index, int64_t n, const uint8_t* x, int64_t k, int32_t* distances, int64_t* labels);
+extern int faiss_IndexBinary_d(FaissIndexBinary index);
+extern int64_t faiss_IndexBinary_ntotal(FaissIndexBinary index);
+extern void faiss_IndexBinary_free(FaissIndexBinary index);
+extern int faiss_IndexBinaryFlat_new(FaissIndexBinary* p_index, int64_t d);
+extern int faiss_IndexBinaryIVF_new(FaissIndexBinary* p_index, FaissIndexBinary quantizer, int64_t d, int64_t nlist);
+extern int faiss_IndexBinaryHNSW_new(FaissIndexBinary* p_index, int64_t d, int M);
+extern int faiss_IndexBinaryHNSWCagra_new(FaissIndexBinary* p_index, int64_t d, int M);
+extern int faiss_IndexBinaryHash_new(FaissIndexBinary* p_index, int64_t d, int b);
+extern int faiss_IndexBinaryMultiHash_new(FaissIndexBinary* p_index, int64_t d, int nhash, int b);
+extern int faiss_IndexBinaryFromFloat_new(FaissIndexBinary* p_index, FaissIndex index, int own_index);
+extern int faiss_index_binary_factory_ext(FaissIndexBinary* p_index, int d, const char* description);
+extern int faiss_IndexBinaryIVF_set_nprobe_ext(FaissIndexBinary index, int64_t nprobe);
+extern int faiss_IndexBinaryIVF_get_nprobe(FaissIndexBinary index, int64_t* nprobe);
+extern int faiss_IndexBinaryIVF_set_max_codes_ext(FaissIndexBinary index, int64_t max_codes);
+extern int faiss_IndexBinaryHNSW_set_efSearch(FaissIndexBinary index, int ef);
+extern int faiss_IndexBinaryHNSW_get_efSearch(FaissIndexBinary index, int* ef);
+extern int faiss_IndexBinaryHNSW_set_efConstruction(FaissIndexBinary index, int ef);
+extern int faiss_IndexBinaryHash_set_nflip(FaissIndexBinary index, int nflip);
+extern int faiss_IndexBinaryHash_get_nflip(FaissIndexBinary index, int* nflip);
+extern int faiss_IndexBinary_range_search_ext(FaissIndexBinary index, int64_t n, const uint8_t* x, int radius, int64_t max_k, FaissRangeSearchResult result, int64_t* n_truncated);
+
+// ==== Approximate Top-k ====
+extern int faiss_SearchParametersApproxTopK_new(FaissSearchParameters* p_params, int approx_topk_mode, int64_t nprobe, int64_t segment_size);
+extern void faiss_SearchParametersApproxTopK_free(FaissSearchParameters params);
+extern int faiss_Index_approx_topk_supported_ext(FaissIndex index, int* supported);
+extern int faiss_Index_search_approx_topk_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+*/
+import "C"
+
+import (
+	"fmt"
+	"unsafe"
+)
+
+// Metric types of faiss_index_factory.
+const (
+	MetricInnerProduct = 0
+	MetricL2           = 1
+)
+
+// callError turns the return code of a C API call into an error.
+func callError(name string, rc C.int) error {
+	if rc == 0 {
+		return nil
+	}
+	msg := ""
+	if p := C.faiss_get_last_error(); p != nil {
+		msg = C.GoString(p)
+	}
+	return fmt.Errorf("%s failed (%d): %s", name, int(rc), msg)
+}
+
+func floatPtr(x []float32) *C.float {
+	if len(x) == 0 {
+		return nil
+	}
+	return (*C.float)(unsafe.Pointer(&x[0]))
+}
+
+func idPtr(x []int64) *C.int64_t {
+	if len(x) == 0 {
+		return nil
+	}
+	return (*C.int64_t)(unsafe.Pointer(&x[0]))
+}
+
+func cIndex(ptr uintptr) C.FaissIndex {
+	return C.FaissIndex(unsafe.Pointer(ptr))
+}
+
+// NewIndexFactory builds an index from a factory string.
+func NewIndexFactory(d int, description string, metric int) (uintptr, error) {
+	cdesc := C.CString(description)
+	defer C.free(unsafe.Pointer(cdesc))
+	var idx C.FaissIndex
+	if err := callError("faiss_index_factory", C.faiss_index_factory(&idx, C.int(d), cdesc, C.int(metric))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// TrainIndex trains an index on the vectors x.
+func TrainIndex(ptr uintptr, x []float32) error {
+	n := len(x) / GetIndexDimension(ptr)
+	return callError("faiss_Index_train", C.faiss_Index_train(cIndex(ptr), C.int64_t(n), floatPtr(x)))
+}
+
+// AddVectors adds the vectors x to an index.
+func AddVectors(ptr uintptr, x []float32) error {
+	n := len(x) / GetIndexDimension(ptr)
+	return callError("faiss_Index_add", C.faiss_Index_add(cIndex(ptr), C.int64_t(n), floatPtr(x)))
+}
+
+// SearchIndex returns the k nearest neighbors of the queries x.
+func SearchIndex(ptr uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search",
+		C.faiss_Index_search(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// GetSIMDLevelName returns the SIMD level selected for the extension kernels.
+func GetSIMDLevelName() string {
+	var level C.int
+	if C.faiss_get_simd_level(&level) != 0 {
+		return ""
+	}
+	return C.GoString(C.faiss_simd_level_name(level))
+}
+
+// SIMD levels of the extension kernels (FaissSIMDLevel).
+const (
+	SIMDGeneric = 0
+	SIMDAVX2    = 1
+	SIMDAVX512  = 2
+	SIMDNEON    = 3
+)
+
+// GetSIMDLevel returns the SIMD level used by the extension kernels.
+func GetSIMDLevel() int {
+	var level C.int
+	C.faiss_get_simd_level(&level)
+	return int(level)
+}
+
+// Scalar quantizer types (ScalarQuantizer::QuantizerType).
+const (
+	QT8bit = iota
+	QT4bit
+	QT8bitUniform
+	QT4bitUniform
+	QTFp16
+	QT8bitDirect
+	QT6bit
+	QTBf16
+	QT8bitDirectSigned
+)
+
+// NewIndexScalarQuantizer creates an IndexScalarQuantizer.
+func NewIndexScalarQuantizer(d, qtype, metric int) (uintptr, error) {
+	var idx C.FaissIndex
+	if err := callError("faiss_IndexScalarQuantizer_new_with",
+		C.faiss_IndexScalarQuantizer_new_with(&idx, C.int64_t(d), C.int(qtype), C.int(metric))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// NewIndexIVFScalarQuantizer creates an IndexIVFScalarQuantizer that owns
+// quantizer, encoding residuals or the vectors themselves.
+func NewIndexIVFScalarQuantizer(quantizer uintptr, d, nlist, qtype, metric int, byResidual bool) (uintptr, error) {
+	residual := C.int(0)
+	if byResidual {
+		residual = 1
+	}
+	var idx C.FaissIndex
+	if err := callError("faiss_IndexIVFScalarQuantizer_new_with_metric",
+		C.faiss_IndexIVFScalarQuantizer_new_with_metric(&idx, cIndex(quantizer), C.size_t(d), C.size_t(nlist),
+			C.int(qtype), C.int(metric), residual)); err != nil {
+		return 0, err
+	}
+	C.faiss_IndexIVFScalarQuantizer_set_own_fields(idx, 1)
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// SetIndexIVFNprobe sets the number of lists an IVF index probes.
+func SetIndexIVFNprobe(ptr uintptr, nprobe int) {
+	C.faiss_IndexIVF_set_nprobe(cIndex(ptr), C.size_t(nprobe))
+}
+
+// IndexScalarQuantizerSearch searches an IndexScalarQuantizer with the
+// dispatched SQ kernels.
+func IndexScalarQuantizerSearch(ptr uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexScalarQuantizer_search_ext",
+		C.faiss_IndexScalarQuantizer_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// IndexIVFScalarQuantizerSearch searches an IndexIVFScalarQuantizer with
+// the dispatched SQ kernels.
+func IndexIVFScalarQuantizerSearch(ptr uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexIVFScalarQuantizer_search_ext",
+		C.faiss_IndexIVFScalarQuantizer_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// SetSIMDLevel forces the SIMD level of the extension kernels.
+func SetSIMDLevel(level int) error {
+	return callError("faiss_set_simd_level", C.faiss_set_simd_level(C.int(level)))
+}
+
+// SIMDLevelSupported reports whether the host CPU runs a SIMD level.
+func SIMDLevelSupported(level int) bool {
+	var supported C.int
+	return C.faiss_simd_level_supported(C.int(level), &supported) == 0 && supported != 0
+}
+
+// IndexPQSearch searches an IndexPQ with the dispatched PQ kernels.
+func IndexPQSearch(ptr uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexPQ_search_ext",
+		C.faiss_IndexPQ_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// L2sqrNy returns the squared L2 distances between x and the vectors y.
+func L2sqrNy(x, y []float32) ([]float32, error) {
+	d := len(x)
+	dis := make([]float32, len(y)/d)
+	err := callError("faiss_fvec_L2sqr_ny_ext",
+		C.faiss_fvec_L2sqr_ny_ext(floatPtr(dis), floatPtr(x), floatPtr(y), C.size_t(d), C.size_t(len(dis))))
+	return dis, err
+}
+
+// InnerProductsNy returns the inner products between x and the vectors y.
+func InnerProductsNy(x, y []float32) ([]float32, error) {
+	d := len(x)
+	ip := make([]float32, len(y)/d)
+	err := callError("faiss_fvec_inner_products_ny_ext",
+		C.faiss_fvec_inner_products_ny_ext(floatPtr(ip), floatPtr(x), floatPtr(y), C.size_t(d), C.size_t(len(ip))))
+	return ip, err
+}
+
+// L2sqrNN returns the nearest neighbor in y of each vector of x.
+func L2sqrNN(x, y []float32, d int) ([]float32, []int64, error) {
+	nx, ny := len(x)/d, len(y)/d
+	D := make([]float32, nx)
+	I := make([]int64, nx)
+	err := callError("faiss_fvec_L2sqr_nn_ext",
+		C.faiss_fvec_L2sqr_nn_ext(floatPtr(x), floatPtr(y), C.size_t(d), C.size_t(nx), C.size_t(ny), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// HammingDistances returns the Hamming distances between the codes a and
+// the codes b, row-major.
+func HammingDistances(a, b []uint8, codeSize int) ([]int32, error) {
+	na, nb := len(a)/codeSize, len(b)/codeSize
+	dis := make([]int32, na*nb)
+	err := callError("faiss_hamming_distances_ext",
+		C.faiss_hamming_distances_ext((*C.uint8_t)(unsafe.Pointer(&a[0])), (*C.uint8_t)(unsafe.Pointer(&b[0])),
+			C.size_t(na), C.size_t(nb), C.size_t(codeSize), (*C.int32_t)(unsafe.Pointer(&dis[0]))))
+	return dis, err
+}
+
+// SearchIndexWithParams is SearchIndex with search parameters.
+func SearchIndexWithParams(ptr, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search_with_params",
+		C.faiss_Index_search_with_params(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// NewSearchParameters makes search parameters with a selector.
+func NewSearchParameters(sel uintptr) (uintptr, error) {
+	var params C.FaissSearchParameters
+	if err := callError("faiss_SearchParameters_new",
+		C.faiss_SearchParameters_new(&params, C.FaissIDSelector(unsafe.Pointer(sel)))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(params)), nil
+}
+
+// NewSearchParametersIVF makes IVF search parameters; sel may be 0.
+func NewSearchParametersIVF(sel uintptr, nprobe, maxCodes int) (uintptr, error) {
+	var params C.FaissSearchParameters
+	if err := callError("faiss_SearchParametersIVF_new_with",
+		C.faiss_SearchParametersIVF_new_with(&params, C.FaissIDSelector(unsafe.Pointer(sel)),
+			C.size_t(nprobe), C.size_t(maxCodes))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(params)), nil
+}
+
+// FreeSearchParameters frees parameters made by NewSearchParameters or
+// NewSearchParametersIVF.
+func FreeSearchParameters(params uintptr) {
+	C.faiss_SearchParameters_free(C.FaissSearchParameters(unsafe.Pointer(params)))
+}
+
+// FastScanSetImplem sets the search implementation of a fast-scan index.
+func FastScanSetImplem(ptr uintptr, implem int) error {
+	return callError("faiss_IndexFastScan_set_implem", C.faiss_IndexFastScan_set_implem(cIndex(ptr), C.int(implem)))
+}
+
+// FastScanImplem returns the search implementation of a fast-scan index.
+func FastScanImplem(ptr uintptr) (int, error) {
+	var implem C.int
+	err := callError("faiss_IndexFastScan_get_implem", C.faiss_IndexFastScan_get_implem(cIndex(ptr), &implem))
+	return int(implem), err
+}
+
+// FastScanSetQbs sets the query block size of a fast-scan index.
+func FastScanSetQbs(ptr uintptr, qbs int) error {
+	return callError("faiss_IndexFastScan_set_qbs", C.faiss_IndexFastScan_set_qbs(cIndex(ptr), C.int(qbs)))
+}
+
+// FastScanQbs returns the query block size of a fast-scan index.
+func FastScanQbs(ptr uintptr) (int, error) {
+	var qbs C.int
+	err := callError("faiss_IndexFastScan_get_qbs", C.faiss_IndexFastScan_get_qbs(cIndex(ptr), &qbs))
+	return int(qbs), err
+}
+
+// FastScanBbs returns the database block size of a fast-scan index.
+func FastScanBbs(ptr uintptr) (int, error) {
+	var bbs C.int
+	err := callError("faiss_IndexFastScan_get_bbs", C.faiss_IndexFastScan_get_bbs(cIndex(ptr), &bbs))
+	return int(bbs), err
+}
+
+// FastScanAutotune times the implem / qbs combinations on the queries x
+// and returns the fastest, storing it on the index with apply.
+func FastScanAutotune(ptr uintptr, x []float32, k, nrep int, apply bool) (implem, qbs int, bestMs, defaultMs float64, err error) {
+	n := len(x) / GetIndexDimension(ptr)
+	capply := C.int(0)
+	if apply {
+		capply = 1
+	}
+	var cimplem, cqbs C.int
+	var cbest, cdefault C.double
+	err = callError("faiss_IndexFastScan_autotune_ext",
+		C.faiss_IndexFastScan_autotune_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), C.int(nrep), capply,
+			&cimplem, &cqbs, &cbest, &cdefault))
+	return int(cimplem), int(cqbs), float64(cbest), float64(cdefault), err
+}
+
+// FastScanSearch searches a fast-scan index with implem and qbs
+// overridden for this call.
+func FastScanSearch(ptr, params uintptr, x []float32, k, implem, qbs int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexFastScan_search_ext",
+		C.faiss_IndexFastScan_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), C.int(implem), C.int(qbs),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// RaBitQQueryParams returns the default query parameters of a RaBitQ index.
+func RaBitQQueryParams(ptr uintptr) (qb, centered int, err error) {
+	var cqb, ccentered C.int
+	err = callError("faiss_RaBitQ_get_query_params", C.faiss_RaBitQ_get_query_params(cIndex(ptr), &cqb, &ccentered))
+	return int(cqb), int(ccentered), err
+}
+
+// RaBitQSetQueryParams sets the default query parameters of a RaBitQ
+// index, negative values keep the current setting.
+func RaBitQSetQueryParams(ptr uintptr, qb, centered int) error {
+	return callError("faiss_RaBitQ_set_query_params", C.faiss_RaBitQ_set_query_params(cIndex(ptr), C.int(qb), C.int(centered)))
+}
+
+// RaBitQParams are per-call RaBitQ search parameters, negative or zero
+// values keep the setting stored on the index.
+type RaBitQParams struct {
+	QB       int     // bits per query component, 0 = fp32 queries
+	Centered int     // zero-centered query quantizer (0 / 1)
+	Nprobe   int     // IVF variants only
+	KFactor  float32 // IndexRefine over a RaBitQ index only
+}
+
+// NewRaBitQParams returns parameters keeping every index setting.
+func NewRaBitQParams() RaBitQParams {
+	var params C.FaissRaBitQSearchParams
+	C.faiss_RaBitQSearchParams_init(&params)
+	return RaBitQParams{int(params.qb), int(params.centered), int(params.nprobe), float32(params.k_factor)}
+}
+
+// RaBitQSearch searches a RaBitQ index, or an IndexRefine over one, with
+// per-call parameters.
+func RaBitQSearch(ptr uintptr, x []float32, k int, p RaBitQParams) ([]float32, []int64, error) {
+	params := C.FaissRaBitQSearchParams{qb: C.int(p.QB), centered: C.int(p.Centered), nprobe: C.size_t(p.Nprobe), k_factor: C.float(p.KFactor)}
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_RaBitQ_search_ext",
+		C.faiss_RaBitQ_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), &params, floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// RaBitQNbBits returns the bits per dimension of a RaBitQ index, or of
+// the base of an IndexRefine over one.
+func RaBitQNbBits(ptr uintptr) (int, error) {
+	var nbBits C.int
+	err := callError("faiss_RaBitQ_get_nb_bits", C.faiss_RaBitQ_get_nb_bits(cIndex(ptr), &nbBits))
+	return int(nbBits), err
+}
+
+// RaBitQStats returns the global multi-bit RaBitQ statistics: candidates
+// scored with the 1-bit bound, candidates that needed the full distance
+// and the percentage filtered by the bound.
+func RaBitQStats() (n1bit, nMultibit int64, skipPercentage float64) {
+	var c1, cm C.size_t
+	var skip C.double
+	C.faiss_RaBitQStats_get(&c1, &cm, &skip)
+	return int64(c1), int64(cm), float64(skip)
+}
+
+// ResetRaBitQStats resets the global RaBitQ statistics.
+func ResetRaBitQStats() {
+	C.faiss_RaBitQStats_reset()
+}
+
+// RefineFlatSetKFactor sets the k_factor of an IndexRefineFlat.
+func RefineFlatSetKFactor(ptr uintptr, kFactor float32) {
+	C.faiss_IndexRefineFlat_set_k_factor(cIndex(ptr), C.float(kFactor))
+}
+
+// ReconstructVector returns the stored vector of key.
+func ReconstructVector(ptr uintptr, key int64) ([]float32, error) {
+	v := make([]float32, GetIndexDimension(ptr))
+	err := callError("faiss_Index_reconstruct", C.faiss_Index_reconstruct(cIndex(ptr), C.int64_t(key), floatPtr(v)))
+	return v, err
+}
+
+// MakeDirectMap makes an IVF index keep the array direct map it needs to
+// reconstruct vectors.
+func MakeDirectMap(ptr uintptr) error {
+	return callError("faiss_IndexIVF_make_direct_map", C.faiss_IndexIVF_make_direct_map(cIndex(ptr), 1))
+}
+
+// NewIndexFlatL2Panorama creates an exact L2 index storing its vectors in
+// level-major batches of batchSize.
+func NewIndexFlatL2Panorama(d, nLevels, batchSize int) (uintptr, error) {
+	var idx C.FaissIndex
+	if err := callError("faiss_IndexFlatL2Panorama_new",
+		C.faiss_IndexFlatL2Panorama_new(&idx, C.int64_t(d), C.int(nLevels), C.int64_t(batchSize))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// PanoramaLevels returns the number of levels of a Panorama index.
+func PanoramaLevels(ptr uintptr) (int, error) {
+	var n C.int
+	err := callError("faiss_Panorama_get_n_levels", C.faiss_Panorama_get_n_levels(cIndex(ptr), &n))
+	return int(n), err
+}
+
+// PanoramaBatchSize returns the storage batch size of an IVFFlat or FlatL2
+// Panorama index.
+func PanoramaBatchSize(ptr uintptr) (int64, error) {
+	var b C.int64_t
+	err := callError("faiss_Panorama_get_batch_size", C.faiss_Panorama_get_batch_size(cIndex(ptr), &b))
+	return int64(b), err
+}
+
+// ToPanorama converts an IVFFlat or HNSWFlat index to its Panorama variant
+// and returns it; the index passed in is freed on success.
+func ToPanorama(ptr uintptr, nLevels int) (uintptr, error) {
+	idx := cIndex(ptr)
+	if err := callError("faiss_Index_to_panorama_ext", C.faiss_Index_to_panorama_ext(&idx, C.int(nLevels))); err != nil {
+		return ptr, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// PanoramaStats returns the dimensions scanned by the Panorama searches
+// since the last ResetPanoramaStats and the dimensions of full scans.
+func PanoramaStats() (scanned, total uint64) {
+	var s, tot C.uint64_t
+	var ratio C.float
+	C.faiss_PanoramaStats_get(&s, &tot, &ratio)
+	return uint64(s), uint64(tot)
+}
+
+// ResetPanoramaStats resets the Panorama statistics.
+func ResetPanoramaStats() {
+	C.faiss_PanoramaStats_reset()
+}
+
+// FlatSearchFused searches an IndexFlat with the fused kernels, using
+// queryBS queries per task and dbBS database vectors per tile (0 for
+// automatic).
+func FlatSearchFused(ptr uintptr, x []float32, k, queryBS, dbBS int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexFlat_search_fused_ext",
+		C.faiss_IndexFlat_search_fused_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.int64_t(queryBS), C.int64_t(dbBS), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// NewIDSelectorRange selects the ids in [imin, imax).
+func NewIDSelectorRange(imin, imax int64) (uintptr, error) {
+	var sel C.FaissIDSelector
+	if err := callError("faiss_IDSelectorRange_new",
+		C.faiss_IDSelectorRange_new(&sel, C.int64_t(imin), C.int64_t(imax))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(sel)), nil
+}
+
+// FreeIDSelector frees a selector.
+func FreeIDSelector(sel uintptr) {
+	C.faiss_IDSelector_free(C.FaissIDSelector(unsafe.Pointer(sel)))
+}
+
+// BlasParams are the BLAS / SIMD crossover and tile sizes of a flat
+// search, negative fields use the process defaults.
+type BlasParams struct {
+	BlasThreshold int
+	QueryBS       int
+	DatabaseBS    int
+	MinKReservoir int
+}
+
+// NewBlasParams returns BLAS parameters that use the process defaults.
+func NewBlasParams() BlasParams {
+	var c C.FaissBlasParams
+	C.faiss_BlasParams_init(&c)
+	return blasParamsFromC(c)
+}
+
+func blasParamsFromC(c C.FaissBlasParams) BlasParams {
+	return BlasParams{int(c.blas_threshold), int(c.query_bs), int(c.database_bs), int(c.min_k_reservoir)}
+}
+
+func (p BlasParams) c() C.FaissBlasParams {
+	return C.FaissBlasParams{C.int(p.BlasThreshold), C.int(p.QueryBS), C.int(p.DatabaseBS), C.int(p.MinKReservoir)}
+}
+
+// GetBlasParams returns the process defaults.
+func GetBlasParams() (BlasParams, error) {
+	var c C.FaissBlasParams
+	err := callError("faiss_get_blas_params", C.faiss_get_blas_params(&c))
+	return blasParamsFromC(c), err
+}
+
+// SetBlasParams sets the process defaults from the non-negative fields.
+func SetBlasParams(p BlasParams) error {
+	c := p.c()
+	return callError("faiss_set_blas_params", C.faiss_set_blas_params(&c))
+}
+
+// FlatSearchBlas searches an IndexFlat with the BLAS parameters blas and
+// the selector of params (0 for none).
+func FlatSearchBlas(ptr uintptr, blas BlasParams, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	c := blas.c()
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexFlat_search_blas_ext",
+		C.faiss_IndexFlat_search_blas_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), &c,
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// IVFSearchBlas searches an IndexIVF whose coarse assignment uses the BLAS
+// parameters blas, with the optional SearchParametersIVF params.
+func IVFSearchBlas(ptr uintptr, blas BlasParams, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	c := blas.c()
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexIVF_search_blas_ext",
+		C.faiss_IndexIVF_search_blas_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), &c,
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// BlasCalibrate measures the BLAS parameters of the host for dimension d
+// and, with install, makes them the process defaults.
+func BlasCalibrate(d int, install bool) (BlasParams, error) {
+	var c C.FaissBlasParams
+	inst := C.int(0)
+	if install {
+		inst = 1
+	}
+	err := callError("faiss_blas_calibrate_ext", C.faiss_blas_calibrate_ext(C.int64_t(d), inst, &c))
+	return blasParamsFromC(c), err
+}
+
+// NewIndexShards returns an IndexShards of dimension d over shards, which
+// it does not own.
+func NewIndexShards(d int, shards []uintptr) (uintptr, error) {
+	var idx C.FaissIndex
+	if err := callError("faiss_IndexShards_new", C.faiss_IndexShards_new(&idx, C.int64_t(d))); err != nil {
+		return 0, err
+	}
+	for _, shard := range shards {
+		if err := callError("faiss_IndexShards_add_shard", C.faiss_IndexShards_add_shard(idx, cIndex(shard))); err != nil {
+			C.faiss_Index_free(idx)
+			return 0, err
+		}
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// ShardsSearch searches an IndexShards with a budget of nThreads and,
+// if deadlineMs > 0, a deadline. It returns the number of shards merged
+// and whether some missed the deadline. Until the shards that missed a
+// deadline are done, new searches of the index fail.
+func ShardsSearch(ptr uintptr, x []float32, k, nThreads int, deadlineMs float64) (D []float32, I []int64, nCompleted int, partial bool, err error) {
+	d := GetIndexDimension(ptr)
+	if d <= 0 {
+		return nil, nil, 0, false, fmt.Errorf("ShardsSearch: index dimension is %d", d)
+	}
+	n := len(x) / d
+	D = make([]float32, n*k)
+	I = make([]int64, n*k)
+	var done, part C.int
+	err = callError("faiss_IndexShards_search_ext",
+		C.faiss_IndexShards_search_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), C.int(nThreads),
+			C.double(deadlineMs), floatPtr(D), idPtr(I), &done, &part))
+	return D, I, int(done), part != 0, err
+}
+
+// ShardsWait waits for the shard searches left running by a deadline and
+// stops the worker pool of the index; call it before freeing an index
+// searched with a deadline.
+func ShardsWait(ptr uintptr) error {
+	return callError("faiss_IndexShards_wait_ext", C.faiss_IndexShards_wait_ext(cIndex(ptr)))
+}
+
+// CloneIndex returns a deep copy of an index.
+func CloneIndex(ptr uintptr) (uintptr, error) {
+	var out C.FaissIndex
+	if err := callError("faiss_clone_index", C.faiss_clone_index(cIndex(ptr), &out)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(out)), nil
+}
+
+// NewIndexReplicas returns an IndexReplicas of dimension d over replicas,
+// which it does not own.
+func NewIndexReplicas(d int, replicas []uintptr) (uintptr, error) {
+	var idx C.FaissIndex
+	if err := callError("faiss_IndexReplicas_new", C.faiss_IndexReplicas_new(&idx, C.int64_t(d))); err != nil {
+		return 0, err
+	}
+	for _, replica := range replicas {
+		if err := callError("faiss_IndexReplicas_add_replica", C.faiss_IndexReplicas_add_replica(idx, cIndex(replica))); err != nil {
+			C.faiss_Index_free(idx)
+			return 0, err
+		}
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// NumaNumNodes returns the number of NUMA nodes with CPUs.
+func NumaNumNodes() int {
+	var n C.int
+	C.faiss_numa_num_nodes(&n)
+	return int(n)
+}
+
+// NewReplicaRouter creates a router over the replicas of an IndexReplicas.
+// nodes gives the NUMA node of each replica's worker (-1 for none), nil
+// for no pinning.
+func NewReplicaRouter(replicas uintptr, smallBatch int, nodes []int) (uintptr, error) {
+	var cnodes []C.int
+	for _, node := range nodes {
+		cnodes = append(cnodes, C.int(node))
+	}
+	var p *C.int
+	if len(cnodes) > 0 {
+		p = &cnodes[0]
+	}
+	var r C.FaissReplicaRouter
+	if err := callError("faiss_ReplicaRouter_new",
+		C.faiss_ReplicaRouter_new(&r, cIndex(replicas), C.int64_t(smallBatch), p)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(r)), nil
+}
+
+func router(ptr uintptr) C.FaissReplicaRouter {
+	return C.FaissReplicaRouter(unsafe.Pointer(ptr))
+}
+
+// ReplicaRouterSearch searches the vectors x of dimension d through the
+// router.
+func ReplicaRouterSearch(ptr uintptr, d int, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / d
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_ReplicaRouter_search",
+		C.faiss_ReplicaRouter_search(router(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// ReplicaRouterQueueDepth returns the requests queued or running on a
+// replica.
+func ReplicaRouterQueueDepth(ptr uintptr, replica int) (int, error) {
+	var depth C.int
+	err := callError("faiss_ReplicaRouter_queue_depth", C.faiss_ReplicaRouter_queue_depth(router(ptr), C.int(replica), &depth))
+	return int(depth), err
+}
+
+// FreeReplicaRouter stops the workers of a router and frees it.
+func FreeReplicaRouter(ptr uintptr) {
+	C.faiss_ReplicaRouter_free(router(ptr))
+}
+
+// WriteIndex writes an index of the stock FAISS types to a file.
+func WriteIndex(ptr uintptr, fname string) error {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	return callError("faiss_write_index_fname", C.faiss_write_index_fname(cIndex(ptr), cname))
+}
+
+// NUMA placement policies of NumaPlace.
+const (
+	NumaBind       = 0
+	NumaInterleave = 1
+)
+
+// NumaPlace moves the memory of an index to the NUMA nodes (nil for all)
+// with policy. It returns the bytes placed and whether mbind was used.
+func NumaPlace(ptr uintptr, policy int, nodes []int) (int64, bool, error) {
+	cnodes := make([]C.int, len(nodes))
+	for i, node := range nodes {
+		cnodes[i] = C.int(node)
+	}
+	var p *C.int
+	if len(cnodes) > 0 {
+		p = &cnodes[0]
+	}
+	var nBytes C.int64_t
+	var usedMbind C.int
+	err := callError("faiss_Index_numa_place_ext",
+		C.faiss_Index_numa_place_ext(cIndex(ptr), C.int(policy), p, C.int(len(nodes)), &nBytes, &usedMbind))
+	return int64(nBytes), usedMbind != 0, err
+}
+
+// NumaPages returns the resident pages of the index data per NUMA node.
+func NumaPages(ptr uintptr) ([]int64, error) {
+	pages := make([]C.int64_t, 64)
+	var n C.int
+	if err := callError("faiss_Index_numa_pages_ext",
+		C.faiss_Index_numa_pages_ext(cIndex(ptr), &pages[0], C.int(len(pages)), &n)); err != nil {
+		return nil, err
+	}
+	out := make([]int64, n)
+	for i := range out {
+		out[i] = int64(pages[i])
+	}
+	return out, nil
+}
+
+// SearchOnNode searches an index from a worker pinned to a NUMA node.
+func SearchOnNode(ptr uintptr, node int, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search_on_node_ext",
+		C.faiss_Index_search_on_node_ext(cIndex(ptr), C.int(node), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// ReplicatePerNode returns an IndexReplicas with one copy of the index per
+// NUMA node, which it owns.
+func ReplicatePerNode(ptr uintptr) (uintptr, error) {
+	var out C.FaissIndex
+	if err := callError("faiss_Index_replicate_per_node_ext", C.faiss_Index_replicate_per_node_ext(cIndex(ptr), &out)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(out)), nil
+}
+
+// ReadIndexPerNode reads an index file into an IndexReplicas with one
+// copy per NUMA node.
+func ReadIndexPerNode(fname string, ioFlags int) (uintptr, error) {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	var out C.FaissIndex
+	if err := callError("faiss_read_index_per_node_ext", C.faiss_read_index_per_node_ext(cname, C.int(ioFlags), &out)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(out)), nil
+}
+
+// AddVectorsWithIDs adds the vectors x with ids to an index.
+func AddVectorsWithIDs(ptr uintptr, x []float32, ids []int64) error {
+	return callError("faiss_Index_add_with_ids",
+		C.faiss_Index_add_with_ids(cIndex(ptr), C.int64_t(len(ids)), floatPtr(x), idPtr(ids)))
+}
+
+// RemoveIDs removes ids from an index with IndexIVF::remove_ids and
+// similar, returning the number of entries removed.
+func RemoveIDs(ptr uintptr, ids []int64) (int, error) {
+	sel, err := NewIDSelectorBatch(ids)
+	if err != nil {
+		return 0, err
+	}
+	defer FreeIDSelector(sel)
+	var n C.size_t
+	err = callError("faiss_Index_remove_ids",
+		C.faiss_Index_remove_ids(cIndex(ptr), C.FaissIDSelector(unsafe.Pointer(sel)), &n))
+	return int(n), err
+}
+
+// NewIDSelectorBatch selects the given ids.
+func NewIDSelectorBatch(ids []int64) (uintptr, error) {
+	var sel C.FaissIDSelector
+	if err := callError("faiss_IDSelectorBatch_new",
+		C.faiss_IDSelectorBatch_new(&sel, C.size_t(len(ids)), idPtr(ids))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(sel)), nil
+}
+
+// IOFlagMmapIFC is the FAISS IO_FLAG_MMAP_IFC read flag: the arrays
+// that support it are views of the mapped file.
+const IOFlagMmapIFC = 1 << 9
+
+// NewIndexFactoryExt builds an index from a factory string that may also
+// use the "IDMap3," and "HNSWWide<M>" components of the extensions.
+func NewIndexFactoryExt(d int, description string, metric int) (uintptr, error) {
+	cdesc := C.CString(description)
+	defer C.free(unsafe.Pointer(cdesc))
+	var idx C.FaissIndex
+	if err := callError("faiss_index_factory_ext", C.faiss_index_factory_ext(&idx, C.int(d), cdesc, C.int(metric))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// IDMap3SubIndex returns the sub-index of an IndexIDMap3.
+func IDMap3SubIndex(ptr uintptr) (uintptr, error) {
+	var sub C.FaissIndex
+	if err := callError("faiss_IndexIDMap3_get_index", C.faiss_IndexIDMap3_get_index(cIndex(ptr), &sub)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(sub)), nil
+}
+
+// WriteIndexExt writes an index, extension types included, to a file.
+func WriteIndexExt(ptr uintptr, fname string) error {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	return callError("faiss_write_index_ext", C.faiss_write_index_ext(cIndex(ptr), cname))
+}
+
+// ReadIndexExt reads an index written by WriteIndexExt or by FAISS.
+func ReadIndexExt(fname string, ioFlags int) (uintptr, error) {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	var idx C.FaissIndex
+	if err := callError("faiss_read_index_ext", C.faiss_read_index_ext(cname, C.int(ioFlags), &idx)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// SetDirectMap sets the DirectMap type of an IVF index (0 none, 1 array,
+// 2 hashtable).
+func SetDirectMap(ptr uintptr, typ int) error {
+	return callError("faiss_IndexIVF_make_direct_map_ext",
+		C.faiss_IndexIVF_make_direct_map_ext(cIndex(ptr), C.int(typ), nil))
+}
+
+// NewIVFIdTable builds an id table for an IVF index.
+func NewIVFIdTable(ptr uintptr) (uintptr, error) {
+	var table C.FaissIVFIdTable
+	if err := callError("faiss_IVFIdTable_new", C.faiss_IVFIdTable_new(&table, cIndex(ptr), nil)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(table)), nil
+}
+
+func idTable(table uintptr) C.FaissIVFIdTable {
+	return C.FaissIVFIdTable(unsafe.Pointer(table))
+}
+
+// IVFIdTableLookup returns the list numbers and offsets of ids, -1 for
+// absent ids.
+func IVFIdTableLookup(table uintptr, ids []int64) ([]int64, []int64, error) {
+	listNos := make([]int64, len(ids))
+	offsets := make([]int64, len(ids))
+	err := callError("faiss_IVFIdTable_lookup",
+		C.faiss_IVFIdTable_lookup(idTable(table), C.int64_t(len(ids)), idPtr(ids), idPtr(listNos), idPtr(offsets)))
+	return listNos, offsets, err
+}
+
+// IVFIdTableReconstruct reconstructs the vectors of ids from the index
+// the table was built from.
+func IVFIdTableReconstruct(table, ptr uintptr, ids []int64) ([]float32, error) {
+	recons := make([]float32, len(ids)*GetIndexDimension(ptr))
+	err := callError("faiss_IVFIdTable_reconstruct",
+		C.faiss_IVFIdTable_reconstruct(idTable(table), cIndex(ptr), C.int64_t(len(ids)), idPtr(ids), floatPtr(recons)))
+	return recons, err
+}
+
+// IVFIdTableAddWithIDs adds vectors to the index and records them in the
+// table.
+func IVFIdTableAddWithIDs(table, ptr uintptr, x []float32, ids []int64) error {
+	return callError("faiss_IVFIdTable_add_with_ids",
+		C.faiss_IVFIdTable_add_with_ids(idTable(table), cIndex(ptr), C.int64_t(len(ids)), floatPtr(x), idPtr(ids)))
+}
+
+// IVFIdTableUpdateVectors replaces the vectors of existing ids.
+func IVFIdTableUpdateVectors(table, ptr uintptr, ids []int64, x []float32) error {
+	return callError("faiss_IVFIdTable_update_vectors",
+		C.faiss_IVFIdTable_update_vectors(idTable(table), cIndex(ptr), C.int64_t(len(ids)), idPtr(ids), floatPtr(x)))
+}
+
+// IVFIdTableStats returns the number of ids and of slots of the table.
+func IVFIdTableStats(table uintptr) (size, capacity int64, err error) {
+	var csize, ccap, cbytes C.int64_t
+	err = callError("faiss_IVFIdTable_stats", C.faiss_IVFIdTable_stats(idTable(table), &csize, &ccap, &cbytes))
+	return int64(csize), int64(ccap), err
+}
+
+// WriteIVFIdTable writes a table to a file.
+func WriteIVFIdTable(table uintptr, fname string) error {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	return callError("faiss_IVFIdTable_write", C.faiss_IVFIdTable_write(idTable(table), cname))
+}
+
+// ReadIVFIdTable reads a table file, mapping it with mmap.
+func ReadIVFIdTable(fname string, mmap bool) (uintptr, error) {
+	cname := C.CString(fname)
+	defer C.free(unsafe.Pointer(cname))
+	m := C.int(0)
+	if mmap {
+		m = 1
+	}
+	var table C.FaissIVFIdTable
+	if err := callError("faiss_IVFIdTable_read", C.faiss_IVFIdTable_read(&table, cname, m)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(table)), nil
+}
+
+// FreeIVFIdTable frees an id table.
+func FreeIVFIdTable(table uintptr) {
+	C.faiss_IVFIdTable_free(idTable(table))
+}
+
+// NewIVFTombstones makes a deferred-delete wrapper of an IVF index (not
+// owned).
+func NewIVFTombstones(ptr uintptr) (uintptr, error) {
+	var ts C.FaissIVFTombstones
+	if err := callError("faiss_IVFTombstones_new", C.faiss_IVFTombstones_new(&ts, cIndex(ptr))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(ts)), nil
+}
+
+func tombstones(ts uintptr) C.FaissIVFTombstones {
+	return C.FaissIVFTombstones(unsafe.Pointer(ts))
+}
+
+// IVFTombstonesDelete marks ids as deleted and returns how many were
+// newly deleted.
+func IVFTombstonesDelete(ts uintptr, ids []int64) (int64, error) {
+	var n C.int64_t
+	err := callError("faiss_IVFTombstones_delete",
+		C.faiss_IVFTombstones_delete(tombstones(ts), C.int64_t(len(ids)), idPtr(ids), &n))
+	return int64(n), err
+}
+
+// IVFTombstonesSearch searches the queries x of dimension d, skipping
+// deleted ids; params may be 0.
+func IVFTombstonesSearch(ts uintptr, d int, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / d
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IVFTombstones_search",
+		C.faiss_IVFTombstones_search(tombstones(ts), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// IVFTombstonesCompact removes the deleted entries from the inverted
+// lists and returns their number.
+func IVFTombstonesCompact(ts uintptr, listsPerBatch int) (int64, error) {
+	var n C.int64_t
+	err := callError("faiss_IVFTombstones_compact",
+		C.faiss_IVFTombstones_compact(tombstones(ts), C.int64_t(listsPerBatch), &n))
+	return int64(n), err
+}
+
+// IVFTombstonesPending returns the number of deleted ids not compacted yet.
+func IVFTombstonesPending(ts uintptr) int64 {
+	var pending, dirty, compacted C.int64_t
+	var ms C.double
+	C.faiss_IVFTombstones_stats(tombstones(ts), &pending, &dirty, &compacted, &ms)
+	return int64(pending)
+}
+
+// FreeIVFTombstones frees the wrapper.
+func FreeIVFTombstones(ts uintptr) {
+	C.faiss_IVFTombstones_free(tombstones(ts))
+}
+
+// RangeSearch runs Index::range_search and returns the result offsets,
+// labels and distances.
+func RangeSearch(ptr uintptr, x []float32, radius float32) ([]int64, []int64, []float32, error) {
+	nq := len(x) / GetIndexDimension(ptr)
+	var result C.FaissRangeSearchResult
+	if err := callError("faiss_RangeSearchResult_new", C.faiss_RangeSearchResult_new(&result, C.int64_t(nq))); err != nil {
+		return nil, nil, nil, err
+	}
+	defer C.faiss_RangeSearchResult_free(result)
+	if err := callError("faiss_Index_range_search",
+		C.faiss_Index_range_search(cIndex(ptr), C.int64_t(nq), floatPtr(x), C.float(radius), result)); err != nil {
+		return nil, nil, nil, err
+	}
+	return rangeSearchResult(result, nq)
+}
+
+// rangeSearchResult copies the offsets, labels and distances of a range
+// search result for nq queries.
+func rangeSearchResult(result C.FaissRangeSearchResult, nq int) ([]int64, []int64, []float32, error) {
+	var clims, clabels *C.int64_t
+	var cdistances *C.float
+	if err := callError("faiss_RangeSearchResult_get",
+		C.faiss_RangeSearchResult_get(result, &clims, &clabels, &cdistances)); err != nil {
+		return nil, nil, nil, err
+	}
+	lims := append([]int64(nil), unsafe.Slice((*int64)(unsafe.Pointer(clims)), nq+1)...)
+	total := lims[nq]
+	labels := append([]int64(nil), unsafe.Slice((*int64)(unsafe.Pointer(clabels)), total)...)
+	distances := append([]float32(nil), unsafe.Slice((*float32)(unsafe.Pointer(cdistances)), total)...)
+	return lims, labels, distances, nil
+}
+
+// NewRangeSearchArena creates a range search arena.
+func NewRangeSearchArena() (uintptr, error) {
+	var arena C.FaissRangeSearchArena
+	if err := callError("faiss_RangeSearchArena_new", C.faiss_RangeSearchArena_new(&arena)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(arena)), nil
+}
+
+func rangeArena(arena uintptr) C.FaissRangeSearchArena {
+	return C.FaissRangeSearchArena(unsafe.Pointer(arena))
+}
+
+// RangeSearchArenaReserve grows an arena to hold n results.
+func RangeSearchArenaReserve(arena uintptr, n int64) error {
+	return callError("faiss_RangeSearchArena_reserve", C.faiss_RangeSearchArena_reserve(rangeArena(arena), C.int64_t(n)))
+}
+
+// RangeSearchWithArena range searches into labels and distances, or into
+// the arena when the results do not fit, keeping at most maxPerQuery
+// results per query (0 for all). It returns the number of results and
+// whether they went to the caller buffers.
+func RangeSearchWithArena(ptr, params uintptr, x []float32, radius float32, maxPerQuery int, arena uintptr,
+	labels []int64, distances []float32) (int64, bool, error) {
+	nq := len(x) / GetIndexDimension(ptr)
+	var total C.int64_t
+	var inOutput C.int
+	err := callError("faiss_Index_range_search_arena_ext",
+		C.faiss_Index_range_search_arena_ext(cIndex(ptr), C.int64_t(nq), floatPtr(x), C.float(radius),
+			C.FaissSearchParameters(unsafe.Pointer(params)), C.int64_t(maxPerQuery), rangeArena(arena),
+			idPtr(labels), floatPtr(distances), C.int64_t(min(len(labels), len(distances))), &total, &inOutput))
+	return int64(total), inOutput != 0, err
+}
+
+// RangeSearchArenaResults returns copies of the results of the last
+// search kept in an arena, read in place; labels and distances are nil if
+// they went to the caller buffers.
+func RangeSearchArenaResults(arena uintptr) ([]int64, []int64, []float32, error) {
+	var nq C.int64_t
+	var clims, clabels *C.int64_t
+	var cdistances *C.float
+	if err := callError("faiss_RangeSearchArena_get",
+		C.faiss_RangeSearchArena_get(rangeArena(arena), &nq, &clims, &clabels, &cdistances)); err != nil {
+		return nil, nil, nil, err
+	}
+	lims := append([]int64(nil), unsafe.Slice((*int64)(unsafe.Pointer(clims)), nq+1)...)
+	if clabels == nil {
+		return lims, nil, nil, nil
+	}
+	total := lims[nq]
+	labels := append([]int64(nil), unsafe.Slice((*int64)(unsafe.Pointer(clabels)), total)...)
+	distances := append([]float32(nil), unsafe.Slice((*float32)(unsafe.Pointer(cdistances)), total)...)
+	return lims, labels, distances, nil
+}
+
+// RangeSearchArenaCopy copies the offsets of the last search of nq
+// queries and, when withResults is set, its total results out of an
+// arena.
+func RangeSearchArenaCopy(arena uintptr, nq int, total int64, withResults bool) ([]int64, []int64, []float32, error) {
+	lims := make([]int64, nq+1)
+	var labels []int64
+	var distances []float32
+	if withResults {
+		labels = make([]int64, total)
+		distances = make([]float32, total)
+	}
+	err := callError("faiss_RangeSearchArena_copy_to",
+		C.faiss_RangeSearchArena_copy_to(rangeArena(arena), idPtr(lims), idPtr(labels), floatPtr(distances)))
+	return lims, labels, distances, err
+}
+
+// RangeSearchArenaStats returns the results an arena holds and how often
+// it grew.
+func RangeSearchArenaStats(arena uintptr) (capacity, nAllocations int64, err error) {
+	var ccap, calloc C.int64_t
+	err = callError("faiss_RangeSearchArena_stats", C.faiss_RangeSearchArena_stats(rangeArena(arena), &ccap, &calloc))
+	return int64(ccap), int64(calloc), err
+}
+
+// FreeRangeSearchArena frees an arena.
+func FreeRangeSearchArena(arena uintptr) {
+	C.faiss_RangeSearchArena_free(rangeArena(arena))
+}
+
+// NewSearchContext creates a search context.
+func NewSearchContext() (uintptr, error) {
+	var ctx C.FaissSearchContext
+	if err := callError("faiss_SearchContext_new", C.faiss_SearchContext_new(&ctx)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(ctx)), nil
+}
+
+func searchContext(ctx uintptr) C.FaissSearchContext {
+	return C.FaissSearchContext(unsafe.Pointer(ctx))
+}
+
+// SearchWithContext searches an index with the buffers of ctx (0 for the
+// calling thread's own) and the optional params.
+func SearchWithContext(ptr, ctx, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search_ctx_ext",
+		C.faiss_Index_search_ctx_ext(cIndex(ptr), searchContext(ctx), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// SearchContextStats returns the bytes held by a context, how often its
+// buffers grew and the searches made with it.
+func SearchContextStats(ctx uintptr) (bytes, nGrows, nSearches int64, err error) {
+	var cbytes, cgrows, csearches C.int64_t
+	err = callError("faiss_SearchContext_stats", C.faiss_SearchContext_stats(searchContext(ctx), &cbytes, &cgrows, &csearches))
+	return int64(cbytes), int64(cgrows), int64(csearches), err
+}
+
+// ResetSearchContext releases the buffers of a context.
+func ResetSearchContext(ctx uintptr) error {
+	return callError("faiss_SearchContext_reset", C.faiss_SearchContext_reset(searchContext(ctx)))
+}
+
+// FreeSearchContext frees a search context.
+func FreeSearchContext(ctx uintptr) {
+	C.faiss_SearchContext_free(searchContext(ctx))
+}
+
+// Visited sets of NewSearchParametersGraph.
+const (
+	VisitedAuto   = 0
+	VisitedDense  = 1
+	VisitedSparse = 2
+)
+
+// NewSearchParametersGraph creates graph search parameters with beam
+// width ef (0 for the index setting) and a visited set mode.
+func NewSearchParametersGraph(ef, visitedMode int) (uintptr, error) {
+	var params C.FaissSearchParameters
+	if err := callError("faiss_SearchParametersGraph_new",
+		C.faiss_SearchParametersGraph_new(&params, C.int(ef), C.int(visitedMode))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(params)), nil
+}
+
+// FreeSearchParametersGraph frees graph search parameters.
+func FreeSearchParametersGraph(params uintptr) {
+	C.faiss_SearchParametersGraph_free(C.FaissSearchParameters(unsafe.Pointer(params)))
+}
+
+// SearchGraph searches an HNSW, NSG or NNDescent index with an adaptive
+// visited set and the optional params.
+func SearchGraph(ptr, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search_graph_ext",
+		C.faiss_Index_search_graph_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// NewParameterSpace creates a ParameterSpace, with the default ranges of
+// idx unless it is 0.
+func NewParameterSpace(idx uintptr) (uintptr, error) {
+	var space C.FaissParameterSpace
+	if err := callError("faiss_ParameterSpace_new_ext", C.faiss_ParameterSpace_new_ext(&space, cIndex(idx))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(space)), nil
+}
+
+func parameterSpace(space uintptr) C.FaissParameterSpace {
+	return C.FaissParameterSpace(unsafe.Pointer(space))
+}
+
+// ParameterSpaceSetRange sets the values of a parameter range.
+func ParameterSpaceSetRange(space uintptr, name string, values []float64) error {
+	cname := C.CString(name)
+	defer C.free(unsafe.Pointer(cname))
+	var p *C.double
+	if len(values) > 0 {
+		p = (*C.double)(unsafe.Pointer(&values[0]))
+	}
+	return callError("faiss_ParameterSpace_set_range_ext",
+		C.faiss_ParameterSpace_set_range_ext(parameterSpace(space), cname, p, C.size_t(len(values))))
+}
+
+// FreeParameterSpace frees a ParameterSpace.
+func FreeParameterSpace(space uintptr) {
+	C.faiss_ParameterSpace_free_ext(parameterSpace(space))
+}
+
+// Criteria of ParameterSpaceExplore.
+const (
+	CriterionOneRecall    = 0
+	CriterionIntersection = 1
+)
+
+// OperatingPoint is one explored combination of a ParameterSpace.
+type OperatingPoint struct {
+	Perf float64 // criterion value
+	T    float64 // search time of the query set (ms)
+	Cno  int64   // combination number
+	Key  string  // combination name
+}
+
+// ParameterSpaceExploreOps explores the combinations of a space on idx
+// with the ground truth gtI (gtK labels per query), nThreads combinations
+// at a time and a pruning pass on nSubset queries. It returns the
+// operating points, to free with FreeOperatingPoints, and the number of
+// pruned combinations.
+func ParameterSpaceExploreOps(space, idx uintptr, xq []float32, gtK int, gtI []int64, criterion, R, nThreads, nSubset int) (uintptr, int64, error) {
+	nq := len(xq) / GetIndexDimension(idx)
+	var ops C.FaissOperatingPoints
+	var pruned C.int64_t
+	if err := callError("faiss_ParameterSpace_explore_ext",
+		C.faiss_ParameterSpace_explore_ext(parameterSpace(space), cIndex(idx), C.int64_t(nq), floatPtr(xq), C.int64_t(gtK),
+			idPtr(gtI), C.int(criterion), C.int64_t(R), C.int(nThreads), C.int64_t(nSubset), &ops, &pruned)); err != nil {
+		return 0, 0, err
+	}
+	return uintptr(unsafe.Pointer(ops)), int64(pruned), nil
+}
+
+func operatingPoints(ops uintptr) C.FaissOperatingPoints {
+	return C.FaissOperatingPoints(unsafe.Pointer(ops))
+}
+
+// OperatingPoints returns all the operating points or the Pareto-optimal
+// ones.
+func OperatingPoints(ops uintptr, onlyOptimal bool) ([]OperatingPoint, error) {
+	optimal := C.int(0)
+	if onlyOptimal {
+		optimal = 1
+	}
+	var n C.size_t
+	if err := callError("faiss_OperatingPoints_size", C.faiss_OperatingPoints_size(operatingPoints(ops), optimal, &n)); err != nil {
+		return nil, err
+	}
+	out := make([]OperatingPoint, n)
+	key := make([]C.char, 256)
+	for i := range out {
+		var perf, t C.double
+		var cno C.int64_t
+		if err := callError("faiss_OperatingPoints_get",
+			C.faiss_OperatingPoints_get(operatingPoints(ops), optimal, C.size_t(i), &perf, &t, &cno, &key[0], C.size_t(len(key)))); err != nil {
+			return nil, err
+		}
+		out[i] = OperatingPoint{float64(perf), float64(t), int64(cno), C.GoString(&key[0])}
+	}
+	return out, nil
+}
+
+// FreeOperatingPoints frees operating points.
+func FreeOperatingPoints(ops uintptr) {
+	C.faiss_OperatingPoints_free(operatingPoints(ops))
+}
+
+// ParameterSpaceExplore is ParameterSpaceExploreOps returning all the
+// points and the Pareto-optimal ones.
+func ParameterSpaceExplore(space, idx uintptr, xq []float32, gtK int, gtI []int64, criterion, R, nThreads, nSubset int) (
+	all, optimal []OperatingPoint, nPruned int64, err error) {
+	ops, nPruned, err := ParameterSpaceExploreOps(space, idx, xq, gtK, gtI, criterion, R, nThreads, nSubset)
+	if err != nil {
+		return nil, nil, 0, err
+	}
+	defer FreeOperatingPoints(ops)
+	if all, err = OperatingPoints(ops, false); err != nil {
+		return nil, nil, 0, err
+	}
+	optimal, err = OperatingPoints(ops, true)
+	return all, optimal, nPruned, err
+}
+
+// NewSearchController creates a controller keeping the p95 latency of the
+// search calls on idx under targetMs, with the ladder of ops (explored on
+// space), of a one-range space, or the default one when both are 0.
+func NewSearchController(idx uintptr, targetMs float64, space, ops uintptr) (uintptr, error) {
+	var ctrl C.FaissSearchController
+	if err := callError("faiss_SearchController_new",
+		C.faiss_SearchController_new(&ctrl, cIndex(idx), C.double(targetMs), parameterSpace(space), operatingPoints(ops))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(ctrl)), nil
+}
+
+func controller(ctrl uintptr) C.FaissSearchController {
+	return C.FaissSearchController(unsafe.Pointer(ctrl))
+}
+
+// SearchControllerSearch searches the vectors x of dimension d at the
+// current level.
+func SearchControllerSearch(ctrl uintptr, d int, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / d
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_SearchController_search",
+		C.faiss_SearchController_search(controller(ctrl), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// SearchControllerState returns the current level, the number of levels
+// and the parameters of the current level.
+func SearchControllerState(ctrl uintptr) (level, nLevels int, key string, err error) {
+	var clevel, cn C.int
+	ckey := make([]C.char, 256)
+	if err = callError("faiss_SearchController_get_state",
+		C.faiss_SearchController_get_state(controller(ctrl), &clevel, &cn, nil, &ckey[0], C.size_t(len(ckey)))); err != nil {
+		return 0, 0, "", err
+	}
+	return int(clevel), int(cn), C.GoString(&ckey[0]), nil
+}
+
+// SearchControllerSetTarget changes the latency target.
+func SearchControllerSetTarget(ctrl uintptr, targetMs float64) error {
+	return callError("faiss_SearchController_set_target", C.faiss_SearchController_set_target(controller(ctrl), C.double(targetMs)))
+}
+
+// LevelChange is one level change of a search controller.
+type LevelChange struct {
+	Call     int64
+	TimeMs   float64
+	From, To int
+	P95Ms    float64
+}
+
+// SearchControllerHistory returns the level changes, oldest first.
+func SearchControllerHistory(ctrl uintptr) ([]LevelChange, error) {
+	var n C.size_t
+	if err := callError("faiss_SearchController_history_size", C.faiss_SearchController_history_size(controller(ctrl), &n)); err != nil {
+		return nil, err
+	}
+	out := make([]LevelChange, n)
+	for i := range out {
+		var call C.int64_t
+		var timeMs, p95 C.double
+		var from, to C.int
+		if err := callError("faiss_SearchController_get_history",
+			C.faiss_SearchController_get_history(controller(ctrl), C.size_t(i), &call, &timeMs, &from, &to, &p95)); err != nil {
+			return nil, err
+		}
+		out[i] = LevelChange{int64(call), float64(timeMs), int(from), int(to), float64(p95)}
+	}
+	return out, nil
+}
+
+// FreeSearchController frees a controller.
+func FreeSearchController(ctrl uintptr) {
+	C.faiss_SearchController_free(controller(ctrl))
+}
+
+// NewCompiledFactory parses a factory description once; its instances are
+// clones of the empty index.
+func NewCompiledFactory(d int, description string, metric int) (uintptr, error) {
+	cdesc := C.CString(description)
+	defer C.free(unsafe.Pointer(cdesc))
+	var f C.FaissCompiledFactory
+	if err := callError("faiss_CompiledFactory_new", C.faiss_CompiledFactory_new(&f, C.int(d), cdesc, C.int(metric))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(f)), nil
+}
+
+// NewCompiledFactoryFromIndex makes a factory whose instances are copies
+// of idx without its vectors, sharing its training.
+func NewCompiledFactoryFromIndex(idx uintptr) (uintptr, error) {
+	var f C.FaissCompiledFactory
+	if err := callError("faiss_CompiledFactory_from_index", C.faiss_CompiledFactory_from_index(&f, cIndex(idx))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(f)), nil
+}
+
+func compiledFactory(f uintptr) C.FaissCompiledFactory {
+	return C.FaissCompiledFactory(unsafe.Pointer(f))
+}
+
+// CompiledFactoryInstantiate creates an empty index. It is safe to call
+// from several goroutines.
+func CompiledFactoryInstantiate(f uintptr) (uintptr, error) {
+	var idx C.FaissIndex
+	if err := callError("faiss_CompiledFactory_instantiate", C.faiss_CompiledFactory_instantiate(compiledFactory(f), &idx)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// FreeCompiledFactory frees a compiled factory.
+func FreeCompiledFactory(f uintptr) {
+	C.faiss_CompiledFactory_free(compiledFactory(f))
+}
+
+// ReverseIndexFactory returns a factory string that rebuilds the structure
+// of an index.
+func ReverseIndexFactory(idx uintptr) (string, error) {
+	var length C.size_t
+	if err := callError("faiss_reverse_index_factory_ext", C.faiss_reverse_index_factory_ext(cIndex(idx), nil, 0, &length)); err != nil {
+		return "", err
+	}
+	buf := make([]C.char, length+1)
+	if err := callError("faiss_reverse_index_factory_ext",
+		C.faiss_reverse_index_factory_ext(cIndex(idx), &buf[0], C.size_t(len(buf)), nil)); err != nil {
+		return "", err
+	}
+	return C.GoString(&buf[0]), nil
+}
+
+// IndexNode is one node of an index tree, see DescribeIndex.
+type IndexNode struct {
+	Parent   int    // -1 for the root
+	Role     string // index, quantizer, storage, base, refine, transform, shard or replica
+	Type     string // class name, e.g. IndexIVFPQ
+	D        int64
+	Ntotal   int64
+	CodeSize int
+	Metric   int
+	Trained  bool
+	Owned    bool
+	Nlist    int
+	M        int
+	Nbits    int
+	QType    string
+}
+
+// DescribeIndex returns the tree of an index, parents before their
+// children.
+func DescribeIndex(idx uintptr) ([]IndexNode, error) {
+	var n C.size_t
+	if err := callError("faiss_Index_describe_ext", C.faiss_Index_describe_ext(cIndex(idx), nil, 0, &n)); err != nil {
+		return nil, err
+	}
+	nodes := make([]C.FaissIndexNode, n)
+	if n > 0 {
+		if err := callError("faiss_Index_describe_ext", C.faiss_Index_describe_ext(cIndex(idx), &nodes[0], n, &n)); err != nil {
+			return nil, err
+		}
+	}
+	out := make([]IndexNode, len(nodes))
+	for i := range nodes {
+		c := &nodes[i]
+		out[i] = IndexNode{int(c.parent), C.GoString(&c.role[0]), C.GoString(&c._type[0]), int64(c.d), int64(c.ntotal),
+			int(c.code_size), int(c.metric_type), c.is_trained != 0, c.owned != 0, int(c.nlist), int(c.M), int(c.nbits),
+			C.GoString(&c.qtype[0])}
+	}
+	return out, nil
+}
+
+// NewSnapshotIndex makes a snapshot index from a trained index.
+func NewSnapshotIndex(ptr uintptr) (uintptr, error) {
+	var snap C.FaissSnapshotIndex
+	if err := callError("faiss_SnapshotIndex_new", C.faiss_SnapshotIndex_new(&snap, cIndex(ptr))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(snap)), nil
+}
+
+func snapshot(snap uintptr) C.FaissSnapshotIndex {
+	return C.FaissSnapshotIndex(unsafe.Pointer(snap))
+}
+
+// SnapshotIndexAdd adds n vectors and publishes a new snapshot.
+func SnapshotIndexAdd(snap uintptr, n int, x []float32) error {
+	return callError("faiss_SnapshotIndex_add", C.faiss_SnapshotIndex_add(snapshot(snap), C.int64_t(n), floatPtr(x)))
+}
+
+// SnapshotIndexAddWithIDs adds vectors with ids and publishes a new snapshot.
+func SnapshotIndexAddWithIDs(snap uintptr, x []float32, ids []int64) error {
+	return callError("faiss_SnapshotIndex_add_with_ids",
+		C.faiss_SnapshotIndex_add_with_ids(snapshot(snap), C.int64_t(len(ids)), floatPtr(x), idPtr(ids)))
+}
+
+// SnapshotIndexAcquire returns the current snapshot, to free with
+// FreeIndex, and the number of adds it includes.
+func SnapshotIndexAcquire(snap uintptr) (uintptr, uint64, error) {
+	var idx C.FaissIndex
+	var version C.uint64_t
+	if err := callError("faiss_SnapshotIndex_acquire",
+		C.faiss_SnapshotIndex_acquire(snapshot(snap), &idx, &version)); err != nil {
+		return 0, 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), uint64(version), nil
+}
+
+// SnapshotIndexNtotal returns the number of vectors of the current snapshot.
+func SnapshotIndexNtotal(snap uintptr) int64 {
+	var n C.int64_t
+	C.faiss_SnapshotIndex_ntotal(snapshot(snap), &n)
+	return int64(n)
+}
+
+// FreeSnapshotIndex frees a snapshot index.
+func FreeSnapshotIndex(snap uintptr) {
+	C.faiss_SnapshotIndex_free(snapshot(snap))
+}
+
+// SegmentInfo describes one segment of a segmented index.
+type SegmentInfo struct {
+	Number   uint64
+	State    int // 0 write, 1 frozen, 2 sealed
+	Ntotal   int64
+	NDeleted int64
+}
+
+// NewSegmentedIndex makes an index taking upserts and deletes from a Flat
+// or HNSW write template and a trained IVF segment template (both copied).
+func NewSegmentedIndex(writeTmpl, segmentTmpl uintptr, writeCapacity, maxSegments, mergeFactor int, purgeFraction float64, background bool) (uintptr, error) {
+	var idx C.FaissSegmentedIndex
+	bg := C.int(0)
+	if background {
+		bg = 1
+	}
+	err := callError("faiss_SegmentedIndex_new",
+		C.faiss_SegmentedIndex_new(&idx, cIndex(writeTmpl), cIndex(segmentTmpl), C.int64_t(writeCapacity),
+			C.size_t(maxSegments), C.size_t(mergeFactor), C.double(purgeFraction), bg))
+	if err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+func segmented(ptr uintptr) C.FaissSegmentedIndex {
+	return C.FaissSegmentedIndex(unsafe.Pointer(ptr))
+}
+
+// SegmentedIndexAdd adds or replaces the vectors x with ids.
+func SegmentedIndexAdd(ptr uintptr, x []float32, ids []int64) error {
+	return callError("faiss_SegmentedIndex_add_with_ids",
+		C.faiss_SegmentedIndex_add_with_ids(segmented(ptr), C.int64_t(len(ids)), floatPtr(x), idPtr(ids)))
+}
+
+// SegmentedIndexRemove deletes ids and returns how many were in the index.
+func SegmentedIndexRemove(ptr uintptr, ids []int64) (int, error) {
+	var n C.size_t
+	err := callError("faiss_SegmentedIndex_remove",
+		C.faiss_SegmentedIndex_remove(segmented(ptr), C.int64_t(len(ids)), idPtr(ids), &n))
+	return int(n), err
+}
+
+// SegmentedIndexSearch searches the queries x of dimension d in all
+// segments.
+func SegmentedIndexSearch(ptr uintptr, d int, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / d
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_SegmentedIndex_search",
+		C.faiss_SegmentedIndex_search(segmented(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
+
+// SegmentedIndexSetSearchParams sets nprobe of the IVF segments and
+// efSearch of HNSW write segments, 0 for the template values.
+func SegmentedIndexSetSearchParams(ptr uintptr, nprobe, efSearch int) error {
+	return callError("faiss_SegmentedIndex_set_search_params",
+		C.faiss_SegmentedIndex_set_search_params(segmented(ptr), C.int(nprobe), C.int(efSearch)))
+}
+
+// SegmentedIndexFlush seals the write segment and waits for the pending
+// seals and merges.
+func SegmentedIndexFlush(ptr uintptr) error {
+	return callError("faiss_SegmentedIndex_flush", C.faiss_SegmentedIndex_flush(segmented(ptr)))
+}
+
+// SegmentedIndexNtotal returns the number of vectors that are not deleted.
+func SegmentedIndexNtotal(ptr uintptr) int64 {
+	var n C.int64_t
+	C.faiss_SegmentedIndex_ntotal(segmented(ptr), &n)
+	return int64(n)
+}
+
+// SegmentedIndexSegments lists the segments, the write segment last.
+func SegmentedIndexSegments(ptr uintptr) ([]SegmentInfo, error) {
+	var n C.size_t
+	if err := callError("faiss_SegmentedIndex_segments", C.faiss_SegmentedIndex_segments(segmented(ptr), nil, 0, &n)); err != nil {
+		return nil, err
+	}
+	infos := make([]C.FaissSegmentInfo, n+4)
+	if err := callError("faiss_SegmentedIndex_segments",
+		C.faiss_SegmentedIndex_segments(segmented(ptr), &infos[0], C.size_t(len(infos)), &n)); err != nil {
+		return nil, err
+	}
+	out := make([]SegmentInfo, 0, n)
+	for _, info := range infos[:min(int(n), len(infos))] {
+		out = append(out, SegmentInfo{uint64(info.number), int(info.state), int64(info.ntotal), int64(info.n_deleted)})
+	}
+	return out, nil
+}
+
+// FreeSegmentedIndex frees a segmented index.
+func FreeSegmentedIndex(ptr uintptr) {
+	C.faiss_SegmentedIndex_free(segmented(ptr))
+}
+
+// IVFMergeFrom moves the entries of the IVF index other into index,
+// adding addID to their ids (IndexIVF::merge_from).
+func IVFMergeFrom(ptr, other uintptr, addID int64) error {
+	return callError("faiss_IndexIVF_merge_from", C.faiss_IndexIVF_merge_from(cIndex(ptr), cIndex(other), C.int64_t(addID)))
+}
+
+// CloneIndexParallel returns a deep copy of an index whose inverted lists
+// are copied by nThreads threads (0 for the default).
+func CloneIndexParallel(ptr uintptr, nThreads int) (uintptr, error) {
+	var out C.FaissIndex
+	if err := callError("faiss_clone_index_parallel", C.faiss_clone_index_parallel(cIndex(ptr), &out, C.int(nThreads))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(out)), nil
+}
+
+// CloneIndexShallow returns a copy of an index that shares the list codes
+// of its IVF index until either side modifies a list.
+func CloneIndexShallow(ptr uintptr) (uintptr, error) {
+	var out C.FaissIndex
+	if err := callError("faiss_clone_index_shallow", C.faiss_clone_index_shallow(cIndex(ptr), &out)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(out)), nil
+}
+
+// MergeIntoParallel merges the IVF indexes srcs into dst in one pass over
+// the lists, leaving them empty.
+func MergeIntoParallel(dst uintptr, srcs []uintptr, shiftIDs bool, nThreads int) error {
+	csrcs := make([]C.FaissIndex, len(srcs))
+	for i, src := range srcs {
+		csrcs[i] = cIndex(src)
+	}
+	var p *C.FaissIndex
+	if len(csrcs) > 0 {
+		p = &csrcs[0]
+	}
+	shift := C.int(0)
+	if shiftIDs {
+		shift = 1
+	}
+	return callError("faiss_merge_into_parallel",
+		C.faiss_merge_into_parallel(cIndex(dst), p, C.size_t(len(srcs)), shift, C.int(nThreads)))
+}
+
+func cIndexBinary(ptr uintptr) C.FaissIndexBinary {
+	return C.FaissIndexBinary(unsafe.Pointer(ptr))
+}
+
+func bytePtr(x []uint8) *C.uint8_t {
+	if len(x) == 0 {
+		return nil
+	}
+	return (*C.uint8_t)(unsafe.Pointer(&x[0]))
+}
+
+func newIndexBinary(name string, create func(*C.FaissIndexBinary) C.int) (uintptr, error) {
+	var idx C.FaissIndexBinary
+	if err := callError(name, create(&idx)); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(idx)), nil
+}
+
+// NewIndexBinaryFlat creates an exact binary index of d bits.
+func NewIndexBinaryFlat(d int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryFlat_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryFlat_new(p, C.int64_t(d))
+	})
+}
+
+// NewIndexBinaryIVF creates a binary IVF index over quantizer, which must
+// outlive it.
+func NewIndexBinaryIVF(quantizer uintptr, d, nlist int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryIVF_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryIVF_new(p, cIndexBinary(quantizer), C.int64_t(d), C.int64_t(nlist))
+	})
+}
+
+// NewIndexBinaryHNSW creates a binary HNSW index with M neighbors per node.
+func NewIndexBinaryHNSW(d, M int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryHNSW_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryHNSW_new(p, C.int64_t(d), C.int(M))
+	})
+}
+
+// NewIndexBinaryHNSWCagra creates a binary HNSW index whose base level can
+// be filled from a CAGRA graph.
+func NewIndexBinaryHNSWCagra(d, M int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryHNSWCagra_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryHNSWCagra_new(p, C.int64_t(d), C.int(M))
+	})
+}
+
+// NewIndexBinaryHash creates a binary index bucketing the codes by their
+// first b bits.
+func NewIndexBinaryHash(d, b int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryHash_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryHash_new(p, C.int64_t(d), C.int(b))
+	})
+}
+
+// NewIndexBinaryMultiHash creates a binary index with nhash hash tables
+// keyed by consecutive b-bit slices of the codes.
+func NewIndexBinaryMultiHash(d, nhash, b int) (uintptr, error) {
+	return newIndexBinary("faiss_IndexBinaryMultiHash_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryMultiHash_new(p, C.int64_t(d), C.int(nhash), C.int(b))
+	})
+}
+
+// NewIndexBinaryFromFloat creates a binary index searching the float index
+// with the codes as +-1 vectors; with ownIndex it frees index.
+func NewIndexBinaryFromFloat(index uintptr, ownIndex bool) (uintptr, error) {
+	own := 0
+	if ownIndex {
+		own = 1
+	}
+	return newIndexBinary("faiss_IndexBinaryFromFloat_new", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_IndexBinaryFromFloat_new(p, cIndex(index), C.int(own))
+	})
+}
+
+// NewIndexBinaryFactory builds a binary index from a description ("BFlat",
+// "BIVF1024", "BHNSW32", "BHash16", ...).
+func NewIndexBinaryFactory(d int, description string) (uintptr, error) {
+	cdesc := C.CString(description)
+	defer C.free(unsafe.Pointer(cdesc))
+	return newIndexBinary("faiss_index_binary_factory_ext", func(p *C.FaissIndexBinary) C.int {
+		return C.faiss_index_binary_factory_ext(p, C.int(d), cdesc)
+	})
+}
+
+// FreeIndexBinary frees a binary index.
+func FreeIndexBinary(ptr uintptr) {
+	C.faiss_IndexBinary_free(cIndexBinary(ptr))
+}
+
+// GetIndexBinaryDimension returns the dimension of a binary index in bits.
+func GetIndexBinaryDimension(ptr uintptr) int {
+	return int(C.faiss_IndexBinary_d(cIndexBinary(ptr)))
+}
+
+// GetIndexBinaryNtotal returns the number of codes of a binary index.
+func GetIndexBinaryNtotal(ptr uintptr) int64 {
+	return int64(C.faiss_IndexBinary_ntotal(cIndexBinary(ptr)))
+}
+
+// TrainIndexBinary trains a binary index on the codes x.
+func TrainIndexBinary(ptr uintptr, x []uint8) error {
+	n := len(x) / (GetIndexBinaryDimension(ptr) / 8)
+	return callError("faiss_IndexBinary_train", C.faiss_IndexBinary_train(cIndexBinary(ptr), C.int64_t(n), bytePtr(x)))
+}
+
+// AddBinary adds the codes x to a binary index.
+func AddBinary(ptr uintptr, x []uint8) error {
+	n := len(x) / (GetIndexBinaryDimension(ptr) / 8)
+	return callError("faiss_IndexBinary_add", C.faiss_IndexBinary_add(cIndexBinary(ptr), C.int64_t(n), bytePtr(x)))
+}
+
+// SearchBinary returns the Hamming distances and labels of the k nearest
+// codes of each query.
+func SearchBinary(ptr uintptr, x []uint8, k int) ([]int32, []int64, error) {
+	n := len(x) / (GetIndexBinaryDimension(ptr) / 8)
+	D := make([]int32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_IndexBinary_search",
+		C.faiss_IndexBinary_search(cIndexBinary(ptr), C.int64_t(n), bytePtr(x), C.int64_t(k),
+			(*C.int32_t)(unsafe.Pointer(&D[0])), idPtr(I)))
+	return D, I, err
+}
+
+// SetBinaryIVFNprobe sets the lists probed per query by a binary IVF index.
+func SetBinaryIVFNprobe(ptr uintptr, nprobe int) error {
+	return callError("faiss_IndexBinaryIVF_set_nprobe_ext",
+		C.faiss_IndexBinaryIVF_set_nprobe_ext(cIndexBinary(ptr), C.int64_t(nprobe)))
+}
+
+// BinaryIVFNprobe returns the nprobe of a binary IVF index.
+func BinaryIVFNprobe(ptr uintptr) (int, error) {
+	var nprobe C.int64_t
+	err := callError("faiss_IndexBinaryIVF_get_nprobe", C.faiss_IndexBinaryIVF_get_nprobe(cIndexBinary(ptr), &nprobe))
+	return int(nprobe), err
+}
+
+// SetBinaryIVFMaxCodes sets the codes a binary IVF index visits per query,
+// 0 for no limit.
+func SetBinaryIVFMaxCodes(ptr uintptr, maxCodes int) error {
+	return callError("faiss_IndexBinaryIVF_set_max_codes_ext",
+		C.faiss_IndexBinaryIVF_set_max_codes_ext(cIndexBinary(ptr), C.int64_t(maxCodes)))
+}
+
+// SetBinaryHNSWEfSearch sets efSearch of a binary HNSW index.
+func SetBinaryHNSWEfSearch(ptr uintptr, ef int) error {
+	return callError("faiss_IndexBinaryHNSW_set_efSearch", C.faiss_IndexBinaryHNSW_set_efSearch(cIndexBinary(ptr), C.int(ef)))
+}
+
+// BinaryHNSWEfSearch returns efSearch of a binary HNSW index.
+func BinaryHNSWEfSearch(ptr uintptr) (int, error) {
+	var ef C.int
+	err := callError("faiss_IndexBinaryHNSW_get_efSearch", C.faiss_IndexBinaryHNSW_get_efSearch(cIndexBinary(ptr), &ef))
+	return int(ef), err
+}
+
+// SetBinaryHNSWEfConstruction sets efConstruction of a binary HNSW index,
+// before codes are added.
+func SetBinaryHNSWEfConstruction(ptr uintptr, ef int) error {
+	return callError("faiss_IndexBinaryHNSW_set_efConstruction",
+		C.faiss_IndexBinaryHNSW_set_efConstruction(cIndexBinary(ptr), C.int(ef)))
+}
+
+// SetBinaryHashNflip sets the hash key bits flipped at search time by a
+// binary Hash or MultiHash index.
+func SetBinaryHashNflip(ptr uintptr, nflip int) error {
+	return callError("faiss_IndexBinaryHash_set_nflip", C.faiss_IndexBinaryHash_set_nflip(cIndexBinary(ptr), C.int(nflip)))
+}
+
+// BinaryHashNflip returns nflip of a binary Hash or MultiHash index.
+func BinaryHashNflip(ptr uintptr) (int, error) {
+	var nflip C.int
+	err := callError("faiss_IndexBinaryHash_get_nflip", C.faiss_IndexBinaryHash_get_nflip(cIndexBinary(ptr), &nflip))
+	return int(nflip), err
+}
+
+// BinaryRangeSearch returns the codes at Hamming distance < radius of each
+// query. Indexes without a range search (HNSW, FromFloat) emulate it with
+// k-NN searches of at most maxK results (0 for the default); nTruncated
+// counts the queries cut there.
+func BinaryRangeSearch(ptr uintptr, x []uint8, radius, maxK int) (lims, labels []int64, distances []float32, nTruncated int64, err error) {
+	nq := len(x) / (GetIndexBinaryDimension(ptr) / 8)
+	var result C.FaissRangeSearchResult
+	if err := callError("faiss_RangeSearchResult_new", C.faiss_RangeSearchResult_new(&result, C.int64_t(nq))); err != nil {
+		return nil, nil, nil, 0, err
+	}
+	defer C.faiss_RangeSearchResult_free(result)
+	var truncated C.int64_t
+	if err := callError("faiss_IndexBinary_range_search_ext",
+		C.faiss_IndexBinary_range_search_ext(cIndexBinary(ptr), C.int64_t(nq), bytePtr(x), C.int(radius), C.int64_t(maxK),
+			result, &truncated)); err != nil {
+		return nil, nil, nil, 0, err
+	}
+	lims, labels, distances, err = rangeSearchResult(result, nq)
+	return lims, labels, distances, int64(truncated), err
+}
+
+// Top-k modes of NewSearchParametersApproxTopK.
+const (
+	ApproxTopKExact = 0
+	ApproxTopKB32D2 = 1
+	ApproxTopKB8D3  = 2
+	ApproxTopKB16D2 = 3
+	ApproxTopKB8D2  = 4
+)
+
+// NewSearchParametersApproxTopK creates parameters selecting a top-k mode,
+// with nprobe for IVF indexes (0 for the index setting) and the vectors
+// scanned between two heap merges (0 to choose it from k).
+func NewSearchParametersApproxTopK(mode, nprobe, segmentSize int) (uintptr, error) {
+	var params C.FaissSearchParameters
+	if err := callError("faiss_SearchParametersApproxTopK_new",
+		C.faiss_SearchParametersApproxTopK_new(&params, C.int(mode), C.int64_t(nprobe), C.int64_t(segmentSize))); err != nil {
+		return 0, err
+	}
+	return uintptr(unsafe.Pointer(params)), nil
+}
+
+// FreeSearchParametersApproxTopK frees approximate top-k parameters.
+func FreeSearchParametersApproxTopK(params uintptr) {
+	C.faiss_SearchParametersApproxTopK_free(C.FaissSearchParameters(unsafe.Pointer(params)))
+}
+
+// ApproxTopKSupported tells whether an index supports the approximate
+// modes.
+func ApproxTopKSupported(ptr uintptr) (bool, error) {
+	var supported C.int
+	err := callError("faiss_Index_approx_topk_supported_ext", C.faiss_Index_approx_topk_supported_ext(cIndex(ptr), &supported))
+	return supported != 0, err
+}
+
+// SearchApproxTopK searches with the top-k mode of params, or as usual
+// when params is 0.
+func SearchApproxTopK(ptr, params uintptr, x []float32, k int) ([]float32, []int64, error) {
+	n := len(x) / GetIndexDimension(ptr)
+	D := make([]float32, n*k)
+	I := make([]int64, n*k)
+	err := callError("faiss_Index_search_approx_topk_ext",
+		C.faiss_Index_search_approx_topk_ext(cIndex(ptr), C.int64_t(n), floatPtr(x), C.int64_t(k),
+			C.FaissSearchParameters(unsafe.Pointer(params)), floatPtr(D), idPtr(I)))
+	return D, I, err
+}
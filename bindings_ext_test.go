@@ -0,0 +1,3589 @@
+//go:build linux && amd64
+
+package bindings
+
+import (
+	"fmt"
+	"math"
+	"math/bits"
+	"math/rand"
+	"os"
+	"os/exec"
+	"path/filepath"
+	"sort"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"testing"
+	"time"
+)
+
+// randomVectors returns n vectors of dimension d with coordinates in [0, 1).
+func randomVectors(n, d int, seed int64) []float32 {
+	rng := rand.New(rand.NewSource(seed))
+	x := make([]float32, n*d)
+	for i := range x {
+		x[i] = rng.Float32()
+	}
+	return x
+}
+
+func mustIndex(t *testing.T, d int, description string, metric int) uintptr {
+	t.Helper()
+	idx, err := NewIndexFactory(d, description, metric)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return idx
+}
+
+// TestSIMDLevel verifies that the Go extensions are linked and report
+// the SIMD level selected at startup.
+func TestSIMDLevel(t *testing.T) {
+	switch level := GetSIMDLevelName(); level {
+	case "generic", "avx2", "avx512", "neon":
+		t.Logf("extension kernels use SIMD level %s", level)
+	default:
+		t.Errorf("unexpected SIMD level %q", level)
+	}
+}
+
+func closeTo(a, b float32) bool {
+	return math.Abs(float64(a-b)) <= 1e-4*math.Max(1, math.Abs(float64(b)))
+}
+
+// TestSQKernels runs the dispatched scalar quantizer searches at every
+// SIMD level of the host and compares them with Index::search, for all
+// quantizer types, both metrics and IVF with and without residuals.
+func TestSQKernels(t *testing.T) {
+	const d, nb, nq, k = 24, 2000, 20, 10
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	for i := range xb {
+		// direct types store integer components
+		xb[i] = float32(math.Round(float64(xb[i] * 100)))
+	}
+	for i := range xq {
+		xq[i] = float32(math.Round(float64(xq[i] * 100)))
+	}
+
+	type sqIndex struct {
+		name   string
+		ptr    uintptr
+		search func(uintptr, []float32, int) ([]float32, []int64, error)
+	}
+	var indexes []sqIndex
+	for qtype := QT8bit; qtype <= QT8bitDirectSigned; qtype++ {
+		data := xb
+		if qtype == QT8bitDirectSigned {
+			data = make([]float32, len(xb))
+			for i := range xb {
+				data[i] = xb[i] - 50
+			}
+		}
+		for _, metric := range []int{MetricL2, MetricInnerProduct} {
+			flat, err := NewIndexScalarQuantizer(d, qtype, metric)
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer FreeIndex(flat)
+			indexes = append(indexes, sqIndex{fmt.Sprintf("SQ qtype %d metric %d", qtype, metric), flat, IndexScalarQuantizerSearch})
+			for _, byResidual := range []bool{false, true} {
+				quantizer := mustIndex(t, d, "Flat", metric)
+				ivf, err := NewIndexIVFScalarQuantizer(quantizer, d, 16, qtype, metric, byResidual)
+				if err != nil {
+					t.Fatal(err)
+				}
+				defer FreeIndex(ivf)
+				SetIndexIVFNprobe(ivf, 4)
+				indexes = append(indexes, sqIndex{fmt.Sprintf("IVFSQ qtype %d metric %d residual %v", qtype, metric, byResidual),
+					ivf, IndexIVFScalarQuantizerSearch})
+			}
+		}
+		for _, idx := range indexes[len(indexes)-6:] {
+			if err := TrainIndex(idx.ptr, data); err != nil {
+				t.Fatal(err)
+			}
+			if err := AddVectors(idx.ptr, data); err != nil {
+				t.Fatal(err)
+			}
+		}
+	}
+
+	defer SetSIMDLevel(GetSIMDLevel())
+	for _, level := range []int{SIMDGeneric, SIMDAVX2, SIMDAVX512, SIMDNEON} {
+		if !SIMDLevelSupported(level) {
+			continue
+		}
+		if err := SetSIMDLevel(level); err != nil {
+			t.Fatal(err)
+		}
+		for _, idx := range indexes {
+			wantD, wantI, err := SearchIndex(idx.ptr, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			gotD, gotI, err := idx.search(idx.ptr, xq, k)
+			if err != nil {
+				t.Fatalf("level %d %s: %v", level, idx.name, err)
+			}
+			// rounding may swap labels between close distances, or at
+			// the k-th distance bring in another label
+			for j := range gotD {
+				q := j / k
+				swapped := closeTo(gotD[j], wantD[(q+1)*k-1])
+				for _, l := range wantI[q*k : (q+1)*k] {
+					swapped = swapped || l == gotI[j]
+				}
+				if !closeTo(gotD[j], wantD[j]) || (gotI[j] != wantI[j] && !swapped) {
+					t.Fatalf("level %d %s: result %d is (%d, %g), want (%d, %g)",
+						level, idx.name, j, gotI[j], gotD[j], wantI[j], wantD[j])
+				}
+			}
+		}
+	}
+}
+
+// TestSIMDKernels runs the dispatched kernels at every SIMD level of the
+// host and compares them with plain Go loops and the FAISS searches.
+func TestSIMDKernels(t *testing.T) {
+	const d, nx, ny, codeSize = 37, 9, 300, 13
+	x := randomVectors(nx, d, 1)
+	y := randomVectors(ny, d, 2)
+	rng := rand.New(rand.NewSource(3))
+	a := make([]uint8, nx*codeSize)
+	b := make([]uint8, ny*codeSize)
+	rng.Read(a)
+	rng.Read(b)
+
+	var pqs []uintptr
+	for _, desc := range []string{"PQ4np", "PQ8x4np"} {
+		pq := mustIndex(t, 16, desc, MetricL2)
+		defer FreeIndex(pq)
+		xb := randomVectors(2000, 16, 4)
+		if err := TrainIndex(pq, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(pq, xb); err != nil {
+			t.Fatal(err)
+		}
+		pqs = append(pqs, pq)
+	}
+	xq := randomVectors(20, 16, 5)
+
+	defer SetSIMDLevel(GetSIMDLevel())
+	for _, level := range []int{SIMDGeneric, SIMDAVX2, SIMDAVX512, SIMDNEON} {
+		if !SIMDLevelSupported(level) {
+			continue
+		}
+		if err := SetSIMDLevel(level); err != nil {
+			t.Fatal(err)
+		}
+		for i := 0; i < nx; i++ {
+			xi := x[i*d : (i+1)*d]
+			l2s, err := L2sqrNy(xi, y)
+			if err != nil {
+				t.Fatal(err)
+			}
+			ips, err := InnerProductsNy(xi, y)
+			if err != nil {
+				t.Fatal(err)
+			}
+			for j := 0; j < ny; j++ {
+				var ip float32
+				for c := 0; c < d; c++ {
+					ip += xi[c] * y[j*d+c]
+				}
+				if !closeTo(l2s[j], l2(xi, y[j*d:(j+1)*d])) || !closeTo(ips[j], ip) {
+					t.Fatalf("level %d: distances to vector %d differ", level, j)
+				}
+			}
+		}
+		D, I, err := L2sqrNN(x, y, d)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for i := 0; i < nx; i++ {
+			best := float32(math.MaxFloat32)
+			for j := 0; j < ny; j++ {
+				best = float32(math.Min(float64(best), float64(l2(x[i*d:(i+1)*d], y[j*d:(j+1)*d]))))
+			}
+			if !closeTo(D[i], best) || !closeTo(l2(x[i*d:(i+1)*d], y[I[i]*d:(I[i]+1)*d]), best) {
+				t.Fatalf("level %d: nearest neighbor of %d at %g, want %g", level, i, D[i], best)
+			}
+		}
+		hd, err := HammingDistances(a, b, codeSize)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for i := 0; i < nx; i++ {
+			for j := 0; j < ny; j++ {
+				want := 0
+				for c := 0; c < codeSize; c++ {
+					want += bits.OnesCount8(a[i*codeSize+c] ^ b[j*codeSize+c])
+				}
+				if int(hd[i*ny+j]) != want {
+					t.Fatalf("level %d: Hamming distance (%d, %d) is %d, want %d", level, i, j, hd[i*ny+j], want)
+				}
+			}
+		}
+		for _, pq := range pqs {
+			wantD, wantI, err := SearchIndex(pq, xq, 10)
+			if err != nil {
+				t.Fatal(err)
+			}
+			gotD, gotI, err := IndexPQSearch(pq, xq, 10)
+			if err != nil {
+				t.Fatal(err)
+			}
+			// labels may only differ between equal distances
+			for j := range gotD {
+				if !closeTo(gotD[j], wantD[j]) || (gotI[j] != wantI[j] && gotD[j] != wantD[j]) {
+					t.Fatalf("level %d: PQ result (%d, %g), want (%d, %g)", level, gotI[j], gotD[j], wantI[j], wantD[j])
+				}
+			}
+		}
+	}
+}
+
+func l2(a, b []float32) float32 {
+	var s float32
+	for i := range a {
+		s += (a[i] - b[i]) * (a[i] - b[i])
+	}
+	return s
+}
+
+func equalLabels(a, b []int64) bool {
+	if len(a) != len(b) {
+		return false
+	}
+	for i := range a {
+		if a[i] != b[i] {
+			return false
+		}
+	}
+	return true
+}
+
+// TestFastScanOverride compares per-call implem / qbs, including the
+// heap and reservoir implementations 14/15 and query blocking, with
+// searches made after storing the same values on flat and IVF fast-scan
+// indexes. The per-call searches run from several goroutines next to
+// plain searches of the same indexes, which must keep the stored
+// settings. The autotuner must pick a valid combination and only store
+// it when asked.
+func TestFastScanOverride(t *testing.T) {
+	const d, nb, nq, k = 32, 3000, 40, 10
+	type setting struct{ implem, qbs int }
+	cases := []struct {
+		desc     string
+		settings []setting
+	}{
+		{"PQ16x4fs", []setting{{0, 0}, {12, 0}, {13, 0}, {12, 0x33}, {13, 0x4}, {14, 0}, {15, 0}, {14, 2}, {15, 1}}},
+		{"IVF16,PQ16x4fs", []setting{{0, 0}, {10, 0}, {11, 0}, {12, 0}, {13, 4}, {14, 0}, {15, 8}}},
+	}
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	params, err := NewSearchParametersIVF(0, 4, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+
+	for _, tc := range cases {
+		idx := mustIndex(t, d, tc.desc, MetricL2)
+		defer FreeIndex(idx)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if bbs, err := FastScanBbs(idx); err != nil || bbs != 32 {
+			t.Fatalf("%s: bbs %d (%v), want 32", tc.desc, bbs, err)
+		}
+		search := func(ptr uintptr) ([]int64, error) {
+			_, I, err := SearchIndexWithParams(ptr, params, xq, k)
+			return I, err
+		}
+		if !strings.HasPrefix(tc.desc, "IVF") {
+			search = func(ptr uintptr) ([]int64, error) {
+				_, I, err := SearchIndex(ptr, xq, k)
+				return I, err
+			}
+		}
+		ivfParams := params
+		if !strings.HasPrefix(tc.desc, "IVF") {
+			ivfParams = 0
+		}
+
+		want := make([][]int64, len(tc.settings))
+		for i, s := range tc.settings {
+			if err := FastScanSetImplem(idx, s.implem); err != nil {
+				t.Fatal(err)
+			}
+			if err := FastScanSetQbs(idx, s.qbs); err != nil {
+				t.Fatalf("%s: qbs %#x: %v", tc.desc, s.qbs, err)
+			}
+			if want[i], err = search(idx); err != nil {
+				t.Fatal(err)
+			}
+		}
+		if err := FastScanSetImplem(idx, 0); err != nil {
+			t.Fatal(err)
+		}
+		if err := FastScanSetQbs(idx, 0); err != nil {
+			t.Fatal(err)
+		}
+		for _, s := range []setting{{12, -1}, {16, 0}} {
+			if _, _, err := FastScanSearch(idx, ivfParams, xq, k, s.implem, s.qbs); err == nil {
+				t.Errorf("%s: search with the invalid %+v", tc.desc, s)
+			}
+		}
+		if _, _, err := FastScanSearch(idx, ivfParams, xq, k, 12, 0x5); (err == nil) != (ivfParams != 0) {
+			t.Errorf("%s: qbs 0x5 with implem 12 (%v)", tc.desc, err)
+		}
+
+		var wg sync.WaitGroup
+		errs := make(chan string, 64)
+		for g := 0; g < 8; g++ {
+			wg.Add(1)
+			go func(g int) {
+				defer wg.Done()
+				for it := 0; it < 20; it++ {
+					i := (g*7 + it) % len(tc.settings)
+					if g%4 == 3 {
+						// plain searches use the stored setting 0
+						I, err := search(idx)
+						if err != nil || !equalLabels(I, want[0]) {
+							errs <- fmt.Sprintf("plain search during overridden ones differs (%v)", err)
+							return
+						}
+						continue
+					}
+					_, I, err := FastScanSearch(idx, ivfParams, xq, k, tc.settings[i].implem, tc.settings[i].qbs)
+					if err != nil {
+						errs <- err.Error()
+						return
+					}
+					if !equalLabels(I, want[i]) {
+						errs <- fmt.Sprintf("overridden search %+v differs from the search with it stored", tc.settings[i])
+						return
+					}
+				}
+			}(g)
+		}
+		wg.Wait()
+		close(errs)
+		for msg := range errs {
+			t.Errorf("%s: %s", tc.desc, msg)
+		}
+		stored := func() setting {
+			implem, err := FastScanImplem(idx)
+			if err != nil {
+				t.Fatal(err)
+			}
+			qbs, err := FastScanQbs(idx)
+			if err != nil {
+				t.Fatal(err)
+			}
+			return setting{implem, qbs}
+		}
+		if s := stored(); s != (setting{}) {
+			t.Errorf("%s: %+v stored after overridden searches, want 0 0", tc.desc, s)
+		}
+
+		for _, apply := range []bool{false, true} {
+			implem, qbs, bestMs, defaultMs, err := FastScanAutotune(idx, xq, k, 2, apply)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if bestMs <= 0 || defaultMs <= 0 || bestMs > defaultMs {
+				t.Errorf("%s: autotune best %g ms, default %g ms", tc.desc, bestMs, defaultMs)
+			}
+			_, I, err := FastScanSearch(idx, ivfParams, xq, k, implem, qbs)
+			if err != nil {
+				t.Fatalf("%s: autotuned implem %d qbs %d: %v", tc.desc, implem, qbs, err)
+			}
+			if !apply {
+				if s := stored(); s != (setting{}) {
+					t.Errorf("%s: autotune without apply stored %+v", tc.desc, s)
+				}
+				continue
+			}
+			if s := stored(); s != (setting{implem, qbs}) {
+				t.Errorf("%s: autotune stored %+v, best %d %d", tc.desc, s, implem, qbs)
+			}
+			if plain, err := search(idx); err != nil || !equalLabels(plain, I) {
+				t.Errorf("%s: search with the autotuned setting stored differs (%v)", tc.desc, err)
+			}
+		}
+	}
+}
+
+// TestRaBitQSearchParams compares per-call qb / centered / nprobe /
+// k_factor with searches made after storing the same values on the
+// index, for the flat and IVF RaBitQ indexes, plain and fast-scan, 1-bit
+// and multi-bit, alone and under IndexRefineFlat. The per-call searches
+// run from several goroutines next to plain searches, which must keep the
+// stored settings. Multi-bit searches must fill the statistics.
+func TestRaBitQSearchParams(t *testing.T) {
+	const d, nb, nq, k = 32, 2000, 20, 10
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	type setting struct {
+		qb, centered, nprobe int
+		kFactor              float32
+	}
+	flat := []setting{{4, 0, 0, 0}, {4, 1, 0, 0}, {8, 0, 0, 0}}
+	ivf := []setting{{4, 0, 2, 0}, {4, 1, 8, 0}, {8, 0, 16, 0}}
+	refine := []setting{{4, 0, 0, 1}, {4, 1, 0, 4}, {8, 0, 0, 8}}
+	for _, tc := range []struct {
+		desc     string
+		nbBits   int
+		settings []setting
+	}{
+		{"RaBitQ", 1, append([]setting{{0, 0, 0, 0}}, flat...)},
+		{"RaBitQfs", 1, flat},
+		{"RaBitQ4", 4, flat},
+		{"RaBitQfs4", 4, flat},
+		// IndexIVFRaBitQ only stores qb, centered is per call
+		{"IVF16,RaBitQ", 1, []setting{{4, 0, 2, 0}, {8, 0, 8, 0}, {0, 0, 16, 0}}},
+		{"IVF16,RaBitQ4", 4, []setting{{4, 0, 2, 0}, {8, 0, 8, 0}}},
+		{"IVF16,RaBitQfs", 1, ivf},
+		{"IVF16,RaBitQfs4", 4, ivf},
+		{"RaBitQ4,RFlat", 4, refine},
+		{"IVF16,RaBitQfs,RFlat", 1, refine},
+	} {
+		idx := mustIndex(t, d, tc.desc, MetricL2)
+		defer FreeIndex(idx)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if nbBits, err := RaBitQNbBits(idx); err != nil || nbBits != tc.nbBits {
+			t.Fatalf("%s: nb_bits %d (%v), want %d", tc.desc, nbBits, err, tc.nbBits)
+		}
+		isRefine := strings.HasSuffix(tc.desc, ",RFlat")
+		qb0, centered0, err := RaBitQQueryParams(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		// reference: the setting stored on the index, nprobe passed in
+		// SearchParametersIVF
+		reference := func(s setting) []int64 {
+			t.Helper()
+			if err := RaBitQSetQueryParams(idx, s.qb, s.centered); err != nil {
+				t.Fatalf("%s: %+v: %v", tc.desc, s, err)
+			}
+			if isRefine {
+				RefineFlatSetKFactor(idx, s.kFactor)
+			}
+			var I []int64
+			if s.nprobe > 0 {
+				params, err := NewSearchParametersIVF(0, s.nprobe, 0)
+				if err != nil {
+					t.Fatal(err)
+				}
+				_, I, err = SearchIndexWithParams(idx, params, xq, k)
+				FreeSearchParameters(params)
+			} else {
+				_, I, err = SearchIndex(idx, xq, k)
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+			return I
+		}
+		want := make([][]int64, len(tc.settings))
+		for i, s := range tc.settings {
+			want[i] = reference(s)
+		}
+		wantPlain := reference(setting{qb0, centered0, 0, 1})
+
+		var wg sync.WaitGroup
+		errs := make(chan string, 64)
+		for g := 0; g < 6; g++ {
+			wg.Add(1)
+			go func(g int) {
+				defer wg.Done()
+				for it := 0; it < 10; it++ {
+					if g == 5 {
+						_, I, err := SearchIndex(idx, xq, k)
+						if err != nil || !equalLabels(I, wantPlain) {
+							errs <- fmt.Sprintf("plain search during per-call ones differs (%v)", err)
+							return
+						}
+						continue
+					}
+					s := tc.settings[(g+it)%len(tc.settings)]
+					_, I, err := RaBitQSearch(idx, xq, k, RaBitQParams{s.qb, s.centered, s.nprobe, s.kFactor})
+					if err != nil {
+						errs <- err.Error()
+						return
+					}
+					if !equalLabels(I, want[(g+it)%len(tc.settings)]) {
+						errs <- fmt.Sprintf("per-call %+v differs from the index setting", s)
+						return
+					}
+				}
+			}(g)
+		}
+		wg.Wait()
+		close(errs)
+		for msg := range errs {
+			t.Errorf("%s: %s", tc.desc, msg)
+		}
+		if qb, centered, err := RaBitQQueryParams(idx); err != nil || qb != qb0 || centered != centered0 {
+			t.Errorf("%s: query params (%d, %d) after per-call searches, want (%d, %d)", tc.desc, qb, centered, qb0, centered0)
+		}
+		if _, _, err := RaBitQSearch(idx, xq, k, RaBitQParams{9, -1, 0, 0}); err == nil {
+			t.Errorf("%s: search with qb 9", tc.desc)
+		}
+
+		ResetRaBitQStats()
+		if _, _, err := RaBitQSearch(idx, xq, k, NewRaBitQParams()); err != nil {
+			t.Fatal(err)
+		}
+		n1, nMulti, skip := RaBitQStats()
+		if tc.nbBits > 1 && (n1 == 0 || nMulti == 0 || nMulti > n1 || skip < 0 || skip > 100) {
+			t.Errorf("%s: stats %d 1-bit, %d multi-bit, %g%% skipped", tc.desc, n1, nMulti, skip)
+		}
+		if tc.nbBits == 1 && (n1 != 0 || nMulti != 0) {
+			t.Errorf("%s: 1-bit index collected stats %d / %d", tc.desc, n1, nMulti)
+		}
+		t.Logf("%s: stats %d 1-bit, %d multi-bit, %.1f%% skipped", tc.desc, n1, nMulti, skip)
+	}
+}
+
+// ivfIndex returns a trained IVF index of nb random vectors with ids 0..nb-1.
+func ivfIndex(t *testing.T, d, nb int, description string) uintptr {
+	t.Helper()
+	idx := mustIndex(t, d, description, MetricL2)
+	xb := randomVectors(nb, d, 1)
+	if err := TrainIndex(idx, xb); err != nil {
+		t.Fatal(err)
+	}
+	if err := AddVectors(idx, xb); err != nil {
+		t.Fatal(err)
+	}
+	return idx
+}
+
+// TestPanoramaConversion converts IVFFlat and HNSWFlat indexes in place
+// and checks that the Panorama searches, whose pruning is exact, return
+// the results of the original indexes; IndexFlatL2Panorama is compared
+// with IndexFlatL2. FAISS only counts the scanned dimensions of the IVF
+// and flat searches.
+func TestPanoramaConversion(t *testing.T) {
+	const d, nb, nq, k, nLevels = 32, 2000, 20, 10, 4
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	check := func(name string, idx uintptr, counted bool, search func(uintptr) ([]float32, []int64)) uintptr {
+		wantD, wantI := search(idx)
+		pano, err := ToPanorama(idx, nLevels)
+		if err != nil {
+			FreeIndex(idx)
+			t.Fatal(err)
+		}
+		if levels, err := PanoramaLevels(pano); err != nil || levels != nLevels {
+			t.Errorf("%s: %d levels (%v), want %d", name, levels, err, nLevels)
+		}
+		if GetIndexNtotal(pano) != nb {
+			t.Errorf("%s: %d vectors after conversion, want %d", name, GetIndexNtotal(pano), nb)
+		}
+		ResetPanoramaStats()
+		gotD, gotI := search(pano)
+		for j := range gotD {
+			if !closeTo(gotD[j], wantD[j]) || (gotI[j] != wantI[j] && gotD[j] != wantD[j]) {
+				t.Fatalf("%s: result %d is (%d, %g), want (%d, %g)", name, j, gotI[j], gotD[j], wantI[j], wantD[j])
+			}
+		}
+		if scanned, total := PanoramaStats(); counted && (total == 0 || scanned > total) {
+			t.Errorf("%s: scanned %d of %d dimensions", name, scanned, total)
+		}
+		return pano
+	}
+	search := func(idx uintptr) ([]float32, []int64) {
+		D, I, err := SearchIndex(idx, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		return D, I
+	}
+
+	ivf := ivfIndex(t, d, nb, "IVF16,Flat")
+	pano := check("IVFFlat", ivf, true, func(idx uintptr) ([]float32, []int64) {
+		params, err := NewSearchParametersIVF(0, 16, 0)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeSearchParameters(params)
+		D, I, err := SearchIndexWithParams(idx, params, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		return D, I
+	})
+	if batch, err := PanoramaBatchSize(pano); err != nil || batch <= 0 {
+		t.Errorf("IVFFlat Panorama batch size %d (%v)", batch, err)
+	}
+	FreeIndex(pano)
+
+	hnsw := mustIndex(t, d, "HNSW16,Flat", MetricL2)
+	if err := AddVectors(hnsw, xb); err != nil {
+		t.Fatal(err)
+	}
+	pano = check("HNSWFlat", hnsw, false, search)
+	if _, err := PanoramaBatchSize(pano); err == nil {
+		t.Error("HNSW Panorama index reports a batch size")
+	}
+	FreeIndex(pano)
+
+	ivfpq := mustIndex(t, d, "IVF16,PQ8x4np", MetricL2)
+	if got, err := ToPanorama(ivfpq, nLevels); err == nil || got != ivfpq {
+		t.Error("converted an IVFPQ index")
+	}
+	FreeIndex(ivfpq)
+
+	flat := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(flat)
+	flatPano, err := NewIndexFlatL2Panorama(d, nLevels, 128)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(flatPano)
+	for _, idx := range []uintptr{flat, flatPano} {
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+	}
+	wantD, wantI := search(flat)
+	ResetPanoramaStats()
+	gotD, gotI := search(flatPano)
+	if scanned, total := PanoramaStats(); total == 0 || scanned > total {
+		t.Errorf("FlatL2Panorama: scanned %d of %d dimensions", scanned, total)
+	}
+	for j := range gotD {
+		if !closeTo(gotD[j], wantD[j]) || (gotI[j] != wantI[j] && gotD[j] != wantD[j]) {
+			t.Fatalf("FlatL2Panorama: result %d is (%d, %g), want (%d, %g)", j, gotI[j], gotD[j], wantI[j], wantD[j])
+		}
+	}
+}
+
+// TestPanoramaConversionFailure checks that failed conversions leave the
+// source index untouched and searchable, and that it converts afterwards.
+func TestPanoramaConversionFailure(t *testing.T) {
+	const d, nb, nq, k = 32, 2000, 20, 10
+	xq := randomVectors(nq, d, 2)
+	ivf := ivfIndex(t, d, nb, "IVF16,Flat")
+	if err := MakeDirectMap(ivf); err != nil {
+		FreeIndex(ivf)
+		t.Fatal(err)
+	}
+	wantD, wantI, err := SearchIndex(ivf, xq, k)
+	if err != nil {
+		FreeIndex(ivf)
+		t.Fatal(err)
+	}
+	for _, nLevels := range []int{0, -1, d + 1} {
+		got, err := ToPanorama(ivf, nLevels)
+		if err == nil || got != ivf {
+			FreeIndex(got)
+			t.Fatalf("converted with %d levels", nLevels)
+		}
+		if GetIndexNtotal(ivf) != nb {
+			t.Fatalf("%d vectors after a failed conversion, want %d", GetIndexNtotal(ivf), nb)
+		}
+		gotD, gotI, err := SearchIndex(ivf, xq, k)
+		if err != nil || !equalLabels(gotI, wantI) || !closeTo(gotD[0], wantD[0]) {
+			t.Fatalf("search after a failed conversion with %d levels differs (%v)", nLevels, err)
+		}
+	}
+	want, err := ReconstructVector(ivf, 7)
+	if err != nil {
+		FreeIndex(ivf)
+		t.Fatal(err)
+	}
+	pano, err := ToPanorama(ivf, 4)
+	if err != nil {
+		FreeIndex(ivf)
+		t.Fatal(err)
+	}
+	defer FreeIndex(pano)
+	if got, err := ReconstructVector(pano, 7); err != nil || !closeTo(got[0], want[0]) || !closeTo(got[d-1], want[d-1]) {
+		t.Errorf("reconstruct through the converted direct map: %v", err)
+	}
+
+	ip := mustIndex(t, d, "IVF16,Flat", MetricInnerProduct)
+	defer FreeIndex(ip)
+	xb := randomVectors(nb, d, 1)
+	if err := TrainIndex(ip, xb); err != nil {
+		t.Fatal(err)
+	}
+	if err := AddVectors(ip, xb); err != nil {
+		t.Fatal(err)
+	}
+	if got, err := ToPanorama(ip, 4); err == nil || got != ip || GetIndexNtotal(ip) != nb {
+		t.Error("converted an inner product index")
+	}
+}
+
+// checkSameResults fails unless got has the distances of want and each
+// label of got is at its distance from the query in xb, so labels may
+// only differ between (nearly) equal distances.
+func checkSameResults(t *testing.T, name string, metric, d int, xb, xq []float32, gotD []float32, gotI []int64, wantD []float32, wantI []int64) {
+	t.Helper()
+	k := len(wantD) / (len(xq) / d)
+	for j := range wantD {
+		if gotI[j] == wantI[j] && closeTo(gotD[j], wantD[j]) {
+			continue
+		}
+		q := xq[j/k*d : (j/k+1)*d]
+		ok := gotI[j] >= 0 && closeTo(gotD[j], wantD[j])
+		if ok {
+			y := xb[gotI[j]*int64(d) : (gotI[j]+1)*int64(d)]
+			dis := l2(q, y)
+			if metric == MetricInnerProduct {
+				dis = 0
+				for i := range q {
+					dis += q[i] * y[i]
+				}
+			}
+			ok = closeTo(dis, gotD[j])
+		}
+		if !ok {
+			t.Fatalf("%s: result %d is (%d, %g), want (%d, %g)", name, j, gotI[j], gotD[j], wantI[j], wantD[j])
+		}
+	}
+}
+
+// TestFlatSearchFused compares the fused flat search with IndexFlat::search
+// for both metrics, dimensions around the register blocks, tile sizes that
+// do not divide the data, k beyond ntotal and the fallback for large d.
+func TestFlatSearchFused(t *testing.T) {
+	const nb, nq = 1000, 33
+	tiles := [][2]int{{0, 0}, {3, 17}, {1, nb}, {nq, 1}}
+	for _, d := range []int{7, 37, 128, 2100} {
+		xb := randomVectors(nb, d, 1)
+		xq := randomVectors(nq, d, 2)
+		for _, metric := range []int{MetricL2, MetricInnerProduct} {
+			idx := mustIndex(t, d, "Flat", metric)
+			if err := AddVectors(idx, xb); err != nil {
+				t.Fatal(err)
+			}
+			for _, k := range []int{1, 10, nb + 5} {
+				wantD, wantI, err := SearchIndex(idx, xq, k)
+				if err != nil {
+					t.Fatal(err)
+				}
+				for _, tile := range tiles {
+					gotD, gotI, err := FlatSearchFused(idx, xq, k, tile[0], tile[1])
+					if err != nil {
+						t.Fatal(err)
+					}
+					name := fmt.Sprintf("d=%d metric=%d k=%d tiles=%v", d, metric, k, tile)
+					checkSameResults(t, name, metric, d, xb, xq, gotD, gotI, wantD, wantI)
+				}
+			}
+			FreeIndex(idx)
+		}
+	}
+}
+
+// TestBlasParams compares flat and IVF searches with per-call BLAS
+// parameters, selectors included, with the regular searches, and checks
+// that calibrating without installing leaves the process defaults alone.
+func TestBlasParams(t *testing.T) {
+	const d, nb, nq = 24, 3000, 50
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	variants := map[string]BlasParams{
+		"defaults":  NewBlasParams(),
+		"simd":      {BlasThreshold: nq + 1, QueryBS: -1, DatabaseBS: -1, MinKReservoir: -1},
+		"blas":      {BlasThreshold: 0, QueryBS: 7, DatabaseBS: 333, MinKReservoir: -1},
+		"reservoir": {BlasThreshold: 0, QueryBS: -1, DatabaseBS: -1, MinKReservoir: 1},
+		"simd heap": {BlasThreshold: nq + 1, QueryBS: -1, DatabaseBS: -1, MinKReservoir: 1 << 20},
+	}
+	sel, err := NewIDSelectorRange(100, 2500)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIDSelector(sel)
+	params, err := NewSearchParameters(sel)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+	for _, metric := range []int{MetricL2, MetricInnerProduct} {
+		idx := mustIndex(t, d, "Flat", metric)
+		defer FreeIndex(idx)
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		for _, k := range []int{1, 20, 200} {
+			wantD, wantI, err := SearchIndex(idx, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			selD, selI, err := SearchIndexWithParams(idx, params, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			for name, blas := range variants {
+				name = fmt.Sprintf("%s metric=%d k=%d", name, metric, k)
+				gotD, gotI, err := FlatSearchBlas(idx, blas, 0, xq, k)
+				if err != nil {
+					t.Fatal(err)
+				}
+				checkSameResults(t, name, metric, d, xb, xq, gotD, gotI, wantD, wantI)
+				gotD, gotI, err = FlatSearchBlas(idx, blas, params, xq, k)
+				if err != nil {
+					t.Fatal(err)
+				}
+				checkSameResults(t, name+" selector", metric, d, xb, xq, gotD, gotI, selD, selI)
+			}
+		}
+	}
+
+	ivf := ivfIndex(t, d, nb, "IVF32,Flat")
+	defer FreeIndex(ivf)
+	ivfParams, err := NewSearchParametersIVF(0, 4, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(ivfParams)
+	wantD, wantI, err := SearchIndexWithParams(ivf, ivfParams, xq, 10)
+	if err != nil {
+		t.Fatal(err)
+	}
+	for name, blas := range variants {
+		gotD, gotI, err := IVFSearchBlas(ivf, blas, ivfParams, xq, 10)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for j := range wantD {
+			if !closeTo(gotD[j], wantD[j]) {
+				t.Fatalf("IVF %s: result %d is (%d, %g), want (%d, %g)", name, j, gotI[j], gotD[j], wantI[j], wantD[j])
+			}
+		}
+	}
+
+	before, err := GetBlasParams()
+	if err != nil {
+		t.Fatal(err)
+	}
+	measured, err := BlasCalibrate(d, false)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if measured.QueryBS <= 0 || measured.DatabaseBS <= 0 || measured.MinKReservoir <= 0 || measured.BlasThreshold < 0 {
+		t.Errorf("calibration measured %+v", measured)
+	}
+	if after, err := GetBlasParams(); err != nil || after != before {
+		t.Errorf("calibration changed the defaults from %+v to %+v (%v)", before, after, err)
+	}
+	defer SetBlasParams(before)
+	partial := NewBlasParams()
+	partial.QueryBS = 123
+	if err := SetBlasParams(partial); err != nil {
+		t.Fatal(err)
+	}
+	want := before
+	want.QueryBS = 123
+	if after, err := GetBlasParams(); err != nil || after != want {
+		t.Errorf("defaults are %+v after setting the query batch, want %+v (%v)", after, want, err)
+	}
+}
+
+// TestShardsSearch compares the budgeted shard search with one index
+// holding all the vectors, for shards of uneven sizes (one empty) numbered
+// with successive ids, and checks the results returned at a deadline.
+func TestShardsSearch(t *testing.T) {
+	const d, nq, k = 16, 40, 15
+	sizes := []int{300, 0, 1200, 7, 4000}
+	nb := 0
+	for _, size := range sizes {
+		nb += size
+	}
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	for _, metric := range []int{MetricL2, MetricInnerProduct} {
+		all := mustIndex(t, d, "Flat", metric)
+		defer FreeIndex(all)
+		if err := AddVectors(all, xb); err != nil {
+			t.Fatal(err)
+		}
+		shards := make([]uintptr, len(sizes))
+		begin := 0
+		for i, size := range sizes {
+			shards[i] = mustIndex(t, d, "Flat", metric)
+			defer FreeIndex(shards[i])
+			if err := AddVectors(shards[i], xb[begin*d:(begin+size)*d]); err != nil {
+				t.Fatal(err)
+			}
+			begin += size
+		}
+		idx, err := NewIndexShards(d, shards)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(idx)
+
+		for _, kk := range []int{1, k, nb + 3} {
+			wantD, wantI, err := SearchIndex(all, xq, kk)
+			if err != nil {
+				t.Fatal(err)
+			}
+			for _, nThreads := range []int{0, 1, 2, 7} {
+				gotD, gotI, done, partial, err := ShardsSearch(idx, xq, kk, nThreads, 0)
+				if err != nil {
+					t.Fatal(err)
+				}
+				if done != len(sizes) || partial {
+					t.Errorf("merged %d of %d shards without a deadline (partial %v)", done, len(sizes), partial)
+				}
+				name := fmt.Sprintf("metric=%d k=%d threads=%d", metric, kk, nThreads)
+				checkSameResults(t, name, metric, d, xb, xq, gotD, gotI, wantD, wantI)
+			}
+		}
+
+		// With a deadline the merged shards are unknown, so check that
+		// each query gets valid, sorted results no better than the full
+		// search.
+		wantD, _, err := SearchIndex(all, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, deadline := range []float64{1e-6, 0.05, 1e4} {
+			gotD, gotI, done, partial, err := ShardsSearch(idx, xq, k, 2, deadline)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if partial == (done == len(sizes)) {
+				t.Errorf("deadline %g ms: %d of %d shards merged, partial %v", deadline, done, len(sizes), partial)
+			}
+			for j := range gotD {
+				if gotI[j] < 0 {
+					continue
+				}
+				q := xq[j/k*d : (j/k+1)*d]
+				y := xb[gotI[j]*int64(d) : (gotI[j]+1)*int64(d)]
+				dis := l2(q, y)
+				better := gotD[j] < wantD[j] && !closeTo(gotD[j], wantD[j])
+				if metric == MetricInnerProduct {
+					dis = 0
+					for i := range q {
+						dis += q[i] * y[i]
+					}
+					better = gotD[j] > wantD[j] && !closeTo(gotD[j], wantD[j])
+				}
+				sorted := j%k == 0 || gotI[j-1] >= 0 &&
+					(metric == MetricL2 && gotD[j-1] <= gotD[j] || metric == MetricInnerProduct && gotD[j-1] >= gotD[j])
+				if !closeTo(dis, gotD[j]) || better || !sorted {
+					t.Fatalf("deadline %g ms: result %d is (%d, %g)", deadline, j, gotI[j], gotD[j])
+				}
+			}
+			if err := ShardsWait(idx); err != nil {
+				t.Fatal(err)
+			}
+		}
+	}
+}
+
+// TestShardsSearchLate checks that shards missing a deadline block new
+// searches of the index until they are done, and that the index searches
+// normally again after ShardsWait.
+func TestShardsSearchLate(t *testing.T) {
+	const d, nbShard, nShards, nq, k = 64, 20000, 4, 1000, 10
+	xb := randomVectors(nbShard*nShards, d, 1)
+	xq := randomVectors(nq, d, 2)
+	shards := make([]uintptr, nShards)
+	for i := range shards {
+		shards[i] = mustIndex(t, d, "Flat", MetricL2)
+		defer FreeIndex(shards[i])
+		if err := AddVectors(shards[i], xb[i*nbShard*d:(i+1)*nbShard*d]); err != nil {
+			t.Fatal(err)
+		}
+	}
+	idx, err := NewIndexShards(d, shards)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(idx)
+
+	// long enough for both workers to start a shard, shorter than a shard
+	_, _, done, partial, err := ShardsSearch(idx, xq, k, 2, 2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !partial || done == nShards {
+		t.Fatalf("%d of %d shards merged before a 2 ms deadline", done, nShards)
+	}
+	if _, _, _, _, err := ShardsSearch(idx, xq[:d], k, 2, 1e4); err == nil {
+		t.Error("deadline search accepted while late shards run")
+	}
+	if _, _, _, _, err := ShardsSearch(idx, xq[:d], k, 2, 0); err == nil {
+		t.Error("search accepted while late shards run")
+	}
+	if err := ShardsWait(idx); err != nil {
+		t.Fatal(err)
+	}
+	for _, deadline := range []float64{0, 1e4} {
+		_, _, done, partial, err := ShardsSearch(idx, xq[:d], k, 2, deadline)
+		if err != nil || partial || done != nShards {
+			t.Errorf("deadline %g ms after waiting: %d of %d shards merged, partial %v (%v)", deadline, done, nShards, partial, err)
+		}
+	}
+	if err := ShardsWait(idx); err != nil {
+		t.Fatal(err)
+	}
+
+	empty, err := NewIndexShards(0, nil)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(empty)
+	if _, _, _, _, err := ShardsSearch(empty, xq, k, 0, 0); err == nil {
+		t.Error("searched an index of dimension 0")
+	}
+}
+
+// TestReplicaRouter searches batches below and above the single-replica
+// size from concurrent goroutines through a router with pinned and
+// unpinned workers, compares them with the replicated index and checks
+// that the queues drain.
+func TestReplicaRouter(t *testing.T) {
+	const d, nb, k, nReplicas, smallBatch = 16, 3000, 10, 3, 4
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(60, d, 2)
+	base := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(base)
+	if err := AddVectors(base, xb); err != nil {
+		t.Fatal(err)
+	}
+	replicas := make([]uintptr, nReplicas)
+	for i := range replicas {
+		clone, err := CloneIndex(base)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(clone)
+		replicas[i] = clone
+	}
+	rep, err := NewIndexReplicas(d, replicas)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(rep)
+	if NumaNumNodes() < 1 {
+		t.Fatalf("%d NUMA nodes", NumaNumNodes())
+	}
+	if _, err := NewReplicaRouter(rep, smallBatch, []int{0, NumaNumNodes(), 0}); err == nil {
+		t.Error("router accepted a node out of range")
+	}
+	r, err := NewReplicaRouter(rep, smallBatch, []int{0, -1, 0})
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeReplicaRouter(r)
+
+	var wg sync.WaitGroup
+	for g := 0; g < 6; g++ {
+		wg.Add(1)
+		go func(g int) {
+			defer wg.Done()
+			for _, n := range []int{1, smallBatch - 1, smallBatch, smallBatch + 1, 2, 60, 17} {
+				start := g * 7 % (60 - n + 1)
+				q := xq[start*d : (start+n)*d]
+				wantD, wantI, err := SearchIndex(base, q, k)
+				if err != nil {
+					t.Error(err)
+					return
+				}
+				gotD, gotI, err := ReplicaRouterSearch(r, d, q, k)
+				if err != nil {
+					t.Error(err)
+					return
+				}
+				for j := range wantD {
+					if !closeTo(gotD[j], wantD[j]) || (gotI[j] != wantI[j] && !closeTo(gotD[j], l2(q[j/k*d:(j/k+1)*d], xb[gotI[j]*d:(gotI[j]+1)*d]))) {
+						t.Errorf("goroutine %d, batch %d: result %d is (%d, %g), want (%d, %g)", g, n, j, gotI[j], gotD[j], wantI[j], wantD[j])
+						return
+					}
+				}
+			}
+		}(g)
+	}
+	wg.Wait()
+	for i := 0; i < nReplicas; i++ {
+		if depth, err := ReplicaRouterQueueDepth(r, i); err != nil || depth != 0 {
+			t.Errorf("replica %d has %d requests left (%v)", i, depth, err)
+		}
+	}
+	if _, err := ReplicaRouterQueueDepth(r, nReplicas); err == nil {
+		t.Error("queue depth of a replica out of range")
+	}
+}
+
+// TestNumaPlacement places IVF, HNSW and flat indexes with each policy and
+// checks that their searches, on a pinned node worker and on the per-node
+// replicas made by copy or by reading a file, return the original results.
+// On a single-node host the test also reruns itself with three emulated
+// nodes.
+func TestNumaPlacement(t *testing.T) {
+	const d, nb, nq, k = 16, 3000, 30, 10
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	nodes := NumaNumNodes()
+	if nodes == 1 && os.Getenv("FAISS_GO_EXT_NUMA_NODES") == "" {
+		cmd := exec.Command(os.Args[0], "-test.run=^TestNumaPlacement$")
+		cmd.Env = append(os.Environ(), "FAISS_GO_EXT_NUMA_NODES=3")
+		if out, err := cmd.CombinedOutput(); err != nil {
+			t.Errorf("with 3 emulated nodes: %v\n%s", err, out)
+		}
+	}
+	for _, desc := range []string{"IVF16,Flat", "HNSW16,Flat", "Flat"} {
+		idx := ivfIndex(t, d, nb, desc)
+		defer FreeIndex(idx)
+		wantD, wantI, err := SearchIndex(idx, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		check := func(name string, ptr uintptr) {
+			t.Helper()
+			gotD, gotI, err := SearchIndex(ptr, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			checkSameResults(t, desc+" "+name, MetricL2, d, xb, xq, gotD, gotI, wantD, wantI)
+		}
+
+		for _, placement := range []struct {
+			policy int
+			nodes  []int
+		}{{NumaBind, nil}, {NumaInterleave, nil}, {NumaBind, []int{nodes - 1}}, {NumaInterleave, []int{0, nodes - 1}}} {
+			nBytes, usedMbind, err := NumaPlace(idx, placement.policy, placement.nodes)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if nBytes < int64(nb*d*4) {
+				t.Errorf("%s: placed %d bytes, less than the vectors", desc, nBytes)
+			}
+			check(fmt.Sprintf("placed with policy %d on %v (mbind %v)", placement.policy, placement.nodes, usedMbind), idx)
+		}
+		if _, _, err := NumaPlace(idx, NumaBind, []int{nodes}); err == nil {
+			t.Errorf("%s: placed on node %d of %d", desc, nodes, nodes)
+		}
+		if pages, err := NumaPages(idx); err == nil {
+			total := int64(0)
+			for _, n := range pages {
+				total += n
+			}
+			if total == 0 {
+				t.Errorf("%s: no resident pages reported", desc)
+			}
+		} else {
+			t.Logf("%s: page locations not available: %v", desc, err)
+		}
+
+		for node := 0; node < nodes; node++ {
+			gotD, gotI, err := SearchOnNode(idx, node, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			checkSameResults(t, fmt.Sprintf("%s on node %d", desc, node), MetricL2, d, xb, xq, gotD, gotI, wantD, wantI)
+		}
+		if _, _, err := SearchOnNode(idx, nodes, xq, k); err == nil {
+			t.Errorf("%s: searched on node %d of %d", desc, nodes, nodes)
+		}
+
+		replicas, err := ReplicatePerNode(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		check("replicated", replicas)
+		FreeIndex(replicas)
+		fname := filepath.Join(t.TempDir(), "index")
+		if err := WriteIndex(idx, fname); err != nil {
+			t.Fatal(err)
+		}
+		replicas, err = ReadIndexPerNode(fname, 0)
+		if err != nil {
+			t.Fatal(err)
+		}
+		check("read per node", replicas)
+		FreeIndex(replicas)
+	}
+}
+
+// checkRoundTrip writes idx with WriteIndexExt, reads it back as a copy
+// and as a mapping, and compares the searches and the reconstruction of
+// ids. It returns the two indexes read.
+func checkRoundTrip(t *testing.T, idx uintptr, d int, ids []int64) []uintptr {
+	t.Helper()
+	const nq, k = 20, 10
+	fname := filepath.Join(t.TempDir(), "index")
+	if err := WriteIndexExt(idx, fname); err != nil {
+		t.Fatal(err)
+	}
+	xq := randomVectors(nq, d, 2)
+	wantD, wantI, err := SearchIndex(idx, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	var read []uintptr
+	for _, flags := range []int{0, IOFlagMmapIFC} {
+		r, err := ReadIndexExt(fname, flags)
+		if err != nil {
+			t.Fatal(err)
+		}
+		t.Cleanup(func() { FreeIndex(r) })
+		read = append(read, r)
+		if GetIndexNtotal(r) != GetIndexNtotal(idx) {
+			t.Fatalf("io flags %d: ntotal %d, want %d", flags, GetIndexNtotal(r), GetIndexNtotal(idx))
+		}
+		D, I, err := SearchIndex(r, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if !equalLabels(I, wantI) {
+			t.Errorf("io flags %d: search differs after the round trip", flags)
+		}
+		for i := range D {
+			if D[i] != wantD[i] {
+				t.Fatalf("io flags %d: distance %g, want %g", flags, D[i], wantD[i])
+			}
+		}
+		for _, id := range ids {
+			want, err := ReconstructVector(idx, id)
+			if err != nil {
+				t.Fatal(err)
+			}
+			got, err := ReconstructVector(r, id)
+			if err != nil {
+				t.Fatalf("io flags %d: %v", flags, err)
+			}
+			for j := range got {
+				if got[j] != want[j] {
+					t.Fatalf("io flags %d: id %d reconstructs to another vector", flags, id)
+				}
+			}
+		}
+	}
+	return read
+}
+
+// TestIDMap3RoundTrip fills IndexIDMap3s in several batches, with a
+// remove in between, and checks their "IxM3" files. It then searches the
+// indexes read back from several goroutines with one SearchParameters
+// object, whose selector the IDMap3 translates to positions per call.
+func TestIDMap3RoundTrip(t *testing.T) {
+	const d, nb, nq, k = 16, 3000, 10, 10
+	for _, desc := range []string{"IDMap3,Flat", "IDMap3,IVF16,Flat"} {
+		idx, err := NewIndexFactoryExt(d, desc, MetricL2)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(idx)
+		xb := randomVectors(nb, d, 1)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if desc != "IDMap3,Flat" {
+			// IVF reconstructs through a direct map
+			sub, err := IDMap3SubIndex(idx)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if err := SetDirectMap(sub, 2); err != nil {
+				t.Fatal(err)
+			}
+		}
+		rng := rand.New(rand.NewSource(4))
+		ids := make([]int64, nb)
+		for i, p := range rng.Perm(nb) {
+			ids[i] = int64(1000 + 7*p)
+		}
+		for b := 0; b < 3; b++ {
+			lo, hi := b*nb/3, (b+1)*nb/3
+			if err := AddVectorsWithIDs(idx, xb[lo*d:hi*d], ids[lo:hi]); err != nil {
+				t.Fatal(err)
+			}
+		}
+		// the sub-index positions of the remaining vectors change
+		removed := ids[:200]
+		if n, err := RemoveIDs(idx, removed); err != nil || n != len(removed) {
+			t.Fatalf("%s: removed %d ids, want %d (%v)", desc, n, len(removed), err)
+		}
+		live := map[int64]bool{}
+		for _, id := range ids[200:] {
+			live[id] = true
+		}
+		_, I, err := SearchIndex(idx, randomVectors(nq, d, 3), k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, id := range I {
+			if !live[id] {
+				t.Fatalf("%s: search after remove returned id %d", desc, id)
+			}
+		}
+		read := checkRoundTrip(t, idx, d, ids[200:])
+
+		sel, err := NewIDSelectorRange(5000, 12000)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIDSelector(sel)
+		var params uintptr
+		if desc == "IDMap3,Flat" {
+			params, err = NewSearchParameters(sel)
+		} else {
+			params, err = NewSearchParametersIVF(sel, 16, 0)
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeSearchParameters(params)
+		xq := randomVectors(nq, d, 3)
+		_, want, err := SearchIndexWithParams(idx, params, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, id := range want {
+			if id >= 0 && (id < 5000 || id >= 12000) {
+				t.Fatalf("%s: id %d outside the selector", desc, id)
+			}
+		}
+		var wg sync.WaitGroup
+		errs := make(chan string, 16)
+		for g := 0; g < 6; g++ {
+			wg.Add(1)
+			go func(r uintptr) {
+				defer wg.Done()
+				for i := 0; i < 30; i++ {
+					_, got, err := SearchIndexWithParams(r, params, xq, k)
+					if err != nil {
+						errs <- err.Error()
+						return
+					}
+					if !equalLabels(got, want) {
+						errs <- "concurrent search with shared parameters returned other results"
+						return
+					}
+				}
+			}(read[g%2])
+		}
+		wg.Wait()
+		close(errs)
+		for msg := range errs {
+			t.Errorf("%s: %s", desc, msg)
+		}
+	}
+}
+
+// TestIDMap3SmallBatches fills an IndexIDMap3 and an IndexIDMap2 with
+// small batches of repeated ids, which the IDMap3 keeps in pending sorted
+// runs, and compares their lookups and searches, also after a remove, a
+// round trip and adds to the index read back.
+func TestIDMap3SmallBatches(t *testing.T) {
+	const d, nb, nq, k = 8, 6000, 10, 10
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	rng := rand.New(rand.NewSource(5))
+	ids := make([]int64, nb)
+	for i := range ids {
+		ids[i] = rng.Int63n(4000)
+	}
+	idx, err := NewIndexFactoryExt(d, "IDMap3,Flat", MetricL2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(idx)
+	ref := mustIndex(t, d, "IDMap2,Flat", MetricL2)
+	defer FreeIndex(ref)
+
+	// compare both indexes on every id added so far
+	check := func(name string, idx uintptr, upto int) {
+		t.Helper()
+		if GetIndexNtotal(idx) != GetIndexNtotal(ref) {
+			t.Fatalf("%s: ntotal %d, want %d", name, GetIndexNtotal(idx), GetIndexNtotal(ref))
+		}
+		for _, id := range ids[:upto] {
+			want, wantErr := ReconstructVector(ref, id)
+			got, err := ReconstructVector(idx, id)
+			if (err == nil) != (wantErr == nil) {
+				t.Fatalf("%s: reconstruct id %d: %v, want %v", name, id, err, wantErr)
+			}
+			for j := range got {
+				if got[j] != want[j] {
+					t.Fatalf("%s: id %d reconstructs to another vector", name, id)
+				}
+			}
+		}
+		_, wantI, err := SearchIndex(ref, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		_, gotI, err := SearchIndex(idx, xq, k)
+		if err != nil || !equalLabels(gotI, wantI) {
+			t.Fatalf("%s: search differs (%v)", name, err)
+		}
+	}
+	add := func(idx uintptr, lo, hi int) {
+		t.Helper()
+		for lo < hi {
+			b := min(lo+1+rng.Intn(9), hi)
+			for _, r := range []uintptr{idx, ref} {
+				if err := AddVectorsWithIDs(r, xb[lo*d:b*d], ids[lo:b]); err != nil {
+					t.Fatal(err)
+				}
+			}
+			lo = b
+			if rng.Intn(50) == 0 {
+				check("small batches", idx, lo)
+			}
+		}
+	}
+
+	add(idx, 0, nb/2)
+	check("small batches", idx, nb/2)
+	removed := ids[:100]
+	nRef, err := RemoveIDs(ref, removed)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if n, err := RemoveIDs(idx, removed); err != nil || n != nRef {
+		t.Fatalf("removed %d ids, want %d (%v)", n, nRef, err)
+	}
+	add(idx, nb/2, 3*nb/4)
+	check("after remove", idx, 3*nb/4)
+
+	fname := filepath.Join(t.TempDir(), "index")
+	if err := WriteIndexExt(idx, fname); err != nil {
+		t.Fatal(err)
+	}
+	mapped, err := ReadIndexExt(fname, IOFlagMmapIFC)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(mapped)
+	check("mapped", mapped, 3*nb/4)
+	read, err := ReadIndexExt(fname, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(read)
+	add(read, 3*nb/4, nb)
+	check("adds to the index read back", read, nb)
+}
+
+// TestIVFIdTable builds id tables over IVF indexes with scattered ids and
+// checks lookups, reconstructions, adds and updates against indexes with a
+// hashtable DirectMap, also after a write / read or mmap round trip.
+func TestIVFIdTable(t *testing.T) {
+	const d, nb, nadd = 16, 3000, 400
+	xb := randomVectors(nb+nadd, d, 1)
+	ids := make([]int64, nb+nadd)
+	for i := range ids {
+		ids[i] = int64(i)*7919 + 3
+	}
+	absent := []int64{0, 4, 7919*(nb+nadd) + 3, -1}
+	updated := []int64{ids[5], ids[nb-1], ids[nb+10]}
+	xu := randomVectors(len(updated), d, 9)
+	dir := t.TempDir()
+	for _, desc := range []string{"IVF16,Flat", "IVF16,SQ8"} {
+		idx := mustIndex(t, d, desc, MetricL2)
+		defer FreeIndex(idx)
+		if err := TrainIndex(idx, xb[:nb*d]); err != nil {
+			t.Fatal(err)
+		}
+		// the expected reconstructions, from indexes with a DirectMap
+		want := map[int64][]float32{}
+		expect := func(x []float32, ids []int64) {
+			ref, err := CloneIndex(idx)
+			if err != nil {
+				t.Fatal(err)
+			}
+			defer FreeIndex(ref)
+			if err := SetDirectMap(ref, 2); err != nil {
+				t.Fatal(err)
+			}
+			if err := AddVectorsWithIDs(ref, x, ids); err != nil {
+				t.Fatal(err)
+			}
+			for _, id := range ids {
+				if want[id], err = ReconstructVector(ref, id); err != nil {
+					t.Fatal(err)
+				}
+			}
+		}
+		expect(xb[:nb*d], ids[:nb])
+		if err := AddVectorsWithIDs(idx, xb[:nb*d], ids[:nb]); err != nil {
+			t.Fatal(err)
+		}
+		table, err := NewIVFIdTable(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIVFIdTable(table)
+
+		check := func(name string, table uintptr, ids []int64) {
+			t.Helper()
+			got, err := IVFIdTableReconstruct(table, idx, ids)
+			if err != nil {
+				t.Fatalf("%s %s: %v", desc, name, err)
+			}
+			for i, id := range ids {
+				for j, v := range want[id] {
+					if got[i*d+j] != v {
+						t.Fatalf("%s %s: id %d reconstructs to other values than with a DirectMap", desc, name, id)
+					}
+				}
+			}
+			listNos, offsets, err := IVFIdTableLookup(table, absent)
+			if err != nil {
+				t.Fatal(err)
+			}
+			for i := range absent {
+				if listNos[i] != -1 || offsets[i] != -1 {
+					t.Errorf("%s %s: absent id %d found at (%d, %d)", desc, name, absent[i], listNos[i], offsets[i])
+				}
+			}
+			if size, capacity, err := IVFIdTableStats(table); err != nil || size != int64(len(ids)) || 5*size > 4*capacity {
+				t.Errorf("%s %s: %d ids in %d slots (%v), want %d ids at most 4/5 full", desc, name, size, capacity, err, len(ids))
+			}
+		}
+		check("built", table, ids[:nb])
+		if _, err := IVFIdTableReconstruct(table, idx, absent[:1]); err == nil {
+			t.Errorf("%s: reconstructed an absent id", desc)
+		}
+
+		if err := IVFIdTableAddWithIDs(table, idx, xb[nb*d:], ids[nb:]); err != nil {
+			t.Fatal(err)
+		}
+		expect(xb[nb*d:], ids[nb:])
+		if err := IVFIdTableUpdateVectors(table, idx, updated, xu); err != nil {
+			t.Fatal(err)
+		}
+		expect(xu, updated)
+		check("after adds and updates", table, ids)
+		if err := IVFIdTableUpdateVectors(table, idx, absent[:1], xu[:d]); err == nil {
+			t.Errorf("%s: updated an absent id", desc)
+		}
+		if GetIndexNtotal(idx) != nb+nadd {
+			t.Errorf("%s: %d vectors after the updates, want %d", desc, GetIndexNtotal(idx), nb+nadd)
+		}
+
+		fname := filepath.Join(dir, desc+".tbl")
+		if err := WriteIVFIdTable(table, fname); err != nil {
+			t.Fatal(err)
+		}
+		for _, mmap := range []bool{false, true} {
+			read, err := ReadIVFIdTable(fname, mmap)
+			if err != nil {
+				t.Fatal(err)
+			}
+			check(fmt.Sprintf("read (mmap %v)", mmap), read, ids)
+			FreeIVFIdTable(read)
+		}
+
+		// an update through a mapped table must not write to the file
+		mapped, err := ReadIVFIdTable(fname, true)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIVFIdTable(mapped)
+		listNos, offsets, err := IVFIdTableLookup(mapped, updated)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if err := IVFIdTableUpdateVectors(mapped, idx, updated, xb[:len(updated)*d]); err != nil {
+			t.Fatal(err)
+		}
+		expect(xb[:len(updated)*d], updated)
+		check("updated through a mapping", mapped, ids)
+		read, err := ReadIVFIdTable(fname, false)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIVFIdTable(read)
+		gotNos, gotOffsets, err := IVFIdTableLookup(read, updated)
+		if err != nil || !equalLabels(gotNos, listNos) || !equalLabels(gotOffsets, offsets) {
+			t.Errorf("%s: the update through a mapped table changed the file (%v)", desc, err)
+		}
+	}
+}
+
+// TestIVFTombstonesSharedParams searches through tombstones from several
+// goroutines with one SearchParametersIVF object holding a selector,
+// while ids are deleted, then checks the results against remove_ids.
+func TestIVFTombstonesSharedParams(t *testing.T) {
+	const d, nb, nq, k = 16, 4000, 20, 10
+	idx := ivfIndex(t, d, nb, "IVF32,Flat")
+	defer FreeIndex(idx)
+	if err := SetDirectMap(idx, 2); err != nil {
+		t.Fatal(err)
+	}
+	ts, err := NewIVFTombstones(idx)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIVFTombstones(ts)
+
+	sel, err := NewIDSelectorRange(0, 2000)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIDSelector(sel)
+	params, err := NewSearchParametersIVF(sel, 8, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+
+	xq := randomVectors(nq, d, 2)
+	var deleted []int64
+	for id := int64(0); id < 1000; id += 2 {
+		deleted = append(deleted, id)
+	}
+
+	var wg sync.WaitGroup
+	errs := make(chan error, 16)
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		for b := 0; b < len(deleted); b += 50 {
+			if _, err := IVFTombstonesDelete(ts, deleted[b:b+50]); err != nil {
+				errs <- err
+				return
+			}
+		}
+	}()
+	for g := 0; g < 8; g++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := 0; i < 30; i++ {
+				_, got, err := IVFTombstonesSearch(ts, d, params, xq, k)
+				if err != nil {
+					errs <- err
+					return
+				}
+				for _, id := range got {
+					if id >= 2000 {
+						t.Errorf("id %d outside the selector", id)
+						return
+					}
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatal(err)
+	}
+
+	ref, err := CloneIndex(idx)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(ref)
+	// remove_ids needs an IDSelectorArray with a hashtable DirectMap
+	if err := SetDirectMap(ref, 0); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := RemoveIDs(ref, deleted); err != nil {
+		t.Fatal(err)
+	}
+	_, want, err := SearchIndexWithParams(ref, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	_, got, err := IVFTombstonesSearch(ts, d, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !equalLabels(got, want) {
+		t.Errorf("search with tombstones differs from remove_ids")
+	}
+}
+
+// TestIVFTombstonesCompact compacts deletes in small batches and compares
+// search and reconstruct with IndexIVF::remove_ids on a copy.
+func TestIVFTombstonesCompact(t *testing.T) {
+	const d, nb, nq, k = 16, 4000, 50, 10
+	idx := ivfIndex(t, d, nb, "IVF32,Flat")
+	defer FreeIndex(idx)
+	if err := SetDirectMap(idx, 2); err != nil {
+		t.Fatal(err)
+	}
+	ts, err := NewIVFTombstones(idx)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIVFTombstones(ts)
+
+	rng := rand.New(rand.NewSource(3))
+	isDeleted := make([]bool, nb)
+	var deleted []int64
+	for _, id := range rng.Perm(nb)[:nb/3] {
+		isDeleted[id] = true
+		deleted = append(deleted, int64(id))
+	}
+	if n, err := IVFTombstonesDelete(ts, deleted); err != nil || n != int64(len(deleted)) {
+		t.Fatalf("deleted %d of %d: %v", n, len(deleted), err)
+	}
+
+	ref, err := CloneIndex(idx)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(ref)
+	// remove_ids needs an IDSelectorArray with a hashtable DirectMap
+	if err := SetDirectMap(ref, 0); err != nil {
+		t.Fatal(err)
+	}
+	if _, err := RemoveIDs(ref, deleted); err != nil {
+		t.Fatal(err)
+	}
+
+	n, err := IVFTombstonesCompact(ts, 4)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if n != int64(len(deleted)) || IVFTombstonesPending(ts) != 0 {
+		t.Errorf("compacted %d entries (%d pending), want %d", n, IVFTombstonesPending(ts), len(deleted))
+	}
+	if got := GetIndexNtotal(idx); got != int64(nb-len(deleted)) {
+		t.Errorf("ntotal %d after compaction, want %d", got, nb-len(deleted))
+	}
+
+	params, err := NewSearchParametersIVF(0, 8, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+	xq := randomVectors(nq, d, 2)
+	_, want, err := SearchIndexWithParams(ref, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	_, got, err := SearchIndexWithParams(idx, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !equalLabels(got, want) {
+		t.Errorf("search after compaction differs from remove_ids")
+	}
+	_, got, err = IVFTombstonesSearch(ts, d, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !equalLabels(got, want) {
+		t.Errorf("search through tombstones after compaction differs from remove_ids")
+	}
+
+	// the hashtable DirectMap follows the entries the compaction moved
+	xb := randomVectors(nb, d, 1)
+	for id := 0; id < nb; id++ {
+		v, err := ReconstructVector(idx, int64(id))
+		if isDeleted[id] {
+			if err == nil {
+				t.Fatalf("deleted id %d still reconstructs", id)
+			}
+			continue
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		for j := 0; j < d; j++ {
+			if v[j] != xb[id*d+j] {
+				t.Fatalf("id %d reconstructs to another vector", id)
+			}
+		}
+	}
+}
+
+// rangeResult is one result of a range search.
+type rangeResult struct {
+	label    int64
+	distance float32
+}
+
+// rangeResults splits range search results per query, sorted by label.
+func rangeResults(lims, labels []int64, distances []float32) [][]rangeResult {
+	out := make([][]rangeResult, len(lims)-1)
+	for q := range out {
+		for j := lims[q]; j < lims[q+1]; j++ {
+			out[q] = append(out[q], rangeResult{labels[j], distances[j]})
+		}
+		sort.Slice(out[q], func(a, b int) bool { return out[q][a].label < out[q][b].label })
+	}
+	return out
+}
+
+// TestRangeSearchArena compares arena range searches, into caller buffers,
+// into the arena and with count-then-fill, with Index::range_search, and
+// checks that a per-query cap keeps the closest results in range.
+func TestRangeSearchArena(t *testing.T) {
+	const d, nb, nq, maxPerQuery = 16, 3000, 40, 5
+	xq := randomVectors(nq, d, 2)
+	arena, err := NewRangeSearchArena()
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeRangeSearchArena(arena)
+	for _, tc := range []struct {
+		desc   string
+		metric int
+		radius float32
+	}{{"Flat", MetricL2, 0.8}, {"Flat", MetricInnerProduct, 5.5}, {"IVF16,Flat", MetricL2, 0.8}} {
+		idx := mustIndex(t, d, tc.desc, tc.metric)
+		defer FreeIndex(idx)
+		xb := randomVectors(nb, d, 1)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		name := fmt.Sprintf("%s metric=%d", tc.desc, tc.metric)
+		lims, labels, distances, err := RangeSearch(idx, xq, tc.radius)
+		if err != nil {
+			t.Fatal(err)
+		}
+		want := rangeResults(lims, labels, distances)
+		total := lims[nq]
+		if total < nq {
+			t.Fatalf("%s: only %d results, pick a larger radius", name, total)
+		}
+		same := func(how string, lims, labels []int64, distances []float32) {
+			t.Helper()
+			got := rangeResults(lims, labels, distances)
+			for q := range want {
+				if len(got[q]) != len(want[q]) {
+					t.Fatalf("%s %s: query %d has %d results, want %d", name, how, q, len(got[q]), len(want[q]))
+				}
+				for j := range want[q] {
+					if got[q][j].label != want[q][j].label || !closeTo(got[q][j].distance, want[q][j].distance) {
+						t.Fatalf("%s %s: query %d has result %v, want %v", name, how, q, got[q][j], want[q][j])
+					}
+				}
+			}
+		}
+
+		// count then fill: no caller buffers, the results stay in the arena
+		n, inOutput, err := RangeSearchWithArena(idx, 0, xq, tc.radius, 0, arena, nil, nil)
+		if err != nil || n != total || inOutput {
+			t.Fatalf("%s: counted %d results (in output %v, %v), want %d in the arena", name, n, inOutput, err, total)
+		}
+		gotLims, gotLabels, gotDistances, err := RangeSearchArenaCopy(arena, nq, n, true)
+		if err != nil {
+			t.Fatal(err)
+		}
+		same("copied out", gotLims, gotLabels, gotDistances)
+		gotLims, gotLabels, gotDistances, err = RangeSearchArenaResults(arena)
+		if err != nil {
+			t.Fatal(err)
+		}
+		same("in place", gotLims, gotLabels, gotDistances)
+
+		// caller buffers large enough, then one entry too small
+		for _, capacity := range []int64{total, total - 1} {
+			gotLabels, gotDistances = make([]int64, capacity), make([]float32, capacity)
+			n, inOutput, err = RangeSearchWithArena(idx, 0, xq, tc.radius, 0, arena, gotLabels, gotDistances)
+			if err != nil || n != total || inOutput != (capacity == total) {
+				t.Fatalf("%s: %d results with capacity %d (in output %v, %v)", name, n, capacity, inOutput, err)
+			}
+			if inOutput {
+				gotLims, _, _, err = RangeSearchArenaCopy(arena, nq, n, false)
+			} else {
+				gotLims, gotLabels, gotDistances, err = RangeSearchArenaResults(arena)
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+			same(fmt.Sprintf("with capacity %d", capacity), gotLims, gotLabels, gotDistances)
+		}
+
+		// the cap keeps the closest results in range; on IVF the scan stops
+		// early, so they only have to be in range
+		n, _, err = RangeSearchWithArena(idx, 0, xq, tc.radius, maxPerQuery, arena, nil, nil)
+		if err != nil {
+			t.Fatal(err)
+		}
+		gotLims, gotLabels, gotDistances, err = RangeSearchArenaCopy(arena, nq, n, true)
+		if err != nil {
+			t.Fatal(err)
+		}
+		capped := rangeResults(gotLims, gotLabels, gotDistances)
+		for q := range want {
+			if len(capped[q]) != min(len(want[q]), maxPerQuery) {
+				t.Fatalf("%s: query %d has %d capped results, want %d", name, q, len(capped[q]), min(len(want[q]), maxPerQuery))
+			}
+			inRange := map[int64]float32{}
+			for _, r := range want[q] {
+				inRange[r.label] = r.distance
+			}
+			closest := append([]rangeResult(nil), want[q]...)
+			sort.Slice(closest, func(a, b int) bool {
+				if tc.metric == MetricInnerProduct {
+					return closest[a].distance > closest[b].distance
+				}
+				return closest[a].distance < closest[b].distance
+			})
+			for _, r := range capped[q] {
+				dis, ok := inRange[r.label]
+				if !ok || !closeTo(dis, r.distance) {
+					t.Fatalf("%s: capped result %v of query %d is not in range", name, r, q)
+				}
+				if tc.desc == "Flat" && len(closest) > maxPerQuery {
+					bound := closest[maxPerQuery-1].distance
+					if tc.metric == MetricL2 && r.distance > bound || tc.metric == MetricInnerProduct && r.distance < bound {
+						t.Fatalf("%s: capped result %v of query %d is not among the closest", name, r, q)
+					}
+				}
+			}
+		}
+	}
+
+	// once the arena is large enough the searches do not grow it
+	idx := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(idx)
+	if err := AddVectors(idx, randomVectors(nb, d, 1)); err != nil {
+		t.Fatal(err)
+	}
+	if err := RangeSearchArenaReserve(arena, nq*nb); err != nil {
+		t.Fatal(err)
+	}
+	capacity, allocations, err := RangeSearchArenaStats(arena)
+	if err != nil || capacity < nq*nb {
+		t.Fatalf("arena holds %d results after reserving %d (%v)", capacity, nq*nb, err)
+	}
+	for _, radius := range []float32{0.5, 2, 100} {
+		if _, _, err := RangeSearchWithArena(idx, 0, xq, radius, 0, arena, nil, nil); err != nil {
+			t.Fatal(err)
+		}
+	}
+	if _, after, err := RangeSearchArenaStats(arena); err != nil || after != allocations {
+		t.Errorf("arena grew from %d to %d allocations within its capacity (%v)", allocations, after, err)
+	}
+}
+
+// TestSearchContext compares searches with reused contexts, one per
+// goroutine, with Index::search on HNSW, IVF, fast-scan and flat indexes,
+// over enough single-query HNSW searches to wrap the visited table
+// generations, and checks that the buffers stop growing.
+func TestSearchContext(t *testing.T) {
+	const d, nb, nq, k = 16, 3000, 300, 10
+	xq := randomVectors(nq, d, 2)
+	ivfParams, err := NewSearchParametersIVF(0, 4, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(ivfParams)
+	for _, tc := range []struct {
+		desc   string
+		metric int
+		params uintptr
+	}{
+		{"HNSW16,Flat", MetricL2, 0}, {"HNSW16,Flat", MetricInnerProduct, 0}, {"IVF16,Flat", MetricL2, 0},
+		{"IVF16,Flat", MetricL2, ivfParams}, {"IVF16,PQ8x4fs", MetricL2, 0}, {"Flat", MetricL2, 0},
+	} {
+		name := fmt.Sprintf("%s metric=%d params=%v", tc.desc, tc.metric, tc.params != 0)
+		idx := mustIndex(t, d, tc.desc, tc.metric)
+		defer FreeIndex(idx)
+		xb := randomVectors(nb, d, 1)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		var wantD []float32
+		var wantI []int64
+		if tc.params != 0 {
+			wantD, wantI, err = SearchIndexWithParams(idx, tc.params, xq, k)
+		} else {
+			wantD, wantI, err = SearchIndex(idx, xq, k)
+		}
+		if err != nil {
+			t.Fatal(err)
+		}
+		// single queries may take other kernels than the batch
+		wantSingle := make([][]int64, nq)
+		for q := range wantSingle {
+			if tc.params != 0 {
+				_, wantSingle[q], err = SearchIndexWithParams(idx, tc.params, xq[q*d:(q+1)*d], k)
+			} else {
+				_, wantSingle[q], err = SearchIndex(idx, xq[q*d:(q+1)*d], k)
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+		}
+
+		var wg sync.WaitGroup
+		for g := 0; g < 3; g++ {
+			wg.Add(1)
+			go func(g int) {
+				defer wg.Done()
+				ctx, err := NewSearchContext()
+				if err != nil {
+					t.Error(err)
+					return
+				}
+				defer FreeSearchContext(ctx)
+				// a batch, then single queries
+				gotD, gotI, err := SearchWithContext(idx, ctx, tc.params, xq, k)
+				if err != nil || !equalLabels(gotI, wantI) {
+					t.Errorf("%s: batch search with a context differs (%v)", name, err)
+					return
+				}
+				for j := range gotD {
+					if gotD[j] != wantD[j] {
+						t.Errorf("%s: batch distance %d is %g, want %g", name, j, gotD[j], wantD[j])
+						return
+					}
+				}
+				_, grows, _, _ := SearchContextStats(ctx)
+				for q := 0; q < nq; q++ {
+					_, gotI, err := SearchWithContext(idx, ctx, tc.params, xq[q*d:(q+1)*d], k)
+					if err != nil || !equalLabels(gotI, wantSingle[q]) {
+						t.Errorf("%s: goroutine %d, query %d differs (%v)", name, g, q, err)
+						return
+					}
+				}
+				_, after, searches, err := SearchContextStats(ctx)
+				if err != nil || after != grows || searches != nq+1 {
+					t.Errorf("%s: buffers grew from %d to %d times over %d searches (%v)", name, grows, after, searches, err)
+				}
+				if err := ResetSearchContext(ctx); err != nil {
+					t.Error(err)
+				}
+				if bytes, _, _, _ := SearchContextStats(ctx); bytes != 0 {
+					t.Errorf("%s: context holds %d bytes after a reset", name, bytes)
+				}
+			}(g)
+		}
+		wg.Wait()
+
+		// the calling thread's own context
+		gotD, gotI, err := SearchWithContext(idx, 0, tc.params, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		checkSameResults(t, name+" thread context", tc.metric, d, xb, xq, gotD, gotI, wantD, wantI)
+	}
+}
+
+// TestHNSWWideRoundTrip checks the "IxHW" files of wide HNSW graphs,
+// alone and under an IDMap3, then adds to the graphs read back, whose
+// mapped link chunks and codes are copied on the first add.
+func TestHNSWWideRoundTrip(t *testing.T) {
+	const d, nb, nadd, nq, k = 16, 3000, 500, 50, 10
+	xb := randomVectors(nb+nadd, d, 1)
+	for _, desc := range []string{"HNSWWide16,Flat", "HNSWWide16,SQ8", "IDMap3,HNSWWide16,Flat"} {
+		idx, err := NewIndexFactoryExt(d, desc, MetricL2)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(idx)
+		if err := TrainIndex(idx, xb[:nb*d]); err != nil {
+			t.Fatal(err)
+		}
+		withIDs := desc[:6] == "IDMap3"
+		ids := make([]int64, nb+nadd)
+		for i := range ids {
+			if withIDs {
+				ids[i] = int64(100 + 3*i)
+			} else {
+				ids[i] = int64(i)
+			}
+		}
+		for b := 0; b < 2; b++ {
+			lo, hi := b*nb/2, (b+1)*nb/2
+			if withIDs {
+				err = AddVectorsWithIDs(idx, xb[lo*d:hi*d], ids[lo:hi])
+			} else {
+				err = AddVectors(idx, xb[lo*d:hi*d])
+			}
+			if err != nil {
+				t.Fatal(err)
+			}
+		}
+		read := checkRoundTrip(t, idx, d, ids[:nb])
+
+		// every graph, extended, still finds the vectors added last
+		xq := xb[(nb+nadd-nq)*d:]
+		for i, r := range append(read, idx) {
+			if withIDs {
+				err = AddVectorsWithIDs(r, xb[nb*d:], ids[nb:])
+			} else {
+				err = AddVectors(r, xb[nb*d:])
+			}
+			if err != nil {
+				t.Fatalf("%s: add to index %d: %v", desc, i, err)
+			}
+			_, I, err := SearchIndex(r, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			found := 0
+			for q := 0; q < nq; q++ {
+				if I[q*k] == ids[nb+nadd-nq+q] {
+					found++
+				}
+			}
+			if found < nq*9/10 {
+				t.Errorf("%s: index %d finds %d of %d added vectors", desc, i, found, nq)
+			}
+		}
+	}
+}
+
+// TestGraphSearch checks that the graph search walks HNSW and NSG graphs
+// (NNDescent has no factory string) like FAISS with either visited set,
+// that a wider beam does not lower recall, and that IndexHNSWWide takes
+// the same parameters.
+func TestGraphSearch(t *testing.T) {
+	const d, nb, nq, k = 16, 3000, 50, 10
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	recall := func(idx, params uintptr, metric int) int {
+		t.Helper()
+		flat := mustIndex(t, d, "Flat", metric)
+		defer FreeIndex(flat)
+		if err := AddVectors(flat, xb); err != nil {
+			t.Fatal(err)
+		}
+		_, wantI, err := SearchIndex(flat, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		_, gotI, err := SearchGraph(idx, params, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		hits := 0
+		for q := 0; q < nq; q++ {
+			for _, want := range wantI[q*k : (q+1)*k] {
+				for _, got := range gotI[q*k : (q+1)*k] {
+					if got == want {
+						hits++
+						break
+					}
+				}
+			}
+		}
+		return hits
+	}
+	modes := map[string]int{"auto": VisitedAuto, "dense": VisitedDense, "sparse": VisitedSparse}
+	for _, tc := range []struct {
+		desc   string
+		metric int
+	}{{"HNSW16,Flat", MetricL2}, {"HNSW16,Flat", MetricInnerProduct}, {"NSG16,Flat", MetricL2}} {
+		name := fmt.Sprintf("%s metric=%d", tc.desc, tc.metric)
+		idx := mustIndex(t, d, tc.desc, tc.metric)
+		defer FreeIndex(idx)
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		wantD, wantI, err := SearchIndex(idx, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		gotD, gotI, err := SearchGraph(idx, 0, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		checkSameResults(t, name+" default", tc.metric, d, xb, xq, gotD, gotI, wantD, wantI)
+		var wideD []float32
+		var wideI []int64
+		for mode, visited := range modes {
+			params, err := NewSearchParametersGraph(0, visited)
+			if err != nil {
+				t.Fatal(err)
+			}
+			gotD, gotI, err := SearchGraph(idx, params, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			FreeSearchParametersGraph(params)
+			checkSameResults(t, name+" "+mode, tc.metric, d, xb, xq, gotD, gotI, wantD, wantI)
+
+			// with a wider beam both sets must still agree
+			params, err = NewSearchParametersGraph(128, visited)
+			if err != nil {
+				t.Fatal(err)
+			}
+			gotD, gotI, err = SearchGraph(idx, params, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if wideD == nil {
+				wideD, wideI = gotD, gotI
+				if narrow, wide := recall(idx, 0, tc.metric), recall(idx, params, tc.metric); wide < narrow {
+					t.Errorf("%s: recall %d with ef 128, %d with the default", name, wide, narrow)
+				}
+			} else {
+				checkSameResults(t, name+" ef 128 "+mode, tc.metric, d, xb, xq, gotD, gotI, wideD, wideI)
+			}
+			FreeSearchParametersGraph(params)
+		}
+	}
+
+	wide, err := NewIndexFactoryExt(d, "HNSWWide16,Flat", MetricL2)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(wide)
+	if err := AddVectors(wide, xb); err != nil {
+		t.Fatal(err)
+	}
+	params, err := NewSearchParametersGraph(256, VisitedAuto)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParametersGraph(params)
+	if hits := recall(wide, params, MetricL2); hits < nq*k*95/100 {
+		t.Errorf("HNSWWide recall %d of %d with ef 256", hits, nq*k)
+	}
+}
+
+// TestParameterSpaceExplore explores nprobe on an IVF index with and
+// without pruning and checks each point against a search with the same
+// parameters, the Pareto frontier against all the points, and that
+// pruning keeps the best recall.
+func TestParameterSpaceExplore(t *testing.T) {
+	const d, nb, nq = 16, 3000, 200
+	nprobes := []float64{1, 2, 4, 8, 16}
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	flat := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(flat)
+	if err := AddVectors(flat, xb); err != nil {
+		t.Fatal(err)
+	}
+	_, gt, err := SearchIndex(flat, xq, 1)
+	if err != nil {
+		t.Fatal(err)
+	}
+	idx := ivfIndex(t, d, nb, "IVF16,Flat")
+	defer FreeIndex(idx)
+
+	// 1-recall@1 of each nprobe, from regular searches
+	want := map[string]float64{}
+	for _, nprobe := range nprobes {
+		params, err := NewSearchParametersIVF(0, int(nprobe), 0)
+		if err != nil {
+			t.Fatal(err)
+		}
+		_, I, err := SearchIndexWithParams(idx, params, xq, 1)
+		FreeSearchParameters(params)
+		if err != nil {
+			t.Fatal(err)
+		}
+		hits := 0
+		for q := range gt {
+			if I[q] == gt[q] {
+				hits++
+			}
+		}
+		want[fmt.Sprintf("nprobe=%g", nprobe)] = float64(hits) / nq
+	}
+
+	space, err := NewParameterSpace(0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeParameterSpace(space)
+	if err := ParameterSpaceSetRange(space, "nprobe", nprobes); err != nil {
+		t.Fatal(err)
+	}
+	best := 0.0
+	for _, v := range want {
+		best = math.Max(best, v)
+	}
+	for _, run := range []struct{ nThreads, nSubset int }{{1, -1}, {0, -1}, {2, 0}, {0, 50}} {
+		name := fmt.Sprintf("threads=%d subset=%d", run.nThreads, run.nSubset)
+		all, optimal, pruned, err := ParameterSpaceExplore(space, idx, xq, 1, gt, CriterionOneRecall, 1, run.nThreads, run.nSubset)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if int64(len(all))+pruned != int64(len(nprobes)) || (run.nSubset < 0 && pruned != 0) {
+			t.Errorf("%s: %d points and %d pruned of %d combinations", name, len(all), pruned, len(nprobes))
+		}
+		for _, p := range all {
+			if w, ok := want[p.Key]; !ok || math.Abs(p.Perf-w) > 1e-9 {
+				t.Errorf("%s: point %q has recall %g, want %g", name, p.Key, p.Perf, w)
+			}
+		}
+		// each optimal point is faster than the next one, which does better,
+		// and no point beats the frontier
+		for i, p := range optimal {
+			if i > 0 && (p.Perf <= optimal[i-1].Perf || p.T < optimal[i-1].T) {
+				t.Errorf("%s: frontier is not sorted at %d: %+v after %+v", name, i, p, optimal[i-1])
+			}
+		}
+		for _, p := range all {
+			dominated := false
+			for _, o := range optimal {
+				if o.Perf >= p.Perf && o.T <= p.T {
+					dominated = true
+				}
+			}
+			if !dominated {
+				t.Errorf("%s: point %+v is not covered by the frontier", name, p)
+			}
+		}
+		if len(optimal) == 0 || optimal[len(optimal)-1].Perf != best {
+			t.Errorf("%s: frontier %+v misses the best recall %g", name, optimal, best)
+		}
+	}
+}
+
+// TestSearchController drives controllers to the top of their ladder with
+// a target no search can miss, then to the bottom with one every search
+// misses, checking each call against a search at the level's nprobe and
+// the history of level changes. Ladders come from the default, a
+// one-range space and explored operating points.
+func TestSearchController(t *testing.T) {
+	const d, nb, nq, k, calls = 16, 3000, 2, 5, 300
+	xq := randomVectors(20, d, 2)
+	idx := ivfIndex(t, d, nb, "IVF16,Flat")
+	defer FreeIndex(idx)
+
+	space, err := NewParameterSpace(0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeParameterSpace(space)
+	if err := ParameterSpaceSetRange(space, "nprobe", []float64{1, 3, 16}); err != nil {
+		t.Fatal(err)
+	}
+	flat := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(flat)
+	if err := AddVectors(flat, randomVectors(nb, d, 1)); err != nil {
+		t.Fatal(err)
+	}
+	_, gt, err := SearchIndex(flat, xq, 1)
+	if err != nil {
+		t.Fatal(err)
+	}
+	ops, _, err := ParameterSpaceExploreOps(space, idx, xq, 1, gt, CriterionOneRecall, 1, 1, -1)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeOperatingPoints(ops)
+	optimal, err := OperatingPoints(ops, true)
+	if err != nil {
+		t.Fatal(err)
+	}
+
+	for _, tc := range []struct {
+		name       string
+		space, ops uintptr
+		levels     int
+	}{{"default", 0, 0, 5}, {"space", space, 0, 3}, {"operating points", space, ops, len(optimal)}} {
+		ctrl, err := NewSearchController(idx, 1e6, tc.space, tc.ops)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeSearchController(ctrl)
+		run := func(phase string) {
+			t.Helper()
+			for c := 0; c < calls; c++ {
+				_, _, key, err := SearchControllerState(ctrl)
+				if err != nil {
+					t.Fatal(err)
+				}
+				var nprobe int
+				if _, err := fmt.Sscanf(key, "nprobe=%d", &nprobe); err != nil {
+					t.Fatalf("%s: level key %q", tc.name, key)
+				}
+				q := xq[c%10*d : (c%10+nq)*d]
+				_, gotI, err := SearchControllerSearch(ctrl, d, q, k)
+				if err != nil {
+					t.Fatal(err)
+				}
+				params, err := NewSearchParametersIVF(0, nprobe, 0)
+				if err != nil {
+					t.Fatal(err)
+				}
+				_, wantI, err := SearchIndexWithParams(idx, params, q, k)
+				FreeSearchParameters(params)
+				if err != nil {
+					t.Fatal(err)
+				}
+				if !equalLabels(gotI, wantI) {
+					t.Fatalf("%s %s: call %d at %s returns other results than nprobe %d", tc.name, phase, c, key, nprobe)
+				}
+			}
+		}
+
+		run("up")
+		level, nLevels, _, err := SearchControllerState(ctrl)
+		if err != nil || nLevels != tc.levels || level != nLevels-1 {
+			t.Fatalf("%s: at level %d of %d after %d calls under a loose target, want the top of %d (%v)",
+				tc.name, level, nLevels, calls, tc.levels, err)
+		}
+		if err := SearchControllerSetTarget(ctrl, 1e-9); err != nil {
+			t.Fatal(err)
+		}
+		run("down")
+		if level, _, _, _ := SearchControllerState(ctrl); level != 0 {
+			t.Fatalf("%s: at level %d after %d calls over the target, want 0", tc.name, level, calls)
+		}
+
+		history, err := SearchControllerHistory(ctrl)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if len(history) != 2*(tc.levels-1) {
+			t.Errorf("%s: %d level changes, want %d", tc.name, len(history), 2*(tc.levels-1))
+		}
+		for i, h := range history {
+			up := i < tc.levels-1
+			if (up && h.To != h.From+1) || (!up && h.To != h.From-1) || h.Call%16 != 0 || h.P95Ms <= 0 ||
+				(i > 0 && (h.Call <= history[i-1].Call || h.TimeMs < history[i-1].TimeMs || h.From != history[i-1].To)) {
+				t.Errorf("%s: change %d is %+v", tc.name, i, h)
+			}
+		}
+	}
+}
+
+// TestCompiledFactory checks that factory instances have the structure of
+// index_factory_ext's indexes, that instances of a trained index keep its
+// training but not its vectors, and that reverse factory strings rebuild
+// the same tree.
+func TestCompiledFactory(t *testing.T) {
+	const d, nb = 16, 2000
+	descriptions := []string{"Flat", "IDMap2,Flat", "HNSW16", "IVF16,Flat", "IVF16,PQ4np", "IVF16,SQ8",
+		"PCA8,IVF16,Flat", "OPQ4_16,IVF16,PQ4np", "IVF16,PQ4x4fs", "IVF16,Flat,RFlat", "LSH", "IDMap3,Flat", "HNSWWide16"}
+
+	sameTree := func(name string, a, b []IndexNode) {
+		t.Helper()
+		if len(a) != len(b) {
+			t.Fatalf("%s: trees of %d and %d nodes", name, len(a), len(b))
+		}
+		for i := range a {
+			if a[i].Parent != b[i].Parent || a[i].Role != b[i].Role || a[i].Type != b[i].Type ||
+				a[i].CodeSize != b[i].CodeSize || a[i].M != b[i].M || a[i].Nlist != b[i].Nlist || a[i].QType != b[i].QType {
+				t.Fatalf("%s: node %d is %+v, want %+v", name, i, a[i], b[i])
+			}
+		}
+	}
+
+	for _, desc := range descriptions {
+		idx, err := NewIndexFactoryExt(d, desc, MetricL2)
+		if err != nil {
+			t.Fatalf("%s: %v", desc, err)
+		}
+		tree, err := DescribeIndex(idx)
+		if err != nil {
+			t.Fatalf("%s: %v", desc, err)
+		}
+		if len(tree) == 0 || tree[0].Parent != -1 || tree[0].D != d {
+			t.Fatalf("%s: root %+v", desc, tree)
+		}
+		for i, n := range tree[1:] {
+			if n.Parent < 0 || n.Parent > i {
+				t.Fatalf("%s: node %d has parent %d", desc, i+1, n.Parent)
+			}
+		}
+		reverse, err := ReverseIndexFactory(idx)
+		if err != nil {
+			t.Fatalf("%s: %v", desc, err)
+		}
+		rebuilt, err := NewIndexFactoryExt(d, reverse, MetricL2)
+		if err != nil {
+			t.Fatalf("%s: reverse string %q: %v", desc, reverse, err)
+		}
+		rebuiltTree, _ := DescribeIndex(rebuilt)
+		sameTree(desc+" -> "+reverse, rebuiltTree, tree)
+		if again, _ := ReverseIndexFactory(rebuilt); again != reverse {
+			t.Errorf("%s: reverse string %q, then %q", desc, reverse, again)
+		}
+		FreeIndex(rebuilt)
+
+		f, err := NewCompiledFactory(d, desc, MetricL2)
+		if err != nil {
+			t.Fatalf("%s: %v", desc, err)
+		}
+		var wg sync.WaitGroup
+		instances := make([]uintptr, 4)
+		errs := make([]error, len(instances))
+		for i := range instances {
+			wg.Add(1)
+			go func(i int) {
+				defer wg.Done()
+				instances[i], errs[i] = CompiledFactoryInstantiate(f)
+			}(i)
+		}
+		wg.Wait()
+		FreeCompiledFactory(f)
+		for i, inst := range instances {
+			if errs[i] != nil {
+				t.Fatalf("%s: %v", desc, errs[i])
+			}
+			instTree, _ := DescribeIndex(inst)
+			sameTree(desc+" instance", instTree, tree)
+			for j := range instances[:i] {
+				if instances[j] == inst {
+					t.Fatalf("%s: instances %d and %d are the same index", desc, j, i)
+				}
+			}
+		}
+		for _, inst := range instances {
+			FreeIndex(inst)
+		}
+		FreeIndex(idx)
+	}
+
+	if _, err := NewCompiledFactory(d, "IVF16,Bogus", MetricL2); err == nil {
+		t.Error("factory of an invalid description")
+	}
+
+	// An instance of a trained index has its training: adding the same
+	// vectors gives the same results without training again.
+	trained := ivfIndex(t, d, nb, "IVF16,PQ4np")
+	defer FreeIndex(trained)
+	f, err := NewCompiledFactoryFromIndex(trained)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeCompiledFactory(f)
+	inst, err := CompiledFactoryInstantiate(f)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(inst)
+	tree, err := DescribeIndex(inst)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if tree[0].Type != "IndexIVFPQ" || tree[0].Nlist != 16 || tree[0].M != 4 || tree[0].Nbits != 8 || tree[0].CodeSize != 4 ||
+		!tree[0].Trained || tree[0].Ntotal != 0 || GetIndexNtotal(trained) != nb {
+		t.Fatalf("instance of a trained index: %+v", tree[0])
+	}
+	if len(tree) < 2 || tree[1].Role != "quantizer" || tree[1].Parent != 0 || tree[1].Ntotal != 16 {
+		t.Fatalf("instance quantizer: %+v", tree)
+	}
+	if err := AddVectors(inst, randomVectors(nb, d, 1)); err != nil {
+		t.Fatal(err)
+	}
+	xq := randomVectors(20, d, 2)
+	wantD, wantI, err := SearchIndex(trained, xq, 5)
+	if err != nil {
+		t.Fatal(err)
+	}
+	gotD, gotI, err := SearchIndex(inst, xq, 5)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if !equalLabels(gotI, wantI) {
+		t.Fatal("instance of a trained index returns other results")
+	}
+	for i := range gotD {
+		if !closeTo(gotD[i], wantD[i]) {
+			t.Fatalf("distance %d: %g, want %g", i, gotD[i], wantD[i])
+		}
+	}
+}
+
+// TestSnapshotSharedParams searches one snapshot from several goroutines
+// with a single SearchParameters object whose selector the snapshot
+// translates from ids to positions, while adds publish new snapshots.
+func TestSnapshotSharedParams(t *testing.T) {
+	const d, nb, nq, k = 16, 2000, 20, 10
+	base := mustIndex(t, d, "IDMap,Flat", MetricL2)
+	defer FreeIndex(base)
+	ids := make([]int64, nb)
+	for i := range ids {
+		ids[i] = int64(1000 + 3*i)
+	}
+	if err := AddVectorsWithIDs(base, randomVectors(nb, d, 1), ids); err != nil {
+		t.Fatal(err)
+	}
+	snap, err := NewSnapshotIndex(base)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSnapshotIndex(snap)
+	view, _, err := SnapshotIndexAcquire(snap)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndex(view)
+
+	sel, err := NewIDSelectorRange(2000, 3000)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIDSelector(sel)
+	params, err := NewSearchParameters(sel)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+
+	xq := randomVectors(nq, d, 2)
+	_, want, err := SearchIndexWithParams(view, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	for _, id := range want {
+		if id < 2000 || id >= 3000 {
+			t.Fatalf("id %d outside the selector", id)
+		}
+	}
+
+	var wg sync.WaitGroup
+	errs := make(chan error, 16)
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		for i := 0; i < 20; i++ {
+			extra := []int64{int64(100000 + i)}
+			if err := SnapshotIndexAddWithIDs(snap, randomVectors(1, d, int64(10+i)), extra); err != nil {
+				errs <- err
+				return
+			}
+		}
+	}()
+	for g := 0; g < 8; g++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for i := 0; i < 50; i++ {
+				_, got, err := SearchIndexWithParams(view, params, xq, k)
+				if err != nil {
+					errs <- err
+					return
+				}
+				if !equalLabels(got, want) {
+					t.Errorf("concurrent search with shared parameters returned other results")
+					return
+				}
+			}
+		}()
+	}
+	wg.Wait()
+	close(errs)
+	for err := range errs {
+		t.Fatal(err)
+	}
+	if n := SnapshotIndexNtotal(snap); n != nb+20 {
+		t.Errorf("ntotal %d, want %d", n, nb+20)
+	}
+}
+
+// TestSnapshotIndexCopyOnWrite adds batches to a snapshot index while
+// goroutines acquire and search snapshots. Each snapshot must return the
+// results of the base index with the batches of its version added, also
+// after later adds have grown the buffers and after the base index and
+// the snapshot index are freed.
+func TestSnapshotIndexCopyOnWrite(t *testing.T) {
+	const d, nb, nbatch, batch, nq, k = 16, 1000, 12, 37, 10, 5
+	xq := randomVectors(nq, d, 2)
+	for _, desc := range []string{"Flat", "IDMap,Flat", "IVF16,Flat", "IVF16,PQ8x4"} {
+		withIDs := desc != "Flat"
+		ivf := desc[:3] == "IVF"
+		base := mustIndex(t, d, desc, MetricL2)
+		xb := randomVectors(nb, d, 1)
+		if ivf {
+			if err := TrainIndex(base, xb); err != nil {
+				t.Fatal(err)
+			}
+		}
+		add := func(idx uintptr, snap uintptr, b int) error {
+			x := randomVectors(batch, d, int64(100+b))
+			if !withIDs {
+				if snap != 0 {
+					return SnapshotIndexAdd(snap, batch, x)
+				}
+				return AddVectors(idx, x)
+			}
+			ids := make([]int64, batch)
+			for i := range ids {
+				ids[i] = int64(7 + 10*(b*batch+i))
+			}
+			if snap != 0 {
+				return SnapshotIndexAddWithIDs(snap, x, ids)
+			}
+			return AddVectorsWithIDs(idx, x, ids)
+		}
+		if err := add(base, 0, -1); err != nil {
+			t.Fatal(err)
+		}
+
+		// results of each version on a plain copy of the index
+		ref, err := CloneIndex(base)
+		if err != nil {
+			t.Fatal(err)
+		}
+		want := make([][]int64, nbatch+1)
+		for v := 0; v <= nbatch; v++ {
+			if v > 0 {
+				if err := add(ref, 0, v-1); err != nil {
+					t.Fatal(err)
+				}
+			}
+			if _, want[v], err = SearchIndex(ref, xq, k); err != nil {
+				t.Fatal(err)
+			}
+		}
+		FreeIndex(ref)
+
+		snap, err := NewSnapshotIndex(base)
+		if err != nil {
+			t.Fatal(err)
+		}
+		// snapshots of IVF indexes share the quantizer and the IVFPQ
+		// precomputed table of a copy, not of the base index
+		FreeIndex(base)
+
+		views := make([]uintptr, nbatch+1)
+		var wg sync.WaitGroup
+		var stop atomic.Bool
+		errs := make(chan string, 16)
+		for g := 0; g < 3; g++ {
+			wg.Add(1)
+			go func() {
+				defer wg.Done()
+				for !stop.Load() {
+					view, version, err := SnapshotIndexAcquire(snap)
+					if err != nil {
+						errs <- err.Error()
+						return
+					}
+					_, I, err := SearchIndex(view, xq, k)
+					n := GetIndexNtotal(view)
+					FreeIndex(view)
+					if err != nil {
+						errs <- err.Error()
+						return
+					}
+					if version > nbatch || n != int64(batch*(int(version)+1)) || !equalLabels(I, want[version]) {
+						errs <- fmt.Sprintf("snapshot version %d (ntotal %d) differs from the index with its adds", version, n)
+						return
+					}
+				}
+			}()
+		}
+		for v := 0; v <= nbatch; v++ {
+			if v > 0 {
+				if err := add(0, snap, v-1); err != nil {
+					t.Fatal(err)
+				}
+			}
+			if views[v], _, err = SnapshotIndexAcquire(snap); err != nil {
+				t.Fatal(err)
+			}
+		}
+		stop.Store(true)
+		wg.Wait()
+		close(errs)
+		for msg := range errs {
+			t.Errorf("%s: %s", desc, msg)
+		}
+		FreeSnapshotIndex(snap)
+
+		for v, view := range views {
+			_, I, err := SearchIndex(view, xq, k)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if !equalLabels(I, want[v]) {
+				t.Errorf("%s: snapshot %d changed after later adds", desc, v)
+			}
+			FreeIndex(view)
+		}
+	}
+}
+
+// segmentedIndex returns a segmented index with Flat write segments and
+// IVF16,Flat sealed segments searched with nprobe = nlist, so that its
+// results are exact.
+func segmentedIndex(t *testing.T, d, writeCapacity int, background bool) uintptr {
+	t.Helper()
+	w := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(w)
+	s := mustIndex(t, d, "IVF16,Flat", MetricL2)
+	defer FreeIndex(s)
+	if err := TrainIndex(s, randomVectors(2000, d, 99)); err != nil {
+		t.Fatal(err)
+	}
+	idx, err := NewSegmentedIndex(w, s, writeCapacity, 3, 2, 0.25, background)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := SegmentedIndexSetSearchParams(idx, 16, 0); err != nil {
+		t.Fatal(err)
+	}
+	return idx
+}
+
+// checkExact verifies that D, I hold the exact k nearest neighbors of the
+// queries xq among ref (id -> vector), up to ties.
+func checkExact(t *testing.T, ref map[int64][]float32, d int, xq []float32, k int, D []float32, I []int64) {
+	t.Helper()
+	const tol = 1e-4
+	for q := 0; q < len(xq)/d; q++ {
+		x := xq[q*d : (q+1)*d]
+		all := make([]float32, 0, len(ref))
+		for _, v := range ref {
+			all = append(all, l2(x, v))
+		}
+		sort.Slice(all, func(i, j int) bool { return all[i] < all[j] })
+		seen := map[int64]bool{}
+		for r := 0; r < k && r < len(all); r++ {
+			id, dis := I[q*k+r], D[q*k+r]
+			v, ok := ref[id]
+			if !ok || seen[id] {
+				t.Fatalf("query %d rank %d: label %d is not a live id or is repeated", q, r, id)
+			}
+			seen[id] = true
+			if math.Abs(float64(l2(x, v)-dis)) > tol || math.Abs(float64(all[r]-dis)) > tol {
+				t.Fatalf("query %d rank %d: distance %g, want %g", q, r, dis, all[r])
+			}
+		}
+	}
+}
+
+// TestSegmentedIndexUpserts applies random upserts and deletes, through
+// seals, merges and purges, and compares searches with a brute-force
+// search of the live vectors.
+func TestSegmentedIndexUpserts(t *testing.T) {
+	const d, k, nq = 16, 10, 20
+	for _, background := range []bool{false, true} {
+		idx := segmentedIndex(t, d, 150, background)
+		defer FreeSegmentedIndex(idx)
+		rng := rand.New(rand.NewSource(5))
+		ref := map[int64][]float32{}
+		xq := randomVectors(nq, d, 2)
+		for round := 0; round < 30; round++ {
+			ids := make([]int64, 100)
+			for i := range ids {
+				ids[i] = int64(rng.Intn(2000))
+			}
+			x := randomVectors(len(ids), d, int64(1000+round))
+			if err := SegmentedIndexAdd(idx, x, ids); err != nil {
+				t.Fatal(err)
+			}
+			for i, id := range ids {
+				ref[id] = x[i*d : (i+1)*d]
+			}
+			var del []int64
+			want := 0
+			for _, id := range rng.Perm(2000)[:40] {
+				del = append(del, int64(id))
+				if _, ok := ref[int64(id)]; ok {
+					want++
+					delete(ref, int64(id))
+				}
+			}
+			if n, err := SegmentedIndexRemove(idx, del); err != nil || n != want {
+				t.Fatalf("removed %d ids, want %d (%v)", n, want, err)
+			}
+			if round%10 == 9 {
+				D, I, err := SegmentedIndexSearch(idx, d, xq, k)
+				if err != nil {
+					t.Fatal(err)
+				}
+				checkExact(t, ref, d, xq, k, D, I)
+			}
+		}
+
+		if err := SegmentedIndexFlush(idx); err != nil {
+			t.Fatal(err)
+		}
+		if n := SegmentedIndexNtotal(idx); n != int64(len(ref)) {
+			t.Errorf("ntotal %d, want %d", n, len(ref))
+		}
+		segs, err := SegmentedIndexSegments(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		last := segs[len(segs)-1]
+		if last.State != 0 || last.Ntotal != 0 {
+			t.Errorf("write segment %+v after flush, want an empty one", last)
+		}
+		for _, seg := range segs[:len(segs)-1] {
+			if seg.State != 2 {
+				t.Errorf("segment %+v not sealed after flush", seg)
+			}
+		}
+		if len(segs)-1 > 3 {
+			t.Errorf("%d sealed segments after flush, max_segments is 3", len(segs)-1)
+		}
+		D, I, err := SegmentedIndexSearch(idx, d, xq, k)
+		if err != nil {
+			t.Fatal(err)
+		}
+		checkExact(t, ref, d, xq, k, D, I)
+	}
+}
+
+// TestSegmentedIndexSearchDuringSeal searches vectors that do not change
+// while upserts and deletes of other ids make the background thread seal
+// and merge segments.
+func TestSegmentedIndexSearchDuringSeal(t *testing.T) {
+	const d, k, nstable = 16, 5, 500
+	idx := segmentedIndex(t, d, 200, true)
+	defer FreeSegmentedIndex(idx)
+	ref := map[int64][]float32{}
+	xs := randomVectors(nstable, d, 1)
+	ids := make([]int64, nstable)
+	for i := range ids {
+		ids[i] = int64(i)
+		ref[int64(i)] = xs[i*d : (i+1)*d]
+	}
+	if err := SegmentedIndexAdd(idx, xs, ids); err != nil {
+		t.Fatal(err)
+	}
+	if err := SegmentedIndexFlush(idx); err != nil {
+		t.Fatal(err)
+	}
+
+	var wg sync.WaitGroup
+	var stop atomic.Bool
+	var searches atomic.Int64
+	errs := make(chan string, 16)
+	xq := xs[:20*d]
+	for g := 0; g < 4; g++ {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			for !stop.Load() {
+				D, I, err := SegmentedIndexSearch(idx, d, xq, k)
+				if err != nil {
+					errs <- err.Error()
+					return
+				}
+				for q := 0; q < 20; q++ {
+					if I[q*k] != int64(q) || D[q*k] > 1e-5 {
+						errs <- fmt.Sprintf("query %d: nearest %d at %g, want itself", q, I[q*k], D[q*k])
+						return
+					}
+				}
+				searches.Add(1)
+			}
+		}()
+	}
+	// on few cores the searchers may not be scheduled before the upserts end
+	for searches.Load() == 0 && len(errs) == 0 {
+		time.Sleep(time.Millisecond)
+	}
+	for b := 0; b < 20; b++ {
+		bids := make([]int64, 250)
+		for i := range bids {
+			bids[i] = int64(1000 + 250*b + i)
+		}
+		x := randomVectors(len(bids), d, int64(100+b))
+		if err := SegmentedIndexAdd(idx, x, bids); err != nil {
+			t.Fatal(err)
+		}
+		for i, id := range bids {
+			ref[id] = x[i*d : (i+1)*d]
+		}
+		var del []int64
+		for _, id := range bids {
+			if id%3 == 0 {
+				del = append(del, id)
+				delete(ref, id)
+			}
+		}
+		if _, err := SegmentedIndexRemove(idx, del); err != nil {
+			t.Fatal(err)
+		}
+	}
+	stop.Store(true)
+	wg.Wait()
+	close(errs)
+	for msg := range errs {
+		t.Error(msg)
+	}
+	if searches.Load() == 0 {
+		t.Error("no search ran during the upserts")
+	}
+
+	if err := SegmentedIndexFlush(idx); err != nil {
+		t.Fatal(err)
+	}
+	if n := SegmentedIndexNtotal(idx); n != int64(len(ref)) {
+		t.Errorf("ntotal %d, want %d", n, len(ref))
+	}
+	xq = randomVectors(20, d, 2)
+	D, I, err := SegmentedIndexSearch(idx, d, xq, 10)
+	if err != nil {
+		t.Fatal(err)
+	}
+	checkExact(t, ref, d, xq, 10, D, I)
+}
+
+// searchAllLists searches an IVF index with nprobe = 16, all the lists of
+// the indexes of these tests.
+func searchAllLists(t *testing.T, idx uintptr, xq []float32, k int) []int64 {
+	t.Helper()
+	params, err := NewSearchParametersIVF(0, 16, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParameters(params)
+	_, I, err := SearchIndexWithParams(idx, params, xq, k)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return I
+}
+
+// TestCloneIndexShallow modifies an index and its copy-on-write clones on
+// every side, and compares each with a deep copy modified the same way.
+func TestCloneIndexShallow(t *testing.T) {
+	const d, nb, nq, k = 16, 2000, 20, 20
+	xq := randomVectors(nq, d, 2)
+	for _, desc := range []string{"IVF16,Flat", "PCA8,IVF16,SQ8"} {
+		idx := ivfIndex(t, d, nb, desc)
+		defer FreeIndex(idx)
+		refAdd, err := CloneIndex(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(refAdd)
+		refRemove, err := CloneIndex(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(refRemove)
+		want := searchAllLists(t, idx, xq, k)
+
+		clone, err := CloneIndexShallow(idx)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(clone)
+		chained, err := CloneIndexShallow(clone)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(chained)
+		for _, c := range []uintptr{idx, clone, chained} {
+			if !equalLabels(searchAllLists(t, c, xq, k), want) {
+				t.Fatalf("%s: shallow clone returns other results", desc)
+			}
+		}
+
+		// the adds copy the codes of the lists they touch in the clone,
+		// the removes those of the source
+		xa := randomVectors(300, d, 7)
+		for _, c := range []uintptr{clone, refAdd} {
+			if err := AddVectors(c, xa); err != nil {
+				t.Fatal(err)
+			}
+		}
+		var del []int64
+		for id := int64(0); id < 600; id += 2 {
+			del = append(del, id)
+		}
+		for _, c := range []uintptr{idx, refRemove} {
+			if _, err := RemoveIDs(c, del); err != nil {
+				t.Fatal(err)
+			}
+		}
+		if !equalLabels(searchAllLists(t, clone, xq, k), searchAllLists(t, refAdd, xq, k)) ||
+			GetIndexNtotal(clone) != nb+300 {
+			t.Errorf("%s: clone differs from a deep copy after adds", desc)
+		}
+		if !equalLabels(searchAllLists(t, idx, xq, k), searchAllLists(t, refRemove, xq, k)) ||
+			GetIndexNtotal(idx) != nb-300 {
+			t.Errorf("%s: source differs from a deep copy after removes", desc)
+		}
+		if !equalLabels(searchAllLists(t, chained, xq, k), want) || GetIndexNtotal(chained) != nb {
+			t.Errorf("%s: clone of the clone changed with the adds and removes of the others", desc)
+		}
+
+		if _, err := RemoveIDs(chained, []int64{1, 3, 5, 7}); err != nil {
+			t.Fatal(err)
+		}
+		if !equalLabels(searchAllLists(t, clone, xq, k), searchAllLists(t, refAdd, xq, k)) {
+			t.Errorf("%s: clone changed with the removes of its own clone", desc)
+		}
+	}
+}
+
+// TestCloneIndexParallel compares a parallel clone with its source, and
+// checks that adds to the clone leave the source unchanged.
+func TestCloneIndexParallel(t *testing.T) {
+	const d, nb, nq, k = 16, 2000, 20, 20
+	xq := randomVectors(nq, d, 2)
+	for _, desc := range []string{"IVF16,Flat", "IVF16,PQ8x4fs"} {
+		idx := ivfIndex(t, d, nb, desc)
+		defer FreeIndex(idx)
+		want := searchAllLists(t, idx, xq, k)
+		clone, err := CloneIndexParallel(idx, 2)
+		if err != nil {
+			t.Fatal(err)
+		}
+		defer FreeIndex(clone)
+		if !equalLabels(searchAllLists(t, clone, xq, k), want) || GetIndexNtotal(clone) != nb {
+			t.Fatalf("%s: parallel clone returns other results", desc)
+		}
+		if err := AddVectors(clone, randomVectors(300, d, 7)); err != nil {
+			t.Fatal(err)
+		}
+		if !equalLabels(searchAllLists(t, idx, xq, k), want) || GetIndexNtotal(idx) != nb {
+			t.Errorf("%s: source changed with the adds to its clone", desc)
+		}
+	}
+}
+
+// TestMergeIntoParallel merges shards, the destination included, of
+// different sizes and compares the result with sequential merges, or, for
+// fast-scan lists whose IndexIVF::merge_from cannot append to a non-empty
+// list, with one index holding all the vectors under the merged ids.
+// IndexIVFPQR, which also merges its refine codes, goes through its own
+// merge_from.
+func TestMergeIntoParallel(t *testing.T) {
+	const d, nq, k = 16, 20, 20
+	sizes := []int{5, 400, 0, 700}
+	xq := randomVectors(nq, d, 2)
+	for _, desc := range []string{"IVF16,Flat", "IVF16,PQ8x4fs", "IVF16,PQ4+8"} {
+		for _, shift := range []bool{false, true} {
+			if desc == "IVF16,PQ4+8" && !shift {
+				// the refine codes are found by id, which must be positions
+				continue
+			}
+			tmpl := mustIndex(t, d, desc, MetricL2)
+			if err := TrainIndex(tmpl, randomVectors(2000, d, 1)); err != nil {
+				t.Fatal(err)
+			}
+			all, err := CloneIndex(tmpl)
+			if err != nil {
+				t.Fatal(err)
+			}
+			shards := make([]uintptr, len(sizes))
+			refs := make([]uintptr, len(sizes))
+			merged := int64(0)
+			for i, n := range sizes {
+				if shards[i], err = CloneIndex(tmpl); err != nil {
+					t.Fatal(err)
+				}
+				if n > 0 {
+					x := randomVectors(n, d, int64(10+i))
+					ids := make([]int64, n)
+					mergedIDs := make([]int64, n)
+					for j := range ids {
+						if shift {
+							ids[j] = int64(j)
+							mergedIDs[j] = merged + int64(j)
+						} else {
+							ids[j] = int64(10000*i + j)
+							mergedIDs[j] = ids[j]
+						}
+					}
+					if err := AddVectorsWithIDs(shards[i], x, ids); err != nil {
+						t.Fatal(err)
+					}
+					if err := AddVectorsWithIDs(all, x, mergedIDs); err != nil {
+						t.Fatal(err)
+					}
+				}
+				merged += int64(n)
+				if refs[i], err = CloneIndex(shards[i]); err != nil {
+					t.Fatal(err)
+				}
+			}
+			FreeIndex(tmpl)
+
+			want := searchAllLists(t, all, xq, k)
+			if desc != "IVF16,PQ8x4fs" {
+				for _, src := range refs[1:] {
+					addID := int64(0)
+					if shift {
+						addID = GetIndexNtotal(refs[0])
+					}
+					if err := IVFMergeFrom(refs[0], src, addID); err != nil {
+						t.Fatal(err)
+					}
+				}
+				want = searchAllLists(t, refs[0], xq, k)
+			}
+
+			if err := MergeIntoParallel(shards[0], shards[1:], shift, 2); err != nil {
+				t.Fatal(err)
+			}
+			if n := GetIndexNtotal(shards[0]); n != merged {
+				t.Errorf("%s shift=%v: %d vectors after the merge, want %d", desc, shift, n, merged)
+			}
+			for _, src := range shards[1:] {
+				if GetIndexNtotal(src) != 0 {
+					t.Errorf("%s shift=%v: source not emptied by the merge", desc, shift)
+				}
+			}
+			if !equalLabels(searchAllLists(t, shards[0], xq, k), want) {
+				t.Errorf("%s shift=%v: parallel merge differs from the reference", desc, shift)
+			}
+			for i := range shards {
+				FreeIndex(shards[i])
+				FreeIndex(refs[i])
+			}
+			FreeIndex(all)
+		}
+	}
+}
+
+// TestBinaryRangeSearch compares the range search of every binary index
+// type with IndexBinaryFlat. IVF with all lists probed and Hash /
+// MultiHash flipping every key bit are exact, as is the k-NN emulation
+// over an exact FromFloat index; HNSW results must be a subset. A small
+// max_k truncates the emulated searches of the queries with more results.
+func TestBinaryRangeSearch(t *testing.T) {
+	const d, nb, nq, radius, maxK = 64, 2000, 20, 23, 16
+	rng := rand.New(rand.NewSource(1))
+	xb := make([]uint8, nb*d/8)
+	rng.Read(xb)
+	xq := make([]uint8, nq*d/8)
+	rng.Read(xq)
+
+	flat, err := NewIndexBinaryFlat(d)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndexBinary(flat)
+	if err := AddBinary(flat, xb); err != nil {
+		t.Fatal(err)
+	}
+	wantLims, wantLabels, wantD, nTrunc, err := BinaryRangeSearch(flat, xq, radius, 0)
+	if err != nil || nTrunc != 0 {
+		t.Fatalf("flat range search: %d truncated (%v)", nTrunc, err)
+	}
+	// distance of every result of each query, and the queries with more
+	// than maxK results
+	want := make([]map[int64]float32, nq)
+	wantTruncated := int64(0)
+	for i := 0; i < nq; i++ {
+		want[i] = map[int64]float32{}
+		for j := wantLims[i]; j < wantLims[i+1]; j++ {
+			want[i][wantLabels[j]] = wantD[j]
+		}
+		if len(want[i]) >= maxK {
+			wantTruncated++
+		}
+	}
+	if wantTruncated == 0 || wantTruncated == nq {
+		t.Fatalf("%d of %d queries have %d results or more, pick another radius", wantTruncated, nq, maxK)
+	}
+
+	quantizer, err := NewIndexBinaryFlat(d)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndexBinary(quantizer)
+	float := mustIndex(t, d, "Flat", MetricL2)
+	cases := []struct {
+		name  string
+		exact bool
+		make  func() (uintptr, error)
+		setup func(uintptr) error
+	}{
+		{"IVF", true, func() (uintptr, error) { return NewIndexBinaryIVF(quantizer, d, 16) }, func(idx uintptr) error {
+			if err := SetBinaryIVFNprobe(idx, 16); err != nil {
+				return err
+			}
+			if nprobe, err := BinaryIVFNprobe(idx); err != nil || nprobe != 16 {
+				return fmt.Errorf("nprobe %d (%v)", nprobe, err)
+			}
+			if SetBinaryIVFNprobe(idx, 0) == nil || SetBinaryIVFMaxCodes(idx, -1) == nil {
+				return fmt.Errorf("invalid nprobe or max_codes accepted")
+			}
+			return SetBinaryIVFMaxCodes(idx, 0)
+		}},
+		{"Hash", true, func() (uintptr, error) { return NewIndexBinaryHash(d, 8) }, func(idx uintptr) error {
+			return setNflip(idx, 8)
+		}},
+		{"MultiHash", true, func() (uintptr, error) { return NewIndexBinaryMultiHash(d, 2, 8) }, func(idx uintptr) error {
+			return setNflip(idx, 8)
+		}},
+		{"FromFloat", true, func() (uintptr, error) { return NewIndexBinaryFromFloat(float, true) }, nil},
+		{"HNSW", false, func() (uintptr, error) { return NewIndexBinaryHNSW(d, 16) }, setEfSearch},
+		{"HNSWCagra", false, func() (uintptr, error) { return NewIndexBinaryHNSWCagra(d, 16) }, setEfSearch},
+	}
+	for _, tc := range cases {
+		idx, err := tc.make()
+		if err != nil {
+			t.Fatalf("%s: %v", tc.name, err)
+		}
+		defer FreeIndexBinary(idx)
+		if tc.name == "HNSW" || tc.name == "HNSWCagra" {
+			if err := SetBinaryHNSWEfConstruction(idx, 200); err != nil {
+				t.Fatal(err)
+			}
+		}
+		if err := TrainIndexBinary(idx, xb); err != nil {
+			t.Fatalf("%s: %v", tc.name, err)
+		}
+		if err := AddBinary(idx, xb); err != nil {
+			t.Fatalf("%s: %v", tc.name, err)
+		}
+		if GetIndexBinaryNtotal(idx) != nb {
+			t.Fatalf("%s: %d codes, want %d", tc.name, GetIndexBinaryNtotal(idx), nb)
+		}
+		if tc.setup != nil {
+			if err := tc.setup(idx); err != nil {
+				t.Fatalf("%s: %v", tc.name, err)
+			}
+		}
+		emulated := tc.name == "FromFloat" || !tc.exact
+
+		for _, mk := range []int{0, maxK} {
+			lims, labels, D, nTrunc, err := BinaryRangeSearch(idx, xq, radius, mk)
+			if err != nil {
+				t.Fatalf("%s max_k %d: %v", tc.name, mk, err)
+			}
+			found := 0
+			for i := 0; i < nq; i++ {
+				n := int(lims[i+1] - lims[i])
+				for j := lims[i]; j < lims[i+1]; j++ {
+					dis, ok := want[i][labels[j]]
+					if !ok || dis != D[j] {
+						t.Fatalf("%s max_k %d: query %d result (%d, %g) is not a flat result", tc.name, mk, i, labels[j], D[j])
+					}
+				}
+				found += n
+				switch {
+				case mk > 0 && emulated && len(want[i]) >= mk:
+					if tc.exact && n != mk {
+						t.Errorf("%s: truncated query %d has %d results, want %d", tc.name, i, n, mk)
+					}
+				case tc.exact && n != len(want[i]):
+					t.Errorf("%s max_k %d: query %d has %d results, want %d", tc.name, mk, i, n, len(want[i]))
+				}
+			}
+			switch {
+			case !emulated || mk == 0:
+				if nTrunc != 0 {
+					t.Errorf("%s max_k %d: %d queries truncated", tc.name, mk, nTrunc)
+				}
+			case tc.exact && nTrunc != wantTruncated:
+				t.Errorf("%s max_k %d: %d queries truncated, want %d", tc.name, mk, nTrunc, wantTruncated)
+			case !tc.exact && nTrunc == 0:
+				t.Errorf("%s max_k %d: no query truncated", tc.name, mk)
+			}
+			if !tc.exact && mk == 0 && float64(found) < 0.9*float64(len(wantLabels)) {
+				t.Errorf("%s: %d of %d results found", tc.name, found, len(wantLabels))
+			}
+		}
+
+		// the k-NN search agrees with the flat one on distances
+		gotD, _, err := SearchBinary(idx, xq, 5)
+		if err != nil {
+			t.Fatal(err)
+		}
+		wantKD, _, err := SearchBinary(flat, xq, 5)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for j := range gotD {
+			if gotD[j] < wantKD[j] || tc.exact && gotD[j] != wantKD[j] {
+				t.Fatalf("%s: k-NN distance %d is %d, want %d", tc.name, j, gotD[j], wantKD[j])
+			}
+		}
+	}
+
+	fact, err := NewIndexBinaryFactory(d, "BHNSW16")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeIndexBinary(fact)
+	if _, err := BinaryIVFNprobe(fact); err == nil {
+		t.Error("read nprobe of a binary HNSW index")
+	}
+}
+
+func setNflip(idx uintptr, nflip int) error {
+	if err := SetBinaryHashNflip(idx, nflip); err != nil {
+		return err
+	}
+	if got, err := BinaryHashNflip(idx); err != nil || got != nflip {
+		return fmt.Errorf("nflip %d (%v), want %d", got, err, nflip)
+	}
+	return nil
+}
+
+func setEfSearch(idx uintptr) error {
+	if err := SetBinaryHNSWEfSearch(idx, 256); err != nil {
+		return err
+	}
+	if ef, err := BinaryHNSWEfSearch(idx); err != nil || ef != 256 {
+		return fmt.Errorf("efSearch %d (%v)", ef, err)
+	}
+	return nil
+}
+
+// TestApproxTopK checks that the exact mode matches a plain search and
+// that the approximate modes return sorted, distinct, correctly scored
+// neighbors with a high recall, on flat and IVF indexes, with a segment
+// chosen from k and a small explicit one, and k beyond ntotal.
+func TestApproxTopK(t *testing.T) {
+	const d, nb, nq = 16, 5000, 20
+	xb := randomVectors(nb, d, 1)
+	xq := randomVectors(nq, d, 2)
+	score := func(metric int, q, y []float32) float32 {
+		if metric == MetricL2 {
+			return l2(q, y)
+		}
+		var ip float32
+		for i := range q {
+			ip += q[i] * y[i]
+		}
+		return ip
+	}
+	modes := []int{ApproxTopKB32D2, ApproxTopKB8D3, ApproxTopKB16D2, ApproxTopKB8D2}
+
+	for _, tc := range []struct {
+		desc        string
+		metric      int
+		supported   bool
+		exactScores bool // distances are exact, not from codes
+	}{
+		{"Flat", MetricL2, true, true},
+		{"Flat", MetricInnerProduct, true, true},
+		{"SQ8", MetricL2, true, false},
+		{"IVF16,Flat", MetricL2, true, true},
+		{"IVF16,SQ8", MetricL2, true, false},
+		{"HNSW16", MetricL2, false, false},
+		{"IVF16,PQ4np", MetricL2, false, false},
+	} {
+		name := fmt.Sprintf("%s/%d", tc.desc, tc.metric)
+		idx := mustIndex(t, d, tc.desc, tc.metric)
+		if err := TrainIndex(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		if err := AddVectors(idx, xb); err != nil {
+			t.Fatal(err)
+		}
+		supported, err := ApproxTopKSupported(idx)
+		if err != nil || supported != tc.supported {
+			t.Fatalf("%s: supported %v (%v), want %v", name, supported, err, tc.supported)
+		}
+
+		for _, k := range []int{10, 100} {
+			ivf, err := NewSearchParametersIVF(0, 4, 0)
+			if err != nil {
+				t.Fatal(err)
+			}
+			ref := SearchIndex
+			if strings.HasPrefix(tc.desc, "IVF") {
+				ref = func(ptr uintptr, x []float32, k int) ([]float32, []int64, error) {
+					return SearchIndexWithParams(ptr, ivf, x, k)
+				}
+			}
+			wantD, wantI, err := ref(idx, xq, k)
+			FreeSearchParameters(ivf)
+			if err != nil {
+				t.Fatal(err)
+			}
+
+			exact, err := NewSearchParametersApproxTopK(ApproxTopKExact, 4, 0)
+			if err != nil {
+				t.Fatal(err)
+			}
+			gotD, gotI, err := SearchApproxTopK(idx, exact, xq, k)
+			FreeSearchParametersApproxTopK(exact)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if !equalLabels(gotI, wantI) {
+				t.Fatalf("%s k=%d: exact mode returns other results than a plain search", name, k)
+			}
+			for j := range gotD {
+				if !closeTo(gotD[j], wantD[j]) {
+					t.Fatalf("%s k=%d: exact mode distance %d is %g, want %g", name, k, j, gotD[j], wantD[j])
+				}
+			}
+			if tc.desc == "Flat" || tc.desc == "HNSW16" {
+				if _, nilI, err := SearchApproxTopK(idx, 0, xq, k); err != nil || !equalLabels(nilI, wantI) {
+					t.Fatalf("%s k=%d: search without params differs from a plain search (%v)", name, k, err)
+				}
+			}
+
+			for _, mode := range modes {
+				for _, segment := range []int{0, 64} {
+					params, err := NewSearchParametersApproxTopK(mode, 4, segment)
+					if err != nil {
+						t.Fatal(err)
+					}
+					gotD, gotI, err = SearchApproxTopK(idx, params, xq, k)
+					FreeSearchParametersApproxTopK(params)
+					label := fmt.Sprintf("%s k=%d mode %d segment %d", name, k, mode, segment)
+					if !tc.supported {
+						if err == nil {
+							t.Fatalf("%s: approximate mode on an unsupported index", label)
+						}
+						continue
+					}
+					if err != nil {
+						t.Fatalf("%s: %v", label, err)
+					}
+					found := 0
+					for q := 0; q < nq; q++ {
+						want := make(map[int64]bool, k)
+						for _, l := range wantI[q*k : (q+1)*k] {
+							want[l] = true
+						}
+						seen := make(map[int64]bool, k)
+						for j := q * k; j < (q+1)*k; j++ {
+							l := gotI[j]
+							if l < 0 || l >= nb || seen[l] {
+								t.Fatalf("%s: query %d returns %v", label, q, gotI[q*k:(q+1)*k])
+							}
+							seen[l] = true
+							if want[l] {
+								found++
+							}
+							if j > q*k && ((tc.metric == MetricL2 && gotD[j] < gotD[j-1]) || (tc.metric == MetricInnerProduct && gotD[j] > gotD[j-1])) {
+								t.Fatalf("%s: query %d distances are not sorted", label, q)
+							}
+							if tc.exactScores && !closeTo(score(tc.metric, xq[q*d:(q+1)*d], xb[l*d:(l+1)*d]), gotD[j]) {
+								t.Fatalf("%s: query %d scores %d at %g", label, q, l, gotD[j])
+							}
+						}
+					}
+					if recall := float64(found) / float64(nq*k); recall < 0.9 {
+						t.Errorf("%s: recall %.3f", label, recall)
+					}
+				}
+			}
+		}
+		FreeIndex(idx)
+	}
+
+	// Fewer vectors than k: the missing results are -1.
+	small := mustIndex(t, d, "Flat", MetricL2)
+	defer FreeIndex(small)
+	if err := AddVectors(small, xb[:3*d]); err != nil {
+		t.Fatal(err)
+	}
+	params, err := NewSearchParametersApproxTopK(ApproxTopKB32D2, 0, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer FreeSearchParametersApproxTopK(params)
+	_, I, err := SearchApproxTopK(small, params, xq[:d], 5)
+	if err != nil {
+		t.Fatal(err)
+	}
+	sort.Slice(I[:3], func(a, b int) bool { return I[a] < I[b] })
+	if !equalLabels(I, []int64{0, 1, 2, -1, -1}) {
+		t.Fatalf("k beyond ntotal: %v", I)
+	}
+}
@@ -0,0 +1,368 @@
+/**
+ * FAISS Go Extensions - approximate top-k for float flat and IVF scans
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "approx_topk.h"
+
+#include "flat_search.h"
+#include "sq_dispatch.h"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexIVFFlatPanorama.h>
+#include <faiss/IndexScalarQuantizer.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// values whose distances are computed at once
+constexpr size_t kScanBlock = 256;
+
+/// largest automatic segment (positions are int32)
+constexpr size_t kMaxSegment = size_t(1) << 20;
+
+bool flat_float(const faiss::IndexFlat* flat) {
+    return flat && !dynamic_cast<const faiss::IndexFlatPanorama*>(flat) &&
+            (flat->metric_type == faiss::METRIC_L2 ||
+             flat->metric_type == faiss::METRIC_INNER_PRODUCT) &&
+            flat->code_size == flat->d * sizeof(float);
+}
+
+bool ivf_flat_float(const faiss::IndexIVF* ivf) {
+    return dynamic_cast<const faiss::IndexIVFFlat*>(ivf) &&
+            !dynamic_cast<const faiss::IndexIVFFlatDedup*>(ivf) &&
+            !dynamic_cast<const faiss::IndexIVFFlatPanorama*>(ivf) &&
+            (ivf->metric_type == faiss::METRIC_L2 ||
+             ivf->metric_type == faiss::METRIC_INNER_PRODUCT);
+}
+
+const faiss::IndexScalarQuantizer* as_sq(const faiss::Index* index) {
+    auto* sq = dynamic_cast<const faiss::IndexScalarQuantizer*>(index);
+    return sq && sq_dispatch_supported(sq->sq, sq->metric_type) ? sq : nullptr;
+}
+
+const faiss::IndexIVFScalarQuantizer* as_ivf_sq(const faiss::Index* index) {
+    auto* sq = dynamic_cast<const faiss::IndexIVFScalarQuantizer*>(index);
+    return sq && sq_dispatch_supported(sq->sq, sq->metric_type) ? sq : nullptr;
+}
+
+/// distances from one query to the codes of the current inverted list
+struct ListDistances {
+    virtual void set_query(const float* x) = 0;
+    virtual void set_list(idx_t list_no, float coarse_dis) = 0;
+    virtual void distances(const uint8_t* codes, size_t n, float* dis) = 0;
+    virtual ~ListDistances() {}
+};
+
+struct FlatListDistances : ListDistances {
+    const DistanceKernels& dk = kernels().distances;
+    size_t d;
+    bool ip;
+    const float* x = nullptr;
+
+    FlatListDistances(size_t d, bool ip) : d(d), ip(ip) {}
+
+    void set_query(const float* q) override {
+        x = q;
+    }
+    void set_list(idx_t, float) override {}
+    void distances(const uint8_t* codes, size_t n, float* dis) override {
+        auto* y = reinterpret_cast<const float*>(codes);
+        if (ip) {
+            dk.inner_products_ny(dis, x, y, d, n);
+        } else {
+            dk.L2sqr_ny(dis, x, y, d, n);
+        }
+    }
+};
+
+struct SQListDistances : ListDistances {
+    DispatchIVFSQScanner scanner;
+
+    explicit SQListDistances(const faiss::IndexIVFScalarQuantizer& index)
+            : scanner(index, false, nullptr) {}
+
+    void set_query(const float* q) override {
+        scanner.set_query(q);
+    }
+    void set_list(idx_t list_no, float coarse_dis) override {
+        scanner.set_list(list_no, coarse_dis);
+    }
+    void distances(const uint8_t* codes, size_t n, float* dis) override {
+        scanner.dc.distances_to_codes(codes, n, dis);
+        if (scanner.keep_max) {
+            for (size_t j = 0; j < n; j++) {
+                dis[j] += scanner.accu0;
+            }
+        }
+    }
+};
+
+template <class C>
+void search_ivf_approx(
+        const faiss::IndexIVF& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const SearchParametersApproxTopK& params,
+        float* distances,
+        idx_t* labels) {
+    const size_t nprobe = std::min(index.nlist, params.nprobe ? params.nprobe : index.nprobe);
+    FAISS_THROW_IF_NOT(nprobe > 0);
+    const size_t max_codes = params.max_codes;
+    const faiss::IDSelector* sel = params.sel;
+
+    std::vector<idx_t> assign(n * nprobe);
+    std::vector<float> coarse_dis(n * nprobe);
+    index.quantizer->search(
+            n, x, nprobe, coarse_dis.data(), assign.data(), params.quantizer_params);
+
+    // without a segment size, the segment follows each list size
+    const ApproxTopKShape shape = make_approx_topk_shape(
+            params.approx_topk_mode, !C::is_max, k, 0, params.segment_size);
+    const faiss::InvertedLists* invlists = index.invlists;
+    const size_t code_size = index.code_size;
+
+    bool failed = false;
+#pragma omp parallel
+    {
+        std::unique_ptr<ListDistances> ld;
+        if (auto* sq = dynamic_cast<const faiss::IndexIVFScalarQuantizer*>(&index)) {
+            ld.reset(new SQListDistances(*sq));
+        } else {
+            ld.reset(new FlatListDistances(index.d, !C::is_max));
+        }
+        ApproxTopKQuery<C> q(shape, k);
+        std::vector<float> dis;
+
+#pragma omp for schedule(dynamic)
+        for (idx_t i = 0; i < n; i++) {
+            try {
+                ld->set_query(x + i * index.d);
+                q.begin(distances + i * k, labels + i * k);
+                size_t nscan = 0;
+                for (size_t p = 0; p < nprobe; p++) {
+                    idx_t list_no = assign[i * nprobe + p];
+                    if (list_no < 0) {
+                        continue;
+                    }
+                    size_t list_size = invlists->list_size(list_no);
+                    if (list_size == 0) {
+                        continue;
+                    }
+                    faiss::InvertedLists::ScopedCodes codes(invlists, list_no);
+                    faiss::InvertedLists::ScopedIds ids(invlists, list_no);
+                    ld->set_list(list_no, coarse_dis[i * nprobe + p]);
+                    dis.resize(list_size);
+                    for (size_t j0 = 0; j0 < list_size; j0 += kScanBlock) {
+                        size_t nb = std::min(kScanBlock, list_size - j0);
+                        ld->distances(codes.get() + j0 * code_size, nb, dis.data() + j0);
+                    }
+                    if (sel) {
+                        for (size_t j = 0; j < list_size; j++) {
+                            if (!sel->is_member(ids[j])) {
+                                dis[j] = C::neutral();
+                            }
+                        }
+                    }
+                    size_t segment = params.segment_size
+                            ? shape.segment
+                            : approx_topk_segment(shape.nbuckets, k, list_size);
+                    q.add_list(ids.get(), list_size, dis.data(), segment);
+                    nscan += list_size;
+                    if (max_codes && nscan >= max_codes) {
+                        break;
+                    }
+                }
+                q.end();
+            } catch (...) {
+#pragma omp critical
+                failed = true;
+            }
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!failed, "approximate top-k IVF search failed");
+}
+
+void search_sq_approx(
+        const faiss::IndexScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const SearchParametersApproxTopK& params,
+        float* distances,
+        idx_t* labels) {
+    const bool ip = index.metric_type == faiss::METRIC_INNER_PRODUCT;
+    const ApproxTopKShape shape = make_approx_topk_shape(
+            params.approx_topk_mode, ip, k, index.ntotal, params.segment_size);
+    const faiss::IDSelector* sel = params.sel;
+    const size_t ny = index.ntotal;
+
+#pragma omp parallel if (n > 1)
+    {
+        DispatchSQDistanceComputer dc(index.sq, index.metric_type);
+        ApproxTopKQuery<faiss::CMax<float, idx_t>> qmax(shape, k);
+        ApproxTopKQuery<faiss::CMin<float, idx_t>> qmin(shape, k);
+        float dis[kScanBlock];
+
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            dc.set_query(x + i * index.d);
+            if (ip) {
+                qmin.begin(distances + i * k, labels + i * k);
+            } else {
+                qmax.begin(distances + i * k, labels + i * k);
+            }
+            for (size_t j0 = 0; j0 < ny; j0 += kScanBlock) {
+                size_t nb = std::min(kScanBlock, ny - j0);
+                dc.distances_to_codes(index.codes.data() + j0 * index.code_size, nb, dis);
+                if (sel) {
+                    for (size_t j = 0; j < nb; j++) {
+                        if (!sel->is_member(j0 + j)) {
+                            dis[j] = ip ? faiss::CMin<float, idx_t>::neutral()
+                                    : faiss::CMax<float, idx_t>::neutral();
+                        }
+                    }
+                }
+                if (ip) {
+                    qmin.add_range(j0, nb, dis);
+                } else {
+                    qmax.add_range(j0, nb, dis);
+                }
+            }
+            if (ip) {
+                qmin.end();
+            } else {
+                qmax.end();
+            }
+        }
+    }
+}
+
+} // namespace
+
+size_t approx_topk_segment(size_t nbuckets, idx_t k, size_t n_scanned) {
+    FAISS_THROW_IF_NOT(nbuckets > 0 && k > 0);
+    size_t seg = n_scanned * nbuckets / (4 * (size_t)k);
+    seg = seg / nbuckets * nbuckets;
+    return std::min(std::max(seg, nbuckets), kMaxSegment);
+}
+
+ApproxTopKShape make_approx_topk_shape(
+        ApproxTopK_mode_t mode,
+        bool keep_max,
+        idx_t k,
+        size_t n_scanned,
+        size_t segment_size) {
+    ApproxTopKShape shape;
+    switch (mode) {
+        case ApproxTopK_mode_t::APPROX_TOPK_BUCKETS_B32_D2:
+            shape.nbuckets = 32;
+            shape.depth = 2;
+            break;
+        case ApproxTopK_mode_t::APPROX_TOPK_BUCKETS_B8_D3:
+            shape.nbuckets = 8;
+            shape.depth = 3;
+            break;
+        case ApproxTopK_mode_t::APPROX_TOPK_BUCKETS_B16_D2:
+            shape.nbuckets = 16;
+            shape.depth = 2;
+            break;
+        case ApproxTopK_mode_t::APPROX_TOPK_BUCKETS_B8_D2:
+            shape.nbuckets = 8;
+            shape.depth = 2;
+            break;
+        default:
+            FAISS_THROW_FMT("not an approximate top-k mode: %d", (int)mode);
+    }
+    const TopKKernels& tk = kernels().topk;
+    shape.fn = keep_max ? tk.max[mode] : tk.min[mode];
+    FAISS_THROW_IF_NOT(k > 0);
+    if (segment_size > 0) {
+        FAISS_THROW_IF_NOT(segment_size <= (size_t)INT32_MAX);
+        shape.segment = segment_size;
+    } else {
+        shape.segment = approx_topk_segment(shape.nbuckets, k, n_scanned);
+    }
+    return shape;
+}
+
+bool approx_topk_supported(const faiss::Index* index) {
+    if (flat_float(dynamic_cast<const faiss::IndexFlat*>(index)) || as_sq(index) ||
+        as_ivf_sq(index)) {
+        return true;
+    }
+    auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index);
+    return ivf && ivf_flat_float(ivf);
+}
+
+void search_approx_topk(
+        const faiss::Index* index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const faiss::SearchParameters* params,
+        float* distances,
+        idx_t* labels) {
+    FAISS_THROW_IF_NOT(index);
+    FAISS_THROW_IF_NOT(k > 0);
+    auto* ap = dynamic_cast<const SearchParametersApproxTopK*>(params);
+    auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index);
+    if (!ap) {
+        index->search(n, x, k, distances, labels, params);
+        return;
+    }
+    if (ap->approx_topk_mode == ApproxTopK_mode_t::EXACT_TOPK) {
+        // the plain search reads nprobe from SearchParametersIVF as is
+        if (ivf) {
+            faiss::SearchParametersIVF sp;
+            sp.sel = ap->sel;
+            sp.nprobe = ap->nprobe ? ap->nprobe : ivf->nprobe;
+            sp.max_codes = ap->max_codes;
+            sp.quantizer_params = ap->quantizer_params;
+            sp.inverted_list_context = ap->inverted_list_context;
+            index->search(n, x, k, distances, labels, &sp);
+        } else {
+            faiss::SearchParameters sp;
+            sp.sel = ap->sel;
+            index->search(n, x, k, distances, labels, &sp);
+        }
+        return;
+    }
+    FAISS_THROW_IF_NOT_MSG(
+            approx_topk_supported(index), "approximate top-k is not supported for this index");
+    if (n == 0) {
+        return;
+    }
+
+    if (auto* flat = dynamic_cast<const faiss::IndexFlat*>(index)) {
+        const float* norms = nullptr;
+        auto* l2 = dynamic_cast<const faiss::IndexFlatL2*>(flat);
+        if (l2 && l2->cached_l2norms.size() == (size_t)flat->ntotal) {
+            norms = l2->cached_l2norms.data();
+        }
+        knn_exhaustive_approx(
+                x, n, flat->get_xb(), flat->ntotal, flat->d, flat->metric_type, norms, k,
+                ap->approx_topk_mode, ap->segment_size, BlasParams(), ap->sel, distances,
+                labels);
+    } else if (auto* sq = as_sq(index)) {
+        search_sq_approx(*sq, n, x, k, *ap, distances, labels);
+    } else if (ivf->metric_type == faiss::METRIC_INNER_PRODUCT) {
+        search_ivf_approx<faiss::CMin<float, idx_t>>(*ivf, n, x, k, *ap, distances, labels);
+    } else {
+        search_ivf_approx<faiss::CMax<float, idx_t>>(*ivf, n, x, k, *ap, distances, labels);
+    }
+}
+
+} // namespace faiss_go_ext
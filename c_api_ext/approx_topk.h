@@ -0,0 +1,222 @@
+/**
+ * FAISS Go Extensions - approximate top-k for float flat and IVF scans
+ *
+ * faiss/utils/approx_topk replaces the per-value heap updates of a scan
+ * by a bucket pass: value j goes to bucket j % nbuckets, each bucket keeps
+ * its depth best values, and only the nbuckets * depth survivors are
+ * pushed to the heap. FAISS only uses it for IndexBinaryFlat and the
+ * residual quantizer beam search. Here the same modes (ApproxTopK_mode_t)
+ * drive the result handlers of the flat searches of flat_search.h and an
+ * IVF scan, selected per call with SearchParametersApproxTopK.
+ *
+ * A value is lost when more than depth better values of its bucket fall
+ * in the same segment (the values scanned between two heap merges). Unless
+ * set explicitly, the segment is chosen so that a bucket expects a quarter
+ * of a top-k value per segment: from the database size for flat scans
+ * (the top-k are assumed spread over the database), from the list size
+ * for IVF scans, where the top-k often all come from the nearest list. On
+ * IVF scans the buckets therefore only shrink the heap traffic when the
+ * lists are much longer than k.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_APPROX_TOPK_H
+#define FAISS_GO_EXT_APPROX_TOPK_H
+
+#include "simd_dispatch.h"
+
+#include <faiss/IndexIVF.h>
+#include <faiss/impl/ResultHandler.h>
+#include <faiss/utils/Heap.h>
+#include <faiss/utils/approx_topk/mode.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Search parameters selecting the top-k mode of one call. The IVF fields
+/// apply to IVF indexes (nprobe 0 uses index->nprobe), flat indexes only
+/// use the selector.
+struct SearchParametersApproxTopK : faiss::SearchParametersIVF {
+    ApproxTopK_mode_t approx_topk_mode = ApproxTopK_mode_t::EXACT_TOPK;
+    /// values per bucket pass, 0 to choose it from k
+    size_t segment_size = 0;
+
+    SearchParametersApproxTopK() {
+        nprobe = 0;
+    }
+};
+
+/// Bucket pass of one search.
+struct ApproxTopKShape {
+    bucket_topk_fn fn = nullptr;
+    size_t nbuckets = 0;
+    size_t depth = 0;
+    size_t segment = 0; ///< values between two heap merges
+
+    size_t ncand() const {
+        return nbuckets * depth;
+    }
+};
+
+/// Automatic segment for n_scanned values: a multiple of nbuckets such
+/// that each bucket expects a quarter of a top-k value.
+size_t approx_topk_segment(size_t nbuckets, idx_t k, size_t n_scanned);
+
+/// Shape for mode, keeping the largest values if keep_max, when about
+/// n_scanned values are scanned per query. segment_size 0 picks the
+/// segment from k.
+ApproxTopKShape make_approx_topk_shape(
+        ApproxTopK_mode_t mode,
+        bool keep_max,
+        idx_t k,
+        size_t n_scanned,
+        size_t segment_size);
+
+/// Result heap of one query fed through the buckets. C is the heap
+/// comparator, as for faiss::HeapBlockResultHandler.
+template <class C>
+struct ApproxTopKQuery {
+    const ApproxTopKShape* shape;
+    size_t k;
+    float* heap_dis = nullptr;
+    idx_t* heap_ids = nullptr;
+    std::vector<float> bucket_dis;
+    std::vector<int32_t> bucket_pos;
+    idx_t seg0 = 0;  ///< label of the first value of the segment
+    size_t nseg = 0; ///< values in the segment
+
+    ApproxTopKQuery(const ApproxTopKShape& shape, size_t k)
+            : shape(&shape), k(k), bucket_dis(shape.ncand()), bucket_pos(shape.ncand()) {}
+
+    void begin(float* dis, idx_t* ids) {
+        heap_dis = dis;
+        heap_ids = ids;
+        faiss::heap_heapify<C>(k, heap_dis, heap_ids);
+        reset();
+    }
+
+    void reset() {
+        std::fill(bucket_dis.begin(), bucket_dis.end(), C::neutral());
+        std::fill(bucket_pos.begin(), bucket_pos.end(), -1);
+        nseg = 0;
+    }
+
+    /// merge the buckets into the heap, position p is label ids[p] (or
+    /// seg0 + p without ids)
+    void flush(const idx_t* ids) {
+        for (size_t c = 0; c < bucket_dis.size(); c++) {
+            int32_t p = bucket_pos[c];
+            if (p >= 0 && C::cmp(heap_dis[0], bucket_dis[c])) {
+                faiss::heap_replace_top<C>(
+                        k, heap_dis, heap_ids, bucket_dis[c], ids ? ids[p] : seg0 + p);
+            }
+        }
+        reset();
+    }
+
+    /// values of the consecutive labels j0 .. j0 + n - 1, the calls of one
+    /// query must come in increasing label order
+    void add_range(idx_t j0, size_t n, const float* dis) {
+        while (n > 0) {
+            if (nseg == 0) {
+                seg0 = j0;
+            }
+            size_t m = std::min(n, shape->segment - nseg);
+            shape->fn(dis, m, (int32_t)nseg, bucket_dis.data(), bucket_pos.data());
+            nseg += m;
+            if (nseg == shape->segment) {
+                flush(nullptr);
+            }
+            j0 += m;
+            dis += m;
+            n -= m;
+        }
+    }
+
+    /// values of n entries with labels ids (an inverted list), merged
+    /// every segment values
+    void add_list(const idx_t* ids, size_t n, const float* dis, size_t segment) {
+        for (size_t o = 0; o < n; o += segment) {
+            size_t m = std::min(segment, n - o);
+            shape->fn(dis + o, m, 0, bucket_dis.data(), bucket_pos.data());
+            flush(ids + o);
+        }
+    }
+
+    void end() {
+        if (nseg > 0) {
+            flush(nullptr);
+        }
+        faiss::heap_reorder<C>(k, heap_dis, heap_ids);
+    }
+};
+
+/// Block result handler for the BLAS tiles of flat_search.cpp: the
+/// approximate counterpart of faiss::HeapBlockResultHandler.
+template <class C, bool use_sel>
+struct ApproxTopKBlockResultHandler : faiss::TopkBlockResultHandler<C, use_sel> {
+    const ApproxTopKShape& shape;
+    std::vector<ApproxTopKQuery<C>> queries; ///< queries i0 .. i1
+
+    ApproxTopKBlockResultHandler(
+            size_t nq,
+            float* dis_tab,
+            idx_t* ids_tab,
+            size_t k,
+            const ApproxTopKShape& shape,
+            const faiss::IDSelector* sel = nullptr)
+            : faiss::TopkBlockResultHandler<C, use_sel>(nq, dis_tab, ids_tab, k, sel),
+              shape(shape) {}
+
+    void begin_multiple(size_t i0, size_t i1) final {
+        this->i0 = i0;
+        this->i1 = i1;
+        queries.clear();
+        queries.reserve(i1 - i0);
+        for (size_t i = i0; i < i1; i++) {
+            queries.emplace_back(shape, this->k);
+            queries.back().begin(this->dis_tab + i * this->k, this->ids_tab + i * this->k);
+        }
+    }
+
+    void add_results(size_t j0, size_t j1, const float* dis_tab) final {
+#pragma omp parallel for
+        for (int64_t i = 0; i < (int64_t)queries.size(); i++) {
+            queries[i].add_range(j0, j1 - j0, dis_tab + (j1 - j0) * i);
+        }
+    }
+
+    void end_multiple() final {
+        for (auto& q : queries) {
+            q.end();
+        }
+    }
+};
+
+/// True if search_approx_topk can run index with an approximate mode:
+/// IndexFlat (L2 / IP), IndexScalarQuantizer, IndexIVFFlat and
+/// IndexIVFScalarQuantizer.
+bool approx_topk_supported(const faiss::Index* index);
+
+/// k-NN search whose top-k mode comes from params. Without a
+/// SearchParametersApproxTopK, or with EXACT_TOPK, this is index->search
+/// (with the IVF fields of params resolved); approximate modes throw for
+/// indexes that approx_topk_supported rejects.
+void search_approx_topk(
+        const faiss::Index* index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const faiss::SearchParameters* params,
+        float* distances,
+        idx_t* labels);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_APPROX_TOPK_H */
@@ -0,0 +1,116 @@
+/**
+ * FAISS Go Extensions - Hamming range search on any binary index
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "binary_range_search.h"
+
+#include <faiss/IndexBinaryFlat.h>
+#include <faiss/IndexBinaryHash.h>
+#include <faiss/IndexBinaryIVF.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// result entries kept per k-NN batch
+constexpr idx_t kBatchEntries = idx_t(1) << 22;
+
+} // namespace
+
+bool has_binary_range_search(const faiss::IndexBinary* index) {
+    if (auto* idmap = dynamic_cast<const faiss::IndexBinaryIDMap*>(index)) {
+        return has_binary_range_search(idmap->index);
+    }
+    return dynamic_cast<const faiss::IndexBinaryFlat*>(index) ||
+            dynamic_cast<const faiss::IndexBinaryIVF*>(index) ||
+            dynamic_cast<const faiss::IndexBinaryHash*>(index) ||
+            dynamic_cast<const faiss::IndexBinaryMultiHash*>(index);
+}
+
+size_t binary_range_search(
+        const faiss::IndexBinary* index,
+        idx_t n,
+        const uint8_t* x,
+        int radius,
+        faiss::RangeSearchResult* result,
+        idx_t min_k,
+        idx_t max_k) {
+    FAISS_THROW_IF_NOT(index && result);
+    FAISS_THROW_IF_NOT(n >= 0 && (n == 0 || x));
+    FAISS_THROW_IF_NOT_MSG(result->nq == (size_t)n && result->lims, "result must have n queries");
+    FAISS_THROW_IF_NOT(min_k > 0 && max_k >= min_k);
+    if (has_binary_range_search(index)) {
+        index->range_search(n, x, radius, result);
+        return 0;
+    }
+
+    const size_t code_size = index->code_size;
+    std::vector<std::vector<idx_t>> labels(n);
+    std::vector<std::vector<int32_t>> distances(n);
+
+    // queries whose k-th result is still within radius are searched again
+    // with twice the k
+    std::vector<idx_t> pending(index->ntotal > 0 ? n : 0);
+    std::iota(pending.begin(), pending.end(), 0);
+    idx_t k = std::min(min_k, index->ntotal);
+    std::vector<uint8_t> xq;
+    std::vector<int32_t> D;
+    std::vector<idx_t> I;
+    size_t n_truncated = 0;
+    while (!pending.empty()) {
+        std::vector<idx_t> next;
+        const idx_t bs = std::max<idx_t>(1, kBatchEntries / k);
+        for (size_t b0 = 0; b0 < pending.size(); b0 += bs) {
+            idx_t nb = std::min<idx_t>(bs, pending.size() - b0);
+            xq.resize(nb * code_size);
+            for (idx_t j = 0; j < nb; j++) {
+                memcpy(xq.data() + j * code_size, x + pending[b0 + j] * code_size, code_size);
+            }
+            D.resize(nb * k);
+            I.resize(nb * k);
+            index->search(nb, xq.data(), k, D.data(), I.data());
+
+            for (idx_t j = 0; j < nb; j++) {
+                idx_t q = pending[b0 + j];
+                const int32_t* Dj = D.data() + j * k;
+                const idx_t* Ij = I.data() + j * k;
+                if (k < index->ntotal && Ij[k - 1] >= 0 && Dj[k - 1] < radius) {
+                    if (k < max_k) {
+                        next.push_back(q);
+                        continue;
+                    }
+                    n_truncated++;
+                }
+                for (idx_t t = 0; t < k && Ij[t] >= 0 && Dj[t] < radius; t++) {
+                    labels[q].push_back(Ij[t]);
+                    distances[q].push_back(Dj[t]);
+                }
+            }
+        }
+        pending.swap(next);
+        k = std::min(std::min(2 * k, max_k), index->ntotal);
+    }
+
+    for (idx_t q = 0; q < n; q++) {
+        result->lims[q] = labels[q].size();
+    }
+    result->do_allocation();
+    for (idx_t q = 0; q < n; q++) {
+        size_t o = result->lims[q];
+        std::copy(labels[q].begin(), labels[q].end(), result->labels + o);
+        std::copy(distances[q].begin(), distances[q].end(), result->distances + o);
+    }
+    return n_truncated;
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,45 @@
+/**
+ * FAISS Go Extensions - Hamming range search on any binary index
+ *
+ * IndexBinaryFlat, IndexBinaryIVF, IndexBinaryHash and IndexBinaryMultiHash
+ * implement range_search, IndexBinaryHNSW and IndexBinaryFromFloat throw.
+ * binary_range_search forwards to the native implementation when there
+ * is one and otherwise runs k-NN searches whose k doubles until the k-th
+ * result is at distance >= radius, so the graph indexes can answer the
+ * same near-duplicate queries (with the recall of their k-NN search).
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_BINARY_RANGE_SEARCH_H
+#define FAISS_GO_EXT_BINARY_RANGE_SEARCH_H
+
+#include <faiss/IndexBinary.h>
+#include <faiss/impl/AuxIndexStructures.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// whether index->range_search is implemented (through IndexBinaryIDMap
+/// wrappers too)
+bool has_binary_range_search(const faiss::IndexBinary* index);
+
+/// Results at Hamming distance < radius, as IndexBinary::range_search.
+/// Without a native range search, k starts at min_k and stops doubling at
+/// max_k: queries with max_k results within radius get the max_k nearest.
+/// Returns the number of such truncated queries (0 with a native range
+/// search).
+size_t binary_range_search(
+        const faiss::IndexBinary* index,
+        idx_t n,
+        const uint8_t* x,
+        int radius,
+        faiss::RangeSearchResult* result,
+        idx_t min_k,
+        idx_t max_k);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_BINARY_RANGE_SEARCH_H */
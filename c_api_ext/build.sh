@@ -2,11 +2,11 @@
 #
 # Build FAISS Go Extensions
 #
-# This script builds the custom C API extensions and merges them
-# into the existing libfaiss_c.a static library.
+# This script builds the custom C API extensions into libfaiss_go_ext.a.
 #
 # Usage: ./build.sh [--install]
-#   --install: Also merge the extensions into libfaiss_c.a
+#   --install: Also copy the archive to lib/<platform>/ and the header
+#              to include/
 
 set -e
 
@@ -67,48 +67,69 @@ if [ "$OS" = "darwin" ]; then
     elif [ -d "/usr/local/opt/libomp/include" ]; then
         OMP_INCLUDE="-I/usr/local/opt/libomp/include"
     fi
-    CXXFLAGS="-std=c++17 -O3 -fPIC -stdlib=libc++ -I$FAISS_HEADERS_DIR -I$LIBS_DIR/include $OMP_INCLUDE"
+    CXXFLAGS="-std=c++17 -O3 -fPIC -stdlib=libc++ -Xpreprocessor -fopenmp -I$FAISS_HEADERS_DIR -I$LIBS_DIR/include $OMP_INCLUDE"
 else
     CXX="${CXX:-g++}"
-    CXXFLAGS="-std=c++17 -O3 -fPIC -I$FAISS_HEADERS_DIR -I$LIBS_DIR/include"
+    CXXFLAGS="-std=c++17 -O3 -fPIC -fopenmp -I$FAISS_HEADERS_DIR -I$LIBS_DIR/include"
 fi
 
+SOURCES="faiss_go_ext.cpp simd_dispatch.cpp sq_dispatch.cpp pq_dispatch.cpp fast_scan_tuning.cpp rabitq_search.cpp panorama_convert.cpp flat_search.cpp shards_search.cpp numa_topology.cpp numa_placement.cpp replica_router.cpp idmap_sorted.cpp search_params.cpp ivf_id_table.cpp ivf_tombstones.cpp range_arena.cpp search_context.cpp hnsw_wide.cpp visited_set.cpp graph_search.cpp parallel_explore.cpp search_controller.cpp compiled_factory.cpp snapshot_index.cpp segmented_index.cpp parallel_clone.cpp binary_range_search.cpp approx_topk.cpp"
+
+# Kernel sources are compiled once per SIMD level (see simd_dispatch.h).
+# NEON is baseline on arm64, so only the generic build is needed there.
+KERNEL_SOURCES="sq_kernels.cpp distance_kernels.cpp hamming_kernels.cpp pq_kernels.cpp topk_kernels.cpp"
+if [ "$ARCH" = "amd64" ]; then
+    SIMD_LEVELS="generic avx2 avx512"
+else
+    SIMD_LEVELS="generic"
+fi
+
+simd_flags() {
+    case "$1" in
+        avx2) echo "-mavx2 -mfma -mf16c -mpopcnt" ;;
+        avx512) echo "-mavx2 -mfma -mf16c -mpopcnt -mavx512f -mavx512cd -mavx512vl -mavx512dq -mavx512bw" ;;
+        *) echo "" ;;
+    esac
+}
+
 # Compile
-echo "Compiling faiss_go_ext.cpp..."
-$CXX $CXXFLAGS -c faiss_go_ext.cpp -o faiss_go_ext.o
+OBJECTS=""
+for src in $SOURCES; do
+    echo "Compiling $src..."
+    $CXX $CXXFLAGS -c "$src" -o "${src%.cpp}.o"
+    OBJECTS="$OBJECTS ${src%.cpp}.o"
+done
+
+for src in $KERNEL_SOURCES; do
+    for level in $SIMD_LEVELS; do
+        echo "Compiling $src ($level)..."
+        $CXX $CXXFLAGS $(simd_flags "$level") -DFAISS_GO_EXT_SIMD_NS=simd_$level \
+            -c "$src" -o "${src%.cpp}_$level.o"
+        OBJECTS="$OBJECTS ${src%.cpp}_$level.o"
+    done
+done
 
 # Create static library
 echo "Creating libfaiss_go_ext.a..."
-ar rcs libfaiss_go_ext.a faiss_go_ext.o
+rm -f libfaiss_go_ext.a
+ar rcs libfaiss_go_ext.a $OBJECTS
 ranlib libfaiss_go_ext.a
 
 echo "Built libfaiss_go_ext.a successfully"
 
-# Install if requested
+# Install if requested: the archive goes next to libfaiss_c.a (the cgo
+# directives link both) and the header to include/
 if [ "$1" = "--install" ]; then
     echo ""
-    echo "Merging into $LIBS_DIR/libfaiss_c.a..."
-
-    # Create temp directory for merging
-    MERGE_DIR=$(mktemp -d)
-    trap "rm -rf $MERGE_DIR" EXIT
-
-    # Extract both libraries
-    cd "$MERGE_DIR"
-    ar x "$LIBS_DIR/libfaiss_c.a"
-    ar x "$SCRIPT_DIR/libfaiss_go_ext.a"
-
-    # Create merged library
-    ar rcs "$LIBS_DIR/libfaiss_c.a" *.o
-    ranlib "$LIBS_DIR/libfaiss_c.a"
-
-    # Copy header
-    cp "$SCRIPT_DIR/faiss_go_ext.h" "$LIBS_DIR/include/"
+    echo "Installing into $LIBS_DIR..."
+    mkdir -p "$LIBS_DIR"
+    cp "$SCRIPT_DIR/libfaiss_go_ext.a" "$LIBS_DIR/libfaiss_go_ext.a"
+    cp "$SCRIPT_DIR/faiss_go_ext.h" "$PROJECT_ROOT/include/"
 
-    echo "Merged successfully!"
+    echo "Installed successfully!"
     echo ""
     echo "Verifying new symbols..."
-    nm "$LIBS_DIR/libfaiss_c.a" 2>/dev/null | grep -E "T _faiss_RangeSearchResult_distances|T _faiss_IndexBinaryFlat_new|T _faiss_serialize_index" | head -5 || echo "Warning: New symbols not found"
+    nm "$LIBS_DIR/libfaiss_go_ext.a" 2>/dev/null | grep -E "T _?(faiss_RangeSearchResult_distances|faiss_IndexBinaryFlat_new|faiss_get_simd_level)$" | head -5 || echo "Warning: New symbols not found"
 fi
 
 echo ""
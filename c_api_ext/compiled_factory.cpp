@@ -0,0 +1,308 @@
+/**
+ * FAISS Go Extensions - compiled index_factory descriptions and index
+ * reflection
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "compiled_factory.h"
+#include "hnsw_wide.h"
+#include "idmap_sorted.h"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/IndexIVFPQFastScan.h>
+#include <faiss/IndexIVFPQR.h>
+#include <faiss/IndexIVFRaBitQ.h>
+#include <faiss/IndexLSH.h>
+#include <faiss/IndexNNDescent.h>
+#include <faiss/IndexNSG.h>
+#include <faiss/IndexPQ.h>
+#include <faiss/IndexPQFastScan.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRaBitQ.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/IndexReplicas.h>
+#include <faiss/IndexScalarQuantizer.h>
+#include <faiss/IndexShards.h>
+#include <faiss/VectorTransform.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <typeinfo>
+
+namespace faiss_go_ext {
+
+namespace {
+
+const std::map<faiss::ScalarQuantizer::QuantizerType, std::string> sq_types = {
+        {faiss::ScalarQuantizer::QT_8bit, "SQ8"},
+        {faiss::ScalarQuantizer::QT_4bit, "SQ4"},
+        {faiss::ScalarQuantizer::QT_6bit, "SQ6"},
+        {faiss::ScalarQuantizer::QT_fp16, "SQfp16"},
+        {faiss::ScalarQuantizer::QT_bf16, "SQbf16"},
+        {faiss::ScalarQuantizer::QT_8bit_direct_signed, "SQ8_direct_signed"},
+        {faiss::ScalarQuantizer::QT_8bit_direct, "SQ8_direct"},
+};
+
+std::string sq_name(faiss::ScalarQuantizer::QuantizerType qtype) {
+    auto it = sq_types.find(qtype);
+    return it == sq_types.end() ? "" : it->second;
+}
+
+int hnsw_M(const faiss::HNSW& hnsw) {
+    // level 0 has 2 * M links
+    return hnsw.cum_nneighbor_per_level.size() > 1 ? hnsw.cum_nneighbor_per_level[1] / 2 : 0;
+}
+
+std::string pq_name(const faiss::ProductQuantizer& pq) {
+    return "PQ" + std::to_string(pq.M) + "x" + std::to_string(pq.nbits);
+}
+
+/// class name of the dynamic type, without namespaces
+template <class T>
+std::string type_name(const T* obj) {
+    const char* mangled = typeid(*obj).name();
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+    std::string name = status == 0 && demangled ? demangled : mangled;
+    free(demangled);
+    for (const char* ns : {"faiss_go_ext::", "faiss::"}) {
+        for (size_t pos; (pos = name.find(ns)) != std::string::npos;) {
+            name.erase(pos, strlen(ns));
+        }
+    }
+    // IndexIDMap and IndexIDMap2 are template instances
+    for (const char* tmpl : {"IndexIDMapTemplate<Index>", "IndexIDMap2Template<Index>"}) {
+        if (name == tmpl) {
+            name = name.substr(0, name.find("Template"));
+        }
+    }
+    return name;
+}
+
+std::string reverse_transform(const faiss::VectorTransform* vt) {
+    const std::string d_out = std::to_string(vt->d_out);
+    if (auto* opq = dynamic_cast<const faiss::OPQMatrix*>(vt)) {
+        return "OPQ" + std::to_string(opq->M) + "_" + d_out;
+    } else if (dynamic_cast<const faiss::ITQTransform*>(vt)) {
+        return "ITQ" + d_out;
+    } else if (auto* pca = dynamic_cast<const faiss::PCAMatrix*>(vt)) {
+        if (pca->eigen_power != 0 && pca->eigen_power != -0.5) {
+            return "";
+        }
+        return std::string("PCA") + (pca->eigen_power == -0.5 ? "W" : "") + (pca->random_rotation ? "R" : "") +
+                d_out;
+    } else if (dynamic_cast<const faiss::RandomRotationMatrix*>(vt)) {
+        return "RR" + d_out;
+    } else if (auto* norm = dynamic_cast<const faiss::NormalizationTransform*>(vt)) {
+        return norm->norm == 2.0 ? "L2norm" : "";
+    }
+    return "";
+}
+
+/// "" stays "" through concatenation
+std::string join(const std::string& a, const std::string& b) {
+    return a.empty() || b.empty() ? "" : a + "," + b;
+}
+
+void describe(const faiss::Index* index, int parent, const char* role, bool owned, std::vector<IndexNode>& nodes) {
+    IndexNode node;
+    node.parent = parent;
+    node.role = role;
+    node.type = type_name(index);
+    node.d = index->d;
+    node.ntotal = index->ntotal;
+    node.metric = index->metric_type;
+    node.is_trained = index->is_trained;
+    node.owned = owned;
+    if (auto* codes = dynamic_cast<const faiss::IndexFlatCodes*>(index)) {
+        node.code_size = codes->code_size;
+    }
+    const int self = (int)nodes.size();
+    nodes.push_back(node);
+    // recursive calls invalidate n, its fields are set before them
+    IndexNode& n = nodes.back();
+
+    if (auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        n.code_size = ivf->code_size;
+        n.nlist = ivf->nlist;
+        if (auto* sq = dynamic_cast<const faiss::IndexIVFScalarQuantizer*>(ivf)) {
+            n.qtype = sq_name(sq->sq.qtype);
+        } else if (auto* pq = dynamic_cast<const faiss::IndexIVFPQ*>(ivf)) {
+            n.M = pq->pq.M;
+            n.nbits = pq->pq.nbits;
+        } else if (auto* pqfs = dynamic_cast<const faiss::IndexIVFPQFastScan*>(ivf)) {
+            n.M = pqfs->pq.M;
+            n.nbits = pqfs->pq.nbits;
+        } else if (auto* rq = dynamic_cast<const faiss::IndexIVFRaBitQ*>(ivf)) {
+            n.nbits = rq->rabitq.nb_bits;
+        }
+        describe(ivf->quantizer, self, "quantizer", ivf->own_fields, nodes);
+    } else if (auto* sq = dynamic_cast<const faiss::IndexScalarQuantizer*>(index)) {
+        n.qtype = sq_name(sq->sq.qtype);
+    } else if (auto* pq = dynamic_cast<const faiss::IndexPQ*>(index)) {
+        n.M = pq->pq.M;
+        n.nbits = pq->pq.nbits;
+    } else if (auto* pqfs = dynamic_cast<const faiss::IndexPQFastScan*>(index)) {
+        n.code_size = pqfs->code_size;
+        n.M = pqfs->pq.M;
+        n.nbits = pqfs->pq.nbits;
+    } else if (auto* lsh = dynamic_cast<const faiss::IndexLSH*>(index)) {
+        n.nbits = lsh->nbits;
+    } else if (auto* rq = dynamic_cast<const faiss::IndexRaBitQ*>(index)) {
+        n.nbits = rq->rabitq.nb_bits;
+    } else if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+        n.M = hnsw_M(hnsw->hnsw);
+        describe(hnsw->storage, self, "storage", hnsw->own_fields, nodes);
+    } else if (auto* wide = dynamic_cast<const IndexHNSWWide*>(index)) {
+        n.M = wide->M;
+        describe(wide->storage, self, "storage", wide->own_fields, nodes);
+    } else if (auto* nsg = dynamic_cast<const faiss::IndexNSG*>(index)) {
+        n.M = nsg->nsg.R;
+        describe(nsg->storage, self, "storage", nsg->own_fields, nodes);
+    } else if (auto* nnd = dynamic_cast<const faiss::IndexNNDescent*>(index)) {
+        n.M = nnd->nndescent.K;
+        describe(nnd->storage, self, "storage", nnd->own_fields, nodes);
+    } else if (auto* refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+        describe(refine->base_index, self, "base", refine->own_fields, nodes);
+        describe(refine->refine_index, self, "refine", refine->own_refine_index, nodes);
+    } else if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+        for (const faiss::VectorTransform* vt : pt->chain) {
+            IndexNode tn;
+            tn.parent = self;
+            tn.role = "transform";
+            tn.type = type_name(vt);
+            tn.d = vt->d_out;
+            tn.is_trained = vt->is_trained;
+            tn.owned = pt->own_fields;
+            nodes.push_back(tn);
+        }
+        describe(pt->index, self, "index", pt->own_fields, nodes);
+    } else if (auto* idmap = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        describe(idmap->index, self, "index", idmap->own_fields, nodes);
+    } else if (auto* idmap3 = dynamic_cast<const IndexIDMap3*>(index)) {
+        describe(idmap3->index, self, "index", idmap3->own_fields, nodes);
+    } else if (auto* threaded = dynamic_cast<const faiss::ThreadedIndex<faiss::Index>*>(index)) {
+        const char* sub_role = dynamic_cast<const faiss::IndexShards*>(index) ? "shard" : "replica";
+        for (int i = 0; i < threaded->count(); i++) {
+            describe(threaded->at(i), self, sub_role, threaded->own_indices, nodes);
+        }
+    }
+}
+
+} // namespace
+
+CompiledFactory::CompiledFactory(int d, const char* description, faiss::MetricType metric)
+        : description(description ? description : "") {
+    prototype.reset(index_factory_ext(d, description, metric));
+}
+
+CompiledFactory::CompiledFactory(const faiss::Index* index) {
+    FAISS_THROW_IF_NOT(index);
+    prototype.reset(clone_index_ext(index));
+    prototype->reset();
+}
+
+faiss::Index* CompiledFactory::instantiate() const {
+    return clone_index_ext(prototype.get());
+}
+
+std::string reverse_index_factory_ext(const faiss::Index* index) {
+    if (dynamic_cast<const faiss::IndexFlat*>(index)) {
+        return "Flat";
+    } else if (auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        const faiss::Index* quantizer = ivf->quantizer;
+        std::string prefix = "IVF" + std::to_string(ivf->nlist);
+        if (dynamic_cast<const faiss::IndexFlat*>(quantizer)) {
+            // prefix as is
+        } else if (auto* miq = dynamic_cast<const faiss::MultiIndexQuantizer*>(quantizer)) {
+            prefix = "IMI" + std::to_string(miq->pq.M) + "x" + std::to_string(miq->pq.nbits);
+        } else if (auto* hnsw = dynamic_cast<const faiss::IndexHNSWFlat*>(quantizer)) {
+            prefix += "_HNSW" + std::to_string(hnsw_M(hnsw->hnsw));
+        } else {
+            std::string q = reverse_index_factory_ext(quantizer);
+            if (q.empty()) {
+                return "";
+            }
+            prefix += "(" + q + ")";
+        }
+
+        if (dynamic_cast<const faiss::IndexIVFFlat*>(ivf)) {
+            return prefix + ",Flat";
+        } else if (auto* sq = dynamic_cast<const faiss::IndexIVFScalarQuantizer*>(ivf)) {
+            return join(prefix, sq_name(sq->sq.qtype));
+        } else if (auto* pqr = dynamic_cast<const faiss::IndexIVFPQR*>(ivf)) {
+            return prefix + ",PQ" + std::to_string(pqr->pq.M) + "+" + std::to_string(pqr->refine_pq.M);
+        } else if (auto* pq = dynamic_cast<const faiss::IndexIVFPQ*>(ivf)) {
+            return prefix + "," + pq_name(pq->pq);
+        } else if (auto* pqfs = dynamic_cast<const faiss::IndexIVFPQFastScan*>(ivf)) {
+            return prefix + ",PQ" + std::to_string(pqfs->pq.M) + "x4fs";
+        } else if (auto* rq = dynamic_cast<const faiss::IndexIVFRaBitQ*>(ivf)) {
+            return prefix + ",RaBitQ" + (rq->rabitq.nb_bits > 1 ? std::to_string(rq->rabitq.nb_bits) : "");
+        }
+    } else if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+        std::string desc;
+        for (const faiss::VectorTransform* vt : pt->chain) {
+            std::string t = reverse_transform(vt);
+            if (t.empty()) {
+                return "";
+            }
+            desc += t + ",";
+        }
+        std::string sub = reverse_index_factory_ext(pt->index);
+        return sub.empty() ? "" : desc + sub;
+    } else if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+        if (!dynamic_cast<const faiss::IndexHNSWFlat*>(hnsw) && !dynamic_cast<const faiss::IndexHNSWSQ*>(hnsw) &&
+            !dynamic_cast<const faiss::IndexHNSWPQ*>(hnsw)) {
+            // 2Level, Cagra, ... have no factory form
+            return "";
+        }
+        return join("HNSW" + std::to_string(hnsw_M(hnsw->hnsw)), reverse_index_factory_ext(hnsw->storage));
+    } else if (auto* wide = dynamic_cast<const IndexHNSWWide*>(index)) {
+        return join("HNSWWide" + std::to_string(wide->M), reverse_index_factory_ext(wide->storage));
+    } else if (auto* nsg = dynamic_cast<const faiss::IndexNSG*>(index)) {
+        return join("NSG" + std::to_string(nsg->nsg.R), reverse_index_factory_ext(nsg->storage));
+    } else if (auto* refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+        std::string base = reverse_index_factory_ext(refine->base_index);
+        if (dynamic_cast<const faiss::IndexRefineFlat*>(refine)) {
+            return join(base, "RFlat");
+        }
+        std::string ref = reverse_index_factory_ext(refine->refine_index);
+        return ref.empty() ? "" : join(base, "Refine(" + ref + ")");
+    } else if (auto* pqfs = dynamic_cast<const faiss::IndexPQFastScan*>(index)) {
+        return "PQ" + std::to_string(pqfs->pq.M) + "x4fs";
+    } else if (auto* pq = dynamic_cast<const faiss::IndexPQ*>(index)) {
+        return pq_name(pq->pq);
+    } else if (auto* lsh = dynamic_cast<const faiss::IndexLSH*>(index)) {
+        return "LSH" + std::to_string(lsh->nbits) + (lsh->rotate_data ? "r" : "") + (lsh->train_thresholds ? "t" : "");
+    } else if (auto* sq = dynamic_cast<const faiss::IndexScalarQuantizer*>(index)) {
+        return sq_name(sq->sq.qtype);
+    } else if (auto* idmap2 = dynamic_cast<const faiss::IndexIDMap2*>(index)) {
+        return join("IDMap2", reverse_index_factory_ext(idmap2->index));
+    } else if (auto* idmap = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        return join("IDMap", reverse_index_factory_ext(idmap->index));
+    } else if (auto* idmap3 = dynamic_cast<const IndexIDMap3*>(index)) {
+        return join("IDMap3", reverse_index_factory_ext(idmap3->index));
+    } else if (auto* rq = dynamic_cast<const faiss::IndexRaBitQ*>(index)) {
+        return "RaBitQ" + (rq->rabitq.nb_bits > 1 ? std::to_string(rq->rabitq.nb_bits) : "");
+    }
+    return "";
+}
+
+std::vector<IndexNode> describe_index(const faiss::Index* index) {
+    FAISS_THROW_IF_NOT(index);
+    std::vector<IndexNode> nodes;
+    describe(index, -1, "", false, nodes);
+    return nodes;
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,76 @@
+/**
+ * FAISS Go Extensions - compiled index_factory descriptions and index
+ * reflection
+ *
+ * faiss::index_factory matches the description against std::regex
+ * patterns, compiled on every call, so creating many small indexes from
+ * the same few descriptions spends most of its time parsing. A
+ * CompiledFactory parses the description once into an empty prototype
+ * and instantiates it by cloning. A prototype taken from a trained index
+ * (with its vectors removed) shares the training with every instance.
+ *
+ * reverse_index_factory_ext is the cppcontrib reverse_index_factory
+ * (which the prebuilt library does not ship), extended to transform
+ * chains, IDMap2, RFlat, IDMap3 and HNSWWide. describe_index lists the
+ * index tree node by node (class, dimensions, codec parameters, sub-index
+ * roles and ownership), so callers do not have to guess types.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_COMPILED_FACTORY_H
+#define FAISS_GO_EXT_COMPILED_FACTORY_H
+
+#include <faiss/Index.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct CompiledFactory {
+    std::string description; ///< empty if built from an index
+    std::unique_ptr<faiss::Index> prototype;
+
+    /// parse with index_factory_ext
+    CompiledFactory(int d, const char* description, faiss::MetricType metric);
+
+    /// the structure and training of index, without its vectors
+    explicit CompiledFactory(const faiss::Index* index);
+
+    /// a new empty index, safe to call from several threads
+    faiss::Index* instantiate() const;
+};
+
+/// Factory string that rebuilds the structure of index, "" if a component
+/// has no factory form. Ext components (IDMap3, HNSWWide) can only be
+/// parsed back by index_factory_ext when they come first.
+std::string reverse_index_factory_ext(const faiss::Index* index);
+
+/// one node of an index tree
+struct IndexNode {
+    int parent = -1;      ///< node number of the parent, -1 for the root
+    std::string role;     ///< relation to the parent: index, quantizer, storage, base, refine, transform, shard
+    std::string type;     ///< class name without namespace, e.g. IndexIVFPQ
+    idx_t d = 0;          ///< output dimension for transforms
+    idx_t ntotal = 0;
+    size_t code_size = 0; ///< bytes per stored vector, 0 if not a codec
+    faiss::MetricType metric = faiss::METRIC_L2;
+    bool is_trained = true;
+    bool owned = false;   ///< deleted with the parent
+    size_t nlist = 0;     ///< IVF lists
+    int M = 0;            ///< graph degree (HNSW M, NSG R, NNDescent K) or PQ sub-quantizers
+    int nbits = 0;        ///< PQ / LSH / RaBitQ bits
+    std::string qtype;    ///< scalar quantizer type, e.g. SQ8
+};
+
+/// the nodes of the tree rooted at index, parents before their children
+std::vector<IndexNode> describe_index(const faiss::Index* index);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_COMPILED_FACTORY_H */
@@ -0,0 +1,296 @@
+/**
+ * FAISS Go Extensions - float vector distance kernels
+ *
+ * Counterparts of fvec_L2sqr / fvec_inner_product / *_ny from
+ * faiss/utils/distances_simd.cpp and of the fused L2 nearest-neighbor
+ * search from faiss/utils/distances_fused, generalized to top-k with
+ * register-blocked dot products, compiled once per SIMD level (see
+ * simd_dispatch.h).
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_kernels-inl.h"
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+
+namespace {
+
+template <bool IP>
+inline float fvec_distance(const float* x, const float* y, size_t d) {
+    size_t i = 0;
+    float accu = 0;
+
+#if SIMD_W > 1
+    // two accumulators hide the fma latency
+    simd_t acc0 = vzero(), acc1 = vzero();
+    for (; i + 2 * SIMD_W <= d; i += 2 * SIMD_W) {
+        simd_t x0 = vload(x + i), y0 = vload(y + i);
+        simd_t x1 = vload(x + i + SIMD_W), y1 = vload(y + i + SIMD_W);
+        if constexpr (IP) {
+            acc0 = vfmadd(x0, y0, acc0);
+            acc1 = vfmadd(x1, y1, acc1);
+        } else {
+            simd_t t0 = vsub(x0, y0), t1 = vsub(x1, y1);
+            acc0 = vfmadd(t0, t0, acc0);
+            acc1 = vfmadd(t1, t1, acc1);
+        }
+    }
+    for (; i + SIMD_W <= d; i += SIMD_W) {
+        simd_t x0 = vload(x + i), y0 = vload(y + i);
+        if constexpr (IP) {
+            acc0 = vfmadd(x0, y0, acc0);
+        } else {
+            simd_t t0 = vsub(x0, y0);
+            acc0 = vfmadd(t0, t0, acc0);
+        }
+    }
+    accu = vreduce(vadd(acc0, acc1));
+#endif
+
+    for (; i < d; i++) {
+        if constexpr (IP) {
+            accu += x[i] * y[i];
+        } else {
+            float t = x[i] - y[i];
+            accu += t * t;
+        }
+    }
+    return accu;
+}
+
+float fvec_L2sqr(const float* x, const float* y, size_t d) {
+    return fvec_distance<false>(x, y, d);
+}
+
+float fvec_inner_product(const float* x, const float* y, size_t d) {
+    return fvec_distance<true>(x, y, d);
+}
+
+template <bool IP>
+void fvec_distances_ny(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    for (size_t j = 0; j < ny; j++) {
+        dis[j] = fvec_distance<IP>(x, y + j * d, d);
+    }
+}
+
+/// dot products of x with 4 consecutive vectors of y, sharing the x loads
+inline void inner_product_4(const float* x, const float* y, size_t d, float* ip) {
+    const float* y0 = y;
+    const float* y1 = y + d;
+    const float* y2 = y + 2 * d;
+    const float* y3 = y + 3 * d;
+    size_t i = 0;
+    float a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+
+#if SIMD_W > 1
+    simd_t s0 = vzero(), s1 = vzero(), s2 = vzero(), s3 = vzero();
+    for (; i + SIMD_W <= d; i += SIMD_W) {
+        simd_t xi = vload(x + i);
+        s0 = vfmadd(xi, vload(y0 + i), s0);
+        s1 = vfmadd(xi, vload(y1 + i), s1);
+        s2 = vfmadd(xi, vload(y2 + i), s2);
+        s3 = vfmadd(xi, vload(y3 + i), s3);
+    }
+    a0 = vreduce(s0);
+    a1 = vreduce(s1);
+    a2 = vreduce(s2);
+    a3 = vreduce(s3);
+#endif
+
+    for (; i < d; i++) {
+        a0 += x[i] * y0[i];
+        a1 += x[i] * y1[i];
+        a2 += x[i] * y2[i];
+        a3 += x[i] * y3[i];
+    }
+    ip[0] = a0;
+    ip[1] = a1;
+    ip[2] = a2;
+    ip[3] = a3;
+}
+
+void fvec_L2sqr_nn(
+        const float* x,
+        const float* y,
+        const float* y_norms,
+        size_t d,
+        size_t nx,
+        size_t ny,
+        float* distances,
+        int64_t* labels) {
+    for (size_t i = 0; i < nx; i++) {
+        const float* xi = x + i * d;
+        float best = 0;
+        int64_t best_j = -1;
+        size_t j = 0;
+        float ip[4];
+        for (; j + 4 <= ny; j += 4) {
+            inner_product_4(xi, y + j * d, d, ip);
+            for (size_t jj = 0; jj < 4; jj++) {
+                float dis = y_norms[j + jj] - 2 * ip[jj];
+                if (best_j < 0 || dis < best) {
+                    best = dis;
+                    best_j = j + jj;
+                }
+            }
+        }
+        for (; j < ny; j++) {
+            float dis = y_norms[j] - 2 * fvec_distance<true>(xi, y + j * d, d);
+            if (best_j < 0 || dis < best) {
+                best = dis;
+                best_j = j;
+            }
+        }
+        float dis = best_j < 0 ? 0 : best + fvec_distance<true>(xi, xi, d);
+        distances[i] = dis < 0 ? 0 : dis;
+        labels[i] = best_j;
+    }
+}
+
+/* fused top-k search */
+
+// register tile of queries x database vectors: 16 accumulators with
+// AVX-512 (32 registers), 8 with AVX2 / NEON so the loads do not spill
+#if SIMD_W == 8
+constexpr size_t kTileQ = 2;
+#else
+constexpr size_t kTileQ = 4;
+#endif
+constexpr size_t kTileY = 4;
+
+/// inner products between QR consecutive queries and YR consecutive
+/// database vectors, ip is QR x YR
+template <size_t QR, size_t YR>
+inline void dot_tile(const float* x, const float* y, size_t d, float* ip) {
+    size_t i = 0;
+    for (size_t t = 0; t < QR * YR; t++) {
+        ip[t] = 0;
+    }
+
+#if SIMD_W > 1
+    simd_t acc[QR][YR];
+    for (size_t q = 0; q < QR; q++) {
+        for (size_t j = 0; j < YR; j++) {
+            acc[q][j] = vzero();
+        }
+    }
+    for (; i + SIMD_W <= d; i += SIMD_W) {
+        simd_t yv[YR];
+        for (size_t j = 0; j < YR; j++) {
+            yv[j] = vload(y + j * d + i);
+        }
+        for (size_t q = 0; q < QR; q++) {
+            simd_t xv = vload(x + q * d + i);
+            for (size_t j = 0; j < YR; j++) {
+                acc[q][j] = vfmadd(xv, yv[j], acc[q][j]);
+            }
+        }
+    }
+    for (size_t q = 0; q < QR; q++) {
+        for (size_t j = 0; j < YR; j++) {
+            ip[q * YR + j] = vreduce(acc[q][j]);
+        }
+    }
+#endif
+
+    for (; i < d; i++) {
+        for (size_t q = 0; q < QR; q++) {
+            float xi = x[q * d + i];
+            for (size_t j = 0; j < YR; j++) {
+                ip[q * YR + j] += xi * y[j * d + i];
+            }
+        }
+    }
+}
+
+/// heap order of faiss::CMax (L2) / faiss::CMin (IP), ties broken on labels
+template <bool IP>
+inline bool heap_above(float a, int64_t ia, float b, int64_t ib) {
+    if constexpr (IP) {
+        return a < b || (a == b && ia < ib);
+    } else {
+        return a > b || (a == b && ia > ib);
+    }
+}
+
+/// same as faiss::heap_replace_top
+template <bool IP>
+void heap_replace_top(size_t k, float* dis, int64_t* ids, float val, int64_t id) {
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= k) {
+            break;
+        }
+        if (c + 1 < k && heap_above<IP>(dis[c + 1], ids[c + 1], dis[c], ids[c])) {
+            c++;
+        }
+        if (!heap_above<IP>(dis[c], ids[c], val, id)) {
+            break;
+        }
+        dis[i] = dis[c];
+        ids[i] = ids[c];
+        i = c;
+    }
+    dis[i] = val;
+    ids[i] = id;
+}
+
+template <bool IP, size_t QR, size_t YR>
+inline void knn_block(const KnnTileArgs* a, size_t i0, size_t j0) {
+    float ip[QR * YR];
+    dot_tile<QR, YR>(a->x + i0 * a->d, a->y + j0 * a->d, a->d, ip);
+    for (size_t q = 0; q < QR; q++) {
+        float* heap_dis = a->heap_dis + (i0 + q) * a->k;
+        int64_t* heap_ids = a->heap_ids + (i0 + q) * a->k;
+        for (size_t j = 0; j < YR; j++) {
+            float dis = IP ? ip[q * YR + j] : a->y_norms[j0 + j] - 2 * ip[q * YR + j];
+            if (IP ? dis > heap_dis[0] : dis < heap_dis[0]) {
+                heap_replace_top<IP>(a->k, heap_dis, heap_ids, dis, a->y0 + j0 + j);
+            }
+        }
+    }
+}
+
+/// the query rows sweep the whole tile so the database vectors stay in
+/// cache while every row block uses them
+template <bool IP>
+void knn_tile(const KnnTileArgs* a) {
+    size_t i0 = 0;
+    for (; i0 + kTileQ <= a->nx; i0 += kTileQ) {
+        size_t j0 = 0;
+        for (; j0 + kTileY <= a->ny; j0 += kTileY) {
+            knn_block<IP, kTileQ, kTileY>(a, i0, j0);
+        }
+        for (; j0 < a->ny; j0++) {
+            knn_block<IP, kTileQ, 1>(a, i0, j0);
+        }
+    }
+    for (; i0 < a->nx; i0++) {
+        size_t j0 = 0;
+        for (; j0 + kTileY <= a->ny; j0 += kTileY) {
+            knn_block<IP, 1, kTileY>(a, i0, j0);
+        }
+        for (; j0 < a->ny; j0++) {
+            knn_block<IP, 1, 1>(a, i0, j0);
+        }
+    }
+}
+
+} // namespace
+
+void get_distance_kernels(DistanceKernels* kernels) {
+    kernels->L2sqr = fvec_L2sqr;
+    kernels->inner_product = fvec_inner_product;
+    kernels->L2sqr_ny = fvec_distances_ny<false>;
+    kernels->inner_products_ny = fvec_distances_ny<true>;
+    kernels->L2sqr_nn = fvec_L2sqr_nn;
+    kernels->knn_tile_L2 = knn_tile<false>;
+    kernels->knn_tile_IP = knn_tile<true>;
+}
+
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
@@ -14,14 +14,93 @@
  */
 
 #include "faiss_go_ext.h"
+#include "approx_topk.h"
+#include "binary_range_search.h"
+#include "compiled_factory.h"
+#include "fast_scan_tuning.h"
+#include "flat_search.h"
+#include "graph_search.h"
+#include "hnsw_wide.h"
+#include "idmap_sorted.h"
+#include "ivf_id_table.h"
+#include "ivf_tombstones.h"
+#include "numa_placement.h"
+#include "numa_topology.h"
+#include "panorama_convert.h"
+#include "parallel_clone.h"
+#include "parallel_explore.h"
+#include "pq_dispatch.h"
+#include "rabitq_search.h"
+#include "range_arena.h"
+#include "replica_router.h"
+#include "search_context.h"
+#include "search_controller.h"
+#include "segmented_index.h"
+#include "shards_search.h"
+#include "snapshot_index.h"
+#include "simd_dispatch.h"
+#include "sq_dispatch.h"
 
 #include <faiss/Index.h>
 #include <faiss/IndexHNSW.h>
 #include <faiss/IndexBinaryFlat.h>
+#include <faiss/IndexBinaryFromFloat.h>
+#include <faiss/IndexBinaryHNSW.h>
+#include <faiss/IndexBinaryHash.h>
+#include <faiss/IndexBinaryIVF.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIVFRaBitQ.h>
+#include <faiss/IndexIVFRaBitQFastScan.h>
+#include <faiss/IndexPQ.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/IndexReplicas.h>
+#include <faiss/IndexRaBitQ.h>
+#include <faiss/IndexRaBitQFastScan.h>
+#include <faiss/IndexScalarQuantizer.h>
 #include <faiss/VectorTransform.h>
+#include <faiss/index_factory.h>
 #include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/PanoramaStats.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+
+faiss_go_ext::BlasParams to_blas_params(const FaissBlasParams* blas) {
+    faiss_go_ext::BlasParams p;
+    if (blas) {
+        p.blas_threshold = blas->blas_threshold;
+        p.query_bs = blas->query_bs;
+        p.database_bs = blas->database_bs;
+        p.min_k_reservoir = blas->min_k_reservoir;
+    }
+    return p;
+}
+
+void from_blas_params(const faiss_go_ext::BlasParams& p, FaissBlasParams* blas) {
+    blas->blas_threshold = p.blas_threshold;
+    blas->query_bs = p.query_bs;
+    blas->database_bs = p.database_bs;
+    blas->min_k_reservoir = p.min_k_reservoir;
+}
+
+/// a NULL context is the calling thread's own
+faiss_go_ext::SearchContext& search_context(FaissSearchContext ctx) {
+    return ctx ? *static_cast<faiss_go_ext::SearchContext*>(ctx) : faiss_go_ext::thread_search_context();
+}
+
+/// NUL-terminated, truncated to size (> 0)
+void copy_string(const std::string& src, char* dst, size_t size) {
+    size_t len = std::min(src.size(), size - 1);
+    memcpy(dst, src.data(), len);
+    dst[len] = 0;
+}
+
+} // namespace
 
 extern "C" {
 
@@ -121,6 +200,201 @@ int faiss_IndexBinaryFlat_new(FaissIndexBinary* p_index, int64_t d) {
     }
 }
 
+int faiss_IndexBinaryIVF_new(FaissIndexBinary* p_index, FaissIndexBinary quantizer, int64_t d, int64_t nlist) {
+    try {
+        if (!p_index || !quantizer || d <= 0 || d % 8 != 0 || nlist <= 0) return -1;
+        *p_index = new faiss::IndexBinaryIVF(static_cast<faiss::IndexBinary*>(quantizer), d, nlist);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHNSW_new(FaissIndexBinary* p_index, int64_t d, int M) {
+    try {
+        if (!p_index || d <= 0 || d % 8 != 0 || M <= 0) return -1;
+        *p_index = new faiss::IndexBinaryHNSW(d, M);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHNSWCagra_new(FaissIndexBinary* p_index, int64_t d, int M) {
+    try {
+        if (!p_index || d <= 0 || d % 8 != 0 || M <= 0) return -1;
+        *p_index = new faiss::IndexBinaryHNSWCagra(d, M);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHash_new(FaissIndexBinary* p_index, int64_t d, int b) {
+    try {
+        if (!p_index || d <= 0 || d % 8 != 0 || b <= 0 || b > d) return -1;
+        *p_index = new faiss::IndexBinaryHash(d, b);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryMultiHash_new(FaissIndexBinary* p_index, int64_t d, int nhash, int b) {
+    try {
+        if (!p_index || d <= 0 || d % 8 != 0 || nhash <= 0 || b <= 0 || (int64_t)nhash * b > d) return -1;
+        *p_index = new faiss::IndexBinaryMultiHash(d, nhash, b);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryFromFloat_new(FaissIndexBinary* p_index, FaissIndex index, int own_index) {
+    try {
+        if (!p_index || !index) return -1;
+        auto* res = new faiss::IndexBinaryFromFloat(static_cast<faiss::Index*>(index));
+        res->own_fields = own_index != 0;
+        *p_index = res;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_index_binary_factory_ext(FaissIndexBinary* p_index, int d, const char* description) {
+    try {
+        if (!p_index || !description) return -1;
+        *p_index = faiss::index_binary_factory(d, description);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Binary Index Extensions (property accessors)
+// ============================================================
+
+int faiss_IndexBinaryIVF_set_nprobe_ext(FaissIndexBinary index, int64_t nprobe) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexBinaryIVF*>(static_cast<faiss::IndexBinary*>(index));
+        if (!ivf || nprobe <= 0) return -1;
+        ivf->nprobe = nprobe;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryIVF_get_nprobe(FaissIndexBinary index, int64_t* nprobe) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexBinaryIVF*>(static_cast<faiss::IndexBinary*>(index));
+        if (!ivf || !nprobe) return -1;
+        *nprobe = ivf->nprobe;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryIVF_set_max_codes_ext(FaissIndexBinary index, int64_t max_codes) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexBinaryIVF*>(static_cast<faiss::IndexBinary*>(index));
+        if (!ivf || max_codes < 0) return -1;
+        ivf->max_codes = max_codes;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHNSW_set_efSearch(FaissIndexBinary index, int ef) {
+    try {
+        auto* hnsw = dynamic_cast<faiss::IndexBinaryHNSW*>(static_cast<faiss::IndexBinary*>(index));
+        if (!hnsw || ef <= 0) return -1;
+        hnsw->hnsw.efSearch = ef;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHNSW_get_efSearch(FaissIndexBinary index, int* ef) {
+    try {
+        auto* hnsw = dynamic_cast<faiss::IndexBinaryHNSW*>(static_cast<faiss::IndexBinary*>(index));
+        if (!hnsw || !ef) return -1;
+        *ef = hnsw->hnsw.efSearch;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHNSW_set_efConstruction(FaissIndexBinary index, int ef) {
+    try {
+        auto* hnsw = dynamic_cast<faiss::IndexBinaryHNSW*>(static_cast<faiss::IndexBinary*>(index));
+        if (!hnsw || ef <= 0) return -1;
+        hnsw->hnsw.efConstruction = ef;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHash_set_nflip(FaissIndexBinary index, int nflip) {
+    try {
+        auto* idx = static_cast<faiss::IndexBinary*>(index);
+        if (nflip < 0) return -1;
+        if (auto* hash = dynamic_cast<faiss::IndexBinaryHash*>(idx)) {
+            hash->nflip = nflip;
+        } else if (auto* multi = dynamic_cast<faiss::IndexBinaryMultiHash*>(idx)) {
+            multi->nflip = nflip;
+        } else {
+            return -1;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinaryHash_get_nflip(FaissIndexBinary index, int* nflip) {
+    try {
+        auto* idx = static_cast<faiss::IndexBinary*>(index);
+        if (!nflip) return -1;
+        if (auto* hash = dynamic_cast<faiss::IndexBinaryHash*>(idx)) {
+            *nflip = hash->nflip;
+        } else if (auto* multi = dynamic_cast<faiss::IndexBinaryMultiHash*>(idx)) {
+            *nflip = multi->nflip;
+        } else {
+            return -1;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexBinary_range_search_ext(FaissIndexBinary index, int64_t n, const uint8_t* x, int radius, int64_t max_k, FaissRangeSearchResult result, int64_t* n_truncated) {
+    try {
+        auto* idx = static_cast<faiss::IndexBinary*>(index);
+        auto* res = static_cast<faiss::RangeSearchResult*>(result);
+        if (!idx || !res || n < 0 || (n > 0 && !x) || max_k < 0) return -1;
+        if (max_k == 0) {
+            max_k = FAISS_BINARY_RANGE_SEARCH_DEFAULT_MAX_K;
+        }
+        size_t nt = faiss_go_ext::binary_range_search(
+                idx, n, x, radius, res,
+                FAISS_BINARY_RANGE_SEARCH_MIN_K,
+                std::max<int64_t>(max_k, FAISS_BINARY_RANGE_SEARCH_MIN_K));
+        if (n_truncated) *n_truncated = nt;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
 // ============================================================
 // VectorTransform Extensions - Custom wrappers for ABI safety
 // ============================================================
@@ -169,4 +443,1755 @@ int faiss_VectorTransform_reverse_transform_ext(FaissVectorTransform vt, int64_t
     }
 }
 
+// ============================================================
+// SIMD Dispatch Extensions
+// ============================================================
+
+int faiss_get_simd_level(int* level) {
+    try {
+        if (!level) return -1;
+        *level = static_cast<int>(faiss_go_ext::simd_level());
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_set_simd_level(int level) {
+    try {
+        return faiss_go_ext::set_simd_level(static_cast<faiss_go_ext::SIMDLevel>(level)) ? 0 : -1;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_simd_level_supported(int level, int* supported) {
+    try {
+        if (!supported) return -1;
+        *supported = faiss_go_ext::simd_level_supported(static_cast<faiss_go_ext::SIMDLevel>(level)) ? 1 : 0;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+const char* faiss_simd_level_name(int level) {
+    return faiss_go_ext::simd_level_name(static_cast<faiss_go_ext::SIMDLevel>(level));
+}
+
+int faiss_IndexScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* sq = dynamic_cast<faiss::IndexScalarQuantizer*>(static_cast<faiss::Index*>(index));
+        if (!sq || !x || !distances || !labels || k <= 0) return -1;
+        if (!faiss_go_ext::sq_dispatch_supported(sq->sq, sq->metric_type)) {
+            sq->search(n, x, k, distances, labels);
+            return 0;
+        }
+        faiss_go_ext::search_sq_flat(*sq, n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIVFScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexIVFScalarQuantizer*>(static_cast<faiss::Index*>(index));
+        if (!ivf || !x || !distances || !labels || k <= 0) return -1;
+        if (!faiss_go_ext::sq_dispatch_supported(ivf->sq, ivf->metric_type)) {
+            ivf->search(n, x, k, distances, labels);
+            return 0;
+        }
+        faiss_go_ext::search_ivf_sq(*ivf, n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexPQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* pq = dynamic_cast<faiss::IndexPQ*>(static_cast<faiss::Index*>(index));
+        if (!pq || !x || !distances || !labels || k <= 0) return -1;
+        if (!faiss_go_ext::pq_dispatch_supported(*pq)) {
+            pq->search(n, x, k, distances, labels);
+            return 0;
+        }
+        faiss_go_ext::search_pq_flat(*pq, n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_fvec_L2sqr_ny_ext(float* dis, const float* x, const float* y, size_t d, size_t ny) {
+    try {
+        if (!dis || !x || (!y && ny > 0)) return -1;
+        faiss_go_ext::kernels().distances.L2sqr_ny(dis, x, y, d, ny);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_fvec_inner_products_ny_ext(float* ip, const float* x, const float* y, size_t d, size_t ny) {
+    try {
+        if (!ip || !x || (!y && ny > 0)) return -1;
+        faiss_go_ext::kernels().distances.inner_products_ny(ip, x, y, d, ny);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_fvec_L2sqr_nn_ext(const float* x, const float* y, size_t d, size_t nx, size_t ny, float* distances, int64_t* labels) {
+    try {
+        if (!x || (!y && ny > 0) || !distances || !labels) return -1;
+        const faiss_go_ext::DistanceKernels& kernels = faiss_go_ext::kernels().distances;
+        std::vector<float> y_norms(ny);
+        for (size_t j = 0; j < ny; j++) {
+            y_norms[j] = kernels.inner_product(y + j * d, y + j * d, d);
+        }
+        const size_t bs = 64; // queries per parallel task
+
+#pragma omp parallel for if (nx > bs)
+        for (size_t i0 = 0; i0 < nx; i0 += bs) {
+            size_t nb = std::min(bs, nx - i0);
+            kernels.L2sqr_nn(x + i0 * d, y, y_norms.data(), d, nb, ny, distances + i0, labels + i0);
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_hamming_distances_ext(const uint8_t* a, const uint8_t* b, size_t na, size_t nb, size_t code_size, int32_t* distances) {
+    try {
+        if (!a || !b || !distances) return -1;
+        const faiss_go_ext::HammingKernels& kernels = faiss_go_ext::kernels().hamming;
+
+#pragma omp parallel for if (na > 1)
+        for (size_t i = 0; i < na; i++) {
+            kernels.hamming_ny(distances + i * nb, a + i * code_size, b, code_size, nb);
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Fast-Scan Extensions
+// ============================================================
+
+int faiss_IndexFastScan_set_implem(FaissIndex index, int implem) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx)) return -1;
+        faiss_go_ext::FastScanParams params = faiss_go_ext::get_fast_scan_params(idx);
+        params.implem = implem;
+        faiss_go_ext::set_fast_scan_params(idx, params);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_get_implem(FaissIndex index, int* implem) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || !implem) return -1;
+        *implem = faiss_go_ext::get_fast_scan_params(idx).implem;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_set_qbs(FaissIndex index, int qbs) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || qbs < 0) return -1;
+        faiss_go_ext::FastScanParams params = faiss_go_ext::get_fast_scan_params(idx);
+        params.qbs = qbs;
+        faiss_go_ext::set_fast_scan_params(idx, params);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_get_qbs(FaissIndex index, int* qbs) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || !qbs) return -1;
+        *qbs = faiss_go_ext::get_fast_scan_params(idx).qbs;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_get_bbs(FaissIndex index, int* bbs) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || !bbs) return -1;
+        faiss_go_ext::get_fast_scan_params(idx, bbs);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int implem, int qbs, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || !x || !distances || !labels || k <= 0) return -1;
+        faiss_go_ext::FastScanParams fs;
+        fs.implem = implem;
+        fs.qbs = qbs;
+        faiss_go_ext::search_fast_scan_with(
+                idx, fs, n, x, k, distances, labels,
+                static_cast<const faiss::SearchParameters*>(params));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFastScan_autotune_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int nrep, int apply, int* best_implem, int* best_qbs, double* best_ms, double* default_ms) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::is_fast_scan(idx) || !x || !best_implem || !best_qbs) return -1;
+        faiss_go_ext::FastScanTuneResult res = faiss_go_ext::autotune_fast_scan(idx, n, x, k, nrep, apply != 0);
+        *best_implem = res.best.implem;
+        *best_qbs = res.best.qbs;
+        if (best_ms) *best_ms = res.best_ms;
+        if (default_ms) *default_ms = res.default_ms;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// RaBitQ Extensions
+// ============================================================
+
+void faiss_RaBitQSearchParams_init(FaissRaBitQSearchParams* params) {
+    if (!params) return;
+    params->qb = -1;
+    params->centered = -1;
+    params->nprobe = 0;
+    params->k_factor = 0;
+}
+
+int faiss_IndexRaBitQ_new(FaissIndex* p_index, int64_t d, int metric_type, int nb_bits) {
+    try {
+        if (!p_index || d <= 0 || nb_bits < 1 || nb_bits > 9) return -1;
+        *p_index = new faiss::IndexRaBitQ(d, static_cast<faiss::MetricType>(metric_type), nb_bits);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIVFRaBitQ_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int metric_type, int nb_bits) {
+    try {
+        if (!p_index || !quantizer || d <= 0 || nlist <= 0 || nb_bits < 1 || nb_bits > 9) return -1;
+        *p_index = new faiss::IndexIVFRaBitQ(
+                static_cast<faiss::Index*>(quantizer), d, nlist,
+                static_cast<faiss::MetricType>(metric_type), true, nb_bits);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexRaBitQFastScan_new(FaissIndex* p_index, int64_t d, int metric_type, int bbs, int nb_bits) {
+    try {
+        if (!p_index || d <= 0 || bbs <= 0 || bbs % 32 != 0 || nb_bits < 1 || nb_bits > 9) return -1;
+        *p_index = new faiss::IndexRaBitQFastScan(d, static_cast<faiss::MetricType>(metric_type), bbs, nb_bits);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexRaBitQFastScan_new_from(FaissIndex* p_index, FaissIndex orig, int bbs) {
+    try {
+        auto* rq = dynamic_cast<faiss::IndexRaBitQ*>(static_cast<faiss::Index*>(orig));
+        if (!p_index || !rq || bbs <= 0 || bbs % 32 != 0) return -1;
+        auto* fs = new faiss::IndexRaBitQFastScan(*rq, bbs);
+        if (fs->qb == 0) {
+            fs->qb = 8; // fast-scan needs quantized queries
+        }
+        *p_index = fs;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIVFRaBitQFastScan_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int metric_type, int bbs, int nb_bits) {
+    try {
+        if (!p_index || !quantizer || d <= 0 || nlist <= 0 || bbs <= 0 || bbs % 32 != 0 || nb_bits < 1 || nb_bits > 9) return -1;
+        *p_index = new faiss::IndexIVFRaBitQFastScan(
+                static_cast<faiss::Index*>(quantizer), d, nlist,
+                static_cast<faiss::MetricType>(metric_type), bbs, true, nb_bits);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RaBitQ_get_nb_bits(FaissIndex index, int* nb_bits) {
+    try {
+        faiss::Index* rq = faiss_go_ext::rabitq_index(static_cast<faiss::Index*>(index));
+        if (!rq || !nb_bits) return -1;
+        *nb_bits = static_cast<int>(faiss_go_ext::rabitq_nb_bits(rq));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RaBitQ_get_query_params(FaissIndex index, int* qb, int* centered) {
+    try {
+        faiss::Index* rq = faiss_go_ext::rabitq_index(static_cast<faiss::Index*>(index));
+        if (!rq || !qb || !centered) return -1;
+        faiss_go_ext::rabitq_get_defaults(rq, qb, centered);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RaBitQ_set_query_params(FaissIndex index, int qb, int centered) {
+    try {
+        faiss::Index* rq = faiss_go_ext::rabitq_index(static_cast<faiss::Index*>(index));
+        if (!rq) return -1;
+        faiss_go_ext::rabitq_set_defaults(rq, qb, centered);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RaBitQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissRaBitQSearchParams* params, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!faiss_go_ext::rabitq_index(idx) || !x || !distances || !labels || k <= 0) return -1;
+        faiss_go_ext::RaBitQQueryParams qp;
+        if (params) {
+            qp.qb = params->qb;
+            qp.centered = params->centered;
+            qp.nprobe = params->nprobe;
+            qp.k_factor = params->k_factor;
+        }
+        faiss_go_ext::rabitq_search(idx, qp, n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RaBitQStats_get(size_t* n_1bit_evaluations, size_t* n_multibit_evaluations, double* skip_percentage) {
+    try {
+        if (n_1bit_evaluations) *n_1bit_evaluations = faiss::rabitq_stats.n_1bit_evaluations;
+        if (n_multibit_evaluations) *n_multibit_evaluations = faiss::rabitq_stats.n_multibit_evaluations;
+        if (skip_percentage) *skip_percentage = faiss::rabitq_stats.skip_percentage();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_RaBitQStats_reset(void) {
+    faiss::rabitq_stats.reset();
+}
+
+// ============================================================
+// Panorama Extensions
+// ============================================================
+
+int faiss_IndexIVFFlatPanorama_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int n_levels) {
+    try {
+        if (!p_index || !quantizer || d <= 0 || nlist <= 0 || n_levels <= 0 || n_levels > d) return -1;
+        auto* idx = new faiss::IndexIVFFlatPanorama(static_cast<faiss::Index*>(quantizer), d, nlist, n_levels);
+        *p_index = idx;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexHNSWFlatPanorama_new(FaissIndex* p_index, int d, int M, int n_levels) {
+    try {
+        if (!p_index || d <= 0 || M <= 0 || n_levels <= 0 || n_levels > d) return -1;
+        *p_index = new faiss::IndexHNSWFlatPanorama(d, M, n_levels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFlatL2Panorama_new(FaissIndex* p_index, int64_t d, int n_levels, int64_t batch_size) {
+    try {
+        if (!p_index || d <= 0 || n_levels <= 0 || n_levels > d || batch_size <= 0) return -1;
+        *p_index = new faiss::IndexFlatL2Panorama(d, n_levels, batch_size);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexRefinePanorama_new(FaissIndex* p_index, FaissIndex base_index, FaissIndex refine_index) {
+    try {
+        if (!p_index || !base_index || !refine_index) return -1;
+        // search_subset of the Panorama flat index only handles one vector per batch
+        auto* flat = dynamic_cast<faiss::IndexFlatPanorama*>(static_cast<faiss::Index*>(refine_index));
+        if (flat && flat->batch_size != 1) return -1;
+        *p_index = new faiss::IndexRefinePanorama(
+                static_cast<faiss::Index*>(base_index), static_cast<faiss::Index*>(refine_index));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Panorama_get_n_levels(FaissIndex index, int* n_levels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !n_levels) return -1;
+        if (auto* ivf = dynamic_cast<faiss::IndexIVFFlatPanorama*>(idx)) {
+            *n_levels = static_cast<int>(ivf->n_levels);
+        } else if (auto* hnsw = dynamic_cast<faiss::IndexHNSWFlatPanorama*>(idx)) {
+            *n_levels = static_cast<int>(hnsw->num_panorama_levels);
+        } else if (auto* flat = dynamic_cast<faiss::IndexFlatPanorama*>(idx)) {
+            *n_levels = static_cast<int>(flat->n_levels);
+        } else {
+            return -1;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Panorama_get_batch_size(FaissIndex index, int64_t* batch_size) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !batch_size) return -1;
+        if (dynamic_cast<faiss::IndexIVFFlatPanorama*>(idx)) {
+            *batch_size = faiss::ArrayInvertedListsPanorama::kBatchSize;
+        } else if (auto* flat = dynamic_cast<faiss::IndexFlatPanorama*>(idx)) {
+            *batch_size = static_cast<int64_t>(flat->batch_size);
+        } else {
+            return -1;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_to_panorama_ext(FaissIndex* p_index, int n_levels) {
+    try {
+        if (!p_index || !*p_index) return -1;
+        auto* idx = static_cast<faiss::Index*>(*p_index);
+        faiss::Index* converted = nullptr;
+        if (auto* ivf = dynamic_cast<faiss::IndexIVFFlat*>(idx)) {
+            converted = faiss_go_ext::ivf_flat_to_panorama(ivf, n_levels);
+        } else if (auto* hnsw = dynamic_cast<faiss::IndexHNSWFlat*>(idx)) {
+            converted = faiss_go_ext::hnsw_flat_to_panorama(hnsw, n_levels);
+        } else {
+            return -1;
+        }
+        delete idx;
+        *p_index = converted;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_PanoramaStats_get(uint64_t* total_dims_scanned, uint64_t* total_dims, float* ratio_dims_scanned) {
+    try {
+        if (total_dims_scanned) *total_dims_scanned = faiss::indexPanorama_stats.total_dims_scanned;
+        if (total_dims) *total_dims = faiss::indexPanorama_stats.total_dims;
+        if (ratio_dims_scanned) *ratio_dims_scanned = faiss::indexPanorama_stats.ratio_dims_scanned;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_PanoramaStats_reset(void) {
+    faiss::indexPanorama_stats.reset();
+}
+
+// ============================================================
+// Flat Search Extensions
+// ============================================================
+
+int faiss_IndexFlat_search_fused_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int64_t query_bs, int64_t db_bs, float* distances, int64_t* labels) {
+    try {
+        auto* flat = dynamic_cast<faiss::IndexFlat*>(static_cast<faiss::Index*>(index));
+        if (!flat || !x || !distances || !labels || n < 0 || k <= 0 || query_bs < 0 || db_bs < 0) return -1;
+        if (!faiss_go_ext::fused_knn_supported(*flat)) {
+            flat->search(n, x, k, distances, labels);
+            return 0;
+        }
+        faiss_go_ext::FusedKnnParams params;
+        params.query_bs = query_bs;
+        params.db_bs = db_bs;
+        faiss_go_ext::search_flat_fused(*flat, n, x, k, params, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_BlasParams_init(FaissBlasParams* params) {
+    if (!params) return;
+    params->blas_threshold = -1;
+    params->query_bs = -1;
+    params->database_bs = -1;
+    params->min_k_reservoir = -1;
+}
+
+int faiss_get_blas_params(FaissBlasParams* params) {
+    try {
+        if (!params) return -1;
+        from_blas_params(faiss_go_ext::resolve_blas_params(faiss_go_ext::BlasParams()), params);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_set_blas_params(const FaissBlasParams* params) {
+    try {
+        if (!params || params->query_bs == 0 || params->database_bs == 0) return -1;
+        faiss_go_ext::install_blas_params(to_blas_params(params));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexFlat_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* flat = dynamic_cast<faiss::IndexFlat*>(static_cast<faiss::Index*>(index));
+        if (!flat || !x || !distances || !labels || n < 0 || k <= 0) return -1;
+        if (blas && (blas->query_bs == 0 || blas->database_bs == 0)) return -1;
+        faiss_go_ext::search_flat_blas(*flat, n, x, k, to_blas_params(blas),
+                static_cast<faiss::SearchParameters*>(params), distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIVF_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!ivf || !x || !distances || !labels || n < 0 || k <= 0) return -1;
+        if (blas && (blas->query_bs == 0 || blas->database_bs == 0)) return -1;
+        const faiss::SearchParametersIVF* ivf_params = nullptr;
+        if (params) {
+            ivf_params = dynamic_cast<faiss::SearchParametersIVF*>(static_cast<faiss::SearchParameters*>(params));
+            if (!ivf_params) return -1;
+        }
+        faiss_go_ext::search_ivf_blas(*ivf, n, x, k, to_blas_params(blas), ivf_params, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_blas_calibrate_ext(int64_t d, int install, FaissBlasParams* result) {
+    try {
+        if (d <= 0) return -1;
+        faiss_go_ext::BlasParams p = faiss_go_ext::calibrate_blas_params(d, install != 0);
+        if (result) from_blas_params(p, result);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// IndexShards Extensions
+// ============================================================
+
+int faiss_IndexShards_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int n_threads, double deadline_ms, float* distances, int64_t* labels, int* n_completed, int* partial) {
+    try {
+        auto* shards = dynamic_cast<faiss::IndexShards*>(static_cast<faiss::Index*>(index));
+        if (!shards || !x || !distances || !labels || n < 0 || k <= 0 || n_threads < 0 || deadline_ms < 0) return -1;
+        faiss_go_ext::ShardSearchOptions options;
+        options.n_threads = n_threads;
+        options.deadline_ms = deadline_ms;
+        faiss_go_ext::ShardSearchStatus status;
+        faiss_go_ext::search_shards(*shards, n, x, k, options, distances, labels, &status);
+        if (n_completed) *n_completed = status.n_completed;
+        if (partial) *partial = status.partial ? 1 : 0;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexShards_wait_ext(FaissIndex index) {
+    try {
+        if (!index) return -1;
+        faiss_go_ext::wait_shards_idle(static_cast<faiss::Index*>(index));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Replica Routing Extensions
+// ============================================================
+
+int faiss_numa_num_nodes(int* n_nodes) {
+    try {
+        if (!n_nodes) return -1;
+        *n_nodes = faiss_go_ext::numa_num_nodes();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_ReplicaRouter_new(FaissReplicaRouter* p_router, FaissIndex replicas, int64_t small_batch, const int* nodes) {
+    try {
+        auto* rep = dynamic_cast<faiss::IndexReplicas*>(static_cast<faiss::Index*>(replicas));
+        if (!p_router || !rep || rep->count() == 0 || small_batch < 0) return -1;
+        std::vector<const faiss::Index*> indexes;
+        faiss_go_ext::ReplicaRouterOptions options;
+        options.small_batch = small_batch;
+        for (int i = 0; i < rep->count(); i++) {
+            indexes.push_back(rep->at(i));
+            if (nodes) options.nodes.push_back(nodes[i]);
+        }
+        *p_router = new faiss_go_ext::ReplicaRouter(indexes, options);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_ReplicaRouter_search(FaissReplicaRouter router, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* r = static_cast<faiss_go_ext::ReplicaRouter*>(router);
+        if (!r || !x || !distances || !labels || n < 0 || k <= 0) return -1;
+        r->search(n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_ReplicaRouter_queue_depth(FaissReplicaRouter router, int replica, int* depth) {
+    try {
+        auto* r = static_cast<faiss_go_ext::ReplicaRouter*>(router);
+        if (!r || !depth || replica < 0 || (size_t)replica >= r->count()) return -1;
+        *depth = r->queue_depth(replica);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_ReplicaRouter_free(FaissReplicaRouter router) {
+    delete static_cast<faiss_go_ext::ReplicaRouter*>(router);
+}
+
+// ============================================================
+// NUMA Placement Extensions
+// ============================================================
+
+int faiss_Index_numa_place_ext(FaissIndex index, int policy, const int* nodes, int n_nodes, int64_t* n_bytes, int* used_mbind) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || (policy != FAISS_NUMA_BIND && policy != FAISS_NUMA_INTERLEAVE)) return -1;
+        if (n_nodes < 0 || (n_nodes > 0 && !nodes)) return -1;
+        std::vector<int> node_list;
+        for (int i = 0; i < n_nodes; i++) {
+            if (nodes[i] < 0 || nodes[i] >= faiss_go_ext::numa_num_nodes()) return -1;
+            node_list.push_back(nodes[i]);
+        }
+        auto result = faiss_go_ext::numa_place_index(idx, (faiss_go_ext::NumaPolicy)policy, node_list);
+        if (n_bytes) *n_bytes = result.n_bytes;
+        if (used_mbind) *used_mbind = result.used_mbind ? 1 : 0;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_numa_pages_ext(FaissIndex index, int64_t* pages_per_node, int max_nodes, int* n_nodes) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !pages_per_node || max_nodes <= 0 || !n_nodes) return -1;
+        std::vector<size_t> pages;
+        if (!faiss_go_ext::numa_index_pages(idx, &pages) || pages.size() > (size_t)max_nodes) return -1;
+        for (int i = 0; i < max_nodes; i++) {
+            pages_per_node[i] = (size_t)i < pages.size() ? pages[i] : 0;
+        }
+        *n_nodes = pages.size();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_search_on_node_ext(FaissIndex index, int node, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !x || !distances || !labels || n < 0 || k <= 0) return -1;
+        if (node < 0 || node >= faiss_go_ext::numa_num_nodes()) return -1;
+        faiss_go_ext::run_on_node(node, [&]() { idx->search(n, x, k, distances, labels); });
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_replicate_per_node_ext(FaissIndex index, FaissIndex* p_replicas) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !p_replicas) return -1;
+        *p_replicas = faiss_go_ext::replicate_index_per_node(*idx);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_read_index_per_node_ext(const char* fname, int io_flags, FaissIndex* p_replicas) {
+    try {
+        if (!fname || !p_replicas) return -1;
+        *p_replicas = faiss_go_ext::read_index_per_node(fname, io_flags);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// IDMap3 Extensions
+// ============================================================
+
+int faiss_IndexIDMap3_new(FaissIndex* p_index, FaissIndex base_index) {
+    try {
+        auto* base = static_cast<faiss::Index*>(base_index);
+        if (!p_index || !base) return -1;
+        *p_index = new faiss_go_ext::IndexIDMap3(base);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIDMap3_set_own_fields(FaissIndex index, int own_fields) {
+    auto* idmap = dynamic_cast<faiss_go_ext::IndexIDMap3*>(static_cast<faiss::Index*>(index));
+    if (!idmap) return -1;
+    idmap->own_fields = own_fields != 0;
+    return 0;
+}
+
+int faiss_IndexIDMap3_get_index(FaissIndex index, FaissIndex* p_sub_index) {
+    auto* idmap = dynamic_cast<faiss_go_ext::IndexIDMap3*>(static_cast<faiss::Index*>(index));
+    if (!idmap || !p_sub_index) return -1;
+    *p_sub_index = idmap->index;
+    return 0;
+}
+
+int faiss_IndexIDMap3_find(FaissIndex index, int64_t n, const int64_t* ids, int64_t* positions) {
+    try {
+        auto* idmap = dynamic_cast<faiss_go_ext::IndexIDMap3*>(static_cast<faiss::Index*>(index));
+        if (!idmap || n < 0 || (n > 0 && (!ids || !positions))) return -1;
+        for (int64_t i = 0; i < n; i++) {
+            positions[i] = idmap->find(ids[i]);
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIDMap3_from_idmap_ext(FaissIndex* p_index) {
+    try {
+        if (!p_index) return -1;
+        auto* idmap = dynamic_cast<faiss::IndexIDMap*>(static_cast<faiss::Index*>(*p_index));
+        if (!idmap || !idmap->index) return -1;
+        faiss::Index* result = faiss_go_ext::idmap3_from_idmap(idmap);
+        delete idmap;
+        *p_index = result;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_index_factory_ext(FaissIndex* p_index, int d, const char* description, int metric_type) {
+    try {
+        if (!p_index || !description || d <= 0) return -1;
+        *p_index = faiss_go_ext::index_factory_ext(d, description, (faiss::MetricType)metric_type);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_write_index_ext(FaissIndex index, const char* fname) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !fname) return -1;
+        faiss_go_ext::write_index_ext(idx, fname);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_read_index_ext(const char* fname, int io_flags, FaissIndex* p_index) {
+    try {
+        if (!fname || !p_index) return -1;
+        *p_index = faiss_go_ext::read_index_ext(fname, io_flags);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// IVF Id Table Extensions
+// ============================================================
+
+int faiss_IVFIdTable_new(FaissIVFIdTable* p_table, FaissIndex index, double* build_ms) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!p_table || !ivf) return -1;
+        std::unique_ptr<faiss_go_ext::IVFIdTable> table(new faiss_go_ext::IVFIdTable());
+        auto t0 = std::chrono::steady_clock::now();
+        table->build(*ivf);
+        auto t1 = std::chrono::steady_clock::now();
+        if (build_ms) *build_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        *p_table = table.release();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_lookup(FaissIVFIdTable table, int64_t n, const int64_t* ids, int64_t* list_nos, int64_t* offsets) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+        if (!t || n < 0 || (n > 0 && (!ids || !list_nos || !offsets))) return -1;
+        for (int64_t i = 0; i < n; i++) {
+            int64_t entry = t->lookup(ids[i]);
+            list_nos[i] = entry < 0 ? -1 : (int64_t)faiss::lo_listno(entry);
+            offsets[i] = entry < 0 ? -1 : (int64_t)faiss::lo_offset(entry);
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_reconstruct(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, float* recons) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!t || !ivf || n < 0 || (n > 0 && (!ids || !recons))) return -1;
+        faiss_go_ext::ivf_reconstruct_ids(*ivf, *t, n, ids, recons);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_add_with_ids(FaissIVFIdTable table, FaissIndex index, int64_t n, const float* x, const int64_t* ids) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!t || !ivf || n < 0 || (n > 0 && !x)) return -1;
+        faiss_go_ext::ivf_add_with_ids(*ivf, *t, n, x, ids);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_update_vectors(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, const float* x) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!t || !ivf || n < 0 || (n > 0 && (!ids || !x))) return -1;
+        faiss_go_ext::ivf_update_vectors(*ivf, *t, n, ids, x);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_stats(FaissIVFIdTable table, int64_t* size, int64_t* capacity, int64_t* bytes) {
+    auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+    if (!t || !size || !capacity || !bytes) return -1;
+    *size = t->size;
+    *capacity = t->capacity;
+    *bytes = t->memory_usage();
+    return 0;
+}
+
+int faiss_IVFIdTable_write(FaissIVFIdTable table, const char* fname) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFIdTable*>(table);
+        if (!t || !fname) return -1;
+        t->write(fname);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFIdTable_read(FaissIVFIdTable* p_table, const char* fname, int mmap) {
+    try {
+        if (!p_table || !fname) return -1;
+        *p_table = faiss_go_ext::IVFIdTable::read(fname, mmap != 0);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_IVFIdTable_free(FaissIVFIdTable table) {
+    delete static_cast<faiss_go_ext::IVFIdTable*>(table);
+}
+
+int faiss_IndexIVF_make_direct_map_ext(FaissIndex index, int type, double* build_ms) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!ivf || type < faiss::DirectMap::NoMap || type > faiss::DirectMap::Hashtable) return -1;
+        double ms = faiss_go_ext::make_direct_map_timed(*ivf, (faiss::DirectMap::Type)type);
+        if (build_ms) *build_ms = ms;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexIVF_direct_map_stats_ext(FaissIndex index, int* type, int64_t* bytes) {
+    auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+    if (!ivf || !type || !bytes) return -1;
+    *type = ivf->direct_map.type;
+    *bytes = faiss_go_ext::direct_map_memory(ivf->direct_map);
+    return 0;
+}
+
+// ============================================================
+// IVF Tombstone Extensions
+// ============================================================
+
+int faiss_IVFTombstones_new(FaissIVFTombstones* p_ts, FaissIndex index) {
+    try {
+        auto* ivf = dynamic_cast<faiss::IndexIVF*>(static_cast<faiss::Index*>(index));
+        if (!p_ts || !ivf) return -1;
+        *p_ts = new faiss_go_ext::IVFTombstones(ivf);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_delete(FaissIVFTombstones ts, int64_t n, const int64_t* ids, int64_t* n_deleted) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+        if (!t || n < 0 || (n > 0 && !ids)) return -1;
+        size_t deleted = t->remove(n, ids);
+        if (n_deleted) *n_deleted = deleted;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_search(FaissIVFTombstones ts, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+        if (!t || n < 0 || k <= 0 || (n > 0 && (!x || !distances || !labels))) return -1;
+        t->search(n, x, k, distances, labels, static_cast<const faiss::SearchParameters*>(params));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_range_search(FaissIVFTombstones ts, int64_t n, const float* x, float radius, FaissSearchParameters params, FaissRangeSearchResult result) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+        auto* res = static_cast<faiss::RangeSearchResult*>(result);
+        if (!t || !res || n < 0 || (size_t)n != res->nq || (n > 0 && !x)) return -1;
+        t->range_search(n, x, radius, res, static_cast<const faiss::SearchParameters*>(params));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_add_with_ids(FaissIVFTombstones ts, int64_t n, const float* x, const int64_t* ids) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+        if (!t || n < 0 || (n > 0 && !x)) return -1;
+        t->add_with_ids(n, x, ids);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_compact(FaissIVFTombstones ts, int64_t lists_per_batch, int64_t* n_removed) {
+    try {
+        auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+        if (!t) return -1;
+        size_t removed = t->compact(lists_per_batch > 0 ? lists_per_batch : 64);
+        if (n_removed) *n_removed = removed;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IVFTombstones_stats(FaissIVFTombstones ts, int64_t* n_pending, int64_t* n_dirty_lists, int64_t* n_compacted, double* last_compact_ms) {
+    auto* t = static_cast<faiss_go_ext::IVFTombstones*>(ts);
+    if (!t || !n_pending || !n_dirty_lists || !n_compacted || !last_compact_ms) return -1;
+    faiss_go_ext::TombstoneStats s = t->stats();
+    *n_pending = s.n_pending;
+    *n_dirty_lists = s.n_dirty_lists;
+    *n_compacted = s.n_compacted;
+    *last_compact_ms = s.last_compact_ms;
+    return 0;
+}
+
+void faiss_IVFTombstones_free(FaissIVFTombstones ts) {
+    delete static_cast<faiss_go_ext::IVFTombstones*>(ts);
+}
+
+// ============================================================
+// Range Search Arena Extensions
+// ============================================================
+
+int faiss_RangeSearchArena_new(FaissRangeSearchArena* p_arena) {
+    try {
+        if (!p_arena) return -1;
+        *p_arena = new faiss_go_ext::RangeSearchArena();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_RangeSearchArena_reserve(FaissRangeSearchArena arena, int64_t n) {
+    try {
+        auto* a = static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+        if (!a || n < 0) return -1;
+        a->reserve(n);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_range_search_arena_ext(FaissIndex index, int64_t n, const float* x, float radius, FaissSearchParameters params, int64_t max_per_query, FaissRangeSearchArena arena, int64_t* labels, float* distances, int64_t capacity, int64_t* total, int* in_output) {
+    auto* a = static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || !a || n < 0 || max_per_query < 0 || capacity < 0 || (n > 0 && !x)) return -1;
+        // the caller buffers are only used during this call
+        a->set_output(labels, distances, capacity);
+        size_t nres = faiss_go_ext::range_search_arena(
+                *idx, n, x, radius, static_cast<const faiss::SearchParameters*>(params), max_per_query, *a);
+        a->set_output(nullptr, nullptr, 0);
+        if (total) *total = nres;
+        if (in_output) *in_output = a->in_output ? 1 : 0;
+        return 0;
+    } catch (...) {
+        if (a) a->set_output(nullptr, nullptr, 0);
+        return -1;
+    }
+}
+
+int faiss_RangeSearchArena_get(FaissRangeSearchArena arena, int64_t* nq, int64_t** lims, int64_t** labels, float** distances) {
+    auto* a = static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+    if (!a || !nq || !lims || !labels || !distances || a->lims.empty()) return -1;
+    *nq = a->nq;
+    *lims = reinterpret_cast<int64_t*>(a->lims.data());
+    // results written to caller buffers are not the arena's to hand out
+    *labels = a->in_output ? nullptr : a->labels;
+    *distances = a->in_output ? nullptr : a->distances;
+    return 0;
+}
+
+int faiss_RangeSearchArena_copy_to(FaissRangeSearchArena arena, int64_t* lims, int64_t* labels, float* distances) {
+    auto* a = static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+    if (!a || a->lims.empty()) return -1;
+    a->copy_to(reinterpret_cast<size_t*>(lims), labels, distances);
+    return 0;
+}
+
+int faiss_RangeSearchArena_stats(FaissRangeSearchArena arena, int64_t* capacity, int64_t* n_allocations) {
+    auto* a = static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+    if (!a || !capacity || !n_allocations) return -1;
+    *capacity = a->capacity();
+    *n_allocations = a->n_allocations;
+    return 0;
+}
+
+void faiss_RangeSearchArena_free(FaissRangeSearchArena arena) {
+    delete static_cast<faiss_go_ext::RangeSearchArena*>(arena);
+}
+
+// ============================================================
+// Search Context Extensions
+// ============================================================
+
+int faiss_SearchContext_new(FaissSearchContext* p_ctx) {
+    try {
+        if (!p_ctx) return -1;
+        *p_ctx = new faiss_go_ext::SearchContext();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_search_ctx_ext(FaissIndex index, FaissSearchContext ctx, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || n < 0 || k <= 0 || (n > 0 && (!x || !distances || !labels))) return -1;
+        faiss_go_ext::search_with_context(
+                *idx, n, x, k, distances, labels, static_cast<const faiss::SearchParameters*>(params),
+                search_context(ctx));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SearchContext_stats(FaissSearchContext ctx, int64_t* bytes, int64_t* n_grows, int64_t* n_searches) {
+    if (!bytes || !n_grows || !n_searches) return -1;
+    const faiss_go_ext::SearchContext& c = search_context(ctx);
+    *bytes = c.memory_usage();
+    *n_grows = c.n_grows;
+    *n_searches = c.n_searches;
+    return 0;
+}
+
+int faiss_SearchContext_reset(FaissSearchContext ctx) {
+    search_context(ctx).reset();
+    return 0;
+}
+
+void faiss_SearchContext_free(FaissSearchContext ctx) {
+    delete static_cast<faiss_go_ext::SearchContext*>(ctx);
+}
+
+// ============================================================
+// HNSW Wide Extensions
+// ============================================================
+
+int faiss_IndexHNSWWide_new(FaissIndex* p_index, FaissIndex storage, int M) {
+    try {
+        auto* s = static_cast<faiss::Index*>(storage);
+        if (!p_index || !s || s->ntotal != 0 || M < 2) return -1;
+        *p_index = new faiss_go_ext::IndexHNSWWide(s, M);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_IndexHNSWWide_set_own_fields(FaissIndex index, int own_fields) {
+    auto* wide = dynamic_cast<faiss_go_ext::IndexHNSWWide*>(static_cast<faiss::Index*>(index));
+    if (!wide) return -1;
+    wide->own_fields = own_fields != 0;
+    return 0;
+}
+
+int faiss_IndexHNSWWide_set_ef(FaissIndex index, int ef_construction, int ef_search) {
+    auto* wide = dynamic_cast<faiss_go_ext::IndexHNSWWide*>(static_cast<faiss::Index*>(index));
+    if (!wide) return -1;
+    if (ef_construction > 0) wide->efConstruction = ef_construction;
+    if (ef_search > 0) wide->efSearch = ef_search;
+    return 0;
+}
+
+int faiss_IndexHNSWWide_stats(FaissIndex index, int64_t* graph_bytes, int* max_level, int64_t* n_upper) {
+    auto* wide = dynamic_cast<faiss_go_ext::IndexHNSWWide*>(static_cast<faiss::Index*>(index));
+    if (!wide || !graph_bytes || !max_level || !n_upper) return -1;
+    *graph_bytes = wide->graph_memory_usage();
+    *max_level = wide->max_level;
+    *n_upper = wide->upper.size;
+    return 0;
+}
+
+// ============================================================
+// Graph Search Extensions
+// ============================================================
+
+int faiss_SearchParametersGraph_new(FaissSearchParameters* p_params, int ef, int visited_mode) {
+    try {
+        if (!p_params || ef < 0 || visited_mode < 0 || visited_mode > 2) return -1;
+        auto* params = new faiss_go_ext::SearchParametersGraph();
+        params->ef = ef;
+        params->visited_mode = static_cast<faiss_go_ext::VisitedMode>(visited_mode);
+        *p_params = params;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_SearchParametersGraph_free(FaissSearchParameters params) {
+    delete static_cast<faiss_go_ext::SearchParametersGraph*>(params);
+}
+
+int faiss_Index_search_graph_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || n < 0 || k <= 0 || (n > 0 && (!x || !distances || !labels))) return -1;
+        faiss_go_ext::graph_search(
+                *idx, n, x, k, distances, labels, static_cast<const faiss::SearchParameters*>(params));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Parallel Explore Extensions
+// ============================================================
+
+int faiss_ParameterSpace_new_ext(FaissParameterSpace* p_space, FaissIndex index) {
+    try {
+        if (!p_space) return -1;
+        std::unique_ptr<faiss::ParameterSpace> space(new faiss::ParameterSpace());
+        if (index) {
+            space->initialize(static_cast<faiss::Index*>(index));
+        }
+        *p_space = space.release();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_ParameterSpace_set_range_ext(FaissParameterSpace space, const char* name, const double* values, size_t n) {
+    try {
+        auto* ps = static_cast<faiss::ParameterSpace*>(space);
+        if (!ps || !name || !values || n == 0) return -1;
+        ps->add_range(name).values.assign(values, values + n);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_ParameterSpace_free_ext(FaissParameterSpace space) {
+    delete static_cast<faiss::ParameterSpace*>(space);
+}
+
+int faiss_ParameterSpace_explore_ext(FaissParameterSpace space, FaissIndex index, int64_t nq, const float* xq, int64_t gt_k, const int64_t* gt_I, int criterion, int64_t R, int n_threads, int64_t n_subset, FaissOperatingPoints* p_ops, int64_t* n_pruned) {
+    try {
+        auto* ps = static_cast<faiss::ParameterSpace*>(space);
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!ps || !idx || nq <= 0 || !xq || gt_k <= 0 || !gt_I || R <= 0 || !p_ops) return -1;
+        std::unique_ptr<faiss::AutoTuneCriterion> crit;
+        if (criterion == 0) {
+            crit.reset(new faiss::OneRecallAtRCriterion(nq, R));
+        } else if (criterion == 1 && gt_k >= R) {
+            crit.reset(new faiss::IntersectionCriterion(nq, R));
+        } else {
+            return -1;
+        }
+        std::vector<float> gt_D(nq * gt_k);
+        crit->set_groundtruth(gt_k, gt_D.data(), gt_I);
+        faiss_go_ext::ExploreOptions options;
+        options.n_threads = n_threads;
+        options.n_subset = n_subset;
+        faiss_go_ext::ExploreStats stats;
+        std::unique_ptr<faiss::OperatingPoints> ops(new faiss::OperatingPoints());
+        faiss_go_ext::explore_parallel(idx, *ps, nq, xq, *crit, options, ops.get(), &stats);
+        if (n_pruned) *n_pruned = stats.n_pruned;
+        *p_ops = ops.release();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_OperatingPoints_size(FaissOperatingPoints ops, int only_optimal, size_t* n) {
+    auto* o = static_cast<faiss::OperatingPoints*>(ops);
+    if (!o || !n) return -1;
+    // optimal_pts starts with a (0, 0) point that is not listed
+    *n = only_optimal ? o->optimal_pts.size() - 1 : o->all_pts.size();
+    return 0;
+}
+
+int faiss_OperatingPoints_get(FaissOperatingPoints ops, int only_optimal, size_t i, double* perf, double* t, int64_t* cno, char* key, size_t key_size) {
+    auto* o = static_cast<faiss::OperatingPoints*>(ops);
+    if (!o || !perf || !t || !cno) return -1;
+    const std::vector<faiss::OperatingPoint>& pts = only_optimal ? o->optimal_pts : o->all_pts;
+    const size_t skip = only_optimal ? 1 : 0;
+    if (i + skip >= pts.size()) return -1;
+    const faiss::OperatingPoint& op = pts[i + skip];
+    *perf = op.perf;
+    *t = op.t;
+    *cno = op.cno;
+    if (key && key_size > 0) {
+        size_t len = std::min(op.key.size(), key_size - 1);
+        memcpy(key, op.key.data(), len);
+        key[len] = 0;
+    }
+    return 0;
+}
+
+void faiss_OperatingPoints_free(FaissOperatingPoints ops) {
+    delete static_cast<faiss::OperatingPoints*>(ops);
+}
+
+// ============================================================
+// Search Controller Extensions
+// ============================================================
+
+int faiss_SearchController_new(FaissSearchController* p_ctrl, FaissIndex index, double target_p95_ms, FaissParameterSpace space, FaissOperatingPoints ops) {
+    try {
+        if (!p_ctrl || !index || target_p95_ms <= 0) return -1;
+        *p_ctrl = new faiss_go_ext::SearchController(
+                static_cast<faiss::Index*>(index),
+                target_p95_ms,
+                static_cast<faiss::ParameterSpace*>(space),
+                static_cast<faiss::OperatingPoints*>(ops));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SearchController_search(FaissSearchController ctrl, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* c = static_cast<faiss_go_ext::SearchController*>(ctrl);
+        if (!c || n < 0 || k <= 0 || !x || !distances || !labels) return -1;
+        c->search(n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SearchController_get_state(FaissSearchController ctrl, int* level, int* n_levels, double* p95_ms, char* key, size_t key_size) {
+    auto* c = static_cast<faiss_go_ext::SearchController*>(ctrl);
+    if (!c || !level || !n_levels) return -1;
+    int l = c->current_level();
+    *level = l;
+    *n_levels = (int)c->levels.size();
+    if (p95_ms) {
+        *p95_ms = c->current_p95_ms();
+    }
+    if (key && key_size > 0) {
+        const std::string& k = c->levels[l].key;
+        size_t len = std::min(k.size(), key_size - 1);
+        memcpy(key, k.data(), len);
+        key[len] = 0;
+    }
+    return 0;
+}
+
+int faiss_SearchController_set_target(FaissSearchController ctrl, double target_p95_ms) {
+    auto* c = static_cast<faiss_go_ext::SearchController*>(ctrl);
+    if (!c || target_p95_ms <= 0) return -1;
+    std::lock_guard<std::mutex> lock(c->mutex);
+    c->target_p95_ms = target_p95_ms;
+    return 0;
+}
+
+int faiss_SearchController_history_size(FaissSearchController ctrl, size_t* n) {
+    auto* c = static_cast<faiss_go_ext::SearchController*>(ctrl);
+    if (!c || !n) return -1;
+    std::lock_guard<std::mutex> lock(c->mutex);
+    *n = c->events.size();
+    return 0;
+}
+
+int faiss_SearchController_get_history(FaissSearchController ctrl, size_t i, int64_t* call, double* time_ms, int* from, int* to, double* p95_ms) {
+    auto* c = static_cast<faiss_go_ext::SearchController*>(ctrl);
+    if (!c || !call || !time_ms || !from || !to || !p95_ms) return -1;
+    std::lock_guard<std::mutex> lock(c->mutex);
+    if (i >= c->events.size()) return -1;
+    const faiss_go_ext::SearchController::Event& e = c->events[i];
+    *call = e.call;
+    *time_ms = e.time_ms;
+    *from = e.from;
+    *to = e.to;
+    *p95_ms = e.p95_ms;
+    return 0;
+}
+
+void faiss_SearchController_free(FaissSearchController ctrl) {
+    delete static_cast<faiss_go_ext::SearchController*>(ctrl);
+}
+
+// ============================================================
+// Compiled Factory Extensions
+// ============================================================
+
+int faiss_CompiledFactory_new(FaissCompiledFactory* p_factory, int d, const char* description, int metric_type) {
+    try {
+        if (!p_factory || !description || d <= 0) return -1;
+        *p_factory = new faiss_go_ext::CompiledFactory(d, description, static_cast<faiss::MetricType>(metric_type));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_CompiledFactory_from_index(FaissCompiledFactory* p_factory, FaissIndex index) {
+    try {
+        if (!p_factory || !index) return -1;
+        *p_factory = new faiss_go_ext::CompiledFactory(static_cast<faiss::Index*>(index));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_CompiledFactory_instantiate(FaissCompiledFactory factory, FaissIndex* p_index) {
+    try {
+        auto* f = static_cast<faiss_go_ext::CompiledFactory*>(factory);
+        if (!f || !p_index) return -1;
+        *p_index = f->instantiate();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_CompiledFactory_free(FaissCompiledFactory factory) {
+    delete static_cast<faiss_go_ext::CompiledFactory*>(factory);
+}
+
+int faiss_reverse_index_factory_ext(FaissIndex index, char* description, size_t size, size_t* length) {
+    try {
+        if (!index) return -1;
+        std::string desc = faiss_go_ext::reverse_index_factory_ext(static_cast<faiss::Index*>(index));
+        if (desc.empty()) return -1;
+        if (description && size > 0) {
+            copy_string(desc, description, size);
+        }
+        if (length) {
+            *length = desc.size();
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_describe_ext(FaissIndex index, FaissIndexNode* nodes, size_t max_nodes, size_t* n_nodes) {
+    try {
+        if (!index || !n_nodes || (max_nodes > 0 && !nodes)) return -1;
+        std::vector<faiss_go_ext::IndexNode> tree = faiss_go_ext::describe_index(static_cast<faiss::Index*>(index));
+        for (size_t i = 0; i < tree.size() && i < max_nodes; i++) {
+            const faiss_go_ext::IndexNode& src = tree[i];
+            FaissIndexNode& dst = nodes[i];
+            dst.parent = src.parent;
+            copy_string(src.role, dst.role, sizeof(dst.role));
+            copy_string(src.type, dst.type, sizeof(dst.type));
+            dst.d = src.d;
+            dst.ntotal = src.ntotal;
+            dst.code_size = src.code_size;
+            dst.metric_type = src.metric;
+            dst.is_trained = src.is_trained;
+            dst.owned = src.owned;
+            dst.nlist = src.nlist;
+            dst.M = src.M;
+            dst.nbits = src.nbits;
+            copy_string(src.qtype, dst.qtype, sizeof(dst.qtype));
+        }
+        *n_nodes = tree.size();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Snapshot Index Extensions
+// ============================================================
+
+int faiss_SnapshotIndex_new(FaissSnapshotIndex* p_snap, FaissIndex index) {
+    try {
+        if (!p_snap || !index) return -1;
+        *p_snap = new faiss_go_ext::SnapshotIndex(static_cast<faiss::Index*>(index));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SnapshotIndex_add(FaissSnapshotIndex snap, int64_t n, const float* x) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+        if (!s || n < 0 || (n > 0 && !x)) return -1;
+        s->add(n, x);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SnapshotIndex_add_with_ids(FaissSnapshotIndex snap, int64_t n, const float* x, const int64_t* ids) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+        if (!s || n < 0 || (n > 0 && (!x || !ids))) return -1;
+        s->add_with_ids(n, x, ids);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SnapshotIndex_search(FaissSnapshotIndex snap, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+        if (!s || n < 0 || k <= 0 || !x || !distances || !labels) return -1;
+        s->snapshot()->search(n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SnapshotIndex_acquire(FaissSnapshotIndex snap, FaissIndex* p_index, uint64_t* version) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+        if (!s || !p_index) return -1;
+        std::shared_ptr<const faiss_go_ext::IndexSnapshot> current = s->snapshot();
+        // a copy shares the inner index and the segments
+        *p_index = new faiss_go_ext::IndexSnapshot(*current);
+        if (version) {
+            *version = current->version;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SnapshotIndex_ntotal(FaissSnapshotIndex snap, int64_t* ntotal) {
+    auto* s = static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+    if (!s || !ntotal) return -1;
+    *ntotal = s->ntotal();
+    return 0;
+}
+
+void faiss_SnapshotIndex_free(FaissSnapshotIndex snap) {
+    delete static_cast<faiss_go_ext::SnapshotIndex*>(snap);
+}
+
+// ============================================================
+// Segmented Index Extensions
+// ============================================================
+
+int faiss_SegmentedIndex_new(FaissSegmentedIndex* p_index, FaissIndex write_template, FaissIndex segment_template, int64_t write_capacity, size_t max_segments, size_t merge_factor, double purge_fraction, int background) {
+    try {
+        if (!p_index || !write_template || !segment_template) return -1;
+        faiss_go_ext::SegmentedIndexOptions options;
+        options.write_capacity = write_capacity;
+        options.max_segments = max_segments;
+        options.merge_factor = merge_factor;
+        options.purge_fraction = purge_fraction;
+        options.background = background != 0;
+        *p_index = new faiss_go_ext::SegmentedIndex(
+                static_cast<faiss::Index*>(write_template), static_cast<faiss::Index*>(segment_template), options);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SegmentedIndex_add_with_ids(FaissSegmentedIndex index, int64_t n, const float* x, const int64_t* ids) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+        if (!s || n < 0 || (n > 0 && (!x || !ids))) return -1;
+        s->add_with_ids(n, x, ids);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SegmentedIndex_remove(FaissSegmentedIndex index, int64_t n, const int64_t* ids, size_t* n_removed) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+        if (!s || n < 0 || (n > 0 && !ids)) return -1;
+        size_t removed = s->remove(n, ids);
+        if (n_removed) {
+            *n_removed = removed;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SegmentedIndex_search(FaissSegmentedIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+        if (!s || n < 0 || k <= 0 || !x || !distances || !labels) return -1;
+        s->search(n, x, k, distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SegmentedIndex_set_search_params(FaissSegmentedIndex index, int nprobe, int efSearch) {
+    auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+    if (!s || nprobe < 0 || efSearch < 0) return -1;
+    s->nprobe = nprobe;
+    s->efSearch = efSearch;
+    return 0;
+}
+
+int faiss_SegmentedIndex_flush(FaissSegmentedIndex index) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+        if (!s) return -1;
+        s->flush();
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_SegmentedIndex_ntotal(FaissSegmentedIndex index, int64_t* ntotal) {
+    auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+    if (!s || !ntotal) return -1;
+    *ntotal = s->ntotal();
+    return 0;
+}
+
+int faiss_SegmentedIndex_segments(FaissSegmentedIndex index, FaissSegmentInfo* infos, size_t max_infos, size_t* n_segments) {
+    try {
+        auto* s = static_cast<faiss_go_ext::SegmentedIndex*>(index);
+        if (!s || !n_segments || (max_infos > 0 && !infos)) return -1;
+        std::vector<faiss_go_ext::SegmentInfo> segs = s->segments();
+        *n_segments = segs.size();
+        for (size_t i = 0; i < segs.size() && i < max_infos; i++) {
+            infos[i].number = segs[i].number;
+            infos[i].state = segs[i].state;
+            infos[i].ntotal = segs[i].ntotal;
+            infos[i].n_deleted = segs[i].n_deleted;
+        }
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_SegmentedIndex_free(FaissSegmentedIndex index) {
+    delete static_cast<faiss_go_ext::SegmentedIndex*>(index);
+}
+
+// ============================================================
+// Parallel Clone Extensions
+// ============================================================
+
+int faiss_clone_index_parallel(FaissIndex index, FaissIndex* p_out, int n_threads) {
+    try {
+        if (!index || !p_out) return -1;
+        *p_out = faiss_go_ext::clone_index_parallel(static_cast<faiss::Index*>(index), n_threads);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_clone_index_shallow(FaissIndex index, FaissIndex* p_out) {
+    try {
+        if (!index || !p_out) return -1;
+        *p_out = faiss_go_ext::clone_index_shallow(static_cast<faiss::Index*>(index));
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_merge_into_parallel(FaissIndex dst, const FaissIndex* srcs, size_t n, int shift_ids, int n_threads) {
+    try {
+        if (!dst || (n > 0 && !srcs)) return -1;
+        std::vector<faiss::Index*> indexes(n);
+        for (size_t i = 0; i < n; i++) {
+            indexes[i] = static_cast<faiss::Index*>(srcs[i]);
+        }
+        faiss_go_ext::merge_into_parallel(
+                static_cast<faiss::Index*>(dst), indexes.data(), n, shift_ids != 0, n_threads);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+// ============================================================
+// Approximate Top-k Extensions
+// ============================================================
+
+int faiss_SearchParametersApproxTopK_new(FaissSearchParameters* p_params, int approx_topk_mode, int64_t nprobe, int64_t segment_size) {
+    try {
+        if (!p_params || approx_topk_mode < 0 || approx_topk_mode >= FAISS_GO_EXT_APPROX_TOPK_MODES ||
+            nprobe < 0 || segment_size < 0 || segment_size > INT32_MAX) return -1;
+        auto* params = new faiss_go_ext::SearchParametersApproxTopK();
+        params->approx_topk_mode = static_cast<ApproxTopK_mode_t>(approx_topk_mode);
+        params->nprobe = nprobe;
+        params->segment_size = segment_size;
+        *p_params = params;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+void faiss_SearchParametersApproxTopK_free(FaissSearchParameters params) {
+    delete static_cast<faiss_go_ext::SearchParametersApproxTopK*>(params);
+}
+
+int faiss_Index_approx_topk_supported_ext(FaissIndex index, int* supported) {
+    try {
+        if (!index || !supported) return -1;
+        *supported = faiss_go_ext::approx_topk_supported(static_cast<faiss::Index*>(index)) ? 1 : 0;
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
+int faiss_Index_search_approx_topk_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels) {
+    try {
+        auto* idx = static_cast<faiss::Index*>(index);
+        if (!idx || n < 0 || k <= 0 || (n > 0 && (!x || !distances || !labels))) return -1;
+        faiss_go_ext::search_approx_topk(
+                idx, n, x, k, static_cast<const faiss::SearchParameters*>(params), distances, labels);
+        return 0;
+    } catch (...) {
+        return -1;
+    }
+}
+
 } // extern "C"
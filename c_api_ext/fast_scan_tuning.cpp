@@ -0,0 +1,266 @@
+/**
+ * FAISS Go Extensions - fast-scan (4-bit PQ) search tuning
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "fast_scan_tuning.h"
+
+#include <faiss/IndexFastScan.h>
+#include <faiss/IndexIVFFastScan.h>
+#include <faiss/IndexIVFRaBitQFastScan.h>
+#include <faiss/IndexRaBitQFastScan.h>
+#include <faiss/clone_index.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <chrono>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// implem and query blocking fields of either fast-scan family. The flat
+/// indexes block queries by qbs, the IVF ones by qbs2.
+struct FastScanFields {
+    int* implem;
+    int* qbs = nullptr;
+    size_t* qbs2 = nullptr;
+    int bbs;
+
+    bool ivf() const {
+        return qbs2 != nullptr;
+    }
+
+    FastScanParams get() const {
+        FastScanParams params;
+        params.implem = *implem;
+        params.qbs = ivf() ? (int)*qbs2 : *qbs;
+        return params;
+    }
+
+    void set(const FastScanParams& params) const {
+        *implem = params.implem;
+        if (ivf()) {
+            *qbs2 = params.qbs;
+        } else {
+            *qbs = params.qbs;
+        }
+    }
+};
+
+FastScanFields fast_scan_fields(const faiss::Index* index) {
+    auto* idx = const_cast<faiss::Index*>(index);
+    FastScanFields f;
+    if (auto* fs = dynamic_cast<faiss::IndexFastScan*>(idx)) {
+        f.implem = &fs->implem;
+        f.qbs = &fs->qbs;
+        f.bbs = fs->bbs;
+        return f;
+    }
+    if (auto* ivf = dynamic_cast<faiss::IndexIVFFastScan*>(idx)) {
+        f.implem = &ivf->implem;
+        f.qbs2 = &ivf->qbs2;
+        f.bbs = ivf->bbs;
+        return f;
+    }
+    FAISS_THROW_MSG("not a fast-scan index");
+}
+
+/// Whether a combination can run. Some invalid ones fail inside the
+/// parallel sections of FAISS, where an exception aborts the process, so
+/// they must be rejected before searching.
+bool combination_valid(const FastScanFields& f, const FastScanParams& params) {
+    int implem = params.implem % 100; // +100 forces single-thread
+    if (implem == 0) {
+        // auto picks 12 (IVF: 10) unless bbs != 32, then 14 (IVF: 10)
+        implem = f.bbs == 32 ? 12 : f.ivf() ? 10 : 14;
+    }
+    if (params.qbs < 0) {
+        return false;
+    }
+    if (f.ivf()) {
+        if (implem == 10 || implem == 11) {
+            return true;
+        }
+        return implem >= 12 && implem <= 15 && f.bbs == 32;
+    }
+    if (implem == 12 || implem == 13) {
+        // base-16 digits, each a block of 1 to 4 queries
+        for (int qbs = params.qbs; qbs; qbs >>= 4) {
+            if ((qbs & 15) < 1 || (qbs & 15) > 4) {
+                return false;
+            }
+        }
+        return f.bbs == 32;
+    }
+    if (implem == 14 || implem == 15) {
+        // plain block size here; the kernels exist for nq * bbs <= 128
+        // queries x vectors, and bbs up to 160 for a single query
+        int nq = params.qbs == 0 ? 4 : params.qbs;
+        return nq == 1 ? f.bbs <= 160 : nq * f.bbs <= 128;
+    }
+    return false;
+}
+
+double time_search_ms(
+        faiss::Index* index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        int nrep,
+        float* distances,
+        idx_t* labels) {
+    double best = -1;
+    for (int rep = 0; rep < nrep; rep++) {
+        auto t0 = std::chrono::steady_clock::now();
+        index->search(n, x, k, distances, labels);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        if (best < 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+std::unique_ptr<faiss::Index> fast_scan_search_copy(const faiss::Index* index) {
+    if (auto* ivf = dynamic_cast<const faiss::IndexIVFFastScan*>(index)) {
+        // the copy constructors copy the quantizer and inverted list
+        // pointers, not what they point to
+        faiss::IndexIVF* copy;
+        if (auto* rq = dynamic_cast<const faiss::IndexIVFRaBitQFastScan*>(ivf)) {
+            copy = new faiss::IndexIVFRaBitQFastScan(*rq);
+        } else {
+            copy = faiss::Cloner().clone_IndexIVF(ivf);
+        }
+        FAISS_THROW_IF_NOT_MSG(copy, "fast-scan IVF type not supported");
+        copy->own_fields = false;
+        copy->own_invlists = false;
+        return std::unique_ptr<faiss::Index>(copy);
+    }
+    if (auto* rq = dynamic_cast<const faiss::IndexRaBitQFastScan*>(index)) {
+        return std::unique_ptr<faiss::Index>(new faiss::IndexRaBitQFastScan(*rq));
+    }
+    FAISS_THROW_IF_NOT_MSG(is_fast_scan(index), "not a fast-scan index");
+    return std::unique_ptr<faiss::Index>(faiss::clone_index(index));
+}
+
+bool is_fast_scan(const faiss::Index* index) {
+    return dynamic_cast<const faiss::IndexFastScan*>(index) ||
+            dynamic_cast<const faiss::IndexIVFFastScan*>(index);
+}
+
+FastScanParams get_fast_scan_params(const faiss::Index* index, int* bbs) {
+    FastScanFields f = fast_scan_fields(index);
+    if (bbs) {
+        *bbs = f.bbs;
+    }
+    return f.get();
+}
+
+void set_fast_scan_params(faiss::Index* index, const FastScanParams& params) {
+    FastScanFields f = fast_scan_fields(index);
+    FAISS_THROW_IF_NOT_MSG(combination_valid(f, params), "invalid implem / qbs for this index");
+    f.set(params);
+}
+
+void search_fast_scan_with(
+        faiss::Index* index,
+        const FastScanParams& params,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* search_params) {
+    FAISS_THROW_IF_NOT_MSG(
+            combination_valid(fast_scan_fields(index), params), "invalid implem / qbs for this index");
+    std::unique_ptr<faiss::Index> copy = fast_scan_search_copy(index);
+    fast_scan_fields(copy.get()).set(params);
+    copy->search(n, x, k, distances, labels, search_params);
+}
+
+FastScanTuneResult autotune_fast_scan(
+        faiss::Index* index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        int nrep,
+        bool apply) {
+    FastScanFields f = fast_scan_fields(index);
+    FAISS_THROW_IF_NOT(n > 0 && k > 0 && nrep > 0);
+
+    // 10/11 (IVF only) and 14/15 do not use the block size, odd values
+    // collect results in a reservoir instead of a heap.
+    std::vector<FastScanParams> candidates;
+    auto add = [&](int implem, std::initializer_list<int> qbs_values) {
+        for (int qbs : qbs_values) {
+            FastScanParams params;
+            params.implem = implem;
+            params.qbs = qbs;
+            if (combination_valid(f, params)) {
+                candidates.push_back(params);
+            }
+        }
+    };
+    if (f.ivf()) {
+        add(10, {0});
+        add(11, {0});
+        for (int implem : {12, 13, 14, 15}) {
+            add(implem, {0, 4, 8, 16, 32, 64});
+        }
+    } else {
+        for (int implem : {12, 13}) {
+            add(implem, {0, 0x1, 0x2, 0x3, 0x4, 0x33, 0x333, 0x3333, 0x4444});
+        }
+        for (int implem : {14, 15}) {
+            add(implem, {0, 1, 2, 3, 4});
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!candidates.empty(), "no valid fast-scan implementation");
+
+    std::vector<float> distances(n * k);
+    std::vector<idx_t> labels(n * k);
+    FastScanTuneResult result;
+
+    std::unique_ptr<faiss::Index> copy = fast_scan_search_copy(index);
+    FastScanFields copy_fields = fast_scan_fields(copy.get());
+
+    auto measure = [&](const FastScanParams& params) {
+        copy_fields.set(params);
+        double ms = time_search_ms(copy.get(), n, x, k, nrep, distances.data(), labels.data());
+        result.n_tried++;
+        return ms;
+    };
+
+    // baseline: the settings currently on the index
+    FastScanParams current = f.get();
+    result.best = current;
+    result.default_ms = combination_valid(f, current) ? measure(current) : -1;
+    result.best_ms = result.default_ms;
+
+    for (const FastScanParams& params : candidates) {
+        double ms;
+        try {
+            ms = measure(params);
+        } catch (const faiss::FaissException&) {
+            // combination not supported by this index
+            continue;
+        }
+        if (result.best_ms < 0 || ms < result.best_ms) {
+            result.best_ms = ms;
+            result.best = params;
+        }
+    }
+
+    if (apply) {
+        f.set(result.best);
+    }
+    return result;
+}
+
+} // namespace faiss_go_ext
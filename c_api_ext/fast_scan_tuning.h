@@ -0,0 +1,89 @@
+/**
+ * FAISS Go Extensions - fast-scan (4-bit PQ) search tuning
+ *
+ * IndexFastScan and IndexIVFFastScan read their search implementation
+ * (implem) and query block size (qbs) from the index itself. The helpers
+ * here give uniform access to both families, run a search with other
+ * values on a per-call copy of the index and sweep them to find the
+ * fastest combination for a batch size and k. The IVF copies share the
+ * quantizer and inverted lists of the index; the flat ones copy their
+ * codes, about the cost of one more pass of the scan.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_FAST_SCAN_TUNING_H
+#define FAISS_GO_EXT_FAST_SCAN_TUNING_H
+
+#include <faiss/Index.h>
+
+#include <memory>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Search-time knobs of a fast-scan index. qbs maps to
+/// IndexFastScan::qbs (base-16 block sizes for implem 12/13, a plain
+/// block size for 14/15) or to IndexIVFFastScan::qbs2 (queries grouped
+/// per block for implem 12-15).
+struct FastScanParams {
+    int implem = 0; ///< 0 = auto, see IndexFastScan.h / IndexIVFFastScan.h
+    int qbs = 0;    ///< query blocking, 0 = default
+};
+
+/// Result of a tuning sweep.
+struct FastScanTuneResult {
+    FastScanParams best;
+    double best_ms = 0;    ///< best wall time of one search call
+    double default_ms = 0; ///< with the settings found on the index, -1 if invalid
+    int n_tried = 0;       ///< number of combinations measured
+};
+
+/// Copy of a fast-scan index (IndexFastScan or IndexIVFFastScan
+/// subclass) whose search fields can be changed for one call. IVF copies
+/// read the quantizer and inverted lists of index without owning them, so
+/// index must outlive the copy and not be modified while it is searched.
+/// Throws for other indexes.
+std::unique_ptr<faiss::Index> fast_scan_search_copy(const faiss::Index* index);
+
+/// True for IndexFastScan and IndexIVFFastScan subclasses.
+bool is_fast_scan(const faiss::Index* index);
+
+/// Read implem / qbs / bbs. Throws if the index is not fast-scan.
+FastScanParams get_fast_scan_params(const faiss::Index* index, int* bbs = nullptr);
+
+/// Set implem / qbs on the index. Throws for combinations the index
+/// cannot run (e.g. implem 12 with bbs != 32). As with the FAISS fields,
+/// the index must not be searched during the call.
+void set_fast_scan_params(faiss::Index* index, const FastScanParams& params);
+
+/// Search with implem / qbs overridden for this call only, on a
+/// fast_scan_search_copy. The index is not modified, so the call can run
+/// concurrently with other searches of it.
+void search_fast_scan_with(
+        faiss::Index* index,
+        const FastScanParams& params,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* search_params = nullptr);
+
+/// Time every valid implem (and qbs, for the implementations that use
+/// it) on the n queries x, keeping the fastest of nrep runs each, on one
+/// fast_scan_search_copy. With apply, the winner is stored on the index,
+/// as set_fast_scan_params does.
+FastScanTuneResult autotune_fast_scan(
+        faiss::Index* index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        int nrep,
+        bool apply);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_FAST_SCAN_TUNING_H */
@@ -0,0 +1,693 @@
+/**
+ * FAISS Go Extensions - exhaustive flat search
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "flat_search.h"
+
+#include "approx_topk.h"
+
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/impl/ResultHandler.h>
+#include <faiss/utils/Heap.h>
+#include <faiss/utils/distances.h>
+#include <faiss/utils/random.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <vector>
+
+#ifndef FINTEGER
+#define FINTEGER long
+#endif
+
+extern "C" {
+
+/* declare BLAS functions, see http://www.netlib.org/clapack/cblas/ */
+
+int sgemm_(
+        const char* transa,
+        const char* transb,
+        FINTEGER* m,
+        FINTEGER* n,
+        FINTEGER* k,
+        const float* alpha,
+        const float* a,
+        FINTEGER* lda,
+        const float* b,
+        FINTEGER* ldb,
+        float* beta,
+        float* c,
+        FINTEGER* ldc);
+}
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// row-major float storage that the raw kernels can read
+bool flat_float_storage(const faiss::IndexFlat& index) {
+    // Panorama stores the vectors level-major
+    if (dynamic_cast<const faiss::IndexFlatPanorama*>(&index)) {
+        return false;
+    }
+    return (index.metric_type == faiss::METRIC_L2 ||
+            index.metric_type == faiss::METRIC_INNER_PRODUCT) &&
+            index.code_size == index.d * sizeof(float);
+}
+
+const float* cached_norms(const faiss::IndexFlat& index) {
+    auto* l2 = dynamic_cast<const faiss::IndexFlatL2*>(&index);
+    if (l2 && l2->cached_l2norms.size() == (size_t)index.ntotal) {
+        return l2->cached_l2norms.data();
+    }
+    return nullptr;
+}
+
+/// automatic database tile: about half of a typical per-core L2 cache
+constexpr size_t kTileBytes = 256 * 1024;
+
+/// automatic number of queries per task
+constexpr size_t kQueryBlock = 64;
+
+KnnTileArgs tile_args(
+        const float* x,
+        size_t nx,
+        const float* xb,
+        const float* y_norms,
+        size_t d,
+        size_t j0,
+        size_t ny,
+        size_t k,
+        float* heap_dis,
+        idx_t* heap_ids) {
+    KnnTileArgs args;
+    args.x = x;
+    args.y = xb + j0 * d;
+    args.y_norms = y_norms ? y_norms + j0 : nullptr;
+    args.d = d;
+    args.nx = nx;
+    args.ny = ny;
+    args.y0 = j0;
+    args.k = k;
+    args.heap_dis = heap_dis;
+    args.heap_ids = heap_ids;
+    return args;
+}
+
+template <class C>
+void search_flat_fused_impl(
+        const faiss::IndexFlat& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const FusedKnnParams& params,
+        float* distances,
+        idx_t* labels) {
+    const bool ip = index.metric_type == faiss::METRIC_INNER_PRODUCT;
+    const size_t d = index.d;
+    const size_t ntotal = index.ntotal;
+    const float* xb = index.get_xb();
+    const DistanceKernels& dk = kernels().distances;
+    void (*knn_tile)(const KnnTileArgs*) = ip ? dk.knn_tile_IP : dk.knn_tile_L2;
+
+    std::vector<float> norms;
+    const float* y_norms = nullptr;
+    if (!ip) {
+        y_norms = cached_norms(index);
+        if (!y_norms) {
+            norms.resize(ntotal);
+            faiss::fvec_norms_L2sqr(norms.data(), xb, d, ntotal);
+            y_norms = norms.data();
+        }
+    }
+
+    const size_t db_bs = params.db_bs
+            ? params.db_bs
+            : std::clamp<size_t>(kTileBytes / (d * sizeof(float)), 64, 8192);
+    const size_t query_bs = params.query_bs ? params.query_bs : kQueryBlock;
+    const size_t nqb = (n + query_bs - 1) / query_bs;
+
+    for (idx_t i = 0; i < n; i++) {
+        faiss::heap_heapify<C>(k, distances + i * k, labels + i * k);
+    }
+
+    if (nqb >= (size_t)omp_get_max_threads() || ntotal <= db_bs) {
+#pragma omp parallel for schedule(dynamic) if (nqb > 1)
+        for (size_t qb = 0; qb < nqb; qb++) {
+            size_t i0 = qb * query_bs;
+            size_t nx = std::min(query_bs, (size_t)n - i0);
+            for (size_t j0 = 0; j0 < ntotal; j0 += db_bs) {
+                KnnTileArgs args = tile_args(
+                        x + i0 * d, nx, xb, y_norms, d, j0, std::min(db_bs, ntotal - j0),
+                        k, distances + i0 * k, labels + i0 * k);
+                knn_tile(&args);
+            }
+        }
+    } else {
+        // few queries: split the database, each thread fills private heaps
+#pragma omp parallel
+        {
+            std::vector<float> heap_dis(n * k);
+            std::vector<idx_t> heap_ids(n * k);
+            for (idx_t i = 0; i < n; i++) {
+                faiss::heap_heapify<C>(k, heap_dis.data() + i * k, heap_ids.data() + i * k);
+            }
+
+#pragma omp for schedule(dynamic)
+            for (size_t j0 = 0; j0 < ntotal; j0 += db_bs) {
+                for (size_t i0 = 0; i0 < (size_t)n; i0 += query_bs) {
+                    KnnTileArgs args = tile_args(
+                            x + i0 * d, std::min(query_bs, (size_t)n - i0), xb, y_norms, d, j0,
+                            std::min(db_bs, ntotal - j0), k, heap_dis.data() + i0 * k,
+                            heap_ids.data() + i0 * k);
+                    knn_tile(&args);
+                }
+            }
+
+#pragma omp critical
+            for (idx_t i = 0; i < n; i++) {
+                faiss::heap_addn<C>(
+                        k, distances + i * k, labels + i * k, heap_dis.data() + i * k,
+                        heap_ids.data() + i * k, k);
+            }
+        }
+    }
+
+#pragma omp parallel for if (n > 1)
+    for (idx_t i = 0; i < n; i++) {
+        float* D = distances + i * k;
+        idx_t* I = labels + i * k;
+        faiss::heap_reorder<C>(k, D, I);
+        if (!ip) {
+            float x_norm = faiss::fvec_norm_L2sqr(x + i * d, d);
+            for (idx_t j = 0; j < k && I[j] >= 0; j++) {
+                D[j] = std::max(D[j] + x_norm, 0.0f);
+            }
+        }
+    }
+}
+
+/* exhaustive search with explicit BLAS parameters */
+
+/// distances are computed in blocks of this size by the SIMD scan
+constexpr size_t kScanBlock = 256;
+
+/// one query at a time with the dispatched distance kernels, as
+/// exhaustive_L2sqr_seq / exhaustive_inner_product_seq
+template <class ResultHandler>
+void exhaustive_seq(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        bool ip,
+        ResultHandler& res) {
+    using SingleResultHandler = typename ResultHandler::SingleResultHandler;
+    const DistanceKernels& dk = kernels().distances;
+
+#pragma omp parallel if (nx > 1)
+    {
+        SingleResultHandler resi(res);
+        float dis[kScanBlock];
+
+#pragma omp for
+        for (int64_t i = 0; i < (int64_t)nx; i++) {
+            const float* xi = x + i * d;
+            resi.begin(i);
+            for (size_t j0 = 0; j0 < ny; j0 += kScanBlock) {
+                size_t nb = std::min(kScanBlock, ny - j0);
+                if (ip) {
+                    dk.inner_products_ny(dis, xi, y + j0 * d, d, nb);
+                } else {
+                    dk.L2sqr_ny(dis, xi, y + j0 * d, d, nb);
+                }
+                for (size_t j = 0; j < nb; j++) {
+                    if (res.is_in_selection(j0 + j)) {
+                        resi.add_result(dis[j], j0 + j);
+                    }
+                }
+            }
+            resi.end();
+        }
+    }
+}
+
+/// BLAS tiles of query_bs x database_bs distances, as
+/// exhaustive_L2sqr_blas / exhaustive_inner_product_blas
+template <class C, class ResultHandler>
+void exhaustive_blas(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        bool ip,
+        const float* y_norms,
+        size_t bs_x,
+        size_t bs_y,
+        ResultHandler& res) {
+    // BLAS does not like empty matrices
+    if (nx == 0 || ny == 0) {
+        return;
+    }
+    std::unique_ptr<float[]> ip_block(new float[bs_x * bs_y]);
+    std::vector<float> x_norms, norms;
+    if (!ip) {
+        x_norms.resize(nx);
+        faiss::fvec_norms_L2sqr(x_norms.data(), x, d, nx);
+        if (!y_norms) {
+            norms.resize(ny);
+            faiss::fvec_norms_L2sqr(norms.data(), y, d, ny);
+            y_norms = norms.data();
+        }
+    }
+
+    for (size_t i0 = 0; i0 < nx; i0 += bs_x) {
+        size_t i1 = std::min(i0 + bs_x, nx);
+        res.begin_multiple(i0, i1);
+
+        for (size_t j0 = 0; j0 < ny; j0 += bs_y) {
+            size_t j1 = std::min(j0 + bs_y, ny);
+            {
+                float one = 1, zero = 0;
+                FINTEGER nyi = j1 - j0, nxi = i1 - i0, di = d;
+                sgemm_("Transpose", "Not transpose", &nyi, &nxi, &di, &one, y + j0 * d, &di,
+                       x + i0 * d, &di, &zero, ip_block.get(), &nyi);
+            }
+            for (size_t i = i0; i < i1; i++) {
+                float* line = ip_block.get() + (i - i0) * (j1 - j0);
+                for (size_t j = j0; j < j1; j++, line++) {
+                    if (!res.is_in_selection(j)) {
+                        *line = C::neutral();
+                    } else if (!ip) {
+                        // negative values can occur for identical vectors
+                        *line = std::max(x_norms[i] + y_norms[j] - 2 * *line, 0.0f);
+                    }
+                }
+            }
+            res.add_results(j0, j1, ip_block.get());
+        }
+        res.end_multiple();
+        faiss::InterruptCallback::check();
+    }
+}
+
+template <class C, class ResultHandler>
+void exhaustive_search(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        const float* y_norms,
+        const BlasParams& params,
+        ResultHandler& res) {
+    // CMin heaps keep the largest inner products
+    const bool ip = !C::is_max;
+    if ((int64_t)nx < params.blas_threshold) {
+        exhaustive_seq(x, nx, y, ny, d, ip, res);
+    } else {
+        exhaustive_blas<C>(
+                x, nx, y, ny, d, ip, y_norms, params.query_bs, params.database_bs, res);
+    }
+}
+
+template <class C, bool use_sel>
+void knn_dispatch(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        const float* y_norms,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels) {
+    if (k == 1) {
+        faiss::Top1BlockResultHandler<C, use_sel> res(nx, distances, labels, sel);
+        exhaustive_search<C>(x, nx, y, ny, d, y_norms, params, res);
+    } else if (k < params.min_k_reservoir) {
+        faiss::HeapBlockResultHandler<C, use_sel> res(nx, distances, labels, k, sel);
+        exhaustive_search<C>(x, nx, y, ny, d, y_norms, params, res);
+    } else {
+        faiss::ReservoirBlockResultHandler<C, use_sel> res(nx, distances, labels, k, sel);
+        exhaustive_search<C>(x, nx, y, ny, d, y_norms, params, res);
+    }
+}
+
+/// one query at a time, distance blocks fed through the buckets
+template <class C, bool use_sel>
+void exhaustive_seq_approx(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        idx_t k,
+        const ApproxTopKShape& shape,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels) {
+    const DistanceKernels& dk = kernels().distances;
+
+#pragma omp parallel if (nx > 1)
+    {
+        ApproxTopKQuery<C> q(shape, k);
+        float dis[kScanBlock];
+
+#pragma omp for
+        for (int64_t i = 0; i < (int64_t)nx; i++) {
+            const float* xi = x + i * d;
+            q.begin(distances + i * k, labels + i * k);
+            for (size_t j0 = 0; j0 < ny; j0 += kScanBlock) {
+                size_t nb = std::min(kScanBlock, ny - j0);
+                if (!C::is_max) {
+                    dk.inner_products_ny(dis, xi, y + j0 * d, d, nb);
+                } else {
+                    dk.L2sqr_ny(dis, xi, y + j0 * d, d, nb);
+                }
+                if (use_sel) {
+                    for (size_t j = 0; j < nb; j++) {
+                        if (!sel->is_member(j0 + j)) {
+                            dis[j] = C::neutral();
+                        }
+                    }
+                }
+                q.add_range(j0, nb, dis);
+            }
+            q.end();
+        }
+    }
+}
+
+template <class C, bool use_sel>
+void knn_dispatch_approx(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        const float* y_norms,
+        idx_t k,
+        const ApproxTopKShape& shape,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels) {
+    if ((int64_t)nx < params.blas_threshold) {
+        exhaustive_seq_approx<C, use_sel>(x, nx, y, ny, d, k, shape, sel, distances, labels);
+    } else {
+        ApproxTopKBlockResultHandler<C, use_sel> res(nx, distances, labels, k, shape, sel);
+        exhaustive_blas<C>(
+                x, nx, y, ny, d, !C::is_max, y_norms, params.query_bs, params.database_bs, res);
+    }
+}
+
+double time_knn_ms(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        const float* y_norms,
+        idx_t k,
+        const BlasParams& params,
+        float* distances,
+        idx_t* labels) {
+    double best = -1;
+    for (int rep = 0; rep < 2; rep++) {
+        auto t0 = std::chrono::steady_clock::now();
+        knn_exhaustive(
+                x, nx, y, ny, d, faiss::METRIC_L2, y_norms, k, params, nullptr, distances, labels);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        if (best < 0 || ms < best) {
+            best = ms;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+bool fused_knn_supported(const faiss::IndexFlat& index) {
+    return flat_float_storage(index) && index.d <= (faiss::idx_t)kMaxFusedDim;
+}
+
+void search_flat_fused(
+        const faiss::IndexFlat& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const FusedKnnParams& params,
+        float* distances,
+        idx_t* labels) {
+    FAISS_THROW_IF_NOT(k > 0);
+    FAISS_THROW_IF_NOT_MSG(fused_knn_supported(index), "unsupported index for fused search");
+    if (index.metric_type == faiss::METRIC_L2) {
+        search_flat_fused_impl<faiss::CMax<float, idx_t>>(
+                index, n, x, k, params, distances, labels);
+    } else {
+        search_flat_fused_impl<faiss::CMin<float, idx_t>>(
+                index, n, x, k, params, distances, labels);
+    }
+}
+
+BlasParams resolve_blas_params(const BlasParams& params) {
+    BlasParams p = params;
+    if (p.blas_threshold < 0) {
+        p.blas_threshold = faiss::distance_compute_blas_threshold;
+    }
+    if (p.query_bs < 0) {
+        p.query_bs = faiss::distance_compute_blas_query_bs;
+    }
+    if (p.database_bs < 0) {
+        p.database_bs = faiss::distance_compute_blas_database_bs;
+    }
+    if (p.min_k_reservoir < 0) {
+        p.min_k_reservoir = faiss::distance_compute_min_k_reservoir;
+    }
+    return p;
+}
+
+void install_blas_params(const BlasParams& params) {
+    FAISS_THROW_IF_NOT(params.query_bs != 0 && params.database_bs != 0);
+    if (params.blas_threshold >= 0) {
+        faiss::distance_compute_blas_threshold = params.blas_threshold;
+    }
+    if (params.query_bs > 0) {
+        faiss::distance_compute_blas_query_bs = params.query_bs;
+    }
+    if (params.database_bs > 0) {
+        faiss::distance_compute_blas_database_bs = params.database_bs;
+    }
+    if (params.min_k_reservoir >= 0) {
+        faiss::distance_compute_min_k_reservoir = params.min_k_reservoir;
+    }
+}
+
+void knn_exhaustive(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        faiss::MetricType metric,
+        const float* y_norms,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels) {
+    FAISS_THROW_IF_NOT(k > 0);
+    FAISS_THROW_IF_NOT(metric == faiss::METRIC_L2 || metric == faiss::METRIC_INNER_PRODUCT);
+    const BlasParams p = resolve_blas_params(params);
+    FAISS_THROW_IF_NOT(p.query_bs > 0 && p.database_bs > 0);
+
+    typedef faiss::CMax<float, idx_t> CMax;
+    typedef faiss::CMin<float, idx_t> CMin;
+    if (metric == faiss::METRIC_L2) {
+        if (sel) {
+            knn_dispatch<CMax, true>(x, nx, y, ny, d, y_norms, k, p, sel, distances, labels);
+        } else {
+            knn_dispatch<CMax, false>(x, nx, y, ny, d, y_norms, k, p, sel, distances, labels);
+        }
+    } else {
+        if (sel) {
+            knn_dispatch<CMin, true>(x, nx, y, ny, d, nullptr, k, p, sel, distances, labels);
+        } else {
+            knn_dispatch<CMin, false>(x, nx, y, ny, d, nullptr, k, p, sel, distances, labels);
+        }
+    }
+}
+
+void knn_exhaustive_approx(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        faiss::MetricType metric,
+        const float* y_norms,
+        idx_t k,
+        ApproxTopK_mode_t mode,
+        size_t segment_size,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels) {
+    FAISS_THROW_IF_NOT(k > 0);
+    FAISS_THROW_IF_NOT(metric == faiss::METRIC_L2 || metric == faiss::METRIC_INNER_PRODUCT);
+    const BlasParams p = resolve_blas_params(params);
+    FAISS_THROW_IF_NOT(p.query_bs > 0 && p.database_bs > 0);
+    const bool ip = metric == faiss::METRIC_INNER_PRODUCT;
+    const ApproxTopKShape shape = make_approx_topk_shape(mode, ip, k, ny, segment_size);
+
+    typedef faiss::CMax<float, idx_t> CMax;
+    typedef faiss::CMin<float, idx_t> CMin;
+    if (!ip) {
+        if (sel) {
+            knn_dispatch_approx<CMax, true>(x, nx, y, ny, d, y_norms, k, shape, p, sel, distances, labels);
+        } else {
+            knn_dispatch_approx<CMax, false>(x, nx, y, ny, d, y_norms, k, shape, p, sel, distances, labels);
+        }
+    } else {
+        if (sel) {
+            knn_dispatch_approx<CMin, true>(x, nx, y, ny, d, nullptr, k, shape, p, sel, distances, labels);
+        } else {
+            knn_dispatch_approx<CMin, false>(x, nx, y, ny, d, nullptr, k, shape, p, sel, distances, labels);
+        }
+    }
+}
+
+void search_flat_blas(
+        const faiss::IndexFlat& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::SearchParameters* search_params,
+        float* distances,
+        idx_t* labels) {
+    if (!flat_float_storage(index)) {
+        index.search(n, x, k, distances, labels, search_params);
+        return;
+    }
+    knn_exhaustive(
+            x, n, index.get_xb(), index.ntotal, index.d, index.metric_type, cached_norms(index), k,
+            params, search_params ? search_params->sel : nullptr, distances, labels);
+}
+
+void search_ivf_blas(
+        const faiss::IndexIVF& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::SearchParametersIVF* search_params,
+        float* distances,
+        idx_t* labels) {
+    FAISS_THROW_IF_NOT(k > 0);
+    const size_t nprobe =
+            std::min(index.nlist, search_params ? search_params->nprobe : index.nprobe);
+    FAISS_THROW_IF_NOT(nprobe > 0);
+
+    std::vector<idx_t> assign(n * nprobe);
+    std::vector<float> coarse_dis(n * nprobe);
+    auto* flat = dynamic_cast<const faiss::IndexFlat*>(index.quantizer);
+    if (flat && flat_float_storage(*flat)) {
+        search_flat_blas(
+                *flat, n, x, nprobe, params,
+                search_params ? search_params->quantizer_params : nullptr, coarse_dis.data(),
+                assign.data());
+    } else {
+        index.quantizer->search(
+                n, x, nprobe, coarse_dis.data(), assign.data(),
+                search_params ? search_params->quantizer_params : nullptr);
+    }
+    index.search_preassigned(
+            n, x, k, assign.data(), coarse_dis.data(), distances, labels, false, search_params);
+}
+
+BlasParams calibrate_blas_params(size_t d, bool install) {
+    FAISS_THROW_IF_NOT(d > 0);
+    // about 4 MB of database vectors and a batch large enough for BLAS
+    const size_t ny = std::clamp<size_t>((1 << 20) / d, 2048, 16384);
+    const size_t nx_max = 1024;
+    const idx_t k_max = 512;
+
+    std::vector<float> y(ny * d), x(nx_max * d), y_norms(ny);
+    faiss::float_rand(y.data(), y.size(), 1234);
+    faiss::float_rand(x.data(), x.size(), 4321);
+    faiss::fvec_norms_L2sqr(y_norms.data(), y.data(), d, ny);
+    std::vector<float> distances(nx_max * k_max);
+    std::vector<idx_t> labels(nx_max * k_max);
+
+    auto time_ms = [&](size_t nx, idx_t k, const BlasParams& p) {
+        return time_knn_ms(
+                x.data(), nx, y.data(), ny, d, y_norms.data(), k, p, distances.data(),
+                labels.data());
+    };
+
+    BlasParams result = resolve_blas_params(BlasParams());
+
+    // crossover: smallest batch for which the BLAS tiles beat the scan
+    BlasParams seq = result, blas = result;
+    seq.blas_threshold = INT_MAX;
+    blas.blas_threshold = 0;
+    result.blas_threshold = 128;
+    for (size_t nx = 1; nx <= 64; nx *= 2) {
+        if (time_ms(nx, 10, blas) < time_ms(nx, 10, seq)) {
+            result.blas_threshold = nx;
+            break;
+        }
+    }
+
+    // tile sizes
+    double best_ms = -1;
+    for (int query_bs : {256, 1024, 4096}) {
+        for (int database_bs : {256, 1024, 4096}) {
+            blas.query_bs = query_bs;
+            blas.database_bs = database_bs;
+            double ms = time_ms(nx_max, 10, blas);
+            if (best_ms < 0 || ms < best_ms) {
+                best_ms = ms;
+                result.query_bs = query_bs;
+                result.database_bs = database_bs;
+            }
+        }
+    }
+    blas.query_bs = result.query_bs;
+    blas.database_bs = result.database_bs;
+
+    // smallest k for which the reservoir beats the heap
+    BlasParams heap = blas, reservoir = blas;
+    heap.min_k_reservoir = INT_MAX;
+    result.min_k_reservoir = 2 * k_max;
+    for (idx_t k = 16; k <= k_max; k *= 2) {
+        reservoir.min_k_reservoir = k;
+        if (time_ms(256, k, reservoir) < time_ms(256, k, heap)) {
+            result.min_k_reservoir = k;
+            break;
+        }
+    }
+
+    if (install) {
+        install_blas_params(result);
+    }
+    return result;
+}
+
+} // namespace faiss_go_ext
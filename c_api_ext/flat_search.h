@@ -0,0 +1,143 @@
+/**
+ * FAISS Go Extensions - exhaustive flat search
+ *
+ * Above distance_compute_blas_threshold queries, IndexFlat::search computes
+ * BLAS tiles of distances into a scratch buffer and then scans them into
+ * the result heaps, which is memory-bound for large k and database sizes.
+ * The fused search accumulates register-blocked dot products with the
+ * knn_tile kernels of simd_dispatch.h and merges them straight into the
+ * per-query heaps, one cache-sized database tile at a time.
+ *
+ * The BLAS search reimplements the FAISS exhaustive search with the
+ * crossover and tile sizes passed per call instead of read from the
+ * distance_compute_* process globals, for flat indexes and the flat coarse
+ * quantizer of IVF indexes, and calibrates them on the host CPU.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_FLAT_SEARCH_H
+#define FAISS_GO_EXT_FLAT_SEARCH_H
+
+#include "simd_dispatch.h"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/utils/approx_topk/mode.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Largest dimension handled by the fused search. Beyond it a query row
+/// block no longer fits in L1 and the BLAS path wins.
+constexpr size_t kMaxFusedDim = 2048;
+
+/// Tile sizes of one fused search, 0 selects them from d.
+struct FusedKnnParams {
+    size_t query_bs = 0; ///< queries per task (heaps kept hot together)
+    size_t db_bs = 0;    ///< database vectors per tile (kept in L2 cache)
+};
+
+/// True if the fused search handles this index (row-major float storage,
+/// L2 or IP, d <= kMaxFusedDim).
+bool fused_knn_supported(const faiss::IndexFlat& index);
+
+/// k-NN search over an IndexFlat with the fused kernels. Queries are split
+/// across threads, or the database is when there are too few query blocks
+/// to keep all threads busy.
+void search_flat_fused(
+        const faiss::IndexFlat& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const FusedKnnParams& params,
+        float* distances,
+        idx_t* labels);
+
+/// Per-call counterpart of the distance_compute_* globals of
+/// faiss/utils/distances.h. Negative fields use the global value.
+struct BlasParams {
+    int blas_threshold = -1;  ///< queries from which BLAS tiles are used
+    int query_bs = -1;        ///< queries per BLAS tile
+    int database_bs = -1;     ///< database vectors per BLAS tile
+    int min_k_reservoir = -1; ///< k from which a reservoir replaces the heap
+};
+
+/// Replace the negative fields with the current global values.
+BlasParams resolve_blas_params(const BlasParams& params);
+
+/// Set the globals from the non-negative fields.
+void install_blas_params(const BlasParams& params);
+
+/// Exhaustive k-NN of the nx queries among the ny vectors of y, like
+/// faiss::knn_L2sqr / knn_inner_product but with explicit parameters.
+/// y_norms (L2 only) may be NULL.
+void knn_exhaustive(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        faiss::MetricType metric,
+        const float* y_norms,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels);
+
+/// knn_exhaustive with the result heaps fed through the buckets of an
+/// approximate top-k mode (see approx_topk.h). segment_size 0 picks the
+/// bucket segment from k and ny.
+void knn_exhaustive_approx(
+        const float* x,
+        size_t nx,
+        const float* y,
+        size_t ny,
+        size_t d,
+        faiss::MetricType metric,
+        const float* y_norms,
+        idx_t k,
+        ApproxTopK_mode_t mode,
+        size_t segment_size,
+        const BlasParams& params,
+        const faiss::IDSelector* sel,
+        float* distances,
+        idx_t* labels);
+
+/// k-NN search over an IndexFlat with explicit BLAS parameters. Only the
+/// selector of search_params is used.
+void search_flat_blas(
+        const faiss::IndexFlat& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::SearchParameters* search_params,
+        float* distances,
+        idx_t* labels);
+
+/// IndexIVF search whose coarse assignment runs with explicit BLAS
+/// parameters when the quantizer is a plain IndexFlat (other quantizers
+/// search as usual). search_params may be NULL or a SearchParametersIVF.
+void search_ivf_blas(
+        const faiss::IndexIVF& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const BlasParams& params,
+        const faiss::SearchParametersIVF* search_params,
+        float* distances,
+        idx_t* labels);
+
+/// Measure on the host CPU, for vectors of dimension d, the query count
+/// from which BLAS beats the SIMD scan, the fastest tile sizes and the k
+/// from which the reservoir beats the heap. Takes a few seconds.
+/// If install is set the result becomes the process default.
+BlasParams calibrate_blas_params(size_t d, bool install);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_FLAT_SEARCH_H */
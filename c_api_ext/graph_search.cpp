@@ -0,0 +1,360 @@
+/**
+ * FAISS Go Extensions - graph search with an adaptive visited set
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "graph_search.h"
+#include "visited_set.h"
+
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexNNDescent.h>
+#include <faiss/IndexNSG.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/utils/random.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+typedef std::pair<float, idx_t> DistId;
+
+/// below this many nodes the dense table stays in cache and is the faster
+/// one (measured crossover near 250K nodes, HNSW8 with d = 8)
+constexpr size_t kDenseAlwaysNodes = 1 << 18;
+
+/// The link arrays of the three graph indexes: rows of int32 node ids,
+/// -1 terminated when shorter than the row.
+struct GraphView {
+    const faiss::HNSW* hnsw = nullptr;
+    const int32_t* rows = nullptr; ///< NSG / NNDescent level 0
+    int row_size = 0;
+    size_t ntotal = 0;
+    int degree = 0; ///< links per node on level 0
+
+    void neighbors(idx_t node, int level, const int32_t** begin, const int32_t** end) const {
+        if (hnsw) {
+            size_t b, e;
+            hnsw->neighbor_range(node, level, &b, &e);
+            *begin = hnsw->neighbors.data() + b;
+            *end = hnsw->neighbors.data() + e;
+        } else {
+            *begin = rows + (size_t)node * row_size;
+            *end = *begin + row_size;
+        }
+    }
+};
+
+/// beam search of one thread, over the visited set type V
+template <class V>
+struct GraphSearcher {
+    const GraphView& graph;
+    faiss::DistanceComputer& dis;
+    V visited;
+    std::priority_queue<DistId, std::vector<DistId>, std::greater<DistId>> candidates;
+    std::priority_queue<DistId> top;     ///< ef closest nodes, for the stop rule
+    std::priority_queue<DistId> results; ///< k closest selected nodes
+    idx_t batch[4];
+
+    GraphSearcher(const GraphView& graph, faiss::DistanceComputer& dis, V&& visited)
+            : graph(graph), dis(dis), visited(std::move(visited)) {}
+
+    /// greedy descent on an HNSW upper level, as HNSW::greedy_update_nearest
+    void greedy(int level, idx_t& nearest, float& d_nearest) {
+        for (bool changed = true; changed;) {
+            changed = false;
+            const int32_t *begin, *end;
+            graph.neighbors(nearest, level, &begin, &end);
+            for (const int32_t* p = begin; p < end && *p >= 0; p++) {
+                float d = dis(*p);
+                if (d < d_nearest) {
+                    nearest = *p;
+                    d_nearest = d;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    void consider(idx_t v, float d, int ef, idx_t k, const faiss::IDSelector* sel) {
+        if ((int)top.size() < ef || d < top.top().first) {
+            candidates.push({d, v});
+            top.push({d, v});
+            if ((int)top.size() > ef) {
+                top.pop();
+            }
+        }
+        if (!sel || sel->is_member(v)) {
+            if ((idx_t)results.size() < k) {
+                results.push({d, v});
+            } else if (d < results.top().first) {
+                results.pop();
+                results.push({d, v});
+            }
+        }
+    }
+
+    /// level-0 search from the init nodes; the k results go to D / I,
+    /// closest first
+    void search(const std::vector<DistId>& init, int ef, idx_t k,
+                const faiss::IDSelector* sel, float* D, idx_t* I) {
+        visited.clear();
+        for (const DistId& c : init) {
+            if (visited.insert(c.second)) {
+                consider(c.second, c.first, ef, k, sel);
+            }
+        }
+        while (!candidates.empty()) {
+            DistId c = candidates.top();
+            if ((int)top.size() >= ef && c.first > top.top().first) {
+                break;
+            }
+            candidates.pop();
+            const int32_t *begin, *end;
+            graph.neighbors(c.second, 0, &begin, &end);
+            int nb = 0;
+            for (const int32_t* p = begin; p < end && *p >= 0; p++) {
+                if (!visited.insert(*p)) {
+                    continue;
+                }
+                batch[nb++] = *p;
+                if (nb == 4) {
+                    float d[4];
+                    dis.distances_batch_4(batch[0], batch[1], batch[2], batch[3], d[0], d[1], d[2], d[3]);
+                    for (int j = 0; j < 4; j++) {
+                        consider(batch[j], d[j], ef, k, sel);
+                    }
+                    nb = 0;
+                }
+            }
+            for (int j = 0; j < nb; j++) {
+                consider(batch[j], dis(batch[j]), ef, k, sel);
+            }
+        }
+        while (!candidates.empty()) {
+            candidates.pop();
+        }
+        while (!top.empty()) {
+            top.pop();
+        }
+        idx_t j = results.size();
+        for (idx_t r = j; r < k; r++) {
+            D[r] = std::numeric_limits<float>::infinity();
+            I[r] = -1;
+        }
+        while (!results.empty()) {
+            j--;
+            D[j] = results.top().first;
+            I[j] = results.top().second;
+            results.pop();
+        }
+    }
+};
+
+/// entry points of a query, and the storage, per index type
+struct GraphIndex {
+    GraphView view;
+    const faiss::Index* storage = nullptr;
+    const faiss::IndexHNSW* hnsw = nullptr;
+    int ef = 0;
+    idx_t entry_point = -1;
+    std::vector<idx_t> random_init; ///< NNDescent pool, the same for all queries
+};
+
+bool make_graph_index(const faiss::Index& index, const faiss::SearchParameters* params, GraphIndex& g) {
+    int ef = 0;
+    if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(&index)) {
+        // these search differently
+        if (dynamic_cast<const faiss::IndexHNSW2Level*>(&index) ||
+            dynamic_cast<const faiss::IndexHNSWCagra*>(&index)) {
+            return false;
+        }
+        FAISS_THROW_IF_NOT_MSG(hnsw->storage, "please use IndexHNSWFlat (or variants) instead of IndexHNSW directly");
+        g.hnsw = hnsw;
+        g.storage = hnsw->storage;
+        g.view.hnsw = &hnsw->hnsw;
+        g.view.degree = hnsw->hnsw.nb_neighbors(0);
+        g.entry_point = hnsw->hnsw.entry_point;
+        ef = hnsw->hnsw.efSearch;
+        if (auto* hp = dynamic_cast<const faiss::SearchParametersHNSW*>(params)) {
+            ef = hp->efSearch;
+        }
+    } else if (auto* nsg = dynamic_cast<const faiss::IndexNSG*>(&index)) {
+        FAISS_THROW_IF_NOT_MSG(nsg->is_built && nsg->nsg.final_graph, "the NSG graph is not built");
+        g.storage = nsg->storage;
+        g.view.rows = nsg->nsg.final_graph->data;
+        g.view.row_size = nsg->nsg.final_graph->K;
+        g.view.degree = nsg->nsg.final_graph->K;
+        g.entry_point = nsg->nsg.enterpoint;
+        ef = nsg->nsg.search_L;
+    } else if (auto* nnd = dynamic_cast<const faiss::IndexNNDescent*>(&index)) {
+        FAISS_THROW_IF_NOT_MSG(nnd->nndescent.has_built, "the NNDescent graph is not built");
+        g.storage = nnd->storage;
+        g.view.rows = nnd->nndescent.final_graph.data();
+        g.view.row_size = nnd->nndescent.K;
+        g.view.degree = nnd->nndescent.K;
+        ef = nnd->nndescent.search_L;
+    } else {
+        return false;
+    }
+    g.view.ntotal = index.ntotal;
+    if (auto* gp = dynamic_cast<const SearchParametersGraph*>(params)) {
+        if (gp->ef > 0) {
+            ef = gp->ef;
+        }
+    }
+    g.ef = ef;
+    return true;
+}
+
+template <class V>
+void search_queries(
+        const GraphIndex& g,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::IDSelector* sel,
+        const std::function<V()>& make_visited) {
+    const int ef = std::max(g.ef, (int)k);
+    std::mutex exception_mutex;
+    std::string exception_string;
+
+#pragma omp parallel if (n > 1)
+    {
+        std::unique_ptr<faiss::DistanceComputer> dis(storage_distance_computer(g.storage));
+        GraphSearcher<V> searcher(g.view, *dis, make_visited());
+        std::vector<DistId> init;
+#pragma omp for schedule(dynamic)
+        for (idx_t q = 0; q < n; q++) {
+            try {
+                dis->set_query(x + q * g.storage->d);
+                init.clear();
+                if (g.hnsw) {
+                    idx_t nearest = g.entry_point;
+                    float d_nearest = (*dis)(nearest);
+                    for (int l = g.hnsw->hnsw.max_level; l >= 1; l--) {
+                        searcher.greedy(l, nearest, d_nearest);
+                    }
+                    init.push_back({d_nearest, nearest});
+                } else if (g.entry_point >= 0) {
+                    // NSG: the entry point and its links
+                    init.push_back({(*dis)(g.entry_point), g.entry_point});
+                    const int32_t *begin, *end;
+                    g.view.neighbors(g.entry_point, 0, &begin, &end);
+                    for (const int32_t* p = begin; p < end && *p >= 0; p++) {
+                        init.push_back({(*dis)(*p), *p});
+                    }
+                } else {
+                    for (idx_t v : g.random_init) {
+                        init.push_back({(*dis)(v), v});
+                    }
+                }
+                searcher.search(init, ef, k, sel, distances + q * k, labels + q * k);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                exception_string = e.what();
+            }
+        }
+    }
+    if (!exception_string.empty()) {
+        FAISS_THROW_MSG(exception_string.c_str());
+    }
+}
+
+} // namespace
+
+faiss::DistanceComputer* storage_distance_computer(const faiss::Index* storage) {
+    if (faiss::is_similarity_metric(storage->metric_type)) {
+        return new faiss::NegativeDistanceComputer(storage->get_distance_computer());
+    }
+    return storage->get_distance_computer();
+}
+
+bool prefer_sparse_visited(size_t ntotal, int ef, int degree) {
+    if (ntotal <= kDenseAlwaysNodes) {
+        return false;
+    }
+    // a search expands about ef nodes and tests their links; past that the
+    // dense table costs a cache miss per test and a memset of ntotal / 255
+    // bytes per query, the sparse one a few hashes in a table that stays
+    // in cache
+    size_t expected = (size_t)std::max(ef, 1) * std::max(degree, 1);
+    return ntotal > 128 * expected;
+}
+
+void graph_search(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params) {
+    FAISS_THROW_IF_NOT(k > 0);
+    GraphIndex g;
+    if (!make_graph_index(index, params, g)) {
+        index.search(n, x, k, distances, labels, params);
+        return;
+    }
+    if (index.ntotal == 0 || n == 0) {
+        for (idx_t i = 0; i < n * k; i++) {
+            distances[i] = faiss::is_similarity_metric(index.metric_type)
+                    ? -std::numeric_limits<float>::infinity()
+                    : std::numeric_limits<float>::infinity();
+            labels[i] = -1;
+        }
+        return;
+    }
+    const int ef = std::max(g.ef, (int)k);
+    if (!g.hnsw && g.entry_point < 0) {
+        // NNDescent starts from ef random nodes, the same for all queries
+        faiss::RandomGenerator rng(
+                dynamic_cast<const faiss::IndexNNDescent&>(index).nndescent.random_seed);
+        for (int i = 0; i < ef; i++) {
+            g.random_init.push_back(rng.rand_int64() % index.ntotal);
+        }
+    }
+
+    VisitedMode mode = VisitedMode::Auto;
+    if (auto* gp = dynamic_cast<const SearchParametersGraph*>(params)) {
+        mode = gp->visited_mode;
+    }
+    if (mode == VisitedMode::Auto) {
+        mode = prefer_sparse_visited(g.view.ntotal, ef, g.view.degree) ? VisitedMode::Sparse
+                                                                       : VisitedMode::Dense;
+    }
+    const faiss::IDSelector* sel = params ? params->sel : nullptr;
+    if (mode == VisitedMode::Sparse) {
+        const size_t expected = (size_t)ef * g.view.degree;
+        search_queries<SparseVisitedSet>(g, n, x, k, distances, labels, sel, [expected]() {
+            return SparseVisitedSet(expected);
+        });
+    } else {
+        const size_t ntotal = g.view.ntotal;
+        search_queries<DenseVisitedSet>(g, n, x, k, distances, labels, sel, [ntotal]() {
+            return DenseVisitedSet(ntotal);
+        });
+    }
+
+    if (faiss::is_similarity_metric(index.metric_type)) {
+        for (idx_t i = 0; i < n * k; i++) {
+            distances[i] = -distances[i];
+        }
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,68 @@
+/**
+ * FAISS Go Extensions - graph search with an adaptive visited set
+ *
+ * IndexHNSW, IndexNSG and IndexNNDescent give every search thread a
+ * VisitedTable of ntotal bytes and clear it with a memset every 250
+ * queries. A search with efSearch = 64 visits a few thousand nodes, so on
+ * a graph of 100M nodes the visited table, not the distance computations,
+ * dominates the memory traffic of a query.
+ *
+ * graph_search runs the level-0 beam search of the three graph indexes
+ * (and the HNSW descent through the upper levels) over their public link
+ * arrays, with a DenseVisitedSet or a SparseVisitedSet picked from ntotal
+ * and the number of nodes a search of width ef is expected to visit, or
+ * forced by SearchParametersGraph. The walk follows the FAISS one: the
+ * same entry points, the same stop rule, and an IDSelector filters the
+ * results without pruning the walk; results can still differ from
+ * Index::search on distance ties. Other indexes fall back to
+ * Index::search.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_GRAPH_SEARCH_H
+#define FAISS_GO_EXT_GRAPH_SEARCH_H
+
+#include <faiss/Index.h>
+#include <faiss/impl/DistanceComputer.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+enum class VisitedMode {
+    Auto = 0,   ///< chosen from ntotal and ef
+    Dense = 1,  ///< one byte per node, as VisitedTable
+    Sparse = 2, ///< hash set of the visited nodes
+};
+
+struct SearchParametersGraph : faiss::SearchParameters {
+    /// beam width; 0 keeps efSearch (HNSW) or search_L (NSG, NNDescent)
+    int ef = 0;
+    VisitedMode visited_mode = VisitedMode::Auto;
+};
+
+/// true if the sparse set is the cheaper one for a search of width ef on a
+/// graph of ntotal nodes with degree links per node on level 0
+bool prefer_sparse_visited(size_t ntotal, int ef, int degree);
+
+/// Index::search for IndexHNSW, IndexNSG and IndexNNDescent through the
+/// adaptive visited set. params may be a SearchParametersGraph or a
+/// SearchParametersHNSW.
+void graph_search(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params);
+
+/// distance computer of a graph storage; similarities are negated, since
+/// the graph walks minimize
+faiss::DistanceComputer* storage_distance_computer(const faiss::Index* storage);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_GRAPH_SEARCH_H */
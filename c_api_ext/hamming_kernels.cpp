@@ -0,0 +1,62 @@
+/**
+ * FAISS Go Extensions - binary code Hamming distance kernels
+ *
+ * Counterpart of the HammingComputer loops in faiss/utils/hamming*,
+ * compiled once per SIMD level (see simd_dispatch.h). The x86 levels
+ * above generic are built with -mpopcnt, so the 64-bit popcounts below
+ * become single instructions instead of libgcc calls.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_kernels-inl.h"
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+
+namespace {
+
+inline uint64_t load_u64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline int hamming(const uint8_t* a, const uint8_t* b, size_t code_size) {
+    size_t i = 0;
+    int accu = 0;
+    for (; i + 32 <= code_size; i += 32) {
+        accu += __builtin_popcountll(load_u64(a + i) ^ load_u64(b + i)) +
+                __builtin_popcountll(load_u64(a + i + 8) ^ load_u64(b + i + 8)) +
+                __builtin_popcountll(load_u64(a + i + 16) ^ load_u64(b + i + 16)) +
+                __builtin_popcountll(load_u64(a + i + 24) ^ load_u64(b + i + 24));
+    }
+    for (; i + 8 <= code_size; i += 8) {
+        accu += __builtin_popcountll(load_u64(a + i) ^ load_u64(b + i));
+    }
+    for (; i < code_size; i++) {
+        accu += __builtin_popcount(a[i] ^ b[i]);
+    }
+    return accu;
+}
+
+void hamming_ny(
+        int32_t* distances,
+        const uint8_t* a,
+        const uint8_t* b,
+        size_t code_size,
+        size_t nb) {
+    for (size_t j = 0; j < nb; j++) {
+        distances[j] = hamming(a, b + j * code_size, code_size);
+    }
+}
+
+} // namespace
+
+void get_hamming_kernels(HammingKernels* kernels) {
+    kernels->hamming_ny = hamming_ny;
+}
+
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
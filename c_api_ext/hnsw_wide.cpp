@@ -0,0 +1,553 @@
+/**
+ * FAISS Go Extensions - HNSW with 64-bit node ids
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "hnsw_wide.h"
+#include "graph_search.h"
+#include "visited_set.h"
+
+#include <faiss/IndexFlatCodes.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/HNSW.h>
+#include <faiss/impl/mapped_io.h>
+#include <faiss/index_io.h>
+#include <faiss/utils/random.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+
+namespace faiss_go_ext {
+
+namespace {
+
+constexpr uint32_t kFormatVersion = 1;
+constexpr int kMaxLevel = 64;
+constexpr size_t kLockStripes = 4096;
+
+typedef std::pair<float, idx_t> DistId;
+
+/// per-thread state of searches and adds
+struct GraphWalker {
+    const IndexHNSWWide& index;
+    std::unique_ptr<faiss::DistanceComputer> dis;
+    SparseVisitedSet visited;
+    std::priority_queue<DistId, std::vector<DistId>, std::greater<DistId>> candidates;
+    std::priority_queue<DistId> top;
+
+    GraphWalker(const IndexHNSWWide& index, int ef)
+            : index(index),
+              dis(storage_distance_computer(index.storage)),
+              visited((size_t)ef * index.M) {}
+
+    /// greedy descent on one upper level
+    void greedy(int level, idx_t& nearest, float& d_nearest) {
+        const int m = index.max_links(level);
+        for (bool changed = true; changed;) {
+            changed = false;
+            const idx_t* row = index.links(nearest, level);
+            for (int j = 0; j < m; j++) {
+                idx_t v = row[j];
+                if (v < 0) {
+                    break;
+                }
+                float d = (*dis)(v);
+                if (d < d_nearest) {
+                    nearest = v;
+                    d_nearest = d;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    /// beam search of width ef on a level, closest first in out
+    void search_level(int level, idx_t ep, float d_ep, int ef, std::vector<DistId>& out) {
+        visited.clear();
+        visited.insert(ep);
+        candidates.push({d_ep, ep});
+        top.push({d_ep, ep});
+        const int m = index.max_links(level);
+        while (!candidates.empty()) {
+            DistId c = candidates.top();
+            if (c.first > top.top().first && (int)top.size() >= ef) {
+                break;
+            }
+            candidates.pop();
+            const idx_t* row = index.links(c.second, level);
+            for (int j = 0; j < m; j++) {
+                idx_t v = row[j];
+                if (v < 0) {
+                    break;
+                }
+                if (!visited.insert(v)) {
+                    continue;
+                }
+                float d = (*dis)(v);
+                if ((int)top.size() < ef || d < top.top().first) {
+                    candidates.push({d, v});
+                    top.push({d, v});
+                    if ((int)top.size() > ef) {
+                        top.pop();
+                    }
+                }
+            }
+        }
+        while (!candidates.empty()) {
+            candidates.pop();
+        }
+        out.resize(top.size());
+        for (size_t i = out.size(); i-- > 0;) {
+            out[i] = top.top();
+            top.pop();
+        }
+    }
+
+    /// HNSW neighbor heuristic (HNSW::shrink_neighbor_list): keep a
+    /// candidate only if it is closer to the base than to any kept one.
+    /// cands is sorted by distance to the base.
+    void select(const std::vector<DistId>& cands, int max_size, std::vector<idx_t>& out) {
+        out.clear();
+        for (const DistId& c : cands) {
+            bool good = true;
+            for (idx_t w : out) {
+                if (dis->symmetric_dis(w, c.second) < c.first) {
+                    good = false;
+                    break;
+                }
+            }
+            if (good) {
+                out.push_back(c.second);
+                if ((int)out.size() >= max_size) {
+                    return;
+                }
+            }
+        }
+    }
+};
+
+/// adds one node to a graph that already has an entry point
+struct NodeInserter : GraphWalker {
+    IndexHNSWWide& graph;
+    std::mutex* locks;
+    std::vector<float> vec;
+    std::vector<DistId> found, cands;
+    std::vector<idx_t> selected, pruned;
+
+    NodeInserter(IndexHNSWWide& graph, std::mutex* locks)
+            : GraphWalker(graph, graph.efConstruction), graph(graph), locks(locks), vec(graph.d) {}
+
+    std::mutex& lock_of(idx_t node) {
+        return locks[(uint64_t)node % kLockStripes];
+    }
+
+    void insert(idx_t node, int level, idx_t entry_point, int max_level) {
+        graph.storage->reconstruct(node, vec.data());
+        dis->set_query(vec.data());
+        idx_t nearest = entry_point;
+        float d_nearest = (*dis)(nearest);
+        for (int l = max_level; l > level; l--) {
+            greedy(l, nearest, d_nearest);
+        }
+        for (int l = std::min(level, max_level); l >= 0; l--) {
+            search_level(l, nearest, d_nearest, graph.efConstruction, found);
+            found.erase(
+                    std::remove_if(found.begin(), found.end(),
+                                   [node](const DistId& c) { return c.second == node; }),
+                    found.end());
+            if (found.empty()) {
+                continue;
+            }
+            select(found, graph.max_links(l), selected);
+            {
+                std::lock_guard<std::mutex> lock(lock_of(node));
+                idx_t* row = graph.links(node, l);
+                std::fill(row, row + graph.max_links(l), -1);
+                std::copy(selected.begin(), selected.end(), row);
+            }
+            for (idx_t v : selected) {
+                add_link(v, node, l);
+            }
+            nearest = found[0].second;
+            d_nearest = found[0].first;
+        }
+    }
+
+    /// link src -> dest, pruning the links of src if they are full
+    void add_link(idx_t src, idx_t dest, int level) {
+        std::lock_guard<std::mutex> lock(lock_of(src));
+        const int m = graph.max_links(level);
+        idx_t* row = graph.links(src, level);
+        if (row[m - 1] < 0) {
+            int j = m - 1;
+            while (j > 0 && row[j - 1] < 0) {
+                j--;
+            }
+            row[j] = dest;
+            return;
+        }
+        cands.clear();
+        for (int j = 0; j < m; j++) {
+            cands.push_back({dis->symmetric_dis(src, row[j]), row[j]});
+        }
+        cands.push_back({dis->symmetric_dis(src, dest), dest});
+        std::sort(cands.begin(), cands.end());
+        select(cands, m, pruned);
+        std::fill(row, row + m, -1);
+        std::copy(pruned.begin(), pruned.end(), row);
+    }
+};
+
+void write_array(faiss::IOWriter& f, const void* data, size_t size, size_t n) {
+    FAISS_THROW_IF_NOT_FMT(f(data, size, n) == n, "write error in %s", f.name.c_str());
+}
+
+void read_array(faiss::IOReader& f, void* data, size_t size, size_t n) {
+    FAISS_THROW_IF_NOT_FMT(f(data, size, n) == n, "read error in %s", f.name.c_str());
+}
+
+/// array of n int64, a view of the file for mmap readers
+faiss::MaybeOwnedVector<idx_t> read_int64s(faiss::IOReader& f, size_t n) {
+    if (auto* mf = dynamic_cast<faiss::MappedFileIOReader*>(&f)) {
+        void* address = nullptr;
+        size_t nread = mf->mmap(&address, sizeof(idx_t), n);
+        FAISS_THROW_IF_NOT_FMT(nread == n, "read error in %s", f.name.c_str());
+        return faiss::MaybeOwnedVector<idx_t>::create_view(address, n, mf->mmap_owner);
+    }
+    std::vector<idx_t> v(n);
+    read_array(f, v.data(), sizeof(idx_t), n);
+    return faiss::MaybeOwnedVector<idx_t>(std::move(v));
+}
+
+void write_links(faiss::IOWriter& f, const ChunkedLinks& links) {
+    uint64_t header[2] = {links.row_size, links.n_rows};
+    write_array(f, header, sizeof(uint64_t), 2);
+    for (const auto& chunk : links.chunks) {
+        write_array(f, chunk.data(), sizeof(idx_t), chunk.size());
+    }
+}
+
+void read_links(faiss::IOReader& f, ChunkedLinks& links) {
+    uint64_t header[2];
+    read_array(f, header, sizeof(uint64_t), 2);
+    links.row_size = header[0];
+    links.n_rows = header[1];
+    size_t n_chunks = (links.n_rows + ChunkedLinks::kChunkRows - 1) >> ChunkedLinks::kChunkShift;
+    links.chunks.clear();
+    for (size_t c = 0; c < n_chunks; c++) {
+        links.chunks.push_back(read_int64s(f, ChunkedLinks::kChunkRows * links.row_size));
+    }
+}
+
+} // namespace
+
+/* ============================================================
+ * ChunkedLinks
+ * ============================================================ */
+
+void ChunkedLinks::resize(size_t n) {
+    while (chunks.size() * kChunkRows < n) {
+        chunks.emplace_back(std::vector<idx_t>(kChunkRows * row_size, -1));
+    }
+    n_rows = std::max(n_rows, n);
+}
+
+void ChunkedLinks::make_writable() {
+    for (auto& chunk : chunks) {
+        if (!chunk.is_owned) {
+            chunk = faiss::MaybeOwnedVector<idx_t>(
+                    std::vector<idx_t>(chunk.data(), chunk.data() + chunk.size()));
+        }
+    }
+}
+
+size_t ChunkedLinks::memory_usage() const {
+    return chunks.size() * kChunkRows * row_size * sizeof(idx_t);
+}
+
+/* ============================================================
+ * IndexHNSWWide
+ * ============================================================ */
+
+IndexHNSWWide::IndexHNSWWide(faiss::Index* storage, int M)
+        : faiss::Index(storage->d, storage->metric_type), storage(storage), M(M) {
+    FAISS_THROW_IF_NOT_MSG(M >= 2, "M must be at least 2");
+    FAISS_THROW_IF_NOT_MSG(storage->ntotal == 0, "the storage must be empty");
+    metric_arg = storage->metric_arg;
+    is_trained = storage->is_trained;
+    level_mult = 1 / std::log((double)M);
+    links0.row_size = 2 * M;
+    links_up.row_size = M;
+}
+
+IndexHNSWWide::~IndexHNSWWide() {
+    if (own_fields) {
+        delete storage;
+    }
+}
+
+void IndexHNSWWide::train(idx_t n, const float* x) {
+    storage->train(n, x);
+    is_trained = storage->is_trained;
+}
+
+int IndexHNSWWide::level_of(idx_t node) const {
+    idx_t entry = upper.lookup(node);
+    return entry < 0 ? 0 : (int)(entry & 0xff);
+}
+
+const idx_t* IndexHNSWWide::links(idx_t node, int level) const {
+    if (level == 0) {
+        return links0.row(node);
+    }
+    return links_up.row((upper.lookup(node) >> 8) + level - 1);
+}
+
+idx_t* IndexHNSWWide::links(idx_t node, int level) {
+    if (level == 0) {
+        return links0.row(node);
+    }
+    return links_up.row((upper.lookup(node) >> 8) + level - 1);
+}
+
+void IndexHNSWWide::add(idx_t n, const float* x) {
+    FAISS_THROW_IF_NOT_MSG(storage && is_trained, "index not trained");
+    FAISS_THROW_IF_NOT(n >= 0);
+    if (n == 0) {
+        return;
+    }
+    const idx_t n0 = ntotal;
+    // a mapped flat storage is a view as well, and asserts on add
+    if (auto* flat = dynamic_cast<faiss::IndexFlatCodes*>(storage)) {
+        if (!flat->codes.is_owned) {
+            flat->codes = faiss::MaybeOwnedVector<uint8_t>(
+                    std::vector<uint8_t>(flat->codes.data(), flat->codes.data() + flat->codes.size()));
+        }
+    }
+    storage->add(n, x);
+    ntotal = storage->ntotal;
+    FAISS_THROW_IF_NOT(ntotal == n0 + n);
+
+    // all allocation happens here, the parallel part only writes links
+    links0.make_writable();
+    links_up.make_writable();
+    links0.resize(ntotal);
+    std::vector<int> levels(n);
+    faiss::RandomGenerator rng(seed + n0);
+    size_t n_up = 0;
+    for (idx_t i = 0; i < n; i++) {
+        double f = std::max(rng.rand_double(), 1e-300);
+        levels[i] = std::min(kMaxLevel, (int)(-std::log(f) * level_mult));
+        n_up += levels[i] > 0;
+    }
+    upper.reserve(upper.size + n_up);
+    for (idx_t i = 0; i < n; i++) {
+        if (levels[i] > 0) {
+            upper.insert(n0 + i, (idx_t)(links_up.n_rows << 8) | levels[i]);
+            links_up.resize(links_up.n_rows + levels[i]);
+        }
+    }
+
+    // higher levels first, as faiss::HNSW does
+    std::vector<idx_t> order(n);
+    for (idx_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](idx_t a, idx_t b) {
+        return levels[a] > levels[b];
+    });
+
+    std::unique_ptr<std::mutex[]> locks(new std::mutex[kLockStripes]);
+    size_t i = 0;
+    if (entry_point < 0) {
+        entry_point = n0 + order[0];
+        max_level = levels[order[0]];
+        i = 1;
+    }
+    {
+        // nodes above the top level raise it, one at a time
+        NodeInserter inserter(*this, locks.get());
+        for (; i < (size_t)n && levels[order[i]] > max_level; i++) {
+            inserter.insert(n0 + order[i], levels[order[i]], entry_point, max_level);
+            entry_point = n0 + order[i];
+            max_level = levels[order[i]];
+        }
+    }
+
+    std::mutex exception_mutex;
+    std::string exception_string;
+#pragma omp parallel
+    {
+        NodeInserter inserter(*this, locks.get());
+#pragma omp for schedule(dynamic, 64)
+        for (size_t j = i; j < (size_t)n; j++) {
+            try {
+                inserter.insert(n0 + order[j], levels[order[j]], entry_point, max_level);
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                exception_string = e.what();
+            }
+        }
+    }
+    if (!exception_string.empty()) {
+        FAISS_THROW_MSG(exception_string.c_str());
+    }
+}
+
+void IndexHNSWWide::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params) const {
+    FAISS_THROW_IF_NOT(k > 0);
+    int ef = efSearch;
+    if (auto* hnsw_params = dynamic_cast<const faiss::SearchParametersHNSW*>(params)) {
+        ef = hnsw_params->efSearch;
+    } else if (auto* graph_params = dynamic_cast<const SearchParametersGraph*>(params)) {
+        ef = graph_params->ef > 0 ? graph_params->ef : ef;
+    }
+    ef = std::max(ef, (int)k);
+    const faiss::IDSelector* sel = params ? params->sel : nullptr;
+    const bool negate = faiss::is_similarity_metric(metric_type);
+
+#pragma omp parallel if (n > 1)
+    {
+        GraphWalker walker(*this, ef);
+        std::vector<DistId> found;
+#pragma omp for schedule(dynamic)
+        for (idx_t q = 0; q < n; q++) {
+            float* D = distances + q * k;
+            idx_t* I = labels + q * k;
+            idx_t j = 0;
+            if (entry_point >= 0) {
+                walker.dis->set_query(x + q * d);
+                idx_t nearest = entry_point;
+                float d_nearest = (*walker.dis)(nearest);
+                for (int l = max_level; l >= 1; l--) {
+                    walker.greedy(l, nearest, d_nearest);
+                }
+                walker.search_level(0, nearest, d_nearest, ef, found);
+                for (size_t r = 0; r < found.size() && j < k; r++) {
+                    if (sel && !sel->is_member(found[r].second)) {
+                        continue;
+                    }
+                    D[j] = negate ? -found[r].first : found[r].first;
+                    I[j] = found[r].second;
+                    j++;
+                }
+            }
+            for (; j < k; j++) {
+                D[j] = negate ? -std::numeric_limits<float>::infinity()
+                              : std::numeric_limits<float>::infinity();
+                I[j] = -1;
+            }
+        }
+    }
+}
+
+void IndexHNSWWide::reset() {
+    storage->reset();
+    ntotal = 0;
+    links0.chunks.clear();
+    links0.n_rows = 0;
+    links_up.chunks.clear();
+    links_up.n_rows = 0;
+    upper = IVFIdTable();
+    entry_point = -1;
+    max_level = -1;
+}
+
+void IndexHNSWWide::reconstruct(idx_t key, float* recons) const {
+    storage->reconstruct(key, recons);
+}
+
+faiss::DistanceComputer* IndexHNSWWide::get_distance_computer() const {
+    return storage->get_distance_computer();
+}
+
+size_t IndexHNSWWide::graph_memory_usage() const {
+    return links0.memory_usage() + links_up.memory_usage() + upper.memory_usage();
+}
+
+/* ============================================================
+ * I/O
+ * ============================================================ */
+
+void write_hnsw_wide(const IndexHNSWWide* index, faiss::IOWriter& f) {
+    uint32_t h[2] = {faiss::fourcc("IxHW"), kFormatVersion};
+    int32_t i32[6] = {index->d, (int32_t)index->metric_type, index->M,
+                      index->efConstruction, index->efSearch, index->max_level};
+    float metric_arg[2] = {index->metric_arg, 0};
+    int64_t i64[3] = {index->ntotal, index->seed, index->entry_point};
+    // every block is a multiple of 8 bytes, so the link arrays stay aligned
+    // in a mapping
+    write_array(f, h, sizeof(uint32_t), 2);
+    write_array(f, i32, sizeof(int32_t), 6);
+    write_array(f, metric_arg, sizeof(float), 2);
+    write_array(f, i64, sizeof(int64_t), 3);
+    write_array(f, &index->level_mult, sizeof(double), 1);
+    write_links(f, index->links0);
+    write_links(f, index->links_up);
+    uint64_t table[2] = {index->upper.capacity, index->upper.size};
+    write_array(f, table, sizeof(uint64_t), 2);
+    write_array(f, index->upper.slots.data(), sizeof(int64_t), 2 * index->upper.capacity);
+    faiss::write_index(index->storage, &f);
+}
+
+IndexHNSWWide* read_hnsw_wide(faiss::IOReader& f, int io_flags) {
+    uint32_t h[2];
+    read_array(f, h, sizeof(uint32_t), 2);
+    FAISS_THROW_IF_NOT_MSG(h[0] == faiss::fourcc("IxHW"), "not an HNSWWide index");
+    FAISS_THROW_IF_NOT_FMT(h[1] == kFormatVersion, "unsupported HNSWWide format version %u", h[1]);
+    int32_t i32[6];
+    float metric_arg[2];
+    int64_t i64[3];
+    read_array(f, i32, sizeof(int32_t), 6);
+    read_array(f, metric_arg, sizeof(float), 2);
+    read_array(f, i64, sizeof(int64_t), 3);
+
+    std::unique_ptr<IndexHNSWWide> index(new IndexHNSWWide());
+    index->d = i32[0];
+    index->metric_type = (faiss::MetricType)i32[1];
+    index->M = i32[2];
+    index->efConstruction = i32[3];
+    index->efSearch = i32[4];
+    index->max_level = i32[5];
+    index->metric_arg = metric_arg[0];
+    index->ntotal = i64[0];
+    index->seed = i64[1];
+    index->entry_point = i64[2];
+    read_array(f, &index->level_mult, sizeof(double), 1);
+    read_links(f, index->links0);
+    read_links(f, index->links_up);
+    FAISS_THROW_IF_NOT_MSG(
+            index->links0.row_size == (size_t)(2 * index->M) &&
+                    index->links_up.row_size == (size_t)index->M &&
+                    index->links0.n_rows == (size_t)index->ntotal,
+            "corrupt HNSWWide links");
+    uint64_t table[2];
+    read_array(f, table, sizeof(uint64_t), 2);
+    index->upper.capacity = table[0];
+    index->upper.size = table[1];
+    index->upper.slots = read_int64s(f, 2 * table[0]);
+
+    std::unique_ptr<faiss::Index> storage(faiss::read_index(&f, io_flags));
+    FAISS_THROW_IF_NOT_MSG(
+            storage->ntotal == index->ntotal && storage->d == index->d,
+            "HNSWWide graph does not match its storage");
+    index->is_trained = storage->is_trained;
+    index->storage = storage.release();
+    index->own_fields = true;
+    return index.release();
+}
+
+} // namespace faiss_go_ext
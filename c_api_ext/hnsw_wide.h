@@ -0,0 +1,137 @@
+/**
+ * FAISS Go Extensions - HNSW with 64-bit node ids
+ *
+ * faiss::HNSW stores neighbor ids as int32 in one neighbors vector, and
+ * each search allocates a VisitedTable of ntotal bytes per thread, so one
+ * graph stops near 2^31 nodes and large graphs pay a multi-GB allocation
+ * per search. IndexHNSWWide is the same algorithm (greedy descent through
+ * the upper levels, beam search on level 0, neighbor selection by the
+ * HNSW heuristic) with:
+ *
+ *  - idx_t neighbor ids;
+ *  - link storage in fixed-size chunks of nodes, so growing the graph
+ *    appends chunks instead of reallocating, and a file maps each chunk
+ *    in place (mapped chunks, and mapped flat storage codes, are copied when
+ *    nodes are next added);
+ *  - upper-level links only for the nodes that have them, located through
+ *    an IVFIdTable, instead of offsets and levels arrays over all nodes;
+ *  - a SparseVisitedSet per search, sized by the nodes visited.
+ *
+ * Vectors are kept in a storage index (IndexFlat, IndexScalarQuantizer,
+ * ... as for IndexHNSW). Wide indexes are built by index_factory_ext
+ * ("HNSWWide32,Flat") and saved by write_index_ext / read_index_ext.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_HNSW_WIDE_H
+#define FAISS_GO_EXT_HNSW_WIDE_H
+
+#include "ivf_id_table.h"
+
+#include <faiss/Index.h>
+#include <faiss/impl/DistanceComputer.h>
+#include <faiss/impl/io.h>
+#include <faiss/impl/maybe_owned_vector.h>
+
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Rows of row_size ids, kChunkRows rows per chunk. Unused entries are -1.
+struct ChunkedLinks {
+    static constexpr int kChunkShift = 16;
+    static constexpr size_t kChunkRows = size_t(1) << kChunkShift;
+
+    size_t row_size = 0;
+    size_t n_rows = 0;
+    std::vector<faiss::MaybeOwnedVector<idx_t>> chunks;
+
+    idx_t* row(idx_t i) {
+        return chunks[i >> kChunkShift].data() + (i & (kChunkRows - 1)) * row_size;
+    }
+
+    const idx_t* row(idx_t i) const {
+        return chunks[i >> kChunkShift].data() + (i & (kChunkRows - 1)) * row_size;
+    }
+
+    /// grow to n rows, appending chunks as needed
+    void resize(size_t n);
+
+    /// copy the chunks that are views of a file mapping
+    void make_writable();
+
+    size_t memory_usage() const;
+};
+
+struct IndexHNSWWide : faiss::Index {
+    faiss::Index* storage = nullptr; ///< the vectors
+    bool own_fields = false;
+
+    int M = 32;              ///< links per node on upper levels, 2 * M on level 0
+    int efConstruction = 40; ///< beam width when adding
+    int efSearch = 16;       ///< default beam width when searching
+    double level_mult = 0;   ///< 1 / log(M)
+    int64_t seed = 456;      ///< level assignment seed
+
+    idx_t entry_point = -1;
+    int max_level = -1;
+
+    ChunkedLinks links0;     ///< level 0, 2 * M per node
+    ChunkedLinks links_up;   ///< levels >= 1, M per row
+    /// node -> (first row in links_up << 8 | level), for nodes with level >= 1
+    IVFIdTable upper;
+
+    IndexHNSWWide(faiss::Index* storage, int M);
+    IndexHNSWWide() {} ///< for deserialization
+    ~IndexHNSWWide() override;
+
+    void train(idx_t n, const float* x) override;
+
+    void add(idx_t n, const float* x) override;
+
+    /// params may be a SearchParametersHNSW (efSearch) or a
+    /// SearchParametersGraph (ef; the visited set is always sparse); the
+    /// selector filters the results, not the graph walk
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::SearchParameters* params = nullptr) const override;
+
+    void reset() override;
+
+    void reconstruct(idx_t key, float* recons) const override;
+
+    faiss::DistanceComputer* get_distance_computer() const override;
+
+    /// level of a node, 0 for most
+    int level_of(idx_t node) const;
+
+    /// links of a node at a level, max_links(level) entries, -1 padded
+    const idx_t* links(idx_t node, int level) const;
+    idx_t* links(idx_t node, int level);
+
+    int max_links(int level) const {
+        return level == 0 ? 2 * M : M;
+    }
+
+    /// bytes used by the graph, storage excluded
+    size_t graph_memory_usage() const;
+};
+
+void write_hnsw_wide(const IndexHNSWWide* index, faiss::IOWriter& f);
+
+/// reads what write_hnsw_wide wrote, the fourcc included; link chunks are
+/// views of the file for mmap readers
+IndexHNSWWide* read_hnsw_wide(faiss::IOReader& f, int io_flags);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_HNSW_WIDE_H */
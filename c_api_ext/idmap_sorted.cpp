@@ -0,0 +1,549 @@
+/**
+ * FAISS Go Extensions - compact IDMap with sorted id arrays
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "idmap_sorted.h"
+#include "hnsw_wide.h"
+#include "search_params.h"
+
+#include <faiss/IVFlib.h>
+#include <faiss/IndexIVFRaBitQ.h>
+#include <faiss/IndexRaBitQ.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/impl/io.h>
+#include <faiss/impl/mapped_io.h>
+#include <faiss/index_factory.h>
+#include <faiss/index_io.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+typedef faiss::MaybeOwnedVector<idx_t> IdArray;
+
+constexpr uint32_t kFormatVersion = 1;
+
+std::vector<idx_t> to_vector(const IdArray& v) {
+    return std::vector<idx_t>(v.data(), v.data() + v.size());
+}
+
+/// positions flagged in a mask
+struct IDSelectorMask : faiss::IDSelector {
+    std::vector<bool> mask;
+
+    explicit IDSelectorMask(size_t n) : mask(n, false) {}
+
+    bool is_member(idx_t pos) const override {
+        return pos >= 0 && (size_t)pos < mask.size() && mask[pos];
+    }
+};
+
+/// sorted (id, position) arrays of an id map; equal ids keep the order of
+/// their positions, so the last one added is found
+void sort_ids(const std::vector<idx_t>& ids, std::vector<idx_t>* sorted_ids, std::vector<idx_t>* sorted_pos) {
+    sorted_pos->resize(ids.size());
+    std::iota(sorted_pos->begin(), sorted_pos->end(), 0);
+    std::stable_sort(sorted_pos->begin(), sorted_pos->end(), [&](idx_t a, idx_t b) { return ids[a] < ids[b]; });
+    sorted_ids->resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        (*sorted_ids)[i] = ids[(*sorted_pos)[i]];
+    }
+}
+
+/// merge two sorted (id, position) lists, the entries of a first on equal
+/// ids since its positions are smaller
+void merge_sorted(
+        const idx_t* a_ids,
+        const idx_t* a_pos,
+        size_t na,
+        const idx_t* b_ids,
+        const idx_t* b_pos,
+        size_t nb,
+        std::vector<idx_t>* ids,
+        std::vector<idx_t>* pos) {
+    ids->resize(na + nb);
+    pos->resize(na + nb);
+    size_t i = 0, j = 0, o = 0;
+    while (i < na || j < nb) {
+        if (j == nb || (i < na && a_ids[i] <= b_ids[j])) {
+            (*ids)[o] = a_ids[i];
+            (*pos)[o++] = a_pos[i++];
+        } else {
+            (*ids)[o] = b_ids[j];
+            (*pos)[o++] = b_pos[j++];
+        }
+    }
+}
+
+/// position of the last entry of id in a sorted list, -1 if absent
+idx_t find_sorted(const idx_t* ids, const idx_t* pos, size_t n, idx_t id) {
+    const idx_t* it = std::upper_bound(ids, ids + n, id);
+    if (it == ids || it[-1] != id) {
+        return -1;
+    }
+    return pos[it - 1 - ids];
+}
+
+/// IndexIVF::remove_ids keeps the ids of the remaining entries, which
+/// for the sub-index of an IDMap3 are positions before the removal: map
+/// them to the new positions
+void renumber_ivf(faiss::IndexIVF* ivf, const std::vector<idx_t>& new_pos) {
+    faiss::InvertedLists* invlists = ivf->invlists;
+    std::vector<idx_t> ids;
+    std::vector<uint8_t> codes;
+    for (size_t l = 0; l < ivf->nlist; l++) {
+        size_t size = invlists->list_size(l);
+        if (size == 0) {
+            continue;
+        }
+        faiss::InvertedLists::ScopedIds list_ids(invlists, l);
+        faiss::InvertedLists::ScopedCodes list_codes(invlists, l);
+        ids.resize(size);
+        for (size_t o = 0; o < size; o++) {
+            ids[o] = new_pos[list_ids[o]];
+        }
+        // update_entries copies the codes too, not from their own storage
+        codes.assign(list_codes.get(), list_codes.get() + size * invlists->code_size);
+        invlists->update_entries(l, 0, size, ids.data(), codes.data());
+    }
+}
+
+void write_array(faiss::IOWriter& f, const void* data, size_t size, size_t n) {
+    FAISS_THROW_IF_NOT_FMT(f(data, size, n) == n, "write error in %s", f.name.c_str());
+}
+
+void read_array(faiss::IOReader& f, void* data, size_t size, size_t n) {
+    FAISS_THROW_IF_NOT_FMT(f(data, size, n) == n, "read error in %s", f.name.c_str());
+}
+
+/// id array of n entries, a view of the file for mmap readers
+void read_ids(faiss::IOReader& f, IdArray& target, size_t n) {
+    if (auto* mf = dynamic_cast<faiss::MappedFileIOReader*>(&f)) {
+        void* address = nullptr;
+        size_t nread = mf->mmap(&address, sizeof(idx_t), n);
+        FAISS_THROW_IF_NOT_FMT(nread == n, "read error in %s", f.name.c_str());
+        target = IdArray::create_view(address, n, mf->mmap_owner);
+        return;
+    }
+    std::vector<idx_t> ids(n);
+    read_array(f, ids.data(), sizeof(idx_t), n);
+    target = IdArray(std::move(ids));
+}
+
+faiss::Index* read_index_stream(faiss::IOReader& f, int io_flags);
+
+IndexIDMap3* read_idmap3(faiss::IOReader& f, int io_flags) {
+    uint32_t h, version;
+    int64_t ntotal;
+    read_array(f, &h, sizeof(h), 1);
+    read_array(f, &version, sizeof(version), 1);
+    FAISS_THROW_IF_NOT_FMT(version == kFormatVersion, "unsupported IDMap3 format version %u", version);
+    read_array(f, &ntotal, sizeof(ntotal), 1);
+    FAISS_THROW_IF_NOT(ntotal >= 0);
+
+    std::unique_ptr<IndexIDMap3> idmap(new IndexIDMap3());
+    read_ids(f, idmap->id_map, ntotal);
+    read_ids(f, idmap->sorted_ids, ntotal);
+    read_ids(f, idmap->sorted_pos, ntotal);
+    std::unique_ptr<faiss::Index> sub(read_index_stream(f, io_flags));
+    FAISS_THROW_IF_NOT_MSG(sub->ntotal == ntotal, "IDMap3 ids do not match the sub-index");
+
+    idmap->d = sub->d;
+    idmap->metric_type = sub->metric_type;
+    idmap->metric_arg = sub->metric_arg;
+    idmap->is_trained = sub->is_trained;
+    idmap->ntotal = ntotal;
+    idmap->index = sub.release();
+    idmap->own_fields = true;
+    return idmap.release();
+}
+
+/// fourcc of the next index in f, without consuming it; 0 if the reader
+/// cannot be rewound
+uint32_t peek_fourcc(faiss::IOReader& f) {
+    uint32_t h = 0;
+    if (auto* mf = dynamic_cast<faiss::MappedFileIOReader*>(&f)) {
+        if (mf->pos + sizeof(h) <= mf->mmap_owner->size()) {
+            memcpy(&h, (const char*)mf->mmap_owner->data() + mf->pos, sizeof(h));
+        }
+    } else if (auto* ff = dynamic_cast<faiss::FileIOReader*>(&f)) {
+        long pos = ftell(ff->f);
+        if (pos >= 0 && fread(&h, sizeof(h), 1, ff->f) != 1) {
+            h = 0;
+        }
+        fseek(ff->f, pos, SEEK_SET);
+    }
+    return h;
+}
+
+/// faiss::read_index, plus the extension formats
+faiss::Index* read_index_stream(faiss::IOReader& f, int io_flags) {
+    uint32_t h = peek_fourcc(f);
+    if (h == faiss::fourcc("IxM3")) {
+        return read_idmap3(f, io_flags);
+    }
+    if (h == faiss::fourcc("IxHW")) {
+        return read_hnsw_wide(f, io_flags);
+    }
+    return faiss::read_index(&f, io_flags);
+}
+
+/// faiss::write_index, plus the extension formats
+void write_index_stream(const faiss::Index* index, faiss::IOWriter& f) {
+    if (auto* wide = dynamic_cast<const IndexHNSWWide*>(index)) {
+        write_hnsw_wide(wide, f);
+        return;
+    }
+    auto* idmap = dynamic_cast<const IndexIDMap3*>(index);
+    if (!idmap) {
+        faiss::write_index(index, &f);
+        return;
+    }
+    uint32_t h = faiss::fourcc("IxM3");
+    int64_t ntotal = idmap->ntotal;
+    write_array(f, &h, sizeof(h), 1);
+    write_array(f, &kFormatVersion, sizeof(kFormatVersion), 1);
+    write_array(f, &ntotal, sizeof(ntotal), 1);
+    // the 16-byte header keeps the arrays 8-byte aligned in a mapping
+    write_array(f, idmap->id_map.data(), sizeof(idx_t), ntotal);
+    if (idmap->pending.empty()) {
+        write_array(f, idmap->sorted_ids.data(), sizeof(idx_t), ntotal);
+        write_array(f, idmap->sorted_pos.data(), sizeof(idx_t), ntotal);
+    } else {
+        std::vector<idx_t> ids, pos;
+        idmap->merged_sorted(&ids, &pos);
+        write_array(f, ids.data(), sizeof(idx_t), ntotal);
+        write_array(f, pos.data(), sizeof(idx_t), ntotal);
+    }
+    write_index_stream(idmap->index, f);
+}
+
+} // namespace
+
+/* ============================================================
+ * IndexIDMap3
+ * ============================================================ */
+
+IndexIDMap3::IndexIDMap3(faiss::Index* index)
+        : faiss::Index(index->d, index->metric_type), index(index) {
+    FAISS_THROW_IF_NOT_MSG(index->ntotal == 0, "index must be empty on input");
+    is_trained = index->is_trained;
+    metric_arg = index->metric_arg;
+    verbose = index->verbose;
+}
+
+IndexIDMap3::~IndexIDMap3() {
+    if (own_fields) {
+        delete index;
+    }
+}
+
+void IndexIDMap3::add(idx_t, const float*) {
+    FAISS_THROW_MSG("add does not make sense with IndexIDMap3, use add_with_ids");
+}
+
+void IndexIDMap3::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    FAISS_THROW_IF_NOT(n == 0 || xids);
+    const idx_t n0 = ntotal;
+    index->add(n, x);
+
+    if (!id_map.is_owned) {
+        id_map = IdArray(to_vector(id_map));
+    }
+    id_map.insert(id_map.end(), xids, xids + n);
+    ntotal = index->ntotal;
+    if (n == 0) {
+        return;
+    }
+
+    SortedRun run;
+    sort_ids(std::vector<idx_t>(xids, xids + n), &run.ids, &run.pos);
+    for (idx_t& p : run.pos) {
+        p += n0;
+    }
+    pending.push_back(std::move(run));
+    while (pending.size() >= 2 &&
+           2 * pending.back().ids.size() >= pending[pending.size() - 2].ids.size()) {
+        SortedRun& a = pending[pending.size() - 2];
+        const SortedRun& b = pending.back();
+        SortedRun merged;
+        merge_sorted(a.ids.data(), a.pos.data(), a.ids.size(), b.ids.data(), b.pos.data(), b.ids.size(),
+                     &merged.ids, &merged.pos);
+        a = std::move(merged);
+        pending.pop_back();
+    }
+    if (2 * pending[0].ids.size() >= sorted_ids.size()) {
+        merge_pending();
+    }
+}
+
+void IndexIDMap3::merged_sorted(std::vector<idx_t>* ids, std::vector<idx_t>* pos) const {
+    // newest runs first, each older list is merged in front
+    std::vector<idx_t> run_ids, run_pos, tmp_ids, tmp_pos;
+    for (size_t r = pending.size(); r-- > 0;) {
+        merge_sorted(pending[r].ids.data(), pending[r].pos.data(), pending[r].ids.size(),
+                     run_ids.data(), run_pos.data(), run_ids.size(), &tmp_ids, &tmp_pos);
+        std::swap(run_ids, tmp_ids);
+        std::swap(run_pos, tmp_pos);
+    }
+    merge_sorted(sorted_ids.data(), sorted_pos.data(), sorted_ids.size(),
+                 run_ids.data(), run_pos.data(), run_ids.size(), ids, pos);
+}
+
+void IndexIDMap3::merge_pending() {
+    if (pending.empty()) {
+        return;
+    }
+    std::vector<idx_t> ids, pos;
+    merged_sorted(&ids, &pos);
+    sorted_ids = IdArray(std::move(ids));
+    sorted_pos = IdArray(std::move(pos));
+    pending.clear();
+}
+
+void IndexIDMap3::train(idx_t n, const float* x) {
+    index->train(n, x);
+    is_trained = index->is_trained;
+}
+
+void IndexIDMap3::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params) const {
+    PositionParams pp(params, id_map.data());
+    index->search(n, x, k, distances, labels, pp.params);
+    for (idx_t i = 0; i < n * k; i++) {
+        labels[i] = labels[i] < 0 ? labels[i] : id_map[labels[i]];
+    }
+}
+
+void IndexIDMap3::range_search(
+        idx_t n,
+        const float* x,
+        float radius,
+        faiss::RangeSearchResult* result,
+        const faiss::SearchParameters* params) const {
+    PositionParams pp(params, id_map.data());
+    index->range_search(n, x, radius, result, pp.params);
+    for (size_t i = 0; i < result->lims[result->nq]; i++) {
+        result->labels[i] = result->labels[i] < 0 ? result->labels[i] : id_map[result->labels[i]];
+    }
+}
+
+void IndexIDMap3::reset() {
+    index->reset();
+    id_map = IdArray();
+    sorted_ids = IdArray();
+    sorted_pos = IdArray();
+    pending.clear();
+    ntotal = 0;
+}
+
+size_t IndexIDMap3::remove_ids(const faiss::IDSelector& sel) {
+    // evaluate the selector once per vector, the sub-index then removes by
+    // position
+    std::vector<idx_t> new_pos(ntotal);
+    std::vector<idx_t> ids;
+    IDSelectorMask removed(ntotal);
+    for (idx_t i = 0; i < ntotal; i++) {
+        if (sel.is_member(id_map[i])) {
+            new_pos[i] = -1;
+            removed.mask[i] = true;
+        } else {
+            new_pos[i] = ids.size();
+            ids.push_back(id_map[i]);
+        }
+    }
+    size_t nremove = ntotal - ids.size();
+    if (nremove == 0) {
+        return 0;
+    }
+    merge_pending();
+    // the direct map of an IVF sub-index is rebuilt after the renumbering
+    // (a hashtable could only remove an IDSelectorArray, an array nothing)
+    faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(index);
+    faiss::DirectMap::Type dm_type = ivf ? ivf->direct_map.type : faiss::DirectMap::NoMap;
+    if (ivf) {
+        ivf->set_direct_map_type(faiss::DirectMap::NoMap);
+    }
+    FAISS_THROW_IF_NOT_MSG(
+            index->remove_ids(removed) == nremove && (size_t)index->ntotal == ids.size(),
+            "sub-index does not support remove_ids");
+    if (ivf) {
+        renumber_ivf(ivf, new_pos);
+        ivf->set_direct_map_type(dm_type);
+    }
+
+    std::vector<idx_t> kept_ids, kept_pos;
+    kept_ids.reserve(ids.size());
+    kept_pos.reserve(ids.size());
+    for (idx_t i = 0; i < ntotal; i++) {
+        idx_t p = new_pos[sorted_pos[i]];
+        if (p >= 0) {
+            kept_ids.push_back(sorted_ids[i]);
+            kept_pos.push_back(p);
+        }
+    }
+
+    id_map = IdArray(std::move(ids));
+    sorted_ids = IdArray(std::move(kept_ids));
+    sorted_pos = IdArray(std::move(kept_pos));
+    ntotal = index->ntotal;
+    return nremove;
+}
+
+idx_t IndexIDMap3::find(idx_t id) const {
+    // later runs hold later positions
+    for (size_t r = pending.size(); r-- > 0;) {
+        idx_t pos = find_sorted(pending[r].ids.data(), pending[r].pos.data(), pending[r].ids.size(), id);
+        if (pos >= 0) {
+            return pos;
+        }
+    }
+    return find_sorted(sorted_ids.data(), sorted_pos.data(), sorted_ids.size(), id);
+}
+
+void IndexIDMap3::reconstruct(idx_t key, float* recons) const {
+    idx_t pos = find(key);
+    FAISS_THROW_IF_NOT_FMT(pos >= 0, "key %" PRId64 " not found", key);
+    index->reconstruct(pos, recons);
+}
+
+/* ============================================================
+ * Conversion, factory and IO
+ * ============================================================ */
+
+IndexIDMap3* idmap3_from_idmap(faiss::IndexIDMap* idmap) {
+    FAISS_THROW_IF_NOT(idmap && idmap->index);
+    std::vector<idx_t> ids_sorted, pos_sorted;
+    sort_ids(idmap->id_map, &ids_sorted, &pos_sorted);
+
+    std::unique_ptr<IndexIDMap3> result(new IndexIDMap3());
+    result->d = idmap->d;
+    result->metric_type = idmap->metric_type;
+    result->metric_arg = idmap->metric_arg;
+    result->is_trained = idmap->is_trained;
+    result->verbose = idmap->verbose;
+    result->ntotal = idmap->ntotal;
+    result->id_map = IdArray(std::move(idmap->id_map));
+    result->sorted_ids = IdArray(std::move(ids_sorted));
+    result->sorted_pos = IdArray(std::move(pos_sorted));
+    result->index = idmap->index;
+    result->own_fields = idmap->own_fields;
+
+    idmap->own_fields = false;
+    idmap->id_map.clear();
+    idmap->ntotal = 0;
+    return result.release();
+}
+
+faiss::Index* index_factory_ext(int d, const char* description, faiss::MetricType metric) {
+    FAISS_THROW_IF_NOT(description);
+    const char prefix[] = "IDMap3,";
+    if (strncmp(description, prefix, sizeof(prefix) - 1) == 0) {
+        std::unique_ptr<faiss::Index> sub(index_factory_ext(d, description + sizeof(prefix) - 1, metric));
+        IndexIDMap3* idmap = new IndexIDMap3(sub.get());
+        idmap->own_fields = true;
+        sub.release();
+        return idmap;
+    }
+    const char wide[] = "HNSWWide";
+    if (strncmp(description, wide, sizeof(wide) - 1) == 0) {
+        char* end = nullptr;
+        long M = strtol(description + sizeof(wide) - 1, &end, 10);
+        FAISS_THROW_IF_NOT_FMT(
+                end != description + sizeof(wide) - 1 && M >= 2 && M <= 1024,
+                "could not parse HNSWWide M in %s", description);
+        // "HNSWWide32" alone stores the vectors flat, as "HNSW32" does
+        const char* storage_desc = *end == ',' ? end + 1 : "Flat";
+        FAISS_THROW_IF_NOT_FMT(*end == ',' || *end == 0, "could not parse %s", description);
+        std::unique_ptr<faiss::Index> storage(faiss::index_factory(d, storage_desc, metric));
+        IndexHNSWWide* index = new IndexHNSWWide(storage.get(), (int)M);
+        index->own_fields = true;
+        storage.release();
+        return index;
+    }
+    return faiss::index_factory(d, description, metric);
+}
+
+void write_index_ext(const faiss::Index* index, const char* fname) {
+    if (!dynamic_cast<const IndexIDMap3*>(index) && !dynamic_cast<const IndexHNSWWide*>(index)) {
+        faiss::write_index(index, fname);
+        return;
+    }
+    faiss::FileIOWriter f(fname);
+    write_index_stream(index, f);
+}
+
+faiss::Index* read_index_ext(const char* fname, int io_flags) {
+    FAISS_THROW_IF_NOT(fname);
+    uint32_t h = 0;
+    FILE* file = fopen(fname, "rb");
+    FAISS_THROW_IF_NOT_FMT(file, "could not open %s for reading", fname);
+    size_t nread = fread(&h, sizeof(h), 1, file);
+    fclose(file);
+    if (nread != 1 || (h != faiss::fourcc("IxM3") && h != faiss::fourcc("IxHW"))) {
+        return faiss::read_index(fname, io_flags);
+    }
+    if ((io_flags & faiss::IO_FLAG_MMAP_IFC) == faiss::IO_FLAG_MMAP_IFC) {
+        auto owner = std::make_shared<faiss::MmappedFileMappingOwner>(fname);
+        faiss::MappedFileIOReader f(owner);
+        return read_index_stream(f, io_flags);
+    }
+    faiss::FileIOReader f(fname);
+    return read_index_stream(f, io_flags);
+}
+
+faiss::Index* ClonerExt::clone_Index(const faiss::Index* index) {
+    if (auto* idmap = dynamic_cast<const IndexIDMap3*>(index)) {
+        std::unique_ptr<faiss::Index> sub(clone_Index(idmap->index));
+        IndexIDMap3* res = new IndexIDMap3(*idmap);
+        res->index = sub.release();
+        res->own_fields = true;
+        return res;
+    }
+    if (auto* wide = dynamic_cast<const IndexHNSWWide*>(index)) {
+        std::unique_ptr<faiss::Index> storage(clone_Index(wide->storage));
+        IndexHNSWWide* res = new IndexHNSWWide(*wide);
+        res->storage = storage.release();
+        res->own_fields = true;
+        return res;
+    }
+    if (auto* rq = dynamic_cast<const faiss::IndexRaBitQ*>(index)) {
+        return new faiss::IndexRaBitQ(*rq);
+    }
+    return faiss::Cloner::clone_Index(index);
+}
+
+faiss::IndexIVF* ClonerExt::clone_IndexIVF(const faiss::IndexIVF* ivf) {
+    if (auto* rq = dynamic_cast<const faiss::IndexIVFRaBitQ*>(ivf)) {
+        return new faiss::IndexIVFRaBitQ(*rq);
+    }
+    return faiss::Cloner::clone_IndexIVF(ivf);
+}
+
+faiss::Index* clone_index_ext(const faiss::Index* index) {
+    FAISS_THROW_IF_NOT(index);
+    ClonerExt cloner;
+    return cloner.clone_Index(index);
+}
+
+} // namespace faiss_go_ext
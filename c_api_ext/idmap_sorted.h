@@ -0,0 +1,133 @@
+/**
+ * FAISS Go Extensions - compact IDMap with sorted id arrays
+ *
+ * IndexIDMap2 answers reverse lookups (reconstruct by id) from an
+ * unordered_map, which costs tens of bytes of node allocations per vector
+ * and has to be rebuilt on every load. IndexIDMap3 keeps the ids sorted
+ * next to their positions in two flat arrays and looks them up by binary
+ * search: 24 bytes per vector in total, and since all three arrays are
+ * MaybeOwnedVectors the whole map is memory-mapped when the index is read
+ * with IO_FLAG_MMAP_IFC.
+ *
+ * The on-disk format is private to faiss_go_ext ("IxM3" header, the three
+ * arrays, then the sub-index in the FAISS format), so IDMap3 indexes are
+ * written and read with write_index_ext / read_index_ext, which fall back
+ * to the FAISS functions for every other index.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_IDMAP_SORTED_H
+#define FAISS_GO_EXT_IDMAP_SORTED_H
+
+#include <faiss/Index.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/clone_index.h>
+#include <faiss/impl/maybe_owned_vector.h>
+
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Same semantics as faiss::IndexIDMap2: search results are translated
+/// to ids, reconstruct takes an id and, for duplicate ids, refers to the
+/// vector added last.
+struct IndexIDMap3 : faiss::Index {
+    faiss::Index* index = nullptr; ///< the sub-index
+    bool own_fields = false;       ///< delete the sub-index in the destructor
+
+    faiss::MaybeOwnedVector<idx_t> id_map;     ///< position -> id
+    faiss::MaybeOwnedVector<idx_t> sorted_ids; ///< ids in increasing order
+    faiss::MaybeOwnedVector<idx_t> sorted_pos; ///< position of each sorted id
+
+    /// ids added since the last merge into sorted_ids / sorted_pos, as
+    /// sorted runs, oldest first, whose sizes more than double from each
+    /// run to the previous one
+    struct SortedRun {
+        std::vector<idx_t> ids, pos;
+    };
+    std::vector<SortedRun> pending;
+
+    explicit IndexIDMap3(faiss::Index* index);
+    IndexIDMap3() {} ///< for deserialization
+    ~IndexIDMap3() override;
+
+    /// Appends to id_map and keeps the sorted new ids in a pending run.
+    /// Runs of similar sizes are merged, and the runs into the sorted
+    /// arrays once they reach half their size, so each id is merged
+    /// O(log ntotal) times. Arrays mapped from a file are copied once.
+    void add_with_ids(idx_t n, const float* x, const idx_t* xids) override;
+
+    /// fails, ids are required
+    void add(idx_t n, const float* x) override;
+
+    void train(idx_t n, const float* x) override;
+
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::SearchParameters* params = nullptr) const override;
+
+    void range_search(
+            idx_t n,
+            const float* x,
+            float radius,
+            faiss::RangeSearchResult* result,
+            const faiss::SearchParameters* params = nullptr) const override;
+
+    void reset() override;
+
+    /// works when the sub-index keeps the order of the remaining vectors;
+    /// the entries of an IVF sub-index, which keep their ids, are
+    /// renumbered to their new positions
+    size_t remove_ids(const faiss::IDSelector& sel) override;
+
+    void reconstruct(idx_t key, float* recons) const override;
+
+    /// position of an id in the sub-index, -1 if absent
+    idx_t find(idx_t id) const;
+
+    /// sorted_ids / sorted_pos with the pending runs merged in
+    void merged_sorted(std::vector<idx_t>* ids, std::vector<idx_t>* pos) const;
+
+    /// merge the pending runs into sorted_ids / sorted_pos
+    void merge_pending();
+};
+
+/// Take over the sub-index and ids of an IndexIDMap / IndexIDMap2. The
+/// result owns the sub-index if idmap did; idmap is left empty.
+IndexIDMap3* idmap3_from_idmap(faiss::IndexIDMap* idmap);
+
+/// faiss::index_factory, plus a leading "IDMap3," component that wraps the
+/// rest of the description in an IndexIDMap3, and "HNSWWide<M>[,storage]"
+/// for an IndexHNSWWide.
+faiss::Index* index_factory_ext(int d, const char* description, faiss::MetricType metric);
+
+/// faiss::write_index that also handles IndexIDMap3 and IndexHNSWWide.
+void write_index_ext(const faiss::Index* index, const char* fname);
+
+/// faiss::read_index that also handles IndexIDMap3 and IndexHNSWWide. With
+/// IO_FLAG_MMAP_IFC the id arrays, graph links (and flat codes) are views
+/// of the file.
+faiss::Index* read_index_ext(const char* fname, int io_flags);
+
+/// faiss::Cloner that also handles IndexIDMap3, IndexHNSWWide and the
+/// RaBitQ indexes, at any depth of the index tree (the FAISS Cloner calls
+/// clone_Index for sub-indexes).
+struct ClonerExt : faiss::Cloner {
+    faiss::Index* clone_Index(const faiss::Index* index) override;
+    faiss::IndexIVF* clone_IndexIVF(const faiss::IndexIVF* ivf) override;
+};
+
+/// faiss::clone_index with ClonerExt
+faiss::Index* clone_index_ext(const faiss::Index* index);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_IDMAP_SORTED_H */
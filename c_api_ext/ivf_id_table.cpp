@@ -0,0 +1,335 @@
+/**
+ * FAISS Go Extensions - open-addressing id table for IVF indexes
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "ivf_id_table.h"
+
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/io.h>
+#include <faiss/impl/mapped_io.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+constexpr int64_t kEmpty = -1;
+constexpr uint32_t kFormatVersion = 1;
+
+/// smallest capacity that keeps n ids at most 4/5 full
+size_t capacity_for(size_t n) {
+    return std::max<size_t>(16, n + n / 4 + 1);
+}
+
+void atomic_max(int64_t* p, int64_t v) {
+    int64_t cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+    while (cur < v && !__atomic_compare_exchange_n(p, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/// insert from several threads at once; duplicate ids keep the largest
+/// entry, which is the last one in inverted list order
+bool insert_concurrent(IVFIdTable& t, int64_t* s, idx_t id, idx_t entry) {
+    for (size_t h = t.slot_of(id);; h = t.next_slot(h)) {
+        int64_t key = __atomic_load_n(s + 2 * h, __ATOMIC_ACQUIRE);
+        bool inserted = false;
+        if (key == kEmpty) {
+            inserted = __atomic_compare_exchange_n(
+                    s + 2 * h, &key, id, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            if (inserted) {
+                key = id;
+            }
+        }
+        if (key == id) {
+            atomic_max(s + 2 * h + 1, entry);
+            return inserted;
+        }
+    }
+}
+
+/// entry of an id, checked against the inverted lists so that a stale
+/// table fails instead of reaching the FAISS assertions
+idx_t checked_entry(const faiss::IndexIVF& ivf, const IVFIdTable& table, idx_t id) {
+    idx_t entry = table.lookup(id);
+    FAISS_THROW_IF_NOT_FMT(entry >= 0, "key %" PRId64 " not found", id);
+    size_t l = faiss::lo_listno(entry), o = faiss::lo_offset(entry);
+    FAISS_THROW_IF_NOT_MSG(
+            l < ivf.invlists->nlist && o < ivf.invlists->list_size(l) &&
+                    ivf.invlists->get_single_id(l, o) == id,
+            "id table does not match the index, rebuild it");
+    return entry;
+}
+
+std::vector<int64_t> empty_slots(size_t capacity) {
+    return std::vector<int64_t>(2 * capacity, kEmpty);
+}
+
+void check_io(size_t got, size_t expected, const std::string& name, const char* what) {
+    FAISS_THROW_IF_NOT_FMT(got == expected, "%s error in %s", what, name.c_str());
+}
+
+} // namespace
+
+/* ============================================================
+ * IVFIdTable
+ * ============================================================ */
+
+void IVFIdTable::build(const faiss::IndexIVF& ivf) {
+    const faiss::InvertedLists* invlists = ivf.invlists;
+    FAISS_THROW_IF_NOT(invlists);
+    capacity = capacity_for(ivf.ntotal);
+    std::vector<int64_t> owned = empty_slots(capacity);
+    int64_t* s = owned.data();
+    size_t n_inserted = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+ : n_inserted)
+    for (idx_t l = 0; l < (idx_t)invlists->nlist; l++) {
+        size_t list_size = invlists->list_size(l);
+        if (list_size == 0) {
+            continue;
+        }
+        faiss::InvertedLists::ScopedIds ids(invlists, l);
+        for (size_t o = 0; o < list_size; o++) {
+            if (ids[o] != kEmpty) {
+                n_inserted += insert_concurrent(*this, s, ids[o], faiss::lo_build(l, o));
+            }
+        }
+    }
+
+    slots = faiss::MaybeOwnedVector<int64_t>(std::move(owned));
+    size = n_inserted;
+}
+
+void IVFIdTable::reserve(size_t n) {
+    size_t cap = capacity_for(n);
+    if (cap <= capacity && slots.is_owned) {
+        return;
+    }
+    // grow by at least half so that single inserts rehash rarely
+    if (cap > capacity && slots.size() > 0) {
+        cap = std::max(cap, capacity + capacity / 2);
+    }
+    cap = std::max(cap, capacity);
+    std::vector<int64_t> owned = empty_slots(cap);
+    const int64_t* old = slots.data();
+    size_t old_capacity = capacity;
+    capacity = cap;
+    for (size_t h = 0; h < old_capacity; h++) {
+        if (old[2 * h] == kEmpty) {
+            continue;
+        }
+        size_t g = slot_of(old[2 * h]);
+        while (owned[2 * g] != kEmpty) {
+            g = next_slot(g);
+        }
+        owned[2 * g] = old[2 * h];
+        owned[2 * g + 1] = old[2 * h + 1];
+    }
+    slots = faiss::MaybeOwnedVector<int64_t>(std::move(owned));
+}
+
+void IVFIdTable::insert(idx_t id, idx_t entry) {
+    FAISS_THROW_IF_NOT_MSG(id != kEmpty, "id -1 cannot be stored");
+    // also copies a memory-mapped table before the first write
+    reserve(size + 1);
+    int64_t* s = slots.data();
+    size_t h = slot_of(id);
+    while (s[2 * h] != kEmpty && s[2 * h] != id) {
+        h = next_slot(h);
+    }
+    size += s[2 * h] == kEmpty;
+    s[2 * h] = id;
+    s[2 * h + 1] = entry;
+}
+
+void IVFIdTable::write(const char* fname) const {
+    faiss::FileIOWriter f(fname);
+    uint32_t h = faiss::fourcc("IxIT");
+    uint64_t header[2] = {capacity, size};
+    check_io(f(&h, sizeof(h), 1), 1, f.name, "write");
+    check_io(f(&kFormatVersion, sizeof(kFormatVersion), 1), 1, f.name, "write");
+    check_io(f(header, sizeof(header[0]), 2), 2, f.name, "write");
+    // the 24-byte header keeps the slots 8-byte aligned in a mapping
+    check_io(f(slots.data(), sizeof(int64_t), 2 * capacity), 2 * capacity, f.name, "write");
+}
+
+IVFIdTable* IVFIdTable::read(const char* fname, bool mmap) {
+    std::unique_ptr<faiss::IOReader> reader;
+    std::shared_ptr<faiss::MmappedFileMappingOwner> owner;
+    if (mmap) {
+        owner = std::make_shared<faiss::MmappedFileMappingOwner>(fname);
+        reader.reset(new faiss::MappedFileIOReader(owner));
+    } else {
+        reader.reset(new faiss::FileIOReader(fname));
+    }
+    faiss::IOReader& f = *reader;
+
+    uint32_t h, version;
+    uint64_t header[2];
+    check_io(f(&h, sizeof(h), 1), 1, f.name, "read");
+    FAISS_THROW_IF_NOT_FMT(h == faiss::fourcc("IxIT"), "%s is not an IVF id table", fname);
+    check_io(f(&version, sizeof(version), 1), 1, f.name, "read");
+    FAISS_THROW_IF_NOT_FMT(version == kFormatVersion, "unsupported id table format version %u", version);
+    check_io(f(header, sizeof(header[0]), 2), 2, f.name, "read");
+    FAISS_THROW_IF_NOT_MSG(
+            header[0] >= 16 && header[1] < header[0],
+            "corrupted id table header");
+
+    std::unique_ptr<IVFIdTable> table(new IVFIdTable());
+    table->capacity = header[0];
+    table->size = header[1];
+    const size_t n = 2 * table->capacity;
+    if (mmap) {
+        void* address = nullptr;
+        auto* mf = static_cast<faiss::MappedFileIOReader*>(reader.get());
+        check_io(mf->mmap(&address, sizeof(int64_t), n), n, f.name, "read");
+        table->slots = faiss::MaybeOwnedVector<int64_t>::create_view(address, n, owner);
+    } else {
+        std::vector<int64_t> owned(n);
+        check_io(f(owned.data(), sizeof(int64_t), n), n, f.name, "read");
+        table->slots = faiss::MaybeOwnedVector<int64_t>(std::move(owned));
+    }
+    return table.release();
+}
+
+/* ============================================================
+ * IVF operations through the table
+ * ============================================================ */
+
+void ivf_reconstruct_ids(
+        const faiss::IndexIVF& ivf,
+        const IVFIdTable& table,
+        idx_t n,
+        const idx_t* ids,
+        float* recons) {
+    // look up everything first: reconstruct_from_offset runs in parallel
+    // and must not throw
+    std::vector<idx_t> entries(n);
+    for (idx_t i = 0; i < n; i++) {
+        entries[i] = checked_entry(ivf, table, ids[i]);
+    }
+
+#pragma omp parallel for if (n > 100)
+    for (idx_t i = 0; i < n; i++) {
+        ivf.reconstruct_from_offset(
+                faiss::lo_listno(entries[i]), faiss::lo_offset(entries[i]), recons + i * ivf.d);
+    }
+}
+
+void ivf_add_with_ids(faiss::IndexIVF& ivf, IVFIdTable& table, idx_t n, const float* x, const idx_t* xids) {
+    FAISS_THROW_IF_NOT(ivf.is_trained);
+    std::vector<idx_t> assign(n);
+    ivf.quantizer->assign(n, x, assign.data());
+
+    // IndexIVF::add_core appends to each list in input order, so the
+    // offsets are known up front
+    faiss::InvertedLists* invlists = ivf.invlists;
+    std::vector<size_t> list_size(invlists->nlist);
+    std::vector<bool> seen(invlists->nlist, false);
+    std::vector<idx_t> offsets(n, -1);
+    for (idx_t i = 0; i < n; i++) {
+        idx_t l = assign[i];
+        if (l < 0) {
+            continue;
+        }
+        if (!seen[l]) {
+            seen[l] = true;
+            list_size[l] = invlists->list_size(l);
+        }
+        offsets[i] = list_size[l]++;
+    }
+
+    std::vector<idx_t> ids(n);
+    for (idx_t i = 0; i < n; i++) {
+        ids[i] = xids ? xids[i] : ivf.ntotal + i;
+    }
+    ivf.add_core(n, x, ids.data(), assign.data());
+
+    bool in_order = true;
+    for (idx_t i = 0; i < n && in_order; i++) {
+        in_order = offsets[i] < 0 || invlists->get_single_id(assign[i], offsets[i]) == ids[i];
+    }
+    if (!in_order) {
+        // an index type that reorders on add
+        table.build(ivf);
+        return;
+    }
+    table.reserve(table.size + n);
+    for (idx_t i = 0; i < n; i++) {
+        if (offsets[i] >= 0) {
+            table.insert(ids[i], faiss::lo_build(assign[i], offsets[i]));
+        }
+    }
+}
+
+void ivf_update_vectors(faiss::IndexIVF& ivf, IVFIdTable& table, idx_t n, const idx_t* ids, const float* x) {
+    FAISS_THROW_IF_NOT_MSG(
+            ivf.direct_map.no(), "the index has its own DirectMap, use IndexIVF::update_vectors");
+    for (idx_t i = 0; i < n; i++) {
+        checked_entry(ivf, table, ids[i]);
+    }
+    std::vector<idx_t> assign(n);
+    ivf.quantizer->assign(n, x, assign.data());
+    const size_t code_size = ivf.code_size;
+    std::vector<uint8_t> codes(n * code_size);
+    ivf.encode_vectors(n, x, assign.data(), codes.data());
+
+    faiss::InvertedLists* invlists = ivf.invlists;
+    for (idx_t i = 0; i < n; i++) {
+        // an earlier update in the batch may have moved this entry
+        idx_t entry = table.lookup(ids[i]);
+        size_t l0 = faiss::lo_listno(entry), o0 = faiss::lo_offset(entry);
+        idx_t l1 = assign[i];
+        const uint8_t* code = codes.data() + i * code_size;
+        if (l1 == (idx_t)l0) {
+            invlists->update_entry(l0, o0, ids[i], code);
+            continue;
+        }
+        // remove from the old list by moving its last entry into the hole
+        size_t last = invlists->list_size(l0) - 1;
+        if (o0 != last) {
+            idx_t moved = invlists->get_single_id(l0, last);
+            faiss::InvertedLists::ScopedCodes moved_code(invlists, l0, last);
+            invlists->update_entry(l0, o0, moved, moved_code.get());
+            if (table.lookup(moved) == (idx_t)faiss::lo_build(l0, last)) {
+                table.insert(moved, faiss::lo_build(l0, o0));
+            }
+        }
+        invlists->resize(l0, last);
+        if (l1 >= 0) {
+            size_t o1 = invlists->add_entry(l1, ids[i], code);
+            table.insert(ids[i], faiss::lo_build(l1, o1));
+        }
+    }
+}
+
+size_t direct_map_memory(const faiss::DirectMap& dm) {
+    switch (dm.type) {
+        case faiss::DirectMap::Array:
+            return dm.array.capacity() * sizeof(idx_t);
+        case faiss::DirectMap::Hashtable:
+            // a node holds the next pointer and the pair, rounded up to the
+            // 32-byte malloc chunk, plus one bucket pointer per bucket
+            return dm.hashtable.size() * 32 + dm.hashtable.bucket_count() * sizeof(void*);
+        default:
+            return 0;
+    }
+}
+
+double make_direct_map_timed(faiss::IndexIVF& ivf, faiss::DirectMap::Type type) {
+    auto t0 = std::chrono::steady_clock::now();
+    ivf.set_direct_map_type(type);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,114 @@
+/**
+ * FAISS Go Extensions - open-addressing id table for IVF indexes
+ *
+ * DirectMap's Hashtable mode is a std::unordered_map: about 50 bytes per
+ * entry in nodes and buckets, and adds stall while it rehashes. IVFIdTable
+ * maps ids to inverted list entries (list number and offset, packed as in
+ * faiss::lo_build) in one flat array of (id, entry) slots with linear
+ * probing, at most 4/5 full: 20 bytes per entry after a build, up to 30
+ * as it grows by half on inserts, and no per-entry allocation. It is built from the inverted lists by all
+ * OpenMP threads at once, and its file format is the slot array itself,
+ * so it can be memory-mapped.
+ *
+ * The table lives next to the index rather than inside it (FAISS cannot
+ * be extended in place): reconstruct, add and update through the
+ * functions below to keep the two in sync, and rebuild the table after
+ * any other change to the inverted lists.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_IVF_ID_TABLE_H
+#define FAISS_GO_EXT_IVF_ID_TABLE_H
+
+#include <faiss/IndexIVF.h>
+#include <faiss/impl/maybe_owned_vector.h>
+#include <faiss/invlists/DirectMap.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct IVFIdTable {
+    /// (id, entry) pairs, id -1 marks an empty slot
+    faiss::MaybeOwnedVector<int64_t> slots;
+    size_t capacity = 0; ///< number of slots
+    size_t size = 0;     ///< number of ids
+
+    /// Rebuild from the inverted lists of ivf in parallel. For duplicate
+    /// ids the last entry wins, as in DirectMap.
+    void build(const faiss::IndexIVF& ivf);
+
+    /// entry of an id (faiss::lo_build), -1 if absent
+    idx_t lookup(idx_t id) const {
+        if (capacity == 0) {
+            return -1;
+        }
+        const int64_t* s = slots.data();
+        for (size_t h = slot_of(id);; h = next_slot(h)) {
+            if (s[2 * h] == id) {
+                return s[2 * h + 1];
+            }
+            if (s[2 * h] == -1) {
+                return -1;
+            }
+        }
+    }
+
+    /// insert or overwrite, growing the table if needed
+    void insert(idx_t id, idx_t entry);
+
+    /// make room for n ids without rehashing
+    void reserve(size_t n);
+
+    size_t memory_usage() const {
+        return capacity * 2 * sizeof(int64_t);
+    }
+
+    void write(const char* fname) const;
+
+    /// read a table file, as a view of the file if mmap is set
+    static IVFIdTable* read(const char* fname, bool mmap);
+
+    size_t slot_of(idx_t id) const {
+        // splitmix64 finalizer, ids are often sequential
+        uint64_t z = id;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z ^= z >> 31;
+        // maps the hash to [0, capacity) without a power-of-2 capacity
+        return (size_t)(((unsigned __int128)z * capacity) >> 64);
+    }
+
+    size_t next_slot(size_t h) const {
+        return h + 1 == capacity ? 0 : h + 1;
+    }
+};
+
+/// reconstruct vectors by id through the table
+void ivf_reconstruct_ids(
+        const faiss::IndexIVF& ivf,
+        const IVFIdTable& table,
+        idx_t n,
+        const idx_t* ids,
+        float* recons);
+
+/// add_with_ids on the index, recording the new entries in the table
+void ivf_add_with_ids(faiss::IndexIVF& ivf, IVFIdTable& table, idx_t n, const float* x, const idx_t* xids);
+
+/// replace the vectors of existing ids, moving them between inverted
+/// lists if their assignment changes (IndexIVF::update_vectors without a
+/// DirectMap)
+void ivf_update_vectors(faiss::IndexIVF& ivf, IVFIdTable& table, idx_t n, const idx_t* ids, const float* x);
+
+/// Estimated heap usage of a DirectMap: the array, or the nodes and
+/// buckets of the unordered_map.
+size_t direct_map_memory(const faiss::DirectMap& dm);
+
+/// ivf.set_direct_map_type, returns the time it took in milliseconds
+double make_direct_map_timed(faiss::IndexIVF& ivf, faiss::DirectMap::Type type);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_IVF_ID_TABLE_H */
@@ -0,0 +1,289 @@
+/**
+ * FAISS Go Extensions - deferred deletion for IVF indexes
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "ivf_tombstones.h"
+#include "search_params.h"
+
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// ids that are not deleted and, if set, pass the caller's selector
+struct LiveIDSelector : faiss::IDSelector {
+    const IVFIdTable* deleted;
+    const faiss::IDSelector* sel;
+
+    LiveIDSelector(const IVFIdTable* deleted, const faiss::IDSelector* sel)
+            : deleted(deleted), sel(sel) {}
+
+    bool is_member(idx_t id) const override {
+        return deleted->lookup(id) < 0 && (!sel || sel->is_member(id));
+    }
+};
+
+/// runs fn with IVF search parameters whose selector also drops the
+/// deleted ids. The selector goes into a copy of the caller's parameters
+/// (see search_params.h): searches run concurrently and may share them.
+template <class Fn>
+void with_live_params(
+        const faiss::IndexIVF& ivf,
+        const IVFIdTable& deleted,
+        const faiss::SearchParameters* params,
+        Fn fn) {
+    FAISS_THROW_IF_NOT_MSG(
+            !params || dynamic_cast<const faiss::SearchParametersIVF*>(params),
+            "search parameters must be SearchParametersIVF");
+    LiveIDSelector sel(&deleted, params ? params->sel : nullptr);
+    if (!params) {
+        faiss::SearchParametersIVF local;
+        local.nprobe = ivf.nprobe;
+        local.max_codes = ivf.max_codes;
+        local.sel = &sel;
+        fn(&local);
+        return;
+    }
+    std::unique_ptr<faiss::SearchParameters> local = copy_search_params(*params);
+    local->sel = &sel;
+    fn(local.get());
+}
+
+/// (id, old entry, new entry) of the entries a compaction moved
+typedef std::vector<std::tuple<idx_t, idx_t, idx_t>> MovedEntries;
+
+/// drop the deleted entries of a list, keeping the others in order
+size_t compact_list(
+        faiss::InvertedLists* invlists,
+        const IVFIdTable& deleted,
+        idx_t l,
+        MovedEntries* moved,
+        std::vector<idx_t>* removed_ids) {
+    const size_t list_size = invlists->list_size(l);
+    if (list_size == 0) {
+        return 0;
+    }
+    const size_t code_size = invlists->code_size;
+    size_t w = 0;
+    {
+        faiss::InvertedLists::ScopedIds ids(invlists, l);
+        faiss::InvertedLists::ScopedCodes codes(invlists, l);
+        for (size_t o = 0; o < list_size; o++) {
+            idx_t id = ids[o];
+            if (deleted.lookup(id) >= 0) {
+                if (removed_ids) {
+                    removed_ids->push_back(id);
+                }
+                continue;
+            }
+            if (w != o) {
+                // w < o, so the entry is read before anything overwrites it
+                invlists->update_entry(l, w, id, codes.get() + o * code_size);
+                if (moved) {
+                    moved->emplace_back(id, faiss::lo_build(l, o), faiss::lo_build(l, w));
+                }
+            }
+            w++;
+        }
+    }
+    if (w < list_size) {
+        invlists->resize(l, w);
+    }
+    return list_size - w;
+}
+
+} // namespace
+
+IVFTombstones::IVFTombstones(faiss::IndexIVF* ivf)
+        : ivf(ivf), tombstones(std::make_shared<IVFIdTable>()) {
+    FAISS_THROW_IF_NOT(ivf && ivf->invlists);
+    dirty.assign(ivf->nlist, false);
+}
+
+std::shared_ptr<const IVFIdTable> IVFTombstones::current() const {
+    std::lock_guard<std::mutex> lock(version_mutex);
+    return tombstones;
+}
+
+size_t IVFTombstones::remove(idx_t n, const idx_t* ids) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    const faiss::DirectMap& dm = ivf->direct_map;
+    FAISS_THROW_IF_NOT_MSG(
+            dm.type != faiss::DirectMap::Array,
+            "deletes are not supported with a DirectMap Array, use Hashtable");
+
+    std::shared_ptr<const IVFIdTable> old = current();
+    auto next = std::make_shared<IVFIdTable>(*old);
+    next->reserve(old->size + n);
+    size_t added = 0;
+    for (idx_t i = 0; i < n; i++) {
+        idx_t id = ids[i];
+        if (id < 0 || next->lookup(id) >= 0) {
+            continue;
+        }
+        if (dm.type == faiss::DirectMap::Hashtable) {
+            auto it = dm.hashtable.find(id);
+            if (it == dm.hashtable.end()) {
+                continue; // not in the index
+            }
+            size_t l = faiss::lo_listno(it->second);
+            n_dirty += !dirty[l];
+            dirty[l] = true;
+        } else {
+            all_dirty = true;
+        }
+        next->insert(id, 0);
+        added++;
+    }
+
+    std::lock_guard<std::mutex> vlock(version_mutex);
+    tombstones = next;
+    return added;
+}
+
+bool IVFTombstones::is_deleted(idx_t id) const {
+    return current()->lookup(id) >= 0;
+}
+
+size_t IVFTombstones::compact(size_t lists_per_batch) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    return compact_locked(lists_per_batch);
+}
+
+size_t IVFTombstones::compact_locked(size_t lists_per_batch) {
+    FAISS_THROW_IF_NOT(lists_per_batch > 0);
+    auto t0 = std::chrono::steady_clock::now();
+    std::shared_ptr<const IVFIdTable> deleted = current();
+    if (deleted->size == 0) {
+        return 0;
+    }
+
+    std::vector<idx_t> lists;
+    for (size_t l = 0; l < ivf->nlist; l++) {
+        if (all_dirty || dirty[l]) {
+            lists.push_back(l);
+        }
+    }
+    faiss::DirectMap& dm = ivf->direct_map;
+    const bool update_dm = dm.type == faiss::DirectMap::Hashtable;
+
+    size_t removed_total = 0;
+    for (size_t b0 = 0; b0 < lists.size(); b0 += lists_per_batch) {
+        const size_t nb = std::min(lists_per_batch, lists.size() - b0);
+        std::vector<MovedEntries> moved(update_dm ? nb : 0);
+        std::vector<std::vector<idx_t>> removed_ids(update_dm ? nb : 0);
+        size_t removed = 0;
+
+        // searches wait only for this batch
+        std::unique_lock<std::shared_mutex> lists_lock(lists_mutex);
+#pragma omp parallel for schedule(dynamic) reduction(+ : removed)
+        for (size_t j = 0; j < nb; j++) {
+            removed += compact_list(
+                    ivf->invlists,
+                    *deleted,
+                    lists[b0 + j],
+                    update_dm ? &moved[j] : nullptr,
+                    update_dm ? &removed_ids[j] : nullptr);
+        }
+        if (update_dm) {
+            for (size_t j = 0; j < nb; j++) {
+                for (idx_t id : removed_ids[j]) {
+                    dm.hashtable.erase(id);
+                }
+                // with duplicate ids the map points to one of the copies
+                for (const auto& m : moved[j]) {
+                    auto it = dm.hashtable.find(std::get<0>(m));
+                    if (it != dm.hashtable.end() && it->second == std::get<1>(m)) {
+                        it->second = std::get<2>(m);
+                    }
+                }
+            }
+        }
+        ivf->ntotal -= removed;
+        removed_total += removed;
+    }
+
+    {
+        std::lock_guard<std::mutex> vlock(version_mutex);
+        tombstones = std::make_shared<IVFIdTable>();
+    }
+    dirty.assign(ivf->nlist, false);
+    n_dirty = 0;
+    all_dirty = false;
+    n_compacted += removed_total;
+    auto t1 = std::chrono::steady_clock::now();
+    last_compact_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    return removed_total;
+}
+
+void IVFTombstones::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params) const {
+    std::shared_lock<std::shared_mutex> lock(lists_mutex);
+    std::shared_ptr<const IVFIdTable> deleted = current();
+    if (deleted->size == 0) {
+        ivf->search(n, x, k, distances, labels, params);
+        return;
+    }
+    with_live_params(*ivf, *deleted, params, [&](const faiss::SearchParameters* p) {
+        ivf->search(n, x, k, distances, labels, p);
+    });
+}
+
+void IVFTombstones::range_search(
+        idx_t n,
+        const float* x,
+        float radius,
+        faiss::RangeSearchResult* result,
+        const faiss::SearchParameters* params) const {
+    std::shared_lock<std::shared_mutex> lock(lists_mutex);
+    std::shared_ptr<const IVFIdTable> deleted = current();
+    if (deleted->size == 0) {
+        ivf->range_search(n, x, radius, result, params);
+        return;
+    }
+    with_live_params(*ivf, *deleted, params, [&](const faiss::SearchParameters* p) {
+        ivf->range_search(n, x, radius, result, p);
+    });
+}
+
+void IVFTombstones::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    std::shared_ptr<const IVFIdTable> deleted = current();
+    bool readded = false;
+    for (idx_t i = 0; xids && i < n && !readded; i++) {
+        readded = deleted->lookup(xids[i]) >= 0;
+    }
+    // the new copy would be hidden by the tombstone of the old one
+    if (readded) {
+        compact_locked(64);
+    }
+    std::unique_lock<std::shared_mutex> lists_lock(lists_mutex);
+    ivf->add_with_ids(n, x, xids);
+}
+
+TombstoneStats IVFTombstones::stats() const {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    TombstoneStats s;
+    s.n_pending = current()->size;
+    s.n_dirty_lists = all_dirty ? -1 : (idx_t)n_dirty;
+    s.n_compacted = n_compacted;
+    s.last_compact_ms = last_compact_ms;
+    return s;
+}
+
+} // namespace faiss_go_ext
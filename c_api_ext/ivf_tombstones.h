@@ -0,0 +1,107 @@
+/**
+ * FAISS Go Extensions - deferred deletion for IVF indexes
+ *
+ * IndexIVF::remove_ids scans every inverted list, and no search can run
+ * while it does. With IVFTombstones, deletes only record the ids in a
+ * tombstone set, which searches made through this object skip via the
+ * IDSelector hook of the scanners. compact() later rewrites just the
+ * lists that hold deleted entries, in parallel and in batches of lists,
+ * letting searches run between the batches.
+ *
+ * The lists to rewrite are found through the index's DirectMap
+ * (Hashtable; Array maps cannot remove entries). Without a DirectMap,
+ * compact() visits every list, but still rewrites only the ones that
+ * contain deleted ids.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_IVF_TOMBSTONES_H
+#define FAISS_GO_EXT_IVF_TOMBSTONES_H
+
+#include "ivf_id_table.h"
+
+#include <faiss/IndexIVF.h>
+#include <faiss/impl/AuxIndexStructures.h>
+
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct TombstoneStats {
+    size_t n_pending = 0;     ///< deleted ids not compacted yet
+    idx_t n_dirty_lists = 0;  ///< lists holding them, -1 if unknown (no DirectMap)
+    size_t n_compacted = 0;   ///< entries removed by compaction so far
+    double last_compact_ms = 0;
+};
+
+/// Deferred deletes for an IVF index, which is not owned. Searches,
+/// deletes, adds and compaction through this object can run from
+/// several threads; searches made on the index directly still see the
+/// deleted vectors until compaction.
+struct IVFTombstones {
+    explicit IVFTombstones(faiss::IndexIVF* ivf);
+
+    /// record deletes, returns the number of ids newly deleted
+    size_t remove(idx_t n, const idx_t* ids);
+
+    /// true if the id is deleted but not compacted
+    bool is_deleted(idx_t id) const;
+
+    /// rewrite the lists holding deleted entries, lists_per_batch at a
+    /// time under the exclusive lock. Returns the number of entries removed.
+    size_t compact(size_t lists_per_batch = 64);
+
+    /// params must be a SearchParametersIVF or null; its selector, if any,
+    /// is combined with the tombstones
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::SearchParameters* params = nullptr) const;
+
+    void range_search(
+            idx_t n,
+            const float* x,
+            float radius,
+            faiss::RangeSearchResult* result,
+            const faiss::SearchParameters* params = nullptr) const;
+
+    /// add_with_ids on the index; compacts first if a pending deleted id
+    /// is added again
+    void add_with_ids(idx_t n, const float* x, const idx_t* xids);
+
+    TombstoneStats stats() const;
+
+    faiss::IndexIVF* ivf;
+
+    /// serializes remove, add and compact
+    mutable std::mutex write_mutex;
+    /// shared by searches, exclusive while lists are rewritten
+    mutable std::shared_mutex lists_mutex;
+    /// guards the tombstones pointer
+    mutable std::mutex version_mutex;
+
+    /// immutable set of deleted ids (entries unused), replaced on each remove
+    std::shared_ptr<const IVFIdTable> tombstones;
+    std::vector<bool> dirty; ///< lists with deleted entries
+    size_t n_dirty = 0;
+    bool all_dirty = false; ///< deletes without DirectMap: visit all lists
+    size_t n_compacted = 0;
+    double last_compact_ms = 0;
+
+    std::shared_ptr<const IVFIdTable> current() const;
+    size_t compact_locked(size_t lists_per_batch);
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_IVF_TOMBSTONES_H */
@@ -0,0 +1,293 @@
+/**
+ * FAISS Go Extensions - NUMA placement of index memory
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "numa_placement.h"
+
+#include "idmap_sorted.h"
+#include "numa_topology.h"
+
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/clone_index.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/index_io.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace faiss_go_ext {
+
+namespace {
+
+// from <linux/mempolicy.h>, which is not installed everywhere
+constexpr int kMpolPreferred = 1;
+constexpr int kMpolInterleave = 3;
+constexpr unsigned kMpolMfMove = 1 << 1;
+
+/// ranges closer than this are placed with one mbind call, so that the
+/// many small inverted lists of an index do not split the heap mapping
+/// into one VMA each
+constexpr size_t kMergeGap = 64;
+
+/// a buffer of the index; relocate() copies it to memory first-touched by
+/// the calling thread
+struct Region {
+    const void* data;
+    size_t size;
+    std::function<void()> relocate;
+};
+
+size_t page_size() {
+#ifdef __linux__
+    static const size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+template <class T>
+void add_region(std::vector<Region>& regions, faiss::MaybeOwnedVector<T>& v) {
+    if (!v.is_owned || v.size() == 0) {
+        return;
+    }
+    faiss::MaybeOwnedVector<T>* pv = &v;
+    regions.push_back({v.data(), v.size() * sizeof(T), [pv]() {
+                           std::vector<T> fresh(pv->data(), pv->data() + pv->size());
+                           *pv = faiss::MaybeOwnedVector<T>(std::move(fresh));
+                       }});
+}
+
+template <class T>
+void add_region(std::vector<Region>& regions, std::vector<T>& v) {
+    if (v.empty()) {
+        return;
+    }
+    std::vector<T>* pv = &v;
+    regions.push_back({v.data(), v.size() * sizeof(T), [pv]() {
+                           std::vector<T> fresh(*pv);
+                           pv->swap(fresh);
+                       }});
+}
+
+void collect_regions(faiss::Index* index, std::vector<Region>& regions) {
+    if (!index) {
+        return;
+    }
+    if (auto* idmap = dynamic_cast<faiss::IndexIDMap*>(index)) {
+        add_region(regions, idmap->id_map);
+        collect_regions(idmap->index, regions);
+    } else if (auto* idmap3 = dynamic_cast<IndexIDMap3*>(index)) {
+        add_region(regions, idmap3->id_map);
+        add_region(regions, idmap3->sorted_ids);
+        add_region(regions, idmap3->sorted_pos);
+        collect_regions(idmap3->index, regions);
+    } else if (auto* pt = dynamic_cast<faiss::IndexPreTransform*>(index)) {
+        collect_regions(pt->index, regions);
+    } else if (auto* refine = dynamic_cast<faiss::IndexRefine*>(index)) {
+        collect_regions(refine->base_index, regions);
+        collect_regions(refine->refine_index, regions);
+    } else if (auto* ivf = dynamic_cast<faiss::IndexIVF*>(index)) {
+        collect_regions(ivf->quantizer, regions);
+        if (auto* ails = dynamic_cast<faiss::ArrayInvertedLists*>(ivf->invlists)) {
+            for (size_t l = 0; l < ails->nlist; l++) {
+                add_region(regions, ails->codes[l]);
+                add_region(regions, ails->ids[l]);
+            }
+        }
+    } else if (auto* hnsw = dynamic_cast<faiss::IndexHNSW*>(index)) {
+        collect_regions(hnsw->storage, regions);
+        add_region(regions, hnsw->hnsw.neighbors);
+        add_region(regions, hnsw->hnsw.offsets);
+        add_region(regions, hnsw->hnsw.levels);
+    } else if (auto* flat = dynamic_cast<faiss::IndexFlatCodes*>(index)) {
+        add_region(regions, flat->codes);
+    }
+}
+
+/// page-aligned [begin, end) ranges covering the regions, merged
+std::vector<std::pair<uintptr_t, uintptr_t>> page_ranges(const std::vector<Region>& regions) {
+    const uintptr_t ps = page_size();
+    std::vector<std::pair<uintptr_t, uintptr_t>> ranges;
+    for (const Region& r : regions) {
+        uintptr_t begin = (uintptr_t)r.data & ~(ps - 1);
+        uintptr_t end = ((uintptr_t)r.data + r.size + ps - 1) & ~(ps - 1);
+        ranges.emplace_back(begin, end);
+    }
+    std::sort(ranges.begin(), ranges.end());
+    std::vector<std::pair<uintptr_t, uintptr_t>> merged;
+    for (const auto& r : ranges) {
+        if (!merged.empty() && r.first <= merged.back().second + kMergeGap * ps) {
+            merged.back().second = std::max(merged.back().second, r.second);
+        } else {
+            merged.push_back(r);
+        }
+    }
+    return merged;
+}
+
+/// mbind over all ranges; false as soon as one call fails
+bool mbind_ranges(const std::vector<Region>& regions, int mode, const std::vector<int>& os_nodes) {
+#if defined(__linux__) && defined(SYS_mbind)
+    int max_node = *std::max_element(os_nodes.begin(), os_nodes.end());
+    const size_t bits = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(max_node / bits + 1, 0);
+    for (int node : os_nodes) {
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+    // the kernel reads maxnode - 1 bits
+    unsigned long maxnode = mask.size() * bits + 1;
+    for (const auto& r : page_ranges(regions)) {
+        if (syscall(SYS_mbind, (void*)r.first, r.second - r.first, mode, mask.data(), maxnode,
+                    kMpolMfMove) != 0) {
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+NumaPlacementResult numa_place_index(
+        faiss::Index* index,
+        NumaPolicy policy,
+        const std::vector<int>& nodes_in) {
+    FAISS_THROW_IF_NOT(index);
+    FAISS_THROW_IF_NOT(policy == NUMA_BIND || policy == NUMA_INTERLEAVE);
+    const NumaTopology& topo = numa_topology();
+    std::vector<int> nodes = nodes_in;
+    if (nodes.empty()) {
+        for (int node = 0; node < numa_num_nodes(); node++) {
+            nodes.push_back(node);
+        }
+    }
+    for (int node : nodes) {
+        FAISS_THROW_IF_NOT_MSG(node >= 0 && node < numa_num_nodes(), "NUMA node out of range");
+    }
+    if (policy == NUMA_BIND) {
+        nodes.resize(1);
+    }
+
+    std::vector<Region> regions;
+    collect_regions(index, regions);
+    NumaPlacementResult result;
+    for (const Region& r : regions) {
+        result.n_bytes += r.size;
+    }
+    if (regions.empty()) {
+        return result;
+    }
+
+    std::vector<int> os_nodes;
+    for (int node : nodes) {
+        os_nodes.push_back(topo.node_ids[node]);
+    }
+    int mode = policy == NUMA_BIND ? kMpolPreferred : kMpolInterleave;
+    if (mbind_ranges(regions, mode, os_nodes)) {
+        return result;
+    }
+
+    // first-touch fallback: whole buffers are copied by a worker on their
+    // target node, rotating over the nodes for interleave
+    result.used_mbind = false;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        run_on_node(nodes[i], [&]() {
+            for (size_t r = i; r < regions.size(); r += nodes.size()) {
+                regions[r].relocate();
+            }
+        });
+    }
+    return result;
+}
+
+bool numa_index_pages(const faiss::Index* index, std::vector<size_t>* pages_per_node) {
+    FAISS_THROW_IF_NOT(index && pages_per_node);
+    pages_per_node->clear();
+#if defined(__linux__) && defined(SYS_move_pages)
+    std::vector<Region> regions;
+    // only the addresses are read
+    collect_regions(const_cast<faiss::Index*>(index), regions);
+    const uintptr_t ps = page_size();
+    std::vector<void*> pages;
+    for (const auto& r : page_ranges(regions)) {
+        for (uintptr_t p = r.first; p < r.second; p += ps) {
+            pages.push_back((void*)p);
+        }
+    }
+
+    // with a NULL node array move_pages reports the node of each page
+    const size_t chunk = 4096;
+    std::vector<int> status(chunk);
+    for (size_t i0 = 0; i0 < pages.size(); i0 += chunk) {
+        size_t n = std::min(chunk, pages.size() - i0);
+        if (syscall(SYS_move_pages, 0, n, pages.data() + i0, nullptr, status.data(), 0) != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+            // negative status: page not present
+            if (status[i] < 0) {
+                continue;
+            }
+            if ((size_t)status[i] >= pages_per_node->size()) {
+                pages_per_node->resize(status[i] + 1, 0);
+            }
+            (*pages_per_node)[status[i]]++;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+namespace {
+
+/// replicas of base, replica i cloned on node i; node 0 takes base itself
+faiss::IndexReplicas* replicate_per_node(std::unique_ptr<faiss::Index> base, const faiss::Index& src) {
+    std::unique_ptr<faiss::IndexReplicas> replicas(new faiss::IndexReplicas(src.d, true));
+    replicas->own_indices = true;
+    for (int node = 0; node < numa_num_nodes(); node++) {
+        std::unique_ptr<faiss::Index> copy;
+        run_on_node(node, [&]() {
+            copy.reset(node == 0 && base ? base.release() : faiss::clone_index(&src));
+            numa_place_index(copy.get(), NUMA_BIND, {node});
+        });
+        replicas->addIndex(copy.get());
+        copy.release();
+    }
+    return replicas.release();
+}
+
+} // namespace
+
+faiss::IndexReplicas* replicate_index_per_node(const faiss::Index& index) {
+    return replicate_per_node(nullptr, index);
+}
+
+faiss::IndexReplicas* read_index_per_node(const char* fname, int io_flags) {
+    FAISS_THROW_IF_NOT(fname);
+    std::unique_ptr<faiss::Index> base;
+    run_on_node(0, [&]() { base.reset(faiss::read_index(fname, io_flags)); });
+    const faiss::Index& src = *base;
+    return replicate_per_node(std::move(base), src);
+}
+
+} // namespace faiss_go_ext
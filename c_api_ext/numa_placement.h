@@ -0,0 +1,65 @@
+/**
+ * FAISS Go Extensions - NUMA placement of index memory
+ *
+ * An index read by one thread is first-touched on that thread's node, so
+ * on a multi-socket host every query pays remote-memory latency from the
+ * OpenMP threads of the other sockets. The functions here either spread
+ * the index pages over nodes (interleave), move them to one node (bind),
+ * or build one copy of the index per node (replicate).
+ *
+ * Pages are moved with the mbind(2) / move_pages(2) system calls directly,
+ * so libnuma is not required. Where those calls are unavailable (non-Linux
+ * systems, seccomp filters) the buffers are copied from a thread pinned to
+ * the target node instead, and the first touch places them: whole buffers
+ * rotate over the nodes for interleave.
+ *
+ * Placement covers the inverted lists and quantizer of IVF indexes, flat
+ * code arrays, and the storage and graph of HNSW, through IDMap, IDMap3,
+ * PreTransform and Refine wrappers. Memory-mapped data is left alone.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_NUMA_PLACEMENT_H
+#define FAISS_GO_EXT_NUMA_PLACEMENT_H
+
+#include <faiss/Index.h>
+#include <faiss/IndexReplicas.h>
+
+#include <vector>
+
+namespace faiss_go_ext {
+
+enum NumaPolicy {
+    NUMA_BIND = 0,       ///< all pages on the first node
+    NUMA_INTERLEAVE = 1, ///< pages round-robin over the nodes
+};
+
+struct NumaPlacementResult {
+    size_t n_bytes = 0;     ///< bytes of index data placed
+    bool used_mbind = true; ///< false if placed by first-touch copies
+};
+
+/// Place the memory of an index over nodes (topology numbering, see
+/// numa_topology.h; empty = all nodes). Copies in the fallback path
+/// reallocate buffers, so the index must not be searched concurrently.
+NumaPlacementResult numa_place_index(
+        faiss::Index* index,
+        NumaPolicy policy,
+        const std::vector<int>& nodes);
+
+/// Count the resident pages of an index per OS node number (move_pages
+/// query). Returns false where the query is not supported.
+bool numa_index_pages(const faiss::Index* index, std::vector<size_t>* pages_per_node);
+
+/// One copy of index per node, each cloned on and bound to its node.
+/// Replica i lives on node i; the result owns the copies.
+faiss::IndexReplicas* replicate_index_per_node(const faiss::Index& index);
+
+/// Read an index file once and replicate it per node as above.
+faiss::IndexReplicas* read_index_per_node(const char* fname, int io_flags);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_NUMA_PLACEMENT_H */
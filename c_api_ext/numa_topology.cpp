@@ -0,0 +1,221 @@
+/**
+ * FAISS Go Extensions - NUMA topology and thread pinning
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "numa_topology.h"
+
+#include <faiss/impl/FaissAssert.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// parse a sysfs CPU list such as "0-3,8-11"
+std::vector<int> parse_cpu_list(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int lo = std::atoi(range.substr(0, dash).c_str());
+        int hi = dash == std::string::npos ? lo : std::atoi(range.substr(dash + 1).c_str());
+        for (int c = lo; c <= hi; c++) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+bool read_cpu_list(const std::string& path, std::vector<int>* cpus) {
+    std::ifstream f(path);
+    std::string line;
+    if (!f || !std::getline(f, line)) {
+        return false;
+    }
+    *cpus = parse_cpu_list(line);
+    return true;
+}
+
+NumaTopology detect_topology() {
+    NumaTopology topo;
+    std::vector<int> online;
+    if (!read_cpu_list("/sys/devices/system/cpu/online", &online) || online.empty()) {
+        int n = std::max(1u, std::thread::hardware_concurrency());
+        for (int c = 0; c < n; c++) {
+            online.push_back(c);
+        }
+    }
+
+    const char* env = getenv("FAISS_GO_EXT_NUMA_NODES");
+    int emulate = env ? std::atoi(env) : 0;
+    if (emulate > 0) {
+        topo.emulated = true;
+        size_t nc = online.size();
+        for (int node = 0; node < emulate; node++) {
+            size_t c0 = node * nc / emulate, c1 = (node + 1) * nc / emulate;
+            std::vector<int> cpus(online.begin() + c0, online.begin() + c1);
+            if (cpus.empty()) {
+                cpus.push_back(online[node % nc]);
+            }
+            topo.node_cpus.push_back(cpus);
+            topo.node_ids.push_back(0);
+        }
+        return topo;
+    }
+
+    std::vector<int> nodes;
+    if (read_cpu_list("/sys/devices/system/node/online", &nodes)) {
+        for (int node : nodes) {
+            std::vector<int> cpus;
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            // memory-only nodes have an empty CPU list
+            if (read_cpu_list(path, &cpus) && !cpus.empty()) {
+                topo.node_cpus.push_back(cpus);
+                topo.node_ids.push_back(node);
+            }
+        }
+    }
+    if (topo.node_cpus.empty()) {
+        topo.node_cpus.push_back(online);
+        topo.node_ids.push_back(0);
+    }
+    return topo;
+}
+
+} // namespace
+
+const NumaTopology& numa_topology() {
+    static const NumaTopology topo = detect_topology();
+    return topo;
+}
+
+int numa_num_nodes() {
+    return numa_topology().node_cpus.size();
+}
+
+bool pin_thread_to_node(int node) {
+    const NumaTopology& topo = numa_topology();
+    if (node < 0 || node >= (int)topo.node_cpus.size()) {
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int c : topo.node_cpus[node]) {
+        CPU_SET(c, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+/* ============================================================
+ * NodeWorker
+ * ============================================================ */
+
+namespace {
+
+/// worker running on the current thread, if any
+thread_local const NodeWorker* current_worker = nullptr;
+
+} // namespace
+
+NodeWorker::NodeWorker(int node) : node(node) {
+    thread = std::thread([this]() { run(); });
+}
+
+NodeWorker::~NodeWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    cv.notify_one();
+    thread.join();
+}
+
+void NodeWorker::enqueue(std::function<void()> task) {
+    n_pending++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(task));
+    }
+    cv.notify_one();
+}
+
+void NodeWorker::run() {
+    current_worker = this;
+    if (node >= 0 && pin_thread_to_node(node)) {
+        omp_set_num_threads(numa_topology().node_cpus[node].size());
+    }
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this]() { return stop || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+        n_pending--;
+    }
+}
+
+void run_on_node(int node, const std::function<void()>& fn) {
+    FAISS_THROW_IF_NOT_MSG(node >= 0 && node < numa_num_nodes(), "NUMA node out of range");
+
+    // created on first use and never destroyed: tasks may still be
+    // submitted from other static destructors at exit
+    static std::mutex mutex;
+    static std::vector<NodeWorker*>* workers = new std::vector<NodeWorker*>(numa_num_nodes());
+    NodeWorker* worker;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!(*workers)[node]) {
+            (*workers)[node] = new NodeWorker(node);
+        }
+        worker = (*workers)[node];
+    }
+    if (current_worker == worker) {
+        fn();
+        return;
+    }
+
+    auto done = std::make_shared<std::promise<void>>();
+    worker->enqueue([&fn, done]() {
+        try {
+            fn();
+            done->set_value();
+        } catch (...) {
+            done->set_exception(std::current_exception());
+        }
+    });
+    done->get_future().get();
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,83 @@
+/**
+ * FAISS Go Extensions - NUMA topology and thread pinning
+ *
+ * The node -> CPU map is read once from /sys/devices/system/node. Setting
+ * FAISS_GO_EXT_NUMA_NODES=N splits the online CPUs into N emulated nodes,
+ * which exercises the NUMA code paths on single-socket machines. On
+ * systems without the sysfs tree (macOS) there is one node and pinning is
+ * a no-op.
+ *
+ * Pinning a goroutine's OS thread from Go does not stick, so work that
+ * must run on a node goes through a NodeWorker: a long-lived thread pinned
+ * to the node, whose OpenMP team is sized to the node's CPUs and inherits
+ * its affinity.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_NUMA_TOPOLOGY_H
+#define FAISS_GO_EXT_NUMA_TOPOLOGY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace faiss_go_ext {
+
+/// Nodes with CPUs, numbered 0..n-1. node_ids maps them back to the OS
+/// node numbers (all 0 for emulated nodes).
+struct NumaTopology {
+    std::vector<std::vector<int>> node_cpus; ///< CPUs of each node
+    std::vector<int> node_ids;               ///< OS node number of each node
+    bool emulated = false;                   ///< from FAISS_GO_EXT_NUMA_NODES
+};
+
+/// Topology of the host (detected on first use).
+const NumaTopology& numa_topology();
+
+/// Number of NUMA nodes, at least 1.
+int numa_num_nodes();
+
+/// Restrict the calling thread to the CPUs of a node. OpenMP teams started
+/// from this thread afterwards inherit the mask.
+/// @return false if the node does not exist or pinning is not supported
+bool pin_thread_to_node(int node);
+
+/// Thread pinned to a node (not pinned for node -1) that runs tasks in
+/// submission order. The destructor runs the queued tasks, then joins.
+struct NodeWorker {
+    explicit NodeWorker(int node);
+    ~NodeWorker();
+
+    void enqueue(std::function<void()> task);
+
+    /// tasks queued or running
+    int depth() const {
+        return n_pending;
+    }
+
+    const int node;
+
+   private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> queue;
+    bool stop = false;
+    std::atomic<int> n_pending{0};
+    std::thread thread;
+
+    void run();
+};
+
+/// Run fn on the shared worker of a node and wait for it. Exceptions are
+/// rethrown in the caller. Calls from the worker itself run inline.
+void run_on_node(int node, const std::function<void()>& fn);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_NUMA_TOPOLOGY_H */
@@ -0,0 +1,118 @@
+/**
+ * FAISS Go Extensions - conversion of flat-storage indexes to Panorama
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "panorama_convert.h"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <memory>
+
+namespace faiss_go_ext {
+
+faiss::IndexIVFFlatPanorama* ivf_flat_to_panorama(faiss::IndexIVFFlat* src, int n_levels) {
+    FAISS_THROW_IF_NOT(src);
+    FAISS_THROW_IF_NOT_MSG(
+            !dynamic_cast<faiss::IndexIVFFlatPanorama*>(src), "index is already Panorama");
+    FAISS_THROW_IF_NOT_MSG(src->metric_type == faiss::METRIC_L2, "Panorama supports L2 only");
+    FAISS_THROW_IF_NOT(n_levels > 0 && n_levels <= src->d);
+
+    std::unique_ptr<faiss::IndexIVFFlatPanorama> dst(new faiss::IndexIVFFlatPanorama(
+            src->quantizer, src->d, src->nlist, n_levels, faiss::METRIC_L2, true));
+    dst->is_trained = src->is_trained;
+    dst->nprobe = src->nprobe;
+    dst->max_codes = src->max_codes;
+    dst->parallel_mode = src->parallel_mode;
+
+    faiss::InvertedLists* in = src->invlists;
+    faiss::InvertedLists* out = dst->invlists;
+    bool failed = false;
+
+    // add_entries on distinct lists may run concurrently; it also
+    // transposes the vectors and computes their cumulative sums
+#pragma omp parallel for schedule(dynamic)
+    for (int64_t list_no = 0; list_no < (int64_t)src->nlist; list_no++) {
+        try {
+            size_t list_size = in->list_size(list_no);
+            if (list_size > 0) {
+                faiss::InvertedLists::ScopedCodes codes(in, list_no);
+                faiss::InvertedLists::ScopedIds ids(in, list_no);
+                out->add_entries(list_no, list_size, ids.get(), codes.get());
+            }
+        } catch (...) {
+#pragma omp critical
+            failed = true;
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!failed, "failed to copy the inverted lists");
+
+    dst->ntotal = src->ntotal;
+    if (src->direct_map.type != faiss::DirectMap::NoMap) {
+        dst->set_direct_map_type(src->direct_map.type);
+    }
+
+    // nothing can fail past this point: release the source lists, which
+    // keep a valid, empty state
+    if (auto* array_in = dynamic_cast<faiss::ArrayInvertedLists*>(in)) {
+        for (size_t list_no = 0; list_no < src->nlist; list_no++) {
+            array_in->codes[list_no] = faiss::MaybeOwnedVector<uint8_t>();
+            array_in->ids[list_no] = faiss::MaybeOwnedVector<faiss::idx_t>();
+        }
+    }
+    src->ntotal = 0;
+    src->direct_map.clear();
+    dst->own_fields = src->own_fields;
+    src->own_fields = false;
+    return dst.release();
+}
+
+faiss::IndexHNSWFlatPanorama* hnsw_flat_to_panorama(faiss::IndexHNSWFlat* src, int n_levels) {
+    FAISS_THROW_IF_NOT(src);
+    FAISS_THROW_IF_NOT_MSG(
+            !dynamic_cast<faiss::IndexHNSWFlatPanorama*>(src), "index is already Panorama");
+    FAISS_THROW_IF_NOT_MSG(src->metric_type == faiss::METRIC_L2, "Panorama supports L2 only");
+    FAISS_THROW_IF_NOT(n_levels > 0 && n_levels <= src->d);
+    auto* storage = dynamic_cast<faiss::IndexFlat*>(src->storage);
+    FAISS_THROW_IF_NOT_MSG(storage, "HNSW storage must be an IndexFlat");
+
+    std::unique_ptr<faiss::IndexHNSWFlatPanorama> dst(new faiss::IndexHNSWFlatPanorama(
+            src->d, src->hnsw.nb_neighbors(1), n_levels, faiss::METRIC_L2));
+
+    const size_t n = src->ntotal;
+    const size_t stride = n_levels + 1;
+    const float* xb = storage->get_xb();
+    dst->cum_sums.resize(n * stride);
+
+#pragma omp parallel for
+    for (int64_t i = 0; i < (int64_t)n; i++) {
+        faiss::IndexHNSWFlatPanorama::compute_cum_sums(
+                xb + i * src->d, &dst->cum_sums[i * stride], src->d, n_levels,
+                dst->panorama_level_width);
+    }
+
+    // hand over the graph (keeping the Panorama search mode) and storage
+    dst->hnsw = std::move(src->hnsw);
+    dst->hnsw.is_panorama = true;
+    if (dst->own_fields) {
+        delete dst->storage;
+    }
+    dst->storage = src->storage;
+    dst->own_fields = src->own_fields;
+    dst->ntotal = n;
+    dst->is_trained = src->is_trained;
+    dst->init_level0 = src->init_level0;
+    dst->keep_max_size_level0 = src->keep_max_size_level0;
+
+    src->storage = nullptr;
+    src->own_fields = false;
+    src->hnsw = faiss::HNSW();
+    src->ntotal = 0;
+    return dst.release();
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,36 @@
+/**
+ * FAISS Go Extensions - conversion of flat-storage indexes to Panorama
+ *
+ * Panorama indexes keep the same vectors as their plain counterparts plus
+ * per-level cumulative norms, stored in a level-major layout. The
+ * converters move the trained quantizer / graph and the stored vectors of
+ * an existing index into a new Panorama index, computing the cumulative
+ * sums in parallel, instead of re-adding the raw data.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_PANORAMA_CONVERT_H
+#define FAISS_GO_EXT_PANORAMA_CONVERT_H
+
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexIVFFlatPanorama.h>
+
+namespace faiss_go_ext {
+
+/// Build an IndexIVFFlatPanorama from an L2 IndexIVFFlat. The lists are
+/// copied in parallel and the source ones released only once every copy
+/// succeeded, so a failure leaves the source untouched (at the cost of two
+/// copies of the data at peak). Takes over the quantizer ownership; the
+/// caller still owns (and should delete) the emptied source.
+faiss::IndexIVFFlatPanorama* ivf_flat_to_panorama(faiss::IndexIVFFlat* src, int n_levels);
+
+/// Build an IndexHNSWFlatPanorama from an L2 IndexHNSWFlat, taking over
+/// its graph and vector storage. The caller still owns the emptied source.
+faiss::IndexHNSWFlatPanorama* hnsw_flat_to_panorama(faiss::IndexHNSWFlat* src, int n_levels);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_PANORAMA_CONVERT_H */
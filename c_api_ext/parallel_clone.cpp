@@ -0,0 +1,411 @@
+/**
+ * FAISS Go Extensions - parallel and copy-on-write clones, parallel merges
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "parallel_clone.h"
+#include "idmap_sorted.h"
+
+#include <faiss/IVFlib.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFAdditiveQuantizer.h>
+#include <faiss/IndexIVFAdditiveQuantizerFastScan.h>
+#include <faiss/IndexIVFPQR.h>
+#include <faiss/impl/CodePacker.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/pq4_fast_scan.h>
+#include <faiss/invlists/BlockInvertedLists.h>
+
+#include <omp.h>
+
+#include <cstring>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// codes of one list shared by several CowInvertedLists
+struct SharedCodes : faiss::MaybeOwnedVectorOwner {
+    std::vector<uint8_t> codes;
+};
+
+template <typename T>
+faiss::MaybeOwnedVector<T> owned_copy(const faiss::MaybeOwnedVector<T>& v) {
+    return faiss::MaybeOwnedVector<T>(std::vector<T>(v.data(), v.data() + v.size()));
+}
+
+bool is_array(const faiss::InvertedLists* il) {
+    return typeid(*il) == typeid(faiss::ArrayInvertedLists) ||
+            typeid(*il) == typeid(CowInvertedLists);
+}
+
+bool is_block(const faiss::InvertedLists* il) {
+    if (typeid(*il) != typeid(faiss::BlockInvertedLists)) {
+        return false;
+    }
+    // the packer is copied, as clone_index does
+    const faiss::CodePacker* packer = static_cast<const faiss::BlockInvertedLists*>(il)->packer;
+    return !packer || dynamic_cast<const faiss::CodePackerPQ4*>(packer);
+}
+
+bool has_additive_quantizer(const faiss::IndexIVF* ivf) {
+    return dynamic_cast<const faiss::IndexIVFAdditiveQuantizer*>(ivf) ||
+            dynamic_cast<const faiss::IndexIVFAdditiveQuantizerFastScan*>(ivf);
+}
+
+int n_threads_or_default(int n_threads) {
+    return n_threads > 0 ? n_threads : omp_get_max_threads();
+}
+
+faiss::InvertedLists* copy_lists_parallel(const faiss::InvertedLists* il, int n_threads) {
+    const int64_t nlist = il->nlist;
+    bool failed = false;
+    if (is_array(il)) {
+        auto* in = static_cast<const faiss::ArrayInvertedLists*>(il);
+        std::unique_ptr<faiss::ArrayInvertedLists> out(
+                new faiss::ArrayInvertedLists(in->nlist, in->code_size));
+        out->use_iterator = in->use_iterator;
+
+        // views (of a CowInvertedLists or of a mapped file) are copied too
+#pragma omp parallel for schedule(dynamic, 16) num_threads(n_threads)
+        for (int64_t l = 0; l < nlist; l++) {
+            try {
+                out->codes[l] = owned_copy(in->codes[l]);
+                out->ids[l] = owned_copy(in->ids[l]);
+            } catch (...) {
+#pragma omp critical
+                failed = true;
+            }
+        }
+        FAISS_THROW_IF_NOT_MSG(!failed, "failed to copy the inverted lists");
+        return out.release();
+    }
+
+    auto* in = static_cast<const faiss::BlockInvertedLists*>(il);
+    std::unique_ptr<faiss::BlockInvertedLists> out(
+            new faiss::BlockInvertedLists(in->nlist, in->n_per_block, in->block_size));
+    out->code_size = in->code_size;
+    out->use_iterator = in->use_iterator;
+    if (in->packer) {
+        out->packer = new faiss::CodePackerPQ4(
+                *static_cast<const faiss::CodePackerPQ4*>(in->packer));
+    }
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(n_threads)
+    for (int64_t l = 0; l < nlist; l++) {
+        try {
+            out->ids[l] = in->ids[l];
+            out->codes[l] = in->codes[l];
+        } catch (...) {
+#pragma omp critical
+            failed = true;
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!failed, "failed to copy the inverted lists");
+    return out.release();
+}
+
+/// appends list l of in to list l of out. BlockInvertedLists::add_entries
+/// copies whole blocks to a wrong offset when the list is not empty and
+/// its size is a multiple of block_size.
+void append_block_list(
+        faiss::BlockInvertedLists* out,
+        size_t l,
+        const faiss::BlockInvertedLists& in,
+        const idx_t* ids) {
+    size_t n = in.ids[l].size();
+    size_t o = out->ids[l].size();
+    out->resize(l, o + n);
+    memcpy(out->ids[l].data() + o, ids, n * sizeof(idx_t));
+    if (o % out->n_per_block == 0) {
+        size_t n_block = (n + out->n_per_block - 1) / out->n_per_block;
+        memcpy(out->codes[l].get() + o / out->n_per_block * out->block_size,
+               in.codes[l].get(),
+               n_block * out->block_size);
+    } else {
+        FAISS_THROW_IF_NOT_MSG(out->packer, "missing code packer");
+        std::vector<uint8_t> code(out->packer->code_size);
+        for (size_t j = 0; j < n; j++) {
+            out->packer->unpack_1(in.codes[l].get(), j, code.data());
+            out->packer->pack_1(code.data(), o + j, out->codes[l].get());
+        }
+    }
+}
+
+/// moves the codes of a list of src to storage shared with the list of
+/// dst, the ids are copied
+void share_list(CowInvertedLists* src, CowInvertedLists* dst, size_t l) {
+    faiss::MaybeOwnedVector<uint8_t>& codes = src->codes[l];
+    if (src->ids[l].size() == 0) {
+        return;
+    }
+    if (codes.is_owned) {
+        auto owner = std::make_shared<SharedCodes>();
+        owner->codes = std::move(codes.owned_data);
+        codes = faiss::MaybeOwnedVector<uint8_t>::create_view(
+                owner->codes.data(), owner->codes.size(), owner);
+    }
+    dst->codes[l] = codes;
+    dst->ids[l] = owned_copy(src->ids[l]);
+}
+
+/// lists of ivf shared with the returned lists. ivf gets a
+/// CowInvertedLists with the same contents if it does not have one yet.
+CowInvertedLists* share_lists(faiss::IndexIVF* ivf, int n_threads) {
+    auto* src = dynamic_cast<CowInvertedLists*>(ivf->invlists);
+    if (!src) {
+        FAISS_THROW_IF_NOT_MSG(
+                ivf->own_invlists, "shallow clones need indexes that own their inverted lists");
+        auto* in = static_cast<faiss::ArrayInvertedLists*>(ivf->invlists);
+        std::unique_ptr<CowInvertedLists> cow(new CowInvertedLists(in->nlist, in->code_size));
+        cow->use_iterator = in->use_iterator;
+        for (size_t l = 0; l < in->nlist; l++) {
+            std::swap(cow->codes[l], in->codes[l]);
+            std::swap(cow->ids[l], in->ids[l]);
+        }
+        src = cow.release();
+        ivf->replace_invlists(src, true);
+    }
+
+    std::unique_ptr<CowInvertedLists> out(new CowInvertedLists(src->nlist, src->code_size));
+    out->use_iterator = src->use_iterator;
+    const int64_t nlist = src->nlist;
+    bool failed = false;
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(n_threads)
+    for (int64_t l = 0; l < nlist; l++) {
+        try {
+            share_list(src, out.get(), l);
+        } catch (...) {
+#pragma omp critical
+            failed = true;
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!failed, "failed to share the inverted lists");
+    return out.release();
+}
+
+/// clones the IVF indexes of the tree with one of the list copies above
+struct ListCloner : ClonerExt {
+    bool shallow;
+    int n_threads;
+
+    ListCloner(bool shallow, int n_threads) : shallow(shallow), n_threads(n_threads) {}
+
+    faiss::Index* clone_Index(const faiss::Index* index) override {
+        auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index);
+        if (!ivf || !ivf->invlists || has_additive_quantizer(ivf) ||
+            !(is_array(ivf->invlists) || is_block(ivf->invlists))) {
+            return ClonerExt::clone_Index(index);
+        }
+
+        // the copy constructor shares the quantizer and the lists
+        std::unique_ptr<faiss::IndexIVF> res(clone_IndexIVF(ivf));
+        res->quantizer = nullptr;
+        res->own_fields = false;
+        res->invlists = nullptr;
+        res->own_invlists = false;
+
+        res->quantizer = clone_Index(ivf->quantizer);
+        res->own_fields = true;
+
+        // last, as it modifies the source index
+        faiss::InvertedLists* lists = shallow && is_array(ivf->invlists)
+                ? share_lists(const_cast<faiss::IndexIVF*>(ivf), n_threads)
+                : copy_lists_parallel(ivf->invlists, n_threads);
+        res->invlists = lists;
+        res->own_invlists = true;
+        return res.release();
+    }
+};
+
+} // namespace
+
+CowInvertedLists::CowInvertedLists(size_t nlist, size_t code_size)
+        : faiss::ArrayInvertedLists(nlist, code_size) {}
+
+size_t CowInvertedLists::add_entries(
+        size_t list_no,
+        size_t n_entry,
+        const idx_t* ids_in,
+        const uint8_t* code) {
+    if (n_entry == 0) {
+        return 0;
+    }
+    // code may point into the shared list
+    auto keep = codes[list_no].owner;
+    materialize(list_no);
+    return faiss::ArrayInvertedLists::add_entries(list_no, n_entry, ids_in, code);
+}
+
+void CowInvertedLists::update_entries(
+        size_t list_no,
+        size_t offset,
+        size_t n_entry,
+        const idx_t* ids_in,
+        const uint8_t* code) {
+    auto keep = codes[list_no].owner;
+    materialize(list_no);
+    faiss::ArrayInvertedLists::update_entries(list_no, offset, n_entry, ids_in, code);
+}
+
+void CowInvertedLists::resize(size_t list_no, size_t new_size) {
+    FAISS_THROW_IF_NOT(list_no < nlist);
+    if (new_size == 0) {
+        // also drops the reference to a shared list
+        codes[list_no] = faiss::MaybeOwnedVector<uint8_t>();
+        ids[list_no] = faiss::MaybeOwnedVector<idx_t>();
+        return;
+    }
+    materialize(list_no);
+    faiss::ArrayInvertedLists::resize(list_no, new_size);
+}
+
+void CowInvertedLists::materialize(size_t list_no) {
+    FAISS_THROW_IF_NOT(list_no < nlist);
+    if (!codes[list_no].is_owned) {
+        codes[list_no] = owned_copy(codes[list_no]);
+    }
+}
+
+size_t CowInvertedLists::n_shared() const {
+    size_t n = 0;
+    for (size_t l = 0; l < nlist; l++) {
+        if (!codes[l].is_owned) {
+            n++;
+        }
+    }
+    return n;
+}
+
+faiss::Index* clone_index_parallel(const faiss::Index* index, int n_threads) {
+    FAISS_THROW_IF_NOT(index);
+    ListCloner cloner(false, n_threads_or_default(n_threads));
+    return cloner.clone_Index(index);
+}
+
+faiss::Index* clone_index_shallow(faiss::Index* index) {
+    FAISS_THROW_IF_NOT(index);
+    ListCloner cloner(true, n_threads_or_default(0));
+    return cloner.clone_Index(index);
+}
+
+void merge_into_parallel(
+        faiss::Index* dst,
+        faiss::Index* const* srcs,
+        size_t n,
+        bool shift_ids,
+        int n_threads) {
+    FAISS_THROW_IF_NOT(dst);
+    FAISS_THROW_IF_NOT(n == 0 || srcs);
+    faiss::IndexIVF* ivf0 = faiss::ivflib::extract_index_ivf(dst);
+
+    std::vector<faiss::IndexIVF*> ivfs(n);
+    std::vector<idx_t> add_ids(n);
+    idx_t ntotal = ivf0->ntotal;
+    bool array = is_array(ivf0->invlists);
+    bool block = is_block(ivf0->invlists);
+    for (size_t i = 0; i < n; i++) {
+        FAISS_THROW_IF_NOT(srcs[i]);
+        faiss::ivflib::check_compatible_for_merge(dst, srcs[i]);
+        ivfs[i] = faiss::ivflib::extract_index_ivf(srcs[i]);
+        FAISS_THROW_IF_NOT_MSG(ivfs[i] != ivf0, "cannot merge an index into itself");
+        for (size_t j = 0; j < i; j++) {
+            FAISS_THROW_IF_NOT_MSG(ivfs[j] != ivfs[i], "an index is merged twice");
+        }
+        FAISS_THROW_IF_NOT_MSG(
+                typeid(*ivfs[i]) == typeid(*ivf0), "cannot merge IVF indexes of different types");
+        add_ids[i] = shift_ids ? ntotal : 0;
+        ntotal += ivfs[i]->ntotal;
+        array = array && is_array(ivfs[i]->invlists);
+        block = block && is_block(ivfs[i]->invlists);
+    }
+
+    // IndexIVFPQR, the only IndexIVF that overrides merge_from, also
+    // appends the refine codes stored next to the lists
+    const bool lists_only = !dynamic_cast<faiss::IndexIVFPQR*>(ivf0);
+    if (!lists_only || (!array && !block)) {
+        for (size_t i = 0; i < n; i++) {
+            ivf0->merge_from(*ivfs[i], add_ids[i]);
+            srcs[i]->ntotal = 0;
+        }
+        dst->ntotal = ivf0->ntotal;
+        return;
+    }
+
+    const int64_t nlist = ivf0->nlist;
+    bool failed = false;
+
+#pragma omp parallel for schedule(dynamic, 16) num_threads(n_threads_or_default(n_threads))
+    for (int64_t l = 0; l < nlist; l++) {
+        try {
+            std::vector<idx_t> shifted;
+            for (size_t i = 0; i < n; i++) {
+                faiss::InvertedLists* in = ivfs[i]->invlists;
+                size_t list_size = in->list_size(l);
+                if (list_size == 0) {
+                    continue;
+                }
+                if (array) {
+                    auto* a0 = static_cast<faiss::ArrayInvertedLists*>(ivf0->invlists);
+                    auto* a1 = static_cast<faiss::ArrayInvertedLists*>(in);
+                    if (a0->ids[l].size() == 0 && a1->codes[l].is_owned && a1->ids[l].is_owned) {
+                        // move the whole list
+                        std::swap(a0->codes[l], a1->codes[l]);
+                        std::swap(a0->ids[l], a1->ids[l]);
+                        if (add_ids[i] != 0) {
+                            idx_t* ids = a0->ids[l].data();
+                            for (size_t j = 0; j < list_size; j++) {
+                                ids[j] += add_ids[i];
+                            }
+                        }
+                        a1->codes[l] = faiss::MaybeOwnedVector<uint8_t>();
+                        a1->ids[l] = faiss::MaybeOwnedVector<idx_t>();
+                        continue;
+                    }
+                }
+
+                const idx_t* ids = in->get_ids(l);
+                if (add_ids[i] != 0) {
+                    shifted.resize(list_size);
+                    for (size_t j = 0; j < list_size; j++) {
+                        shifted[j] = ids[j] + add_ids[i];
+                    }
+                    ids = shifted.data();
+                }
+
+                // free the source list now rather than when it is destroyed
+                if (array) {
+                    ivf0->invlists->add_entries(l, list_size, ids, in->get_codes(l));
+                    auto* a1 = static_cast<faiss::ArrayInvertedLists*>(in);
+                    a1->codes[l] = faiss::MaybeOwnedVector<uint8_t>();
+                    a1->ids[l] = faiss::MaybeOwnedVector<idx_t>();
+                } else {
+                    auto* b1 = static_cast<faiss::BlockInvertedLists*>(in);
+                    append_block_list(
+                            static_cast<faiss::BlockInvertedLists*>(ivf0->invlists), l, *b1, ids);
+                    std::vector<idx_t>().swap(b1->ids[l]);
+                    b1->codes[l].resize(0);
+                }
+            }
+        } catch (...) {
+#pragma omp critical
+            failed = true;
+        }
+    }
+    FAISS_THROW_IF_NOT_MSG(!failed, "failed to merge the inverted lists");
+
+    ivf0->ntotal = ntotal;
+    dst->ntotal = ntotal;
+    for (size_t i = 0; i < n; i++) {
+        ivfs[i]->ntotal = 0;
+        srcs[i]->ntotal = 0;
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,98 @@
+/**
+ * FAISS Go Extensions - parallel and copy-on-write clones, parallel merges
+ *
+ * faiss::clone_index copies inverted lists one after the other, and the
+ * usual workaround of serializing an index and reading it back is slower
+ * still and needs the bytes twice. This file has three alternatives for
+ * IVF indexes on ArrayInvertedLists or BlockInvertedLists (fast-scan),
+ * alone or under IndexPreTransform / IndexIDMap wrappers:
+ *
+ *  - clone_index_parallel: a deep copy whose inverted lists are copied by
+ *    an OpenMP loop over the lists;
+ *  - clone_index_shallow: the clone and the source share the codes of
+ *    ArrayInvertedLists through MaybeOwnedVector views (the ids are
+ *    copied), each side copies the codes of a list the first time it
+ *    modifies the list (CowInvertedLists);
+ *  - merge_into_parallel: merges several shards in one pass over the
+ *    lists, moving whole lists when the destination one is empty and
+ *    freeing each source list as soon as it is merged, so the peak memory
+ *    stays close to the size of the merged index.
+ *
+ * Everything else in the index tree (quantizers, transforms, id maps) is
+ * copied as faiss::Cloner does. Indexes of other types, and IVF indexes
+ * with additive quantizers, get a regular clone_index_ext copy.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_PARALLEL_CLONE_H
+#define FAISS_GO_EXT_PARALLEL_CLONE_H
+
+#include <faiss/Index.h>
+#include <faiss/invlists/InvertedLists.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// ArrayInvertedLists whose codes may be views shared with other indexes,
+/// the ids are always owned. The codes of a list are copied into owned
+/// storage before the list is modified (the ids stay in place, as
+/// IndexIVF::remove_ids holds a pointer to them across updates). As with
+/// ArrayInvertedLists, modifications of different lists can run
+/// concurrently.
+struct CowInvertedLists : faiss::ArrayInvertedLists {
+    CowInvertedLists(size_t nlist, size_t code_size);
+
+    size_t add_entries(
+            size_t list_no,
+            size_t n_entry,
+            const idx_t* ids,
+            const uint8_t* code) override;
+
+    void update_entries(
+            size_t list_no,
+            size_t offset,
+            size_t n_entry,
+            const idx_t* ids,
+            const uint8_t* code) override;
+
+    void resize(size_t list_no, size_t new_size) override;
+
+    /// copy the codes of list_no into owned storage if they are a view
+    void materialize(size_t list_no);
+
+    /// lists whose codes are still views
+    size_t n_shared() const;
+};
+
+/// Deep copy with the inverted lists copied by n_threads threads (0 for
+/// the OpenMP default).
+faiss::Index* clone_index_parallel(const faiss::Index* index, int n_threads = 0);
+
+/// Copy that shares the list codes of index. The ArrayInvertedLists of
+/// index are turned into CowInvertedLists, so index must own its inverted
+/// lists and must not be searched or modified during the call; afterwards
+/// both indexes are independent. BlockInvertedLists are copied.
+/// faiss::clone_index copies a CowInvertedLists into ArrayInvertedLists
+/// that still view the shared codes and cannot be modified, copy such
+/// indexes with clone_index_parallel or clone_index_shallow.
+faiss::Index* clone_index_shallow(faiss::Index* index);
+
+/// Merges the n srcs into dst (ivflib::merge_into for several sources):
+/// the srcs are left empty. With shift_ids, the ids of each source are
+/// shifted by the number of vectors merged before it, as with sequential
+/// merge_into calls. IVF types with data outside the lists (IndexIVFPQR)
+/// and lists other than Array / Block ones are merged sequentially with
+/// IndexIVF::merge_from.
+void merge_into_parallel(
+        faiss::Index* dst,
+        faiss::Index* const* srcs,
+        size_t n,
+        bool shift_ids,
+        int n_threads = 0);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_PARALLEL_CLONE_H */
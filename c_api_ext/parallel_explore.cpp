@@ -0,0 +1,309 @@
+/**
+ * FAISS Go Extensions - parallel ParameterSpace exploration
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "parallel_explore.h"
+#include "idmap_sorted.h"
+
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace faiss_go_ext {
+
+namespace {
+
+typedef std::vector<std::pair<std::string, double>> ParamValues;
+typedef std::vector<std::unique_ptr<faiss::SearchParameters>> ParamChain;
+
+double elapsed_ms(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+/// the (name, value) pairs of a combination, decoded as
+/// ParameterSpace::set_index_parameters does
+ParamValues combination_values(const faiss::ParameterSpace& ps, size_t cno) {
+    ParamValues values;
+    for (const faiss::ParameterRange& pr : ps.parameter_ranges) {
+        size_t j = cno % pr.values.size();
+        cno /= pr.values.size();
+        values.emplace_back(pr.name, pr.values[j]);
+    }
+    return values;
+}
+
+/// removes name from values, returns whether it was there
+bool take(ParamValues& values, const char* name, double* val) {
+    for (auto it = values.begin(); it != values.end(); ++it) {
+        if (it->first == name) {
+            *val = it->second;
+            values.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Parameters of values for index in *out, nullptr if none apply. Returns
+/// false if a value has no SearchParameters equivalent.
+bool build_params(const faiss::Index* index, ParamValues values, ParamChain& chain, faiss::SearchParameters** out) {
+    *out = nullptr;
+    double val;
+    if (auto* idmap = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        return build_params(idmap->index, values, chain, out);
+    }
+    if (auto* idmap3 = dynamic_cast<const IndexIDMap3*>(index)) {
+        return build_params(idmap3->index, values, chain, out);
+    }
+    if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+        auto* p = new faiss::SearchParametersPreTransform();
+        chain.emplace_back(p);
+        *out = p;
+        return build_params(pt->index, values, chain, &p->index_params);
+    }
+    if (auto* refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+        auto* p = new faiss::IndexRefineSearchParameters();
+        chain.emplace_back(p);
+        *out = p;
+        p->k_factor = refine->k_factor;
+        if (take(values, "k_factor_rf", &val)) {
+            p->k_factor = val;
+        }
+        return build_params(refine->base_index, values, chain, &p->base_index_params);
+    }
+    if (auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        auto* p = new faiss::SearchParametersIVF();
+        chain.emplace_back(p);
+        *out = p;
+        p->nprobe = ivf->nprobe;
+        p->max_codes = ivf->max_codes;
+        if (take(values, "nprobe", &val)) {
+            p->nprobe = (size_t)val;
+        }
+        if (take(values, "max_codes", &val)) {
+            p->max_codes = std::isfinite(val) ? (size_t)val : 0;
+        }
+        ParamValues quantizer_values;
+        for (auto it = values.begin(); it != values.end();) {
+            if (it->first.compare(0, 10, "quantizer_") == 0) {
+                quantizer_values.emplace_back(it->first.substr(10), it->second);
+                it = values.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (!values.empty()) {
+            return false;
+        }
+        return build_params(ivf->quantizer, quantizer_values, chain, &p->quantizer_params);
+    }
+    if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+        auto* p = new faiss::SearchParametersHNSW();
+        chain.emplace_back(p);
+        *out = p;
+        p->efSearch = hnsw->hnsw.efSearch;
+        p->check_relative_distance = hnsw->hnsw.check_relative_distance;
+        p->bounded_queue = hnsw->hnsw.search_bounded_queue;
+        if (take(values, "efSearch", &val)) {
+            p->efSearch = (int)val;
+        }
+        return values.empty();
+    }
+    return values.empty();
+}
+
+struct Measure {
+    double perf = 0;
+    double t = 0;
+};
+
+/// a point is dominated if another one is at least as good in less time,
+/// with slack for the timing noise
+std::vector<size_t> prune(const std::vector<size_t>& cnos, const std::vector<Measure>& m, double slack) {
+    std::vector<size_t> kept;
+    for (size_t i = 0; i < cnos.size(); i++) {
+        bool dominated = false;
+        for (size_t j = 0; j < cnos.size() && !dominated; j++) {
+            dominated = j != i && m[j].perf >= m[i].perf && m[j].t * (1 + slack) < m[i].t;
+        }
+        if (!dominated) {
+            kept.push_back(cnos[i]);
+        }
+    }
+    return kept;
+}
+
+/// Runs the combinations on nq queries, concurrently, one thread each.
+std::vector<Measure> run_concurrent(
+        const faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        const std::vector<size_t>& cnos,
+        idx_t nq,
+        const float* xq,
+        const faiss::AutoTuneCriterion& crit,
+        int n_threads) {
+    std::vector<Measure> m(cnos.size());
+    std::mutex exception_mutex;
+    std::string exception_string;
+
+#pragma omp parallel num_threads(n_threads)
+    {
+        std::vector<float> D(nq * crit.nnn);
+        std::vector<idx_t> I(nq * crit.nnn);
+#pragma omp for schedule(dynamic)
+        for (size_t i = 0; i < cnos.size(); i++) {
+            try {
+                ParamChain chain;
+                faiss::SearchParameters* params = nullptr;
+                build_params(index, combination_values(ps, cnos[i]), chain, &params);
+                auto t0 = std::chrono::steady_clock::now();
+                // nested regions of the search run on this thread
+                index->search(nq, xq, crit.nnn, D.data(), I.data(), params);
+                m[i].t = elapsed_ms(t0);
+                m[i].perf = crit.evaluate(D.data(), I.data());
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                exception_string = e.what();
+            }
+        }
+    }
+    if (!exception_string.empty()) {
+        FAISS_THROW_MSG(exception_string.c_str());
+    }
+    return m;
+}
+
+/// ParameterSpace::explore without its bounds: set each combination, then
+/// search with all threads
+std::vector<Measure> run_sequential(
+        faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        const std::vector<size_t>& cnos,
+        idx_t nq,
+        const float* xq,
+        const faiss::AutoTuneCriterion& crit) {
+    std::vector<Measure> m(cnos.size());
+    std::vector<float> D(nq * crit.nnn);
+    std::vector<idx_t> I(nq * crit.nnn);
+    for (size_t i = 0; i < cnos.size(); i++) {
+        ps.set_index_parameters(index, cnos[i]);
+        auto t0 = std::chrono::steady_clock::now();
+        index->search(nq, xq, crit.nnn, D.data(), I.data());
+        m[i].t = elapsed_ms(t0);
+        m[i].perf = crit.evaluate(D.data(), I.data());
+    }
+    return m;
+}
+
+/// evaluates a criterion on its first nq queries, restoring it on exit
+struct ScopedCriterionSubset {
+    faiss::AutoTuneCriterion& crit;
+    idx_t saved_nq;
+    std::vector<float> saved_D;
+    std::vector<idx_t> saved_I;
+
+    ScopedCriterionSubset(faiss::AutoTuneCriterion& crit, idx_t nq)
+            : crit(crit), saved_nq(crit.nq), saved_D(crit.gt_D), saved_I(crit.gt_I) {
+        crit.nq = nq;
+        crit.gt_D.resize(std::min(crit.gt_D.size(), (size_t)(nq * crit.gt_nnn)));
+        crit.gt_I.resize(nq * crit.gt_nnn);
+    }
+
+    ~ScopedCriterionSubset() {
+        crit.nq = saved_nq;
+        crit.gt_D.swap(saved_D);
+        crit.gt_I.swap(saved_I);
+    }
+};
+
+} // namespace
+
+std::vector<std::unique_ptr<faiss::SearchParameters>> combination_search_params(
+        const faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        size_t cno) {
+    ParamChain chain;
+    faiss::SearchParameters* params = nullptr;
+    if (!build_params(index, combination_values(ps, cno), chain, &params)) {
+        chain.clear();
+    }
+    return chain;
+}
+
+void explore_parallel(
+        faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        idx_t nq,
+        const float* xq,
+        faiss::AutoTuneCriterion& crit,
+        const ExploreOptions& options,
+        faiss::OperatingPoints* ops,
+        ExploreStats* stats) {
+    FAISS_THROW_IF_NOT(index && ops && nq > 0);
+    FAISS_THROW_IF_NOT_FMT(crit.nq == nq, "criterion has %" PRId64 " queries, not %" PRId64, crit.nq, nq);
+    FAISS_THROW_IF_NOT_MSG(crit.gt_I.size() == (size_t)(crit.nq * crit.gt_nnn), "the criterion has no ground truth");
+    for (const faiss::ParameterRange& pr : ps.parameter_ranges) {
+        FAISS_THROW_IF_NOT_FMT(!pr.values.empty(), "parameter %s has no values", pr.name.c_str());
+    }
+
+    ExploreStats st;
+    const size_t n_comb = ps.n_combinations();
+    st.n_combinations = n_comb;
+    std::vector<size_t> cnos(n_comb);
+    st.concurrent = true;
+    for (size_t cno = 0; cno < n_comb; cno++) {
+        cnos[cno] = cno;
+        ParamChain chain;
+        faiss::SearchParameters* params = nullptr;
+        if (!build_params(index, combination_values(ps, cno), chain, &params)) {
+            st.concurrent = false;
+        }
+    }
+    const int n_threads = options.n_threads > 0 ? options.n_threads : omp_get_max_threads();
+    auto run = [&](const std::vector<size_t>& c, idx_t n) {
+        return st.concurrent ? run_concurrent(index, ps, c, n, xq, crit, n_threads)
+                             : run_sequential(index, ps, c, n, xq, crit);
+    };
+
+    idx_t n_subset = options.n_subset == 0 ? nq / 10 : options.n_subset;
+    if (n_subset > 0 && n_subset < nq && n_comb > 1) {
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<Measure> m;
+        {
+            ScopedCriterionSubset scoped(crit, n_subset);
+            m = run(cnos, n_subset);
+        }
+        cnos = prune(cnos, m, options.prune_slack);
+        st.subset_ms = elapsed_ms(t0);
+    }
+    st.n_pruned = n_comb - cnos.size();
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<Measure> m = run(cnos, nq);
+    st.full_ms = elapsed_ms(t0);
+    for (size_t i = 0; i < cnos.size(); i++) {
+        ops->add(m[i].perf, m[i].t, ps.combination_name(cnos[i]), cnos[i]);
+    }
+    if (stats) {
+        *stats = st;
+    }
+}
+
+} // namespace faiss_go_ext
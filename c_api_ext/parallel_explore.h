@@ -0,0 +1,81 @@
+/**
+ * FAISS Go Extensions - parallel ParameterSpace exploration
+ *
+ * ParameterSpace::explore sets each combination on the index and runs the
+ * whole query set with it, one combination after the other, so tuning
+ * nprobe x efSearch x k_factor on a large index takes as many full
+ * benchmark runs as there are combinations. Its operating points were
+ * only printed, not returned.
+ *
+ * explore_parallel evaluates combinations concurrently, n_threads at a
+ * time. Each one searches on a single thread, with the parameters passed
+ * as SearchParameters, so the index is not modified. A first pass runs
+ * every combination on the first n_subset queries; a combination is
+ * pruned if another one reached at least the same performance in less
+ * than 1 / (1 + prune_slack) of its time. The others run on all queries
+ * and fill an OperatingPoints, whose optimal_pts is the Pareto frontier
+ * of (performance, time).
+ *
+ * Concurrent combinations share the memory bandwidth, so times are
+ * comparable with each other, not with a dedicated single-thread run.
+ * Combinations that cannot be expressed as SearchParameters (polysemous
+ * ht, IVFPQR k_factor, ...) switch the exploration to the sequential
+ * path: set_index_parameters, then a multi-threaded search, as
+ * ParameterSpace::explore does, with the same pruning. That path leaves
+ * the last combination set on the index.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_PARALLEL_EXPLORE_H
+#define FAISS_GO_EXT_PARALLEL_EXPLORE_H
+
+#include <faiss/AutoTune.h>
+#include <faiss/Index.h>
+
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct ExploreOptions {
+    int n_threads = 0;        ///< combinations run at once, 0 = all OpenMP threads
+    idx_t n_subset = 0;       ///< queries of the pruning pass, 0 = nq / 10, < 0 = no pruning
+    double prune_slack = 0.1; ///< time margin before a point counts as dominated
+};
+
+struct ExploreStats {
+    size_t n_combinations = 0;
+    size_t n_pruned = 0;      ///< combinations not run on the full query set
+    bool concurrent = false;  ///< false if the sequential path was taken
+    double subset_ms = 0;     ///< wall time of the pruning pass
+    double full_ms = 0;       ///< wall time of the full pass
+};
+
+/// The SearchParameters chain of combination cno for index, or nullptr if
+/// one of its parameters has no SearchParameters equivalent. The chain is
+/// owned by the returned vector, outermost first.
+std::vector<std::unique_ptr<faiss::SearchParameters>> combination_search_params(
+        const faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        size_t cno);
+
+/// Explore the combinations of ps on index. The criterion is evaluated on
+/// the first n_subset queries during the pruning pass (its nq and ground
+/// truth are cut for the duration of the pass). Time is in ms for the query set.
+void explore_parallel(
+        faiss::Index* index,
+        const faiss::ParameterSpace& ps,
+        idx_t nq,
+        const float* xq,
+        faiss::AutoTuneCriterion& crit,
+        const ExploreOptions& options,
+        faiss::OperatingPoints* ops,
+        ExploreStats* stats = nullptr);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_PARALLEL_EXPLORE_H */
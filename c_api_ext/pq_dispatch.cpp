@@ -0,0 +1,90 @@
+/**
+ * FAISS Go Extensions - product quantizer search with runtime SIMD dispatch
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "pq_dispatch.h"
+
+#include <faiss/utils/Heap.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// codes are scored in blocks of this size before touching the heap
+constexpr size_t kScanBlock = 256;
+
+template <class C>
+void search_pq_flat_impl(
+        const faiss::IndexPQ& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    const faiss::ProductQuantizer& pq = index.pq;
+    const pq_distances_fn fn = pq.nbits == 8 ? kernels().pq.pq8 : kernels().pq.pq4;
+    const uint8_t* codes = index.codes.data();
+    const size_t code_size = index.code_size;
+    const size_t ntotal = index.ntotal;
+    const bool ip = index.metric_type == faiss::METRIC_INNER_PRODUCT;
+
+#pragma omp parallel if (n > 1)
+    {
+        std::vector<float> lut(pq.M * pq.ksub);
+        float dis[kScanBlock];
+
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            float* heap_dis = distances + i * k;
+            idx_t* heap_ids = labels + i * k;
+            faiss::heap_heapify<C>(k, heap_dis, heap_ids);
+            if (ip) {
+                pq.compute_inner_prod_table(x + i * index.d, lut.data());
+            } else {
+                pq.compute_distance_table(x + i * index.d, lut.data());
+            }
+
+            for (size_t j0 = 0; j0 < ntotal; j0 += kScanBlock) {
+                size_t nb = std::min(kScanBlock, ntotal - j0);
+                fn(lut.data(), codes + j0 * code_size, pq.M, nb, dis);
+                for (size_t j = 0; j < nb; j++) {
+                    if (C::cmp(heap_dis[0], dis[j])) {
+                        faiss::heap_replace_top<C>(k, heap_dis, heap_ids, dis[j], j0 + j);
+                    }
+                }
+            }
+            faiss::heap_reorder<C>(k, heap_dis, heap_ids);
+        }
+    }
+}
+
+} // namespace
+
+bool pq_dispatch_supported(const faiss::IndexPQ& index) {
+    return (index.pq.nbits == 8 || index.pq.nbits == 4) &&
+            index.search_type == faiss::IndexPQ::ST_PQ &&
+            (index.metric_type == faiss::METRIC_L2 ||
+             index.metric_type == faiss::METRIC_INNER_PRODUCT);
+}
+
+void search_pq_flat(
+        const faiss::IndexPQ& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    if (index.metric_type == faiss::METRIC_L2) {
+        search_pq_flat_impl<faiss::CMax<float, idx_t>>(index, n, x, k, distances, labels);
+    } else {
+        search_pq_flat_impl<faiss::CMin<float, idx_t>>(index, n, x, k, distances, labels);
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,37 @@
+/**
+ * FAISS Go Extensions - product quantizer search with runtime SIMD dispatch
+ *
+ * Flat IndexPQ search that builds the per-query look-up tables with FAISS
+ * and sums them with the PQ kernels selected by simd_dispatch.h.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_PQ_DISPATCH_H
+#define FAISS_GO_EXT_PQ_DISPATCH_H
+
+#include "simd_dispatch.h"
+
+#include <faiss/IndexPQ.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// True if the dispatched kernels handle this index (8 or 4 bits per
+/// sub-quantizer, L2 or IP, plain PQ search type).
+bool pq_dispatch_supported(const faiss::IndexPQ& index);
+
+/// k-NN search over an IndexPQ with the dispatched kernels.
+void search_pq_flat(
+        const faiss::IndexPQ& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_PQ_DISPATCH_H */
@@ -0,0 +1,87 @@
+/**
+ * FAISS Go Extensions - product quantizer code distance kernels
+ *
+ * Counterpart of faiss/impl/code_distance: sums of look-up table entries
+ * selected by PQ codes, compiled once per SIMD level (see
+ * simd_dispatch.h). The x86 builds gather SIMD_W table entries per
+ * instruction for 8-bit codes.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_kernels-inl.h"
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+
+namespace {
+
+/// 8-bit codes, lut is M x 256
+inline float pq8_distance(const float* lut, const uint8_t* code, size_t M) {
+    size_t m = 0;
+    float accu = 0;
+
+#if defined(__AVX512F__)
+    const __m512i steps = _mm512_setr_epi32(
+            0, 256, 512, 768, 1024, 1280, 1536, 1792,
+            2048, 2304, 2560, 2816, 3072, 3328, 3584, 3840);
+    __m512 acc = _mm512_setzero_ps();
+    for (; m + 16 <= M; m += 16) {
+        __m512i idx = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(code + m)));
+        idx = _mm512_add_epi32(idx, steps);
+        acc = _mm512_add_ps(acc, _mm512_i32gather_ps(idx, lut + m * 256, 4));
+    }
+    accu = _mm512_reduce_add_ps(acc);
+#elif defined(__AVX2__)
+    const __m256i steps = _mm256_setr_epi32(0, 256, 512, 768, 1024, 1280, 1536, 1792);
+    __m256 acc = _mm256_setzero_ps();
+    for (; m + 8 <= M; m += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(code + m)));
+        idx = _mm256_add_epi32(idx, steps);
+        acc = _mm256_add_ps(acc, _mm256_i32gather_ps(lut + m * 256, idx, 4));
+    }
+    accu = vreduce(acc);
+#endif
+
+    for (; m < M; m++) {
+        accu += lut[m * 256 + code[m]];
+    }
+    return accu;
+}
+
+void pq8_distances(const float* lut, const uint8_t* codes, size_t M, size_t n, float* distances) {
+    for (size_t j = 0; j < n; j++) {
+        distances[j] = pq8_distance(lut, codes + j * M, M);
+    }
+}
+
+/// 4-bit codes packed two per byte (even sub-quantizer in the low nibble),
+/// lut is M x 16
+void pq4_distances(const float* lut, const uint8_t* codes, size_t M, size_t n, float* distances) {
+    const size_t code_size = (M + 1) / 2;
+    for (size_t j = 0; j < n; j++) {
+        const uint8_t* code = codes + j * code_size;
+        float a0 = 0, a1 = 0;
+        size_t m = 0;
+        for (; m + 2 <= M; m += 2) {
+            uint8_t c = code[m / 2];
+            a0 += lut[m * 16 + (c & 15)];
+            a1 += lut[(m + 1) * 16 + (c >> 4)];
+        }
+        if (m < M) {
+            a0 += lut[m * 16 + (code[m / 2] & 15)];
+        }
+        distances[j] = a0 + a1;
+    }
+}
+
+} // namespace
+
+void get_pq_kernels(PQKernels* kernels) {
+    kernels->pq8 = pq8_distances;
+    kernels->pq4 = pq4_distances;
+}
+
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
@@ -0,0 +1,185 @@
+/**
+ * FAISS Go Extensions - RaBitQ search with per-call query parameters
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "rabitq_search.h"
+#include "fast_scan_tuning.h"
+
+#include <faiss/IndexIVFRaBitQ.h>
+#include <faiss/IndexIVFRaBitQFastScan.h>
+#include <faiss/IndexRaBitQ.h>
+#include <faiss/IndexRaBitQFastScan.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <memory>
+
+namespace faiss_go_ext {
+
+namespace {
+
+uint8_t pick_qb(int qb, uint8_t current) {
+    FAISS_THROW_IF_NOT_MSG(qb <= 8, "qb must be at most 8 bits");
+    return qb >= 0 ? (uint8_t)qb : current;
+}
+
+bool pick_centered(int centered, bool current) {
+    return centered >= 0 ? centered != 0 : current;
+}
+
+/// the fast-scan variants work on quantized look-up tables only
+uint8_t pick_fast_scan_qb(int qb, uint8_t current) {
+    uint8_t used = pick_qb(qb, current);
+    FAISS_THROW_IF_NOT_MSG(used > 0, "fast-scan RaBitQ needs qb > 0");
+    return used;
+}
+
+/// Search the RaBitQ index base, through refine if it is not null. The
+/// fast-scan variants take qb / centered from the index only, they are
+/// set on a per-call copy.
+void search_base(
+        faiss::Index* base,
+        faiss::IndexRefine* refine,
+        const RaBitQQueryParams& params,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    std::unique_ptr<faiss::SearchParameters> base_params;
+    std::unique_ptr<faiss::Index> copy;
+
+    if (auto* idx = dynamic_cast<faiss::IndexRaBitQ*>(base)) {
+        auto* p = new faiss::RaBitQSearchParameters();
+        base_params.reset(p);
+        p->qb = pick_qb(params.qb, idx->qb);
+        p->centered = pick_centered(params.centered, idx->centered);
+    } else if (auto* idx = dynamic_cast<faiss::IndexIVFRaBitQ*>(base)) {
+        auto* p = new faiss::IVFRaBitQSearchParameters();
+        base_params.reset(p);
+        p->nprobe = params.nprobe ? params.nprobe : idx->nprobe;
+        p->qb = pick_qb(params.qb, idx->qb);
+        p->centered = pick_centered(params.centered, false);
+    } else if (auto* idx = dynamic_cast<faiss::IndexRaBitQFastScan*>(base)) {
+        // takes no SearchParameters at all
+        copy = fast_scan_search_copy(idx);
+        auto* c = static_cast<faiss::IndexRaBitQFastScan*>(copy.get());
+        c->qb = pick_fast_scan_qb(params.qb, idx->qb);
+        c->centered = pick_centered(params.centered, idx->centered);
+    } else if (auto* idx = dynamic_cast<faiss::IndexIVFRaBitQFastScan*>(base)) {
+        // reads nprobe from SearchParameters but qb / centered from the index
+        auto* p = new faiss::IVFSearchParameters();
+        base_params.reset(p);
+        p->nprobe = params.nprobe ? params.nprobe : idx->nprobe;
+        copy = fast_scan_search_copy(idx);
+        auto* c = static_cast<faiss::IndexIVFRaBitQFastScan*>(copy.get());
+        c->qb = pick_fast_scan_qb(params.qb, idx->qb);
+        c->centered = pick_centered(params.centered, idx->centered);
+    } else {
+        FAISS_THROW_MSG("not a RaBitQ index");
+    }
+    faiss::Index* searched = copy ? copy.get() : base;
+
+    if (refine) {
+        // the copy constructors copy the base and refinement pointers,
+        // the view owns neither
+        std::unique_ptr<faiss::IndexRefine> view(
+                dynamic_cast<faiss::IndexRefineFlat*>(refine)
+                        ? new faiss::IndexRefineFlat(*static_cast<faiss::IndexRefineFlat*>(refine))
+                        : new faiss::IndexRefine(*refine));
+        view->own_fields = false;
+        view->own_refine_index = false;
+        view->base_index = searched;
+        faiss::IndexRefineSearchParameters rp;
+        rp.k_factor = params.k_factor > 0 ? params.k_factor : refine->k_factor;
+        rp.base_index_params = base_params.get();
+        view->search(n, x, k, distances, labels, &rp);
+    } else {
+        searched->search(n, x, k, distances, labels, base_params.get());
+    }
+}
+
+} // namespace
+
+faiss::Index* rabitq_index(faiss::Index* index) {
+    if (auto* refine = dynamic_cast<faiss::IndexRefine*>(index)) {
+        index = refine->base_index;
+    }
+    if (dynamic_cast<faiss::IndexRaBitQ*>(index) ||
+        dynamic_cast<faiss::IndexIVFRaBitQ*>(index) ||
+        dynamic_cast<faiss::IndexRaBitQFastScan*>(index) ||
+        dynamic_cast<faiss::IndexIVFRaBitQFastScan*>(index)) {
+        return index;
+    }
+    return nullptr;
+}
+
+size_t rabitq_nb_bits(const faiss::Index* index) {
+    if (auto* idx = dynamic_cast<const faiss::IndexRaBitQ*>(index)) {
+        return idx->rabitq.nb_bits;
+    }
+    if (auto* idx = dynamic_cast<const faiss::IndexIVFRaBitQ*>(index)) {
+        return idx->rabitq.nb_bits;
+    }
+    if (auto* idx = dynamic_cast<const faiss::IndexRaBitQFastScan*>(index)) {
+        return idx->rabitq.nb_bits;
+    }
+    if (auto* idx = dynamic_cast<const faiss::IndexIVFRaBitQFastScan*>(index)) {
+        return idx->rabitq.nb_bits;
+    }
+    FAISS_THROW_MSG("not a RaBitQ index");
+}
+
+void rabitq_get_defaults(const faiss::Index* index, int* qb, int* centered) {
+    if (auto* idx = dynamic_cast<const faiss::IndexRaBitQ*>(index)) {
+        *qb = idx->qb;
+        *centered = idx->centered;
+    } else if (auto* idx = dynamic_cast<const faiss::IndexIVFRaBitQ*>(index)) {
+        *qb = idx->qb;
+        *centered = 0;
+    } else if (auto* idx = dynamic_cast<const faiss::IndexRaBitQFastScan*>(index)) {
+        *qb = idx->qb;
+        *centered = idx->centered;
+    } else if (auto* idx = dynamic_cast<const faiss::IndexIVFRaBitQFastScan*>(index)) {
+        *qb = idx->qb;
+        *centered = idx->centered;
+    } else {
+        FAISS_THROW_MSG("not a RaBitQ index");
+    }
+}
+
+void rabitq_set_defaults(faiss::Index* index, int qb, int centered) {
+    if (auto* idx = dynamic_cast<faiss::IndexRaBitQ*>(index)) {
+        idx->qb = pick_qb(qb, idx->qb);
+        idx->centered = pick_centered(centered, idx->centered);
+    } else if (auto* idx = dynamic_cast<faiss::IndexIVFRaBitQ*>(index)) {
+        FAISS_THROW_IF_NOT_MSG(centered <= 0, "IndexIVFRaBitQ takes centered per search only");
+        idx->qb = pick_qb(qb, idx->qb);
+    } else if (auto* idx = dynamic_cast<faiss::IndexRaBitQFastScan*>(index)) {
+        idx->qb = pick_fast_scan_qb(qb, idx->qb);
+        idx->centered = pick_centered(centered, idx->centered);
+    } else if (auto* idx = dynamic_cast<faiss::IndexIVFRaBitQFastScan*>(index)) {
+        idx->qb = pick_fast_scan_qb(qb, idx->qb);
+        idx->centered = pick_centered(centered, idx->centered);
+    } else {
+        FAISS_THROW_MSG("not a RaBitQ index");
+    }
+}
+
+void rabitq_search(
+        faiss::Index* index,
+        const RaBitQQueryParams& params,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    auto* refine = dynamic_cast<faiss::IndexRefine*>(index);
+    faiss::Index* base = refine ? refine->base_index : index;
+    search_base(base, refine, params, n, x, k, distances, labels);
+}
+
+} // namespace faiss_go_ext
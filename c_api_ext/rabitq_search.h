@@ -0,0 +1,60 @@
+/**
+ * FAISS Go Extensions - RaBitQ search with per-call query parameters
+ *
+ * The RaBitQ family takes its query quantization (qb bits, centered mode)
+ * either from SearchParameters (IndexRaBitQ, IndexIVFRaBitQ) or only from
+ * index fields (the fast-scan variants). rabitq_search() hides the
+ * difference, and also reaches through an IndexRefine so the base index
+ * gets the RaBitQ parameters and the refinement its k_factor.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_RABITQ_SEARCH_H
+#define FAISS_GO_EXT_RABITQ_SEARCH_H
+
+#include <faiss/Index.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Per-call parameters, negative / zero values keep the index setting.
+struct RaBitQQueryParams {
+    int qb = -1;        ///< bits per query component, 0 = fp32 queries
+    int centered = -1;  ///< zero-centered query quantizer (0 / 1)
+    size_t nprobe = 0;  ///< IVF variants only
+    float k_factor = 0; ///< IndexRefine only
+};
+
+/// The RaBitQ index itself, or the base of an IndexRefine; nullptr if
+/// neither is a RaBitQ index.
+faiss::Index* rabitq_index(faiss::Index* index);
+
+/// Number of bits per dimension of the codes (1, or 2-9 for multi-bit).
+size_t rabitq_nb_bits(const faiss::Index* index);
+
+/// Default query parameters stored on the index (centered is always 0 for
+/// IndexIVFRaBitQ, which only takes it per search).
+void rabitq_get_defaults(const faiss::Index* index, int* qb, int* centered);
+
+/// Change the default query parameters, negative values are left as is.
+/// The index must not be searched during the call.
+void rabitq_set_defaults(faiss::Index* index, int qb, int centered);
+
+/// k-NN search of a RaBitQ index or of an IndexRefine over one. The
+/// fast-scan variants are searched through a fast_scan_search_copy with
+/// qb / centered set, so no search modifies the index.
+void rabitq_search(
+        faiss::Index* index,
+        const RaBitQQueryParams& params,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_RABITQ_SEARCH_H */
@@ -0,0 +1,275 @@
+/**
+ * FAISS Go Extensions - range search into reusable buffers
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "range_arena.h"
+
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFFastScan.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/MetricType.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// default RangeSearchResult::buffer_size, the upper bound of the hint
+constexpr size_t kMaxPartialBuffer = 256 * 1024;
+constexpr size_t kMinPartialBuffer = 4096;
+
+/// the per-query cap for IndexIVF: scan the probed lists in blocks and
+/// stop a query once it has max_per_query results
+void ivf_range_search_capped(
+        const faiss::IndexIVF& ivf,
+        idx_t n,
+        const float* x,
+        float radius,
+        const faiss::SearchParametersIVF* params,
+        size_t max_per_query,
+        faiss::RangeSearchResult* result) {
+    const size_t nprobe = std::min(ivf.nlist, params ? params->nprobe : ivf.nprobe);
+    FAISS_THROW_IF_NOT(nprobe > 0);
+    std::unique_ptr<idx_t[]> keys(new idx_t[n * nprobe]);
+    std::unique_ptr<float[]> coarse_dis(new float[n * nprobe]);
+    ivf.quantizer->search(
+            n, x, nprobe, coarse_dis.get(), keys.get(), params ? params->quantizer_params : nullptr);
+
+    const faiss::InvertedLists* invlists = ivf.invlists;
+    const size_t code_size = invlists->code_size;
+    const faiss::IDSelector* sel = params ? params->sel : nullptr;
+    std::mutex exception_mutex;
+    std::string exception_string;
+
+#pragma omp parallel
+    {
+        faiss::RangeSearchPartialResult pres(result);
+        std::unique_ptr<faiss::InvertedListScanner> scanner(
+                ivf.get_InvertedListScanner(false, sel, params));
+
+#pragma omp for schedule(dynamic)
+        for (idx_t i = 0; i < n; i++) {
+            faiss::RangeQueryResult& qres = pres.new_result(i);
+            try {
+                scanner->set_query(x + i * ivf.d);
+                for (size_t j = 0; j < nprobe && qres.nres < max_per_query; j++) {
+                    idx_t key = keys[i * nprobe + j];
+                    if (key < 0) {
+                        continue;
+                    }
+                    size_t list_size = invlists->list_size(key);
+                    if (list_size == 0) {
+                        continue;
+                    }
+                    scanner->set_list(key, coarse_dis[i * nprobe + j]);
+                    faiss::InvertedLists::ScopedCodes codes(invlists, key);
+                    faiss::InvertedLists::ScopedIds ids(invlists, key);
+                    for (size_t b = 0; b < list_size && qres.nres < max_per_query;
+                         b += kRangeScanBlock) {
+                        size_t nb = std::min(kRangeScanBlock, list_size - b);
+                        scanner->scan_codes_range(
+                                nb, codes.get() + b * code_size, ids.get() + b, radius, qres);
+                    }
+                }
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(exception_mutex);
+                exception_string = e.what();
+            }
+        }
+        // all threads must reach the barriers of finalize
+        pres.finalize();
+    }
+    if (!exception_string.empty()) {
+        FAISS_THROW_MSG(exception_string.c_str());
+    }
+}
+
+/// true if the capped IVF scan handles this index
+bool ivf_capped_supported(const faiss::IndexIVF& ivf, const faiss::SearchParametersIVF* params) {
+    // these override range_search, the scanner would bypass that
+    if (dynamic_cast<const faiss::IndexIVFFastScan*>(&ivf) ||
+        dynamic_cast<const faiss::IndexIVFFlatDedup*>(&ivf)) {
+        return false;
+    }
+    if (ivf.invlists->use_iterator) {
+        return false;
+    }
+    try {
+        std::unique_ptr<faiss::InvertedListScanner> scanner(
+                ivf.get_InvertedListScanner(false, nullptr, params));
+        return scanner != nullptr;
+    } catch (const faiss::FaissException&) {
+        return false;
+    }
+}
+
+/// keep the max_per_query best results of each query, in place
+void trim_results(RangeSearchArena& arena, size_t max_per_query, bool larger_is_better) {
+    size_t* lims = arena.lims.data();
+    std::vector<std::pair<float, idx_t>> tmp;
+    size_t w = 0;
+    for (size_t q = 0; q < arena.nq; q++) {
+        size_t begin = lims[q], end = lims[q + 1];
+        lims[q] = w;
+        if (end - begin <= max_per_query) {
+            std::memmove(arena.labels + w, arena.labels + begin, (end - begin) * sizeof(idx_t));
+            std::memmove(arena.distances + w, arena.distances + begin, (end - begin) * sizeof(float));
+            w += end - begin;
+            continue;
+        }
+        tmp.clear();
+        for (size_t j = begin; j < end; j++) {
+            tmp.emplace_back(arena.distances[j], arena.labels[j]);
+        }
+        auto mid = tmp.begin() + max_per_query;
+        if (larger_is_better) {
+            std::nth_element(tmp.begin(), mid, tmp.end(), std::greater<std::pair<float, idx_t>>());
+        } else {
+            std::nth_element(tmp.begin(), mid, tmp.end());
+        }
+        for (size_t j = 0; j < max_per_query; j++) {
+            arena.distances[w + j] = tmp[j].first;
+            arena.labels[w + j] = tmp[j].second;
+        }
+        w += max_per_query;
+    }
+    lims[arena.nq] = w;
+    arena.total = w;
+}
+
+} // namespace
+
+void RangeSearchArena::set_output(idx_t* labels, float* distances, size_t capacity) {
+    if (!labels || !distances) {
+        capacity = 0;
+    }
+    out_labels = capacity ? labels : nullptr;
+    out_distances = capacity ? distances : nullptr;
+    out_capacity = capacity;
+}
+
+void RangeSearchArena::reserve(size_t n) {
+    if (n <= arena_capacity) {
+        return;
+    }
+    // grow by half at least, result sizes of similar queries drift
+    size_t cap = std::max(n, arena_capacity + arena_capacity / 2);
+    arena_labels.reset(new idx_t[cap]);
+    arena_distances.reset(new float[cap]);
+    arena_capacity = cap;
+    n_allocations++;
+}
+
+void RangeSearchArena::allocate(size_t n) {
+    total = n;
+    if (out_labels && n <= out_capacity) {
+        labels = out_labels;
+        distances = out_distances;
+        in_output = true;
+        return;
+    }
+    reserve(n);
+    labels = arena_labels.get();
+    distances = arena_distances.get();
+    in_output = false;
+}
+
+void RangeSearchArena::copy_to(size_t* lims_out, idx_t* labels_out, float* distances_out) const {
+    if (lims_out) {
+        std::memcpy(lims_out, lims.data(), (nq + 1) * sizeof(size_t));
+    }
+    if (labels_out && labels_out != labels) {
+        std::memcpy(labels_out, labels, total * sizeof(idx_t));
+    }
+    if (distances_out && distances_out != distances) {
+        std::memcpy(distances_out, distances, total * sizeof(float));
+    }
+}
+
+size_t RangeSearchArena::partial_buffer_size() const {
+    // each thread allocates its buffers in blocks of this size, even for
+    // a handful of results
+    size_t per_thread = total / omp_get_max_threads() + 1;
+    size_t size = kMinPartialBuffer;
+    while (size < per_thread && size < kMaxPartialBuffer) {
+        size *= 2;
+    }
+    return size;
+}
+
+ArenaRangeSearchResult::ArenaRangeSearchResult(RangeSearchArena& arena, size_t nq)
+        : faiss::RangeSearchResult(nq, false), arena(arena) {
+    buffer_size = arena.partial_buffer_size();
+    arena.nq = nq;
+    arena.total = 0;
+    arena.labels = nullptr;
+    arena.distances = nullptr;
+    arena.in_output = false;
+    arena.lims.assign(nq + 1, 0);
+    lims = arena.lims.data();
+}
+
+void ArenaRangeSearchResult::do_allocation() {
+    FAISS_THROW_IF_NOT(labels == nullptr && distances == nullptr);
+    size_t ofs = 0;
+    for (size_t i = 0; i < nq; i++) {
+        size_t n = lims[i];
+        lims[i] = ofs;
+        ofs += n;
+    }
+    lims[nq] = ofs;
+    arena.allocate(ofs);
+    labels = arena.labels;
+    distances = arena.distances;
+}
+
+ArenaRangeSearchResult::~ArenaRangeSearchResult() {
+    // the arrays belong to the arena or the caller
+    lims = nullptr;
+    labels = nullptr;
+    distances = nullptr;
+}
+
+size_t range_search_arena(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        float radius,
+        const faiss::SearchParameters* params,
+        size_t max_per_query,
+        RangeSearchArena& arena) {
+    FAISS_THROW_IF_NOT(n >= 0);
+    ArenaRangeSearchResult result(arena, n);
+
+    auto* ivf = dynamic_cast<const faiss::IndexIVF*>(&index);
+    if (max_per_query > 0 && ivf) {
+        auto* ivf_params = dynamic_cast<const faiss::SearchParametersIVF*>(params);
+        FAISS_THROW_IF_NOT_MSG(!params || ivf_params, "IndexIVF params have incorrect type");
+        if (ivf_capped_supported(*ivf, ivf_params)) {
+            ivf_range_search_capped(*ivf, n, x, radius, ivf_params, max_per_query, &result);
+            trim_results(arena, max_per_query, faiss::is_similarity_metric(index.metric_type));
+            return arena.total;
+        }
+    }
+
+    index.range_search(n, x, radius, &result, params);
+    if (max_per_query > 0) {
+        trim_results(arena, max_per_query, faiss::is_similarity_metric(index.metric_type));
+    }
+    return arena.total;
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,111 @@
+/**
+ * FAISS Go Extensions - range search into reusable buffers
+ *
+ * A FAISS range search collects results in per-thread buffer lists of
+ * 256K entries each, allocates fresh lims/labels/distances arrays in
+ * RangeSearchResult::do_allocation and copies the buffers into them; the
+ * Go side then copied the arrays once more. RangeSearchArena keeps the
+ * output arrays between calls, growing them only for a larger result, and
+ * can point them at caller memory instead, so that a range search does
+ * the one copy out of the thread buffers and no allocation in the steady
+ * state. The thread buffer size is sized from the previous result.
+ *
+ * Results larger than the caller buffers stay in the arena and report
+ * their size: the caller can then size its buffers and copy them out
+ * (count-then-fill), or keep reading them in place.
+ *
+ * A per-query cap keeps the max_per_query closest results. On IndexIVF
+ * (with plain inverted lists, not fast-scan) a query stops scanning once the
+ * cap is reached, in blocks of kRangeScanBlock codes, so the kept results
+ * are the closest of those scanned, in probe order; other indexes search
+ * in full and are trimmed afterwards.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_RANGE_ARENA_H
+#define FAISS_GO_EXT_RANGE_ARENA_H
+
+#include <faiss/Index.h>
+#include <faiss/impl/AuxIndexStructures.h>
+
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// codes scanned between two checks of the per-query cap
+constexpr size_t kRangeScanBlock = 1024;
+
+struct RangeSearchArena {
+    size_t nq = 0;       ///< queries of the last search
+    size_t total = 0;    ///< results of the last search
+    std::vector<size_t> lims; ///< nq + 1 offsets of the last search
+
+    /// results of the last search, in the caller buffers or the arena
+    idx_t* labels = nullptr;
+    float* distances = nullptr;
+    bool in_output = false; ///< true if they are in the caller buffers
+
+    size_t n_allocations = 0; ///< times the arena storage grew
+
+    /// Caller buffers for the next searches, used when the results fit.
+    /// NULL buffers (or capacity 0) detach them.
+    void set_output(idx_t* labels, float* distances, size_t capacity);
+
+    /// grow the arena storage to hold n results
+    void reserve(size_t n);
+
+    /// Copy the results out; lims (nq + 1), labels and distances may
+    /// each be NULL. Labels and distances must hold total entries.
+    void copy_to(size_t* lims, idx_t* labels, float* distances) const;
+
+    size_t capacity() const {
+        return arena_capacity;
+    }
+
+    /// entries per thread buffer for the next search
+    size_t partial_buffer_size() const;
+
+    /// point labels and distances at room for n results
+    void allocate(size_t n);
+
+    std::unique_ptr<idx_t[]> arena_labels;
+    std::unique_ptr<float[]> arena_distances;
+    size_t arena_capacity = 0;
+
+    idx_t* out_labels = nullptr;
+    float* out_distances = nullptr;
+    size_t out_capacity = 0;
+};
+
+/// RangeSearchResult whose arrays live in an arena. Pass it to any
+/// Index::range_search; the arena holds the results afterwards.
+struct ArenaRangeSearchResult : faiss::RangeSearchResult {
+    RangeSearchArena& arena;
+
+    ArenaRangeSearchResult(RangeSearchArena& arena, size_t nq);
+
+    void do_allocation() override;
+
+    ~ArenaRangeSearchResult() override;
+};
+
+/// Range search of n queries into the arena, keeping at most
+/// max_per_query results per query (0 = no cap). Returns the number of
+/// results.
+size_t range_search_arena(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        float radius,
+        const faiss::SearchParameters* params,
+        size_t max_per_query,
+        RangeSearchArena& arena);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_RANGE_ARENA_H */
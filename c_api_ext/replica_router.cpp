@@ -0,0 +1,132 @@
+/**
+ * FAISS Go Extensions - load-aware query routing over replicas
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "replica_router.h"
+
+#include <faiss/impl/FaissAssert.h>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// completion of the parts of one search call
+struct PendingSearch {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int left = 0;
+    std::exception_ptr error;
+
+    void finish(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (e && !error) {
+            error = e;
+        }
+        left--;
+        cv.notify_all();
+    }
+};
+
+} // namespace
+
+ReplicaRouter::ReplicaRouter(
+        const std::vector<const faiss::Index*>& replicas,
+        const ReplicaRouterOptions& options)
+        : replicas(replicas), depths(replicas.size()), small_batch(options.small_batch) {
+    FAISS_THROW_IF_NOT_MSG(!replicas.empty(), "no replicas");
+    FAISS_THROW_IF_NOT(options.nodes.empty() || options.nodes.size() == replicas.size());
+    for (size_t r = 0; r < replicas.size(); r++) {
+        FAISS_THROW_IF_NOT(replicas[r] && replicas[r]->d == replicas[0]->d);
+        int node = options.nodes.empty() ? -1 : options.nodes[r];
+        FAISS_THROW_IF_NOT_MSG(node >= -1 && node < numa_num_nodes(), "NUMA node out of range");
+        workers.emplace_back(new NodeWorker(node));
+    }
+}
+
+ReplicaRouter::~ReplicaRouter() {}
+
+int ReplicaRouter::queue_depth(size_t replica) const {
+    FAISS_THROW_IF_NOT(replica < workers.size());
+    return depths[replica];
+}
+
+size_t ReplicaRouter::least_loaded() {
+    const size_t nrep = workers.size();
+    size_t start = next_start++ % nrep;
+    size_t best = start;
+    for (size_t i = 1; i < nrep; i++) {
+        size_t r = (start + i) % nrep;
+        if (depths[r] < depths[best]) {
+            best = r;
+        }
+    }
+    return best;
+}
+
+void ReplicaRouter::search(idx_t n, const float* x, idx_t k, float* distances, idx_t* labels) {
+    FAISS_THROW_IF_NOT(k > 0);
+    if (n == 0) {
+        return;
+    }
+    const size_t nrep = workers.size();
+    std::vector<idx_t> sizes(nrep, 0);
+    if (n <= small_batch || nrep == 1) {
+        sizes[least_loaded()] = n;
+    } else {
+        // share of each replica proportional to 1 / (1 + queue depth)
+        std::vector<double> weights(nrep);
+        double total = 0;
+        for (size_t r = 0; r < nrep; r++) {
+            weights[r] = 1.0 / (1 + depths[r]);
+            total += weights[r];
+        }
+        idx_t assigned = 0;
+        for (size_t r = 0; r < nrep; r++) {
+            sizes[r] = (idx_t)(n * weights[r] / total);
+            assigned += sizes[r];
+        }
+        sizes[least_loaded()] += n - assigned;
+    }
+
+    PendingSearch pending;
+    for (size_t r = 0; r < nrep; r++) {
+        pending.left += sizes[r] > 0;
+    }
+    const size_t d = replicas[0]->d;
+    idx_t i0 = 0;
+    for (size_t r = 0; r < nrep; r++) {
+        idx_t nr = sizes[r];
+        if (nr == 0) {
+            continue;
+        }
+        const faiss::Index* index = replicas[r];
+        std::atomic<int>* depth = &depths[r];
+        (*depth)++;
+        workers[r]->enqueue([=, &pending]() {
+            std::exception_ptr error;
+            try {
+                index->search(nr, x + i0 * d, k, distances + i0 * k, labels + i0 * k);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            (*depth)--;
+            pending.finish(error);
+        });
+        i0 += nr;
+    }
+
+    std::unique_lock<std::mutex> lock(pending.mutex);
+    pending.cv.wait(lock, [&]() { return pending.left == 0; });
+    if (pending.error) {
+        std::rethrow_exception(pending.error);
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,65 @@
+/**
+ * FAISS Go Extensions - load-aware query routing over replicas
+ *
+ * IndexReplicas::search splits every batch evenly over all replicas and
+ * waits for the slowest one, and the depth of its worker queues is not
+ * visible. The router runs one worker thread per replica with its own
+ * queue: small batches go whole to the replica with the fewest queued or
+ * running requests, and larger ones are split in proportion to how idle
+ * each replica is. A worker can be pinned to a NUMA node, so its OpenMP
+ * team runs next to the memory of its replica.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_REPLICA_ROUTER_H
+#define FAISS_GO_EXT_REPLICA_ROUTER_H
+
+#include "numa_topology.h"
+
+#include <faiss/Index.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct ReplicaRouterOptions {
+    idx_t small_batch = 16; ///< batches up to this size go to a single replica
+    std::vector<int> nodes; ///< NUMA node of each replica, -1 or empty = not pinned
+};
+
+/// Routes searches over replicas of the same index. The replicas are not
+/// owned and must outlive the router. search() is thread-safe.
+struct ReplicaRouter {
+    ReplicaRouter(const std::vector<const faiss::Index*>& replicas, const ReplicaRouterOptions& options);
+    ~ReplicaRouter();
+
+    void search(idx_t n, const float* x, idx_t k, float* distances, idx_t* labels);
+
+    size_t count() const {
+        return workers.size();
+    }
+
+    /// requests queued or running on a replica
+    int queue_depth(size_t replica) const;
+
+    std::vector<const faiss::Index*> replicas;
+    std::vector<std::unique_ptr<NodeWorker>> workers; ///< one per replica
+    /// requests of each replica not yet reported to their caller; unlike
+    /// the worker queues, it drops before the caller's search returns
+    std::vector<std::atomic<int>> depths;
+    idx_t small_batch;
+    std::atomic<size_t> next_start{0}; ///< rotates ties between equally loaded replicas
+
+    /// replica with the fewest requests, ties rotate
+    size_t least_loaded();
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_REPLICA_ROUTER_H */
@@ -0,0 +1,141 @@
+/**
+ * FAISS Go Extensions - reusable search scratch
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "search_context.h"
+#include "graph_search.h"
+
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFFastScan.h>
+#include <faiss/impl/DistanceComputer.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/ResultHandler.h>
+
+#include <algorithm>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// hnsw_search of IndexHNSW.cpp for one thread, with the visited table
+/// of the context
+void hnsw_search_with_context(
+        const faiss::IndexHNSW& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params,
+        SearchContext& ctx) {
+    FAISS_THROW_IF_NOT_MSG(
+            index.storage,
+            "No storage index, please use IndexHNSWFlat (or variants) "
+            "instead of IndexHNSW directly");
+    if (!ctx.visited) {
+        ctx.visited.reset(new faiss::VisitedTable(index.ntotal));
+        ctx.n_grows++;
+    } else if (ctx.visited->visited.size() < (size_t)index.ntotal) {
+        // new flags are 0, never the current generation
+        ctx.visited->visited.resize(index.ntotal);
+        ctx.n_grows++;
+    }
+
+    using RH = faiss::HeapBlockResultHandler<faiss::HNSW::C>;
+    RH bres(n, distances, labels, k);
+    RH::SingleResultHandler res(bres);
+    std::unique_ptr<faiss::DistanceComputer> dis(storage_distance_computer(index.storage));
+    for (idx_t i = 0; i < n; i++) {
+        res.begin(i);
+        dis->set_query(x + i * index.d);
+        index.hnsw.search(*dis, &index, res, *ctx.visited, params);
+        res.end();
+    }
+
+    if (faiss::is_similarity_metric(index.metric_type)) {
+        for (size_t i = 0; i < (size_t)(k * n); i++) {
+            distances[i] = -distances[i];
+        }
+    }
+}
+
+/// IndexIVF::search with the coarse buffers of the context
+void ivf_search_with_context(
+        const faiss::IndexIVF& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParametersIVF* params,
+        SearchContext& ctx) {
+    const size_t nprobe = std::min(index.nlist, params ? params->nprobe : index.nprobe);
+    FAISS_THROW_IF_NOT(nprobe > 0);
+    const size_t size = n * nprobe;
+    if (ctx.coarse_ids.size() < size) {
+        ctx.coarse_ids.resize(size);
+        ctx.coarse_dis.resize(size);
+        ctx.n_grows++;
+    }
+    index.quantizer->search(
+            n, x, nprobe, ctx.coarse_dis.data(), ctx.coarse_ids.data(),
+            params ? params->quantizer_params : nullptr);
+    index.invlists->prefetch_lists(ctx.coarse_ids.data(), size);
+    index.search_preassigned(
+            n, x, k, ctx.coarse_ids.data(), ctx.coarse_dis.data(), distances, labels, false, params);
+}
+
+} // namespace
+
+size_t SearchContext::memory_usage() const {
+    return (visited ? visited->visited.capacity() : 0) + coarse_ids.capacity() * sizeof(idx_t) +
+            coarse_dis.capacity() * sizeof(float);
+}
+
+void SearchContext::reset() {
+    visited.reset();
+    std::vector<idx_t>().swap(coarse_ids);
+    std::vector<float>().swap(coarse_dis);
+}
+
+void search_with_context(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params,
+        SearchContext& ctx) {
+    FAISS_THROW_IF_NOT(n >= 0 && k > 0);
+    ctx.n_searches++;
+
+    auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(&index);
+    // these two override search
+    if (hnsw && !dynamic_cast<const faiss::IndexHNSW2Level*>(hnsw) &&
+        !dynamic_cast<const faiss::IndexHNSWCagra*>(hnsw)) {
+        hnsw_search_with_context(*hnsw, n, x, k, distances, labels, params, ctx);
+        return;
+    }
+
+    auto* ivf = dynamic_cast<const faiss::IndexIVF*>(&index);
+    if (ivf && !dynamic_cast<const faiss::IndexIVFFastScan*>(ivf)) {
+        auto* ivf_params = dynamic_cast<const faiss::SearchParametersIVF*>(params);
+        FAISS_THROW_IF_NOT_MSG(!params || ivf_params, "IndexIVF params have incorrect type");
+        ivf_search_with_context(*ivf, n, x, k, distances, labels, ivf_params, ctx);
+        return;
+    }
+
+    index.search(n, x, k, distances, labels, params);
+}
+
+SearchContext& thread_search_context() {
+    static thread_local SearchContext ctx;
+    return ctx;
+}
+
+} // namespace faiss_go_ext
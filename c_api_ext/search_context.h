@@ -0,0 +1,75 @@
+/**
+ * FAISS Go Extensions - reusable search scratch
+ *
+ * Each IndexHNSW::search builds a VisitedTable of ntotal bytes per thread,
+ * zeroed, and each IndexIVF::search allocates the n * nprobe coarse
+ * assignment arrays and an InvertedListScanner per thread. For single
+ * queries at high rates the allocation and the memset, not the graph walk
+ * or the list scan, set the tail latency on large indexes.
+ *
+ * A SearchContext keeps the large buffers across calls: the visited
+ * table, whose generation counter makes a reset free 249 times out of
+ * 250, and the coarse assignment buffers. search_with_context runs the
+ * queries on the calling thread with them; result heaps are built in the
+ * output arrays. Only plain data is cached, so a context can serve any
+ * number of indexes, including ones freed since. The per-call distance
+ * computer and list scanner, a few hundred bytes, are still allocated.
+ * Indexes it does not cover (and HNSW/IVF variants that override search)
+ * fall back to Index::search.
+ *
+ * HNSW queries run one after the other on the calling thread; IVF
+ * batches are still spread over the OpenMP threads by search_preassigned.
+ * A context serves one thread at a time.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SEARCH_CONTEXT_H
+#define FAISS_GO_EXT_SEARCH_CONTEXT_H
+
+#include <faiss/Index.h>
+#include <faiss/impl/AuxIndexStructures.h>
+
+#include <memory>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct SearchContext {
+    /// HNSW visited flags, grown to the largest ntotal seen
+    std::unique_ptr<faiss::VisitedTable> visited;
+
+    /// IVF coarse assignment of the current queries
+    std::vector<idx_t> coarse_ids;
+    std::vector<float> coarse_dis;
+
+    size_t n_grows = 0;    ///< times a buffer was (re)allocated
+    size_t n_searches = 0; ///< calls through the context
+
+    /// bytes held by the scratch buffers
+    size_t memory_usage() const;
+
+    /// release the buffers
+    void reset();
+};
+
+/// Index::search on the calling thread with the scratch of ctx.
+void search_with_context(
+        const faiss::Index& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params,
+        SearchContext& ctx);
+
+/// the calling thread's own context
+SearchContext& thread_search_context();
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SEARCH_CONTEXT_H */
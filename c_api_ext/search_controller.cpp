@@ -0,0 +1,221 @@
+/**
+ * FAISS Go Extensions - search effort controller for a latency target
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "search_controller.h"
+#include "idmap_sorted.h"
+#include "parallel_explore.h"
+
+#include <faiss/IVFlib.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/FaissAssert.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace faiss_go_ext {
+
+namespace {
+
+double now_ms() {
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double, std::milli>(t).count();
+}
+
+/// the IndexHNSW under the wrappers that pass parameters down
+const faiss::IndexHNSW* find_hnsw(const faiss::Index* index) {
+    for (;;) {
+        if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+            return hnsw;
+        } else if (auto* idmap = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+            index = idmap->index;
+        } else if (auto* idmap3 = dynamic_cast<const IndexIDMap3*>(index)) {
+            index = idmap3->index;
+        } else if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(index)) {
+            index = pt->index;
+        } else if (auto* refine = dynamic_cast<const faiss::IndexRefine*>(index)) {
+            index = refine->base_index;
+        } else {
+            return nullptr;
+        }
+    }
+}
+
+/// nprobe or efSearch in powers of two
+faiss::ParameterSpace default_ladder(const faiss::Index* index) {
+    faiss::ParameterSpace ps;
+    if (const faiss::IndexIVF* ivf = faiss::ivflib::try_extract_index_ivf(const_cast<faiss::Index*>(index))) {
+        auto& range = ps.add_range("nprobe");
+        for (size_t nprobe = 1; nprobe < ivf->nlist; nprobe *= 2) {
+            range.values.push_back(nprobe);
+        }
+        range.values.push_back(ivf->nlist);
+    } else if (find_hnsw(index)) {
+        auto& range = ps.add_range("efSearch");
+        for (int ef = 16; ef <= 1024; ef *= 2) {
+            range.values.push_back(ef);
+        }
+    }
+    return ps;
+}
+
+} // namespace
+
+SearchController::SearchController(
+        const faiss::Index* index,
+        double target_p95_ms,
+        const faiss::ParameterSpace* ps,
+        const faiss::OperatingPoints* ops)
+        : index(index), target_p95_ms(target_p95_ms) {
+    FAISS_THROW_IF_NOT(index);
+    FAISS_THROW_IF_NOT_MSG(target_p95_ms > 0, "the latency target must be positive");
+    FAISS_THROW_IF_NOT_MSG(!ops || ps, "operating points need their parameter space");
+    faiss::ParameterSpace ladder = ps ? *ps : default_ladder(index);
+
+    std::vector<size_t> cnos;
+    if (ops) {
+        // optimal_pts is sorted by perf, hence by time; the first point is
+        // the (0, 0) one every OperatingPoints starts with
+        for (const faiss::OperatingPoint& op : ops->optimal_pts) {
+            if (!op.key.empty()) {
+                cnos.push_back(op.cno);
+            }
+        }
+    } else {
+        FAISS_THROW_IF_NOT_MSG(
+                ladder.parameter_ranges.size() <= 1,
+                "a space of several parameters needs operating points to order it");
+        for (size_t cno = 0; cno < ladder.n_combinations(); cno++) {
+            cnos.push_back(cno);
+        }
+    }
+    for (size_t cno : cnos) {
+        FAISS_THROW_IF_NOT_FMT(cno < ladder.n_combinations(), "combination %zu out of range", cno);
+        Level l;
+        l.key = ladder.combination_name(cno);
+        l.params = combination_search_params(index, ladder, cno);
+        FAISS_THROW_IF_NOT_FMT(
+                !l.params.empty() || ladder.parameter_ranges.empty(),
+                "%s has no SearchParameters form", l.key.c_str());
+        levels.push_back(std::move(l));
+    }
+    if (levels.empty()) {
+        // nothing to tune, the controller only measures
+        levels.emplace_back();
+    }
+    samples.resize(window);
+    t_start = now_ms();
+}
+
+void SearchController::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::IDSelector* sel) {
+    const int at = level.load();
+    const Level& l = levels[at];
+    faiss::SearchParameters* params = l.params.empty() ? nullptr : l.params[0].get();
+    // the level parameters are shared between threads, a selector gets
+    // its own copy of the outer one
+    std::unique_ptr<faiss::SearchParameters> outer;
+    if (sel) {
+        if (auto* ivf = dynamic_cast<faiss::SearchParametersIVF*>(params)) {
+            outer.reset(new faiss::SearchParametersIVF(*ivf));
+        } else if (auto* hnsw = dynamic_cast<faiss::SearchParametersHNSW*>(params)) {
+            outer.reset(new faiss::SearchParametersHNSW(*hnsw));
+        } else if (params) {
+            FAISS_THROW_MSG("a selector is only supported for IVF and HNSW levels");
+        } else {
+            outer.reset(new faiss::SearchParameters());
+        }
+        outer->sel = const_cast<faiss::IDSelector*>(sel);
+        params = outer.get();
+    }
+    double t0 = now_ms();
+    index->search(n, x, k, distances, labels, params);
+    record(at, n, now_ms() - t0);
+}
+
+void SearchController::record(int at_level, idx_t n, double ms) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Level& l = levels[at_level];
+    l.n_calls++;
+    l.n_queries += n;
+    l.total_ms += ms;
+    n_calls++;
+    if (at_level != level.load()) {
+        // started before the last level change
+        return;
+    }
+    samples[n_samples % window] = ms;
+    n_samples++;
+    if (n_calls % adjust_every == 0) {
+        adjust();
+    }
+}
+
+double SearchController::window_p95() const {
+    size_t n = std::min(n_samples, window);
+    if (n == 0) {
+        return -1;
+    }
+    std::vector<double> tmp(samples.begin(), samples.begin() + n);
+    size_t rank = (size_t)std::ceil(0.95 * n) - 1;
+    std::nth_element(tmp.begin(), tmp.begin() + rank, tmp.end());
+    return tmp[rank];
+}
+
+void SearchController::adjust() {
+    n_adjust++;
+    if (n_samples < min_samples) {
+        return;
+    }
+    const int cur = level.load();
+    const double p95 = window_p95();
+    Level& l = levels[cur];
+    if (n_samples >= window || p95 > target_p95_ms) {
+        l.last_p95_ms = p95;
+        l.measured_at = n_adjust;
+    }
+    int to = cur;
+    if (p95 > target_p95_ms && cur > 0) {
+        to = cur - 1;
+    } else if (p95 < headroom * target_p95_ms && cur + 1 < (int)levels.size()) {
+        const Level& up = levels[cur + 1];
+        bool failed = up.last_p95_ms > target_p95_ms && n_adjust - up.measured_at < stale_after;
+        if (!failed) {
+            to = cur + 1;
+        }
+    }
+    if (to == cur) {
+        return;
+    }
+    if (events.size() >= max_history) {
+        events.erase(events.begin());
+    }
+    events.push_back({n_calls, now_ms() - t_start, cur, to, p95});
+    level.store(to);
+    n_samples = 0;
+}
+
+double SearchController::current_p95_ms() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return window_p95();
+}
+
+std::vector<SearchController::Event> SearchController::history() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return events;
+}
+
+} // namespace faiss_go_ext
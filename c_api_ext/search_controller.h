@@ -0,0 +1,115 @@
+/**
+ * FAISS Go Extensions - search effort controller for a latency target
+ *
+ * nprobe and efSearch are set by hand and drift out of tune as the data
+ * and the traffic change. A SearchController wraps an index and a ladder
+ * of effort levels, from the cheapest to the most accurate, each one a
+ * parameter combination passed per call as SearchParameters (the index
+ * itself is not modified, so several controllers can share it).
+ *
+ * Every call is timed. Each adjust_every calls the controller takes the
+ * p95 of the last window calls at the current level: above the target it
+ * steps down a level, below headroom * target it steps up, unless the
+ * level above was measured over the target in the last stale_after
+ * adjustments. Each step starts a new window.
+ *
+ * The ladder comes from the optimal points of an OperatingPoints (e.g.
+ * from explore_parallel), from the values of a single-range
+ * ParameterSpace, or by default from powers of two of nprobe (IVF) or
+ * efSearch (HNSW).
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SEARCH_CONTROLLER_H
+#define FAISS_GO_EXT_SEARCH_CONTROLLER_H
+
+#include <faiss/AutoTune.h>
+#include <faiss/Index.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct SearchController {
+    struct Level {
+        std::string key; ///< combination name, e.g. "nprobe=16"
+        std::vector<std::unique_ptr<faiss::SearchParameters>> params; ///< outermost first, may be empty
+        size_t n_calls = 0;
+        size_t n_queries = 0;
+        double total_ms = 0;
+        double last_p95_ms = -1;  ///< p95 of the last full window at this level
+        size_t measured_at = 0;   ///< adjustment count of last_p95_ms
+    };
+
+    /// a level change
+    struct Event {
+        size_t call;     ///< calls before the change
+        double time_ms;  ///< since construction
+        int from, to;
+        double p95_ms;   ///< window p95 that triggered it
+    };
+
+    const faiss::Index* index;
+    std::vector<Level> levels;
+
+    double target_p95_ms;
+    double headroom = 0.8;
+    size_t window = 128;       ///< calls per p95 estimate
+    size_t adjust_every = 16;  ///< calls between two adjustments
+    size_t min_samples = 32;   ///< calls at a level before it may be left
+    size_t stale_after = 32;   ///< adjustments before a failed level is tried again
+    size_t max_history = 1024;
+
+    /// Levels from the optimal points of ops (with ps), from the values of
+    /// a one-range ps, or the default ladder if ps is null.
+    SearchController(
+            const faiss::Index* index,
+            double target_p95_ms,
+            const faiss::ParameterSpace* ps = nullptr,
+            const faiss::OperatingPoints* ops = nullptr);
+
+    /// Index::search with the parameters of the current level; sel, if
+    /// any, is passed along
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::IDSelector* sel = nullptr);
+
+    int current_level() const {
+        return level.load();
+    }
+
+    /// p95 of the current window, -1 if it is empty
+    double current_p95_ms() const;
+
+    std::vector<Event> history() const;
+
+    /// guards the counters of levels, the samples and the events
+    mutable std::mutex mutex;
+    std::atomic<int> level{0};
+    std::vector<double> samples; ///< ring buffer of call latencies (ms)
+    size_t n_samples = 0;        ///< calls at the current level
+    size_t n_calls = 0;
+    size_t n_adjust = 0;
+    std::vector<Event> events;
+    double t_start = 0;
+
+    void record(int at_level, idx_t n, double ms);
+    void adjust();
+    double window_p95() const;
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SEARCH_CONTROLLER_H */
@@ -0,0 +1,63 @@
+/**
+ * FAISS Go Extensions - per-call copies of search parameters
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "search_params.h"
+
+#include <faiss/IndexAdditiveQuantizer.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/IndexIVFRaBitQ.h>
+#include <faiss/IndexPQ.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/IndexRaBitQ.h>
+#include <faiss/IndexRefine.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/HNSW.h>
+
+#include <typeinfo>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// copies params if its dynamic type is exactly T, so no field is sliced
+template <class T>
+bool copy_as(const faiss::SearchParameters& params, std::unique_ptr<faiss::SearchParameters>* res) {
+    if (typeid(params) != typeid(T)) {
+        return false;
+    }
+    res->reset(new T(static_cast<const T&>(params)));
+    return true;
+}
+
+} // namespace
+
+std::unique_ptr<faiss::SearchParameters> copy_search_params(const faiss::SearchParameters& params) {
+    std::unique_ptr<faiss::SearchParameters> res;
+    if (copy_as<faiss::SearchParameters>(params, &res) || copy_as<faiss::SearchParametersIVF>(params, &res) ||
+        copy_as<faiss::IVFPQSearchParameters>(params, &res) ||
+        copy_as<faiss::IVFRaBitQSearchParameters>(params, &res) ||
+        copy_as<faiss::SearchParametersHNSW>(params, &res) || copy_as<faiss::SearchParametersPQ>(params, &res) ||
+        copy_as<faiss::RaBitQSearchParameters>(params, &res) ||
+        copy_as<faiss::SearchParametersPreTransform>(params, &res) ||
+        copy_as<faiss::IndexRefineSearchParameters>(params, &res) ||
+        copy_as<faiss::SearchParametersResidualCoarseQuantizer>(params, &res)) {
+        return res;
+    }
+    FAISS_THROW_FMT("cannot copy search parameters of type %s", typeid(params).name());
+}
+
+PositionParams::PositionParams(const faiss::SearchParameters* p, const faiss::idx_t* ids) : params(p) {
+    if (p && p->sel) {
+        sel.reset(new IDSelectorPositions(ids, p->sel));
+        copy = copy_search_params(*p);
+        copy->sel = sel.get();
+        params = copy.get();
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,59 @@
+/**
+ * FAISS Go Extensions - per-call copies of search parameters
+ *
+ * Wrappers that translate or extend the caller's IDSelector (IndexIDMap3,
+ * snapshots, IVF tombstones) cannot swap it into the caller's
+ * SearchParameters for the duration of a search, as faiss::IndexIDMap
+ * does: the same object may be shared by concurrent searches, and one of
+ * them would save, then restore, the selector of another call after that
+ * call freed it. They search with a copy whose selector is their own.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SEARCH_PARAMS_H
+#define FAISS_GO_EXT_SEARCH_PARAMS_H
+
+#include <faiss/Index.h>
+#include <faiss/impl/IDSelector.h>
+
+#include <memory>
+
+namespace faiss_go_ext {
+
+/// Copy of params with its dynamic type, for the SearchParameters types
+/// of the FAISS CPU indexes (SearchParametersIVF, IVFPQSearchParameters,
+/// IVFRaBitQSearchParameters, SearchParametersHNSW, SearchParametersPQ,
+/// RaBitQSearchParameters, SearchParametersPreTransform,
+/// IndexRefineSearchParameters, SearchParametersResidualCoarseQuantizer).
+/// Pointer fields (quantizer_params, index_params, ...) are shared with
+/// params. Throws for other types, whose fields could not be kept.
+std::unique_ptr<faiss::SearchParameters> copy_search_params(const faiss::SearchParameters& params);
+
+/// IDSelector on positions for a selector on ids
+struct IDSelectorPositions : faiss::IDSelector {
+    const faiss::idx_t* ids; ///< position -> id
+    const faiss::IDSelector* sel;
+
+    IDSelectorPositions(const faiss::idx_t* ids, const faiss::IDSelector* sel) : ids(ids), sel(sel) {}
+
+    bool is_member(faiss::idx_t i) const override {
+        return sel->is_member(ids[i]);
+    }
+};
+
+/// params, or a copy of them whose selector on ids is translated to
+/// positions through ids, for wrappers that store the ids of the
+/// positions of their sub-index
+struct PositionParams {
+    const faiss::SearchParameters* params;
+    std::unique_ptr<IDSelectorPositions> sel;
+    std::unique_ptr<faiss::SearchParameters> copy;
+
+    PositionParams(const faiss::SearchParameters* params, const faiss::idx_t* ids);
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SEARCH_PARAMS_H */
@@ -0,0 +1,597 @@
+/**
+ * FAISS Go Extensions - segmented index for continuous upserts
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "segmented_index.h"
+#include "idmap_sorted.h"
+
+#include <faiss/IVFlib.h>
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexPreTransform.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/invlists/BlockInvertedLists.h>
+#include <faiss/invlists/InvertedLists.h>
+#include <faiss/utils/Heap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+namespace faiss_go_ext {
+
+namespace {
+
+/// labels that are not deleted and whose id, if sel is set, passes it
+struct SegmentSelector : faiss::IDSelector {
+    const IVFIdTable* deleted;
+    const std::vector<idx_t>* ids; ///< position -> id, null if labels are ids
+    const faiss::IDSelector* sel;
+
+    SegmentSelector(const IVFIdTable* deleted, const std::vector<idx_t>* ids, const faiss::IDSelector* sel)
+            : deleted(deleted), ids(ids), sel(sel) {}
+
+    bool is_member(idx_t label) const override {
+        return deleted->lookup(label) < 0 && (!sel || sel->is_member(ids ? (*ids)[label] : label));
+    }
+};
+
+/// the tombstoned labels, for remove_ids
+struct DeletedSelector : faiss::IDSelector {
+    const IVFIdTable* deleted;
+
+    explicit DeletedSelector(const IVFIdTable* deleted) : deleted(deleted) {}
+
+    bool is_member(idx_t label) const override {
+        return deleted->lookup(label) >= 0;
+    }
+};
+
+/// k-NN search of a write or frozen segment, labels translated to ids
+void search_unsealed(
+        const faiss::Index* index,
+        const std::vector<idx_t>* ids,
+        const IVFIdTable* deleted,
+        int efSearch,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::IDSelector* sel) {
+    if (index->ntotal == 0) {
+        // the flat kernels leave the results of an empty index unset;
+        // the merge skips -1 labels whatever their distance
+        std::fill(labels, labels + n * k, -1);
+        return;
+    }
+    SegmentSelector filter(deleted, ids, sel);
+    // HNSW and flat searches are slower with a selector, skip it if possible
+    faiss::IDSelector* fsel = deleted->size > 0 || sel ? &filter : nullptr;
+    if (auto* hnsw = dynamic_cast<const faiss::IndexHNSW*>(index)) {
+        faiss::SearchParametersHNSW params;
+        params.efSearch = efSearch > 0 ? efSearch : hnsw->hnsw.efSearch;
+        params.check_relative_distance = hnsw->hnsw.check_relative_distance;
+        params.bounded_queue = hnsw->hnsw.search_bounded_queue;
+        params.sel = fsel;
+        index->search(n, x, k, distances, labels, &params);
+    } else {
+        faiss::SearchParameters params;
+        params.sel = fsel;
+        index->search(n, x, k, distances, labels, &params);
+    }
+    for (idx_t i = 0; i < n * k; i++) {
+        if (labels[i] >= 0) {
+            labels[i] = (*ids)[labels[i]];
+        }
+    }
+}
+
+/// k-NN search of a sealed segment for queries already transformed and
+/// assigned to lists
+void search_sealed(
+        const Segment& seg,
+        size_t nprobe,
+        idx_t n,
+        const float* xq,
+        const idx_t* keys,
+        const float* coarse_dis,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::IDSelector* sel) {
+    const faiss::IndexIVF* ivf = faiss::ivflib::extract_index_ivf(seg.index.get());
+    SegmentSelector filter(seg.deleted.get(), nullptr, sel);
+    faiss::SearchParametersIVF params;
+    params.nprobe = nprobe;
+    params.max_codes = ivf->max_codes;
+    params.sel = seg.deleted->size > 0 || sel ? &filter : nullptr;
+    ivf->search_preassigned(n, xq, k, keys, coarse_dis, distances, labels, false, &params);
+}
+
+/// IVF segment holding the vectors of a frozen segment that are not deleted
+faiss::Index* seal_segment(const Segment& seg, const faiss::Index* tmpl) {
+    const int d = tmpl->d;
+    const idx_t nt = seg.index->ntotal;
+    std::vector<float> x(nt * d);
+    seg.index->reconstruct_n(0, nt, x.data());
+    std::vector<idx_t> live_ids;
+    live_ids.reserve(nt);
+    for (idx_t p = 0; p < nt; p++) {
+        if (seg.deleted->lookup(p) >= 0) {
+            continue;
+        }
+        idx_t w = live_ids.size();
+        if (w != p) {
+            memcpy(x.data() + w * d, x.data() + p * d, sizeof(float) * d);
+        }
+        live_ids.push_back((*seg.ids)[p]);
+    }
+    std::unique_ptr<faiss::Index> index(clone_index_ext(tmpl));
+    index->add_with_ids(live_ids.size(), x.data(), live_ids.data());
+    return index.release();
+}
+
+/// ntotal from the list sizes: BlockInvertedLists::remove_ids does not
+/// return the number of entries it removed
+void sync_ntotal(faiss::Index* index) {
+    faiss::IndexIVF* ivf = faiss::ivflib::extract_index_ivf(index);
+    idx_t nt = 0;
+    for (size_t l = 0; l < ivf->nlist; l++) {
+        nt += ivf->invlists->list_size(l);
+    }
+    ivf->ntotal = nt;
+    index->ntotal = nt;
+}
+
+/// sealed segments merged into one without their deleted entries. The
+/// segments are searched meanwhile, so each is copied before it is purged
+/// and moved into the largest one by merge_into.
+faiss::Index* merge_segments(std::vector<std::shared_ptr<const Segment>> sources) {
+    std::sort(sources.begin(), sources.end(), [](const auto& a, const auto& b) {
+        return a->index->ntotal > b->index->ntotal;
+    });
+    std::unique_ptr<faiss::Index> merged;
+    for (const auto& seg : sources) {
+        std::unique_ptr<faiss::Index> copy(clone_index_ext(seg->index.get()));
+        if (seg->deleted->size > 0) {
+            DeletedSelector sel(seg->deleted.get());
+            copy->remove_ids(sel);
+            sync_ntotal(copy.get());
+        }
+        if (!merged) {
+            merged = std::move(copy);
+        } else {
+            faiss::ivflib::merge_into(merged.get(), copy.get(), false);
+        }
+    }
+    return merged.release();
+}
+
+} // namespace
+
+SegmentedIndex::SegmentedIndex(
+        const faiss::Index* write_template,
+        const faiss::Index* segment_template,
+        const SegmentedIndexOptions& options)
+        : options(options) {
+    FAISS_THROW_IF_NOT(write_template && segment_template);
+    FAISS_THROW_IF_NOT_MSG(
+            dynamic_cast<const faiss::IndexFlat*>(write_template) ||
+                    dynamic_cast<const faiss::IndexHNSW*>(write_template),
+            "the write segment must be an IndexFlat or an IndexHNSW");
+    const faiss::Index* under = segment_template;
+    if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(under)) {
+        under = pt->index;
+    }
+    auto* ivf = dynamic_cast<const faiss::IndexIVF*>(under);
+    FAISS_THROW_IF_NOT_MSG(ivf, "sealed segments must be an IndexIVF, possibly under an IndexPreTransform");
+    FAISS_THROW_IF_NOT_MSG(
+            dynamic_cast<const faiss::ArrayInvertedLists*>(ivf->invlists) ||
+                    dynamic_cast<const faiss::BlockInvertedLists*>(ivf->invlists),
+            "sealed segments must use array or block inverted lists");
+    FAISS_THROW_IF_NOT_MSG(write_template->is_trained && segment_template->is_trained, "the templates must be trained");
+    FAISS_THROW_IF_NOT_MSG(
+            write_template->d == segment_template->d &&
+                    write_template->metric_type == segment_template->metric_type,
+            "the templates must have the same dimension and metric");
+    FAISS_THROW_IF_NOT(options.write_capacity > 0 && options.max_segments > 0 && options.merge_factor >= 2);
+    d = write_template->d;
+    metric_type = write_template->metric_type;
+
+    write_tmpl.reset(clone_index_ext(write_template));
+    write_tmpl->reset();
+    segment_tmpl.reset(clone_index_ext(segment_template));
+    segment_tmpl->reset();
+    // merge_from does not support direct maps
+    faiss::ivflib::extract_index_ivf(segment_tmpl.get())->set_direct_map_type(faiss::DirectMap::NoMap);
+
+    current = std::make_shared<const SegmentList>();
+    new_write_segment();
+    if (options.background) {
+        worker = std::thread([this]() { run_worker(); });
+    }
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    if (worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            stop = true;
+        }
+        task_cv.notify_all();
+        worker.join();
+    }
+}
+
+void SegmentedIndex::new_write_segment() {
+    write.number = next_number++;
+    write.index.reset(clone_index_ext(write_tmpl.get()));
+    write.ids = std::make_shared<std::vector<idx_t>>();
+    write.positions = std::make_shared<IVFIdTable>();
+    write.deleted = std::make_shared<IVFIdTable>();
+}
+
+void SegmentedIndex::publish(std::shared_ptr<const SegmentList> list) {
+    std::atomic_store(&current, list);
+}
+
+uint64_t SegmentedIndex::resolve(uint64_t number) const {
+    for (auto it = merged_into.find(number); it != merged_into.end(); it = merged_into.find(number)) {
+        number = it->second;
+    }
+    return number;
+}
+
+/// Rebuild locations without the deleted ids, with the numbers of merged
+/// segments resolved so that merged_into can be emptied. Run by the tasks
+/// once the deleted ids outnumber the live ones, so the rebuilds cost
+/// O(1) per delete.
+void SegmentedIndex::purge_locations() {
+    IVFIdTable live;
+    live.reserve(n_live.load());
+    const int64_t* slots = locations.slots.data();
+    for (size_t h = 0; h < locations.capacity; h++) {
+        if (slots[2 * h] >= 0 && slots[2 * h + 1] >= 0) {
+            live.insert(slots[2 * h], resolve(slots[2 * h + 1]));
+        }
+    }
+    locations = std::move(live);
+    merged_into.clear();
+}
+
+void SegmentedIndex::freeze() {
+    if (write.index->ntotal == 0) {
+        return;
+    }
+    auto seg = std::make_shared<Segment>();
+    seg->number = write.number;
+    seg->index = write.index;
+    seg->ids = write.ids;
+    seg->positions = write.positions;
+    seg->deleted = write.deleted;
+    auto list = std::make_shared<SegmentList>(*std::atomic_load(&current));
+    list->push_back(seg);
+    publish(list);
+    new_write_segment();
+}
+
+size_t SegmentedIndex::remove_locked(idx_t n, const idx_t* ids) {
+    std::unordered_map<uint64_t, std::vector<idx_t>> by_segment;
+    size_t n_removed = 0;
+    for (idx_t i = 0; i < n; i++) {
+        idx_t id = ids[i];
+        idx_t loc = id < 0 ? -1 : locations.lookup(id);
+        if (loc < 0) {
+            continue;
+        }
+        locations.insert(id, -1);
+        by_segment[resolve(loc)].push_back(id);
+        n_removed++;
+    }
+    if (n_removed == 0) {
+        return 0;
+    }
+    auto w = by_segment.find(write.number);
+    if (w != by_segment.end()) {
+        std::unique_lock<std::shared_mutex> lock(write_segment_mutex);
+        for (idx_t id : w->second) {
+            write.deleted->insert(write.positions->lookup(id), 0);
+        }
+        by_segment.erase(w);
+    }
+    if (!by_segment.empty()) {
+        // new versions of the segments with the added tombstones
+        auto list = std::make_shared<SegmentList>(*std::atomic_load(&current));
+        for (auto& seg : *list) {
+            auto it = by_segment.find(seg->number);
+            if (it == by_segment.end()) {
+                continue;
+            }
+            auto deleted = std::make_shared<IVFIdTable>(*seg->deleted);
+            deleted->reserve(deleted->size + it->second.size());
+            for (idx_t id : it->second) {
+                deleted->insert(seg->sealed ? id : seg->positions->lookup(id), 0);
+            }
+            auto next = std::make_shared<Segment>(*seg);
+            next->deleted = deleted;
+            seg = next;
+        }
+        publish(list);
+    }
+    n_live -= n_removed;
+    return n_removed;
+}
+
+void SegmentedIndex::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    for (idx_t i = 0; i < n; i++) {
+        FAISS_THROW_IF_NOT_MSG(xids[i] >= 0, "ids must be >= 0");
+    }
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        for (idx_t i0 = 0; i0 < n;) {
+            // up to the end of the write segment
+            idx_t m = std::min(n - i0, options.write_capacity - write.index->ntotal);
+            const idx_t* chunk = xids + i0;
+            // earlier versions, so that no search sees two
+            remove_locked(m, chunk);
+
+            std::unique_lock<std::shared_mutex> wlock(write_segment_mutex);
+            const idx_t p0 = write.index->ntotal;
+            write.index->add(m, x + i0 * d);
+            write.ids->insert(write.ids->end(), chunk, chunk + m);
+            write.positions->reserve(write.positions->size + m);
+            for (idx_t j = 0; j < m; j++) {
+                idx_t id = chunk[j];
+                if (locations.lookup(id) >= 0) {
+                    // repeated within the chunk
+                    write.deleted->insert(write.positions->lookup(id), 0);
+                    n_live--;
+                }
+                write.positions->insert(id, p0 + j);
+                locations.insert(id, write.number);
+            }
+            n_live += m;
+            if (write.index->ntotal >= options.write_capacity) {
+                freeze();
+            }
+            i0 += m;
+        }
+    }
+    schedule();
+}
+
+size_t SegmentedIndex::remove(idx_t n, const idx_t* ids) {
+    size_t n_removed;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        n_removed = remove_locked(n, ids);
+    }
+    schedule();
+    return n_removed;
+}
+
+void SegmentedIndex::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::IDSelector* sel) const {
+    FAISS_THROW_IF_NOT(k > 0);
+    const int ef = efSearch.load();
+    // the list is taken under the write segment lock: a freeze moves the
+    // write segment to a new list under the exclusive lock
+    std::shared_lock<std::shared_mutex> wlock(write_segment_mutex);
+    std::shared_ptr<const SegmentList> list = std::atomic_load(&current);
+    const size_t nseg = list->size() + 1;
+    const size_t stride = n * k;
+    std::vector<float> all_distances(nseg * stride);
+    std::vector<idx_t> all_labels(nseg * stride);
+    // the newest segment last
+    search_unsealed(
+            write.index.get(), write.ids.get(), write.deleted.get(), ef, n, x, k,
+            all_distances.data() + (nseg - 1) * stride, all_labels.data() + (nseg - 1) * stride, sel);
+    wlock.unlock();
+
+    // sealed segments are copies of the same trained template: the queries
+    // are transformed and assigned to lists once for all of them
+    const faiss::IndexIVF* tivf = faiss::ivflib::extract_index_ivf(segment_tmpl.get());
+    const int np = nprobe.load();
+    const size_t nprobe_used = std::min(tivf->nlist, (size_t)(np > 0 ? np : tivf->nprobe));
+    const float* xq = x;
+    std::unique_ptr<const float[]> transformed;
+    std::vector<idx_t> keys;
+    std::vector<float> coarse_dis;
+    for (size_t s = 0; s + 1 < nseg; s++) {
+        const Segment& seg = *(*list)[s];
+        float* seg_distances = all_distances.data() + s * stride;
+        idx_t* seg_labels = all_labels.data() + s * stride;
+        if (!seg.sealed) {
+            search_unsealed(
+                    seg.index.get(), seg.ids.get(), seg.deleted.get(), ef, n, x, k, seg_distances, seg_labels, sel);
+            continue;
+        }
+        if (keys.empty()) {
+            if (auto* pt = dynamic_cast<const faiss::IndexPreTransform*>(segment_tmpl.get())) {
+                xq = pt->apply_chain(n, x);
+                if (xq != x) {
+                    transformed.reset(xq);
+                }
+            }
+            keys.resize(n * nprobe_used);
+            coarse_dis.resize(n * nprobe_used);
+            tivf->quantizer->search(n, xq, nprobe_used, coarse_dis.data(), keys.data());
+        }
+        search_sealed(seg, nprobe_used, n, xq, keys.data(), coarse_dis.data(), k, seg_distances, seg_labels, sel);
+    }
+    // the merge heap has the best result on top
+    if (faiss::is_similarity_metric(metric_type)) {
+        faiss::merge_knn_results<idx_t, faiss::CMax<float, int>>(
+                n, k, nseg, all_distances.data(), all_labels.data(), distances, labels);
+    } else {
+        faiss::merge_knn_results<idx_t, faiss::CMin<float, int>>(
+                n, k, nseg, all_distances.data(), all_labels.data(), distances, labels);
+    }
+}
+
+std::vector<SegmentInfo> SegmentedIndex::segments() const {
+    std::shared_lock<std::shared_mutex> wlock(write_segment_mutex);
+    std::shared_ptr<const SegmentList> list = std::atomic_load(&current);
+    std::vector<SegmentInfo> infos;
+    for (const auto& seg : *list) {
+        infos.push_back({seg->number, seg->sealed ? 2 : 1, seg->index->ntotal, (idx_t)seg->deleted->size});
+    }
+    infos.push_back({write.number, 0, write.index->ntotal, (idx_t)write.deleted->size});
+    return infos;
+}
+
+bool SegmentedIndex::run_task() {
+    std::vector<std::shared_ptr<const Segment>> sources;
+    bool seal = false;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        std::shared_ptr<const SegmentList> list = std::atomic_load(&current);
+        std::vector<std::shared_ptr<const Segment>> sealed;
+        for (const auto& seg : *list) {
+            if (seg->sealed) {
+                sealed.push_back(seg);
+            } else if (!seal) {
+                // the oldest frozen segment first
+                sources.push_back(seg);
+                seal = true;
+            }
+        }
+        if (!seal) {
+            for (const auto& seg : sealed) {
+                size_t nd = seg->deleted->size;
+                if (nd > 0 && nd >= options.purge_fraction * seg->index->ntotal) {
+                    sources.push_back(seg);
+                    break;
+                }
+            }
+        }
+        if (sources.empty() && sealed.size() > options.max_segments) {
+            std::sort(sealed.begin(), sealed.end(), [](const auto& a, const auto& b) {
+                return a->index->ntotal - (idx_t)a->deleted->size < b->index->ntotal - (idx_t)b->deleted->size;
+            });
+            sources.assign(sealed.begin(), sealed.begin() + std::min(options.merge_factor, sealed.size()));
+        }
+        if (sources.empty()) {
+            return false;
+        }
+    }
+
+    std::shared_ptr<const faiss::Index> built(
+            seal ? seal_segment(*sources[0], segment_tmpl.get()) : merge_segments(sources));
+
+    std::lock_guard<std::mutex> lock(write_mutex);
+    auto result = std::make_shared<Segment>();
+    result->number = seal ? sources[0]->number : next_number++;
+    result->sealed = true;
+    result->index = built;
+    auto deleted = std::make_shared<IVFIdTable>();
+    auto list = std::make_shared<SegmentList>();
+    bool placed = false;
+    for (const auto& seg : *std::atomic_load(&current)) {
+        auto src = std::find_if(sources.begin(), sources.end(), [&](const auto& s) {
+            return s->number == seg->number;
+        });
+        if (src == sources.end()) {
+            list->push_back(seg);
+            continue;
+        }
+        if (seg->deleted != (*src)->deleted) {
+            // tombstones added while the task ran
+            const int64_t* slots = seg->deleted->slots.data();
+            for (size_t h = 0; h < seg->deleted->capacity; h++) {
+                idx_t label = slots[2 * h];
+                if (label < 0 || (*src)->deleted->lookup(label) >= 0) {
+                    continue;
+                }
+                deleted->insert(seg->sealed ? label : (*seg->ids)[label], 0);
+            }
+        }
+        if (!seal) {
+            merged_into[seg->number] = result->number;
+        }
+        if (!placed && built->ntotal > 0) {
+            list->push_back(result);
+        }
+        placed = true;
+    }
+    result->deleted = deleted;
+    publish(list);
+    if (locations.size > 2 * (size_t)n_live.load()) {
+        purge_locations();
+    }
+    return true;
+}
+
+void SegmentedIndex::schedule() {
+    if (options.background) {
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            task_pending = true;
+        }
+        task_cv.notify_one();
+    } else {
+        // one caller at a time runs the tasks
+        std::lock_guard<std::mutex> lock(task_mutex);
+        while (run_task()) {
+        }
+    }
+}
+
+void SegmentedIndex::run_worker() {
+    std::unique_lock<std::mutex> lock(task_mutex);
+    for (;;) {
+        task_cv.wait(lock, [this]() { return stop || task_pending; });
+        if (stop) {
+            return;
+        }
+        task_pending = false;
+        task_running = true;
+        lock.unlock();
+        std::string error;
+        try {
+            while (!stop && run_task()) {
+            }
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        lock.lock();
+        task_running = false;
+        if (!error.empty()) {
+            task_error = error;
+        }
+        idle_cv.notify_all();
+    }
+}
+
+void SegmentedIndex::flush() {
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        std::unique_lock<std::shared_mutex> wlock(write_segment_mutex);
+        freeze();
+    }
+    if (!options.background) {
+        schedule();
+        return;
+    }
+    std::unique_lock<std::mutex> lock(task_mutex);
+    task_pending = true;
+    task_cv.notify_one();
+    idle_cv.wait(lock, [this]() { return !task_pending && !task_running; });
+    if (!task_error.empty()) {
+        std::string error;
+        std::swap(error, task_error);
+        FAISS_THROW_MSG(error);
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,185 @@
+/**
+ * FAISS Go Extensions - segmented index for continuous upserts
+ *
+ * No single FAISS index takes a steady stream of upserts well: HNSW
+ * cannot delete, IVF remove_ids scans every list and blocks searches, and
+ * a flat index grows without bound. A SegmentedIndex is organized like a
+ * log-structured merge tree:
+ *
+ *  - adds go to a small write segment (IndexFlat or IndexHNSW). When it
+ *    holds write_capacity vectors it is frozen, stays searchable as is,
+ *    and a new write segment takes the adds;
+ *  - a background thread seals frozen segments into IVF segments (any
+ *    IndexIVF, fast-scan included, possibly under an IndexPreTransform)
+ *    and merges the smallest sealed segments together with
+ *    ivflib::merge_into (IndexIVF::merge_from), purging deleted entries
+ *    on the way;
+ *  - deletes, and the old version of an upserted id, only add the id to
+ *    the tombstones of the segment holding it, an IVFIdTable used as the
+ *    IDSelector of that segment's searches. A segment with many
+ *    tombstones is rewritten on its own;
+ *  - searches go through every segment and combine the per-segment
+ *    results with a k-way merge (faiss::merge_knn_results). All sealed
+ *    segments have the template's coarse quantizer, so the queries are
+ *    assigned to lists once and each segment is scanned with
+ *    search_preassigned.
+ *
+ * Sealed and frozen segments are immutable and published as a list
+ * swapped atomically (tombstone changes publish new segment versions),
+ * so only the write segment is searched under a lock, and only adds and
+ * deletes that hit it take that lock exclusively.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SEGMENTED_INDEX_H
+#define FAISS_GO_EXT_SEGMENTED_INDEX_H
+
+#include "ivf_id_table.h"
+
+#include <faiss/Index.h>
+#include <faiss/impl/IDSelector.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct SegmentedIndexOptions {
+    idx_t write_capacity = 65536; ///< vectors in the write segment before it is frozen
+    size_t max_segments = 8;      ///< sealed segments before the smallest are merged
+    size_t merge_factor = 4;      ///< sealed segments merged at once
+    double purge_fraction = 0.25; ///< deleted fraction that makes a segment be rewritten
+    bool background = true;       ///< seal and merge on a thread, else in the add and remove calls
+};
+
+/// An immutable segment. Frozen write segments return positions as
+/// labels, sealed IVF segments return ids.
+struct Segment {
+    uint64_t number = 0; ///< id locations refer to it, kept when it is sealed
+    bool sealed = false;
+    std::shared_ptr<const faiss::Index> index;
+    /// frozen segments only: position -> id and id -> position
+    std::shared_ptr<const std::vector<idx_t>> ids;
+    std::shared_ptr<const IVFIdTable> positions;
+    /// tombstones, keyed by the labels of index
+    std::shared_ptr<const IVFIdTable> deleted;
+};
+
+struct SegmentInfo {
+    uint64_t number;
+    int state; ///< 0 write, 1 frozen, 2 sealed
+    idx_t ntotal;
+    idx_t n_deleted;
+};
+
+struct SegmentedIndex {
+    int d;
+    faiss::MetricType metric_type;
+
+    /// search-time nprobe of the sealed segments and efSearch of HNSW
+    /// write segments, 0 for the values of the templates
+    std::atomic<int> nprobe{0};
+    std::atomic<int> efSearch{0};
+
+    /// write_template: IndexFlat or IndexHNSW, vectors are read back from
+    /// it with reconstruct when it is sealed. segment_template: trained
+    /// IndexIVF on array or block inverted lists, possibly under an
+    /// IndexPreTransform. Both are copied and emptied.
+    SegmentedIndex(
+            const faiss::Index* write_template,
+            const faiss::Index* segment_template,
+            const SegmentedIndexOptions& options = SegmentedIndexOptions());
+
+    ~SegmentedIndex();
+
+    /// ids must be >= 0. An id already in the index is replaced.
+    void add_with_ids(idx_t n, const float* x, const idx_t* xids);
+
+    /// returns the number of ids that were in the index
+    size_t remove(idx_t n, const idx_t* ids);
+
+    /// sel, if any, filters by id
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::IDSelector* sel = nullptr) const;
+
+    /// freeze the write segment and wait until it is sealed and no merge
+    /// is due. Throws the error of a failed background task, if any.
+    void flush();
+
+    /// vectors that are not deleted
+    idx_t ntotal() const {
+        return n_live.load();
+    }
+
+    std::vector<SegmentInfo> segments() const;
+
+    SegmentedIndexOptions options;
+    std::unique_ptr<faiss::Index> write_tmpl;
+    std::unique_ptr<faiss::Index> segment_tmpl;
+
+    /// the mutable segment, guarded by write_segment_mutex
+    struct WriteSegment {
+        uint64_t number = 0;
+        std::shared_ptr<faiss::Index> index;
+        std::shared_ptr<std::vector<idx_t>> ids;
+        std::shared_ptr<IVFIdTable> positions;
+        std::shared_ptr<IVFIdTable> deleted;
+    } write;
+
+    typedef std::vector<std::shared_ptr<const Segment>> SegmentList;
+    std::shared_ptr<const SegmentList> current; ///< atomic access only
+
+    /// serializes adds, removes and the publication of background results
+    std::mutex write_mutex;
+    /// shared by searches, exclusive while the write segment changes
+    mutable std::shared_mutex write_segment_mutex;
+
+    /// id -> segment number, -1 once deleted. IVFIdTable cannot erase,
+    /// the deleted ids are dropped by purge_locations.
+    IVFIdTable locations;
+    /// numbers of merged segments -> the segment they were merged into
+    std::unordered_map<uint64_t, uint64_t> merged_into;
+    uint64_t next_number = 0;
+    std::atomic<idx_t> n_live{0};
+
+    std::thread worker;
+    std::mutex task_mutex;
+    std::condition_variable task_cv;
+    std::condition_variable idle_cv;
+    std::atomic<bool> stop{false};
+    bool task_pending = false;
+    bool task_running = false;
+    std::string task_error;
+
+    void new_write_segment();
+    void freeze();
+    size_t remove_locked(idx_t n, const idx_t* ids);
+    void publish(std::shared_ptr<const SegmentList> list);
+    uint64_t resolve(uint64_t number) const;
+    void purge_locations();
+
+    /// seal or merge once, false if there is nothing to do
+    bool run_task();
+    void schedule();
+    void run_worker();
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SEGMENTED_INDEX_H */
@@ -0,0 +1,404 @@
+/**
+ * FAISS Go Extensions - IndexShards search with a shared thread budget
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "shards_search.h"
+
+#include <faiss/impl/FaissAssert.h>
+
+#include <omp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace faiss_go_ext {
+
+namespace {
+
+struct ShardSearchState;
+void run_worker(std::shared_ptr<ShardSearchState> st, int n_threads);
+
+/* Deadline searches run on a persistent pool per index, capped at the
+ * largest thread budget requested, so shards that miss their deadline
+ * cannot pile up threads: new calls are refused until they finished. */
+
+struct ShardPool {
+    struct Task {
+        std::shared_ptr<ShardSearchState> st;
+        int n_threads;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;      ///< tasks queued or stop
+    std::condition_variable idle_cv; ///< n_pending or n_late reached 0
+    std::deque<Task> queue;
+    std::vector<std::thread> threads;
+    size_t n_pending = 0; ///< tasks queued or running
+    size_t n_late = 0;    ///< running tasks of calls that already returned
+    bool stop = false;
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [&]() { return stop || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            Task task = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            run_worker(std::move(task.st), task.n_threads);
+            lock.lock();
+            n_pending--;
+            idle_cv.notify_all();
+        }
+    }
+
+    /// queue the workers of one call, growing the pool to n_workers threads
+    void submit(const std::shared_ptr<ShardSearchState>& st, const std::vector<int>& n_threads) {
+        std::lock_guard<std::mutex> lock(mutex);
+        FAISS_THROW_IF_NOT_MSG(!stop, "the index is being released");
+        FAISS_THROW_IF_NOT_MSG(
+                n_late == 0, "shard searches of an earlier call are still running past its deadline");
+        while (threads.size() < n_threads.size()) {
+            threads.emplace_back([this]() { loop(); });
+        }
+        for (int nt : n_threads) {
+            queue.push_back({st, nt});
+        }
+        n_pending += n_threads.size();
+        cv.notify_all();
+    }
+
+    void check_no_late() {
+        std::lock_guard<std::mutex> lock(mutex);
+        FAISS_THROW_IF_NOT_MSG(
+                n_late == 0, "shard searches of an earlier call are still running past its deadline");
+    }
+
+    void add_late(long delta) {
+        std::lock_guard<std::mutex> lock(mutex);
+        n_late += delta;
+        if (n_late == 0) {
+            idle_cv.notify_all();
+        }
+    }
+
+    /// wait for every queued task, then stop and join the threads
+    void shutdown() {
+        std::unique_lock<std::mutex> lock(mutex);
+        idle_cv.wait(lock, [&]() { return n_pending == 0; });
+        stop = true;
+        cv.notify_all();
+        lock.unlock();
+        for (auto& t : threads) {
+            t.join();
+        }
+    }
+};
+
+std::mutex pools_mutex;
+std::unordered_map<const faiss::Index*, std::shared_ptr<ShardPool>> pools;
+
+/// the pool of index, created if create is set (else nullptr if none)
+std::shared_ptr<ShardPool> get_pool(const faiss::Index* index, bool create) {
+    std::lock_guard<std::mutex> lock(pools_mutex);
+    auto it = pools.find(index);
+    if (it != pools.end()) {
+        return it->second;
+    }
+    if (!create) {
+        return nullptr;
+    }
+    auto pool = std::make_shared<ShardPool>();
+    pools[index] = pool;
+    return pool;
+}
+
+/// shared between the caller and the workers, which may outlive the call
+struct ShardSearchState {
+    const faiss::IndexShards& index;
+    size_t nshard;
+    idx_t n, k;
+    const float* x;
+    std::vector<float> x_copy; ///< queries, kept alive for late workers
+    std::vector<idx_t> translations;
+
+    std::vector<float> distances; ///< nshard x n x k
+    std::vector<idx_t> labels;
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> cancelled{false};
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<char> done; ///< per shard, under mutex
+    size_t n_done = 0;      ///< shards finished or failed
+    int n_workers_left = 0;
+    std::exception_ptr error;
+    std::shared_ptr<ShardPool> pool; ///< set for deadline searches
+    bool late = false;               ///< the caller returned, under mutex
+
+    ShardSearchState(const faiss::IndexShards& index, idx_t n, const float* x, idx_t k)
+            : index(index), nshard(index.count()), n(n), k(k), x(x) {}
+};
+
+void run_worker(std::shared_ptr<ShardSearchState> st, int n_threads) {
+    omp_set_num_threads(n_threads);
+    for (;;) {
+        size_t s = st->next++;
+        if (s >= st->nshard || st->cancelled) {
+            break;
+        }
+        float* D = st->distances.data() + s * st->n * st->k;
+        idx_t* I = st->labels.data() + s * st->n * st->k;
+        std::exception_ptr error;
+        try {
+            const faiss::Index* shard = st->index.at(s);
+            if (shard->ntotal == 0) {
+                // FAISS leaves the outputs of an empty flat index untouched
+                // and IndexIDMap would then translate garbage labels
+                const bool ip = st->index.metric_type == faiss::METRIC_INNER_PRODUCT;
+                std::fill(D, D + st->n * st->k,
+                          ip ? -std::numeric_limits<float>::max() : std::numeric_limits<float>::max());
+                std::fill(I, I + st->n * st->k, idx_t(-1));
+            } else {
+                shard->search(st->n, st->x, st->k, D, I);
+            }
+            idx_t shift = st->translations[s];
+            if (shift != 0) {
+                for (idx_t j = 0; j < st->n * st->k; j++) {
+                    if (I[j] >= 0) {
+                        I[j] += shift;
+                    }
+                }
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(st->mutex);
+        if (error) {
+            if (!st->error) {
+                st->error = error;
+            }
+        } else {
+            st->done[s] = 1;
+        }
+        st->n_done++;
+        st->cv.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(st->mutex);
+    st->n_workers_left--;
+    if (st->late) {
+        st->pool->add_late(-1);
+    }
+    st->cv.notify_all();
+}
+
+/// merge two sorted lists of k results, invalid labels (-1) sort last and
+/// ties keep the entry of the first list
+template <bool IP>
+void merge2(
+        const float* da,
+        const idx_t* la,
+        const float* db,
+        const idx_t* lb,
+        size_t k,
+        float* dout,
+        idx_t* lout) {
+    size_t ia = 0, ib = 0;
+    for (size_t j = 0; j < k; j++) {
+        // ia + ib == j < k, so both reads are in range
+        float a = da[ia], b = db[ib];
+        bool a_ok = la[ia] >= 0, b_ok = lb[ib] >= 0;
+        bool take_a = a_ok & (!b_ok | (IP ? a >= b : a <= b));
+        dout[j] = take_a ? a : b;
+        lout[j] = take_a ? la[ia] : lb[ib];
+        ia += take_a;
+        ib += !take_a;
+    }
+}
+
+/// merge the sorted lists of the given shards for every query
+template <bool IP>
+void merge_shards(
+        const ShardSearchState& st,
+        const std::vector<size_t>& shards,
+        float* distances,
+        idx_t* labels) {
+    const size_t n = st.n, k = st.k, m = shards.size();
+    const float neutral = IP ? -std::numeric_limits<float>::max()
+                             : std::numeric_limits<float>::max();
+
+#pragma omp parallel if (n > 1)
+    {
+        // lists of the current round of the merge tree, two buffers
+        std::vector<float> dbuf(2 * m * k);
+        std::vector<idx_t> lbuf(2 * m * k);
+        std::vector<const float*> dl(m);
+        std::vector<const idx_t*> ll(m);
+
+#pragma omp for
+        for (int64_t i = 0; i < (int64_t)n; i++) {
+            float* D = distances + i * k;
+            idx_t* I = labels + i * k;
+            if (m == 0) {
+                std::fill(D, D + k, neutral);
+                std::fill(I, I + k, idx_t(-1));
+                continue;
+            }
+            for (size_t s = 0; s < m; s++) {
+                dl[s] = st.distances.data() + (shards[s] * n + i) * k;
+                ll[s] = st.labels.data() + (shards[s] * n + i) * k;
+            }
+            size_t nl = m;
+            int round = 0;
+            while (nl > 1) {
+                float* dout = dbuf.data() + (round & 1) * m * k;
+                idx_t* lout = lbuf.data() + (round & 1) * m * k;
+                size_t half = nl / 2;
+                for (size_t p = 0; p < half; p++) {
+                    merge2<IP>(dl[2 * p], ll[2 * p], dl[2 * p + 1], ll[2 * p + 1], k,
+                               dout + p * k, lout + p * k);
+                }
+                for (size_t p = 0; p < half; p++) {
+                    dl[p] = dout + p * k;
+                    ll[p] = lout + p * k;
+                }
+                if (nl & 1) {
+                    dl[half] = dl[nl - 1];
+                    ll[half] = ll[nl - 1];
+                }
+                nl = half + (nl & 1);
+                round++;
+            }
+            std::copy(dl[0], dl[0] + k, D);
+            std::copy(ll[0], ll[0] + k, I);
+        }
+    }
+}
+
+} // namespace
+
+void search_shards(
+        const faiss::IndexShards& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const ShardSearchOptions& options,
+        float* distances,
+        idx_t* labels,
+        ShardSearchStatus* status) {
+    FAISS_THROW_IF_NOT(k > 0);
+    FAISS_THROW_IF_NOT(options.n_threads >= 0 && options.deadline_ms >= 0);
+
+    auto st = std::make_shared<ShardSearchState>(index, n, x, k);
+    const size_t nshard = st->nshard;
+    const bool has_deadline = options.deadline_ms > 0;
+    if (has_deadline) {
+        st->x_copy.assign(x, x + n * index.d);
+        st->x = st->x_copy.data();
+    }
+    st->translations.assign(nshard, 0);
+    if (index.successive_ids) {
+        for (size_t s = 0; s + 1 < nshard; s++) {
+            st->translations[s + 1] = st->translations[s] + index.at(s)->ntotal;
+        }
+    }
+    st->distances.resize(nshard * n * k);
+    st->labels.resize(nshard * n * k);
+    st->done.assign(nshard, 0);
+
+    // split the thread budget over at most one worker per thread
+    const int budget = options.n_threads > 0 ? options.n_threads : omp_get_max_threads();
+    const int n_workers = (int)std::min<size_t>(nshard, budget);
+    st->n_workers_left = n_workers;
+
+    auto t_deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double, std::milli>(options.deadline_ms));
+    std::vector<int> worker_threads;
+    for (int w = 0; w < n_workers; w++) {
+        worker_threads.push_back(budget / n_workers + (w < budget % n_workers ? 1 : 0));
+    }
+    std::vector<std::thread> workers;
+    if (has_deadline) {
+        st->pool = get_pool(&index, true);
+        st->pool->submit(st, worker_threads);
+    } else {
+        if (auto pool = get_pool(&index, false)) {
+            pool->check_no_late();
+        }
+        for (int nt : worker_threads) {
+            workers.emplace_back(run_worker, st, nt);
+        }
+    }
+
+    std::vector<size_t> completed;
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(st->mutex);
+        auto all_done = [&]() { return st->n_done == nshard || st->n_workers_left == 0; };
+        if (has_deadline) {
+            if (!st->cv.wait_until(lock, t_deadline, all_done)) {
+                // the workers still running now count against new calls
+                st->cancelled = true;
+                st->late = true;
+                st->pool->add_late(st->n_workers_left);
+            }
+        } else {
+            st->cv.wait(lock, all_done);
+        }
+        error = st->error;
+        for (size_t s = 0; s < nshard; s++) {
+            if (st->done[s]) {
+                completed.push_back(s);
+            }
+        }
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (index.metric_type == faiss::METRIC_INNER_PRODUCT) {
+        merge_shards<true>(*st, completed, distances, labels);
+    } else {
+        merge_shards<false>(*st, completed, distances, labels);
+    }
+    if (status) {
+        status->n_completed = completed.size();
+        status->partial = completed.size() < nshard;
+    }
+}
+
+void wait_shards_idle(const faiss::Index* index) {
+    std::shared_ptr<ShardPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(pools_mutex);
+        auto it = pools.find(index);
+        if (it == pools.end()) {
+            return;
+        }
+        pool = it->second;
+        pools.erase(it);
+    }
+    pool->shutdown();
+}
+
+} // namespace faiss_go_ext
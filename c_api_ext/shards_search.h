@@ -0,0 +1,58 @@
+/**
+ * FAISS Go Extensions - IndexShards search with a shared thread budget
+ *
+ * IndexShards::search runs every shard on its own thread, each with a full
+ * OpenMP team, waits for all of them and merges the n x k results of every
+ * shard through a heap. With many shards the teams oversubscribe the cores.
+ * Here a bounded set of workers searches the shards, each with its share of
+ * the thread budget. The already sorted per-shard lists are combined with
+ * branchless pairwise merges. An optional deadline returns whatever the
+ * completed shards found, flagged as partial; late shards run on a
+ * persistent per-index pool and block new searches until they finish.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SHARDS_SEARCH_H
+#define FAISS_GO_EXT_SHARDS_SEARCH_H
+
+#include <faiss/IndexShards.h>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct ShardSearchOptions {
+    int n_threads = 0;      ///< total thread budget, 0 = omp_get_max_threads()
+    double deadline_ms = 0; ///< return after this long, 0 = wait for all shards
+};
+
+struct ShardSearchStatus {
+    int n_completed = 0;  ///< shards merged into the result
+    bool partial = false; ///< some shards missed the deadline
+};
+
+/// k-NN search over the shards of an IndexShards. Searches with a deadline
+/// run on a persistent pool of the index, capped at the largest thread
+/// budget requested. Shards that miss the deadline keep running there on a
+/// copy of the queries and their results are dropped; until they are done
+/// new searches of the index throw. wait_shards_idle() waits for them and
+/// releases the pool, and must be called before the index is destroyed.
+void search_shards(
+        const faiss::IndexShards& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        const ShardSearchOptions& options,
+        float* distances,
+        idx_t* labels,
+        ShardSearchStatus* status);
+
+/// Wait until no shard search of this index runs in the background and
+/// stop its worker pool (recreated by the next search with a deadline).
+void wait_shards_idle(const faiss::Index* index);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SHARDS_SEARCH_H */
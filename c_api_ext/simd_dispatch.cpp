@@ -0,0 +1,170 @@
+/**
+ * FAISS Go Extensions - runtime SIMD dispatch
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_dispatch.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace faiss_go_ext {
+
+namespace {
+
+SIMDLevel detect_simd_level() {
+#if defined(__x86_64__) || defined(_M_X64)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd") &&
+        __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq") &&
+        __builtin_cpu_supports("avx512bw")) {
+        return SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+        __builtin_cpu_supports("f16c") && __builtin_cpu_supports("popcnt")) {
+        return SIMD_AVX2;
+    }
+    return SIMD_GENERIC;
+#elif defined(__aarch64__)
+    // NEON is part of the aarch64 baseline, the generic build uses it
+    return SIMD_NEON;
+#else
+    return SIMD_GENERIC;
+#endif
+}
+
+/// level requested through FAISS_OPT_LEVEL, same spelling as the FAISS
+/// cmake option ("generic", "avx2", "avx512"); -1 if unset or unknown
+int env_simd_level() {
+    const char* env = getenv("FAISS_OPT_LEVEL");
+    if (!env) {
+        return -1;
+    }
+    for (int level = SIMD_GENERIC; level <= SIMD_NEON; level++) {
+        if (strcmp(env, simd_level_name((SIMDLevel)level)) == 0) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+#define FAISS_GO_EXT_FILL_TABLES(ns, t)           \
+    do {                                          \
+        ns::get_sq_kernels(&(t).sq);              \
+        ns::get_distance_kernels(&(t).distances); \
+        ns::get_hamming_kernels(&(t).hamming);    \
+        ns::get_pq_kernels(&(t).pq);              \
+        ns::get_topk_kernels(&(t).topk);          \
+    } while (0)
+
+/// Tables for every level are built once; switching levels only swaps the
+/// current pointer, so kernels fetched by running searches stay valid.
+struct Dispatch {
+    SIMDLevel max_level;
+    KernelTables generic;
+#if defined(__x86_64__) || defined(_M_X64)
+    KernelTables avx2;
+    KernelTables avx512;
+#endif
+    std::atomic<const KernelTables*> current;
+
+    Dispatch() : max_level(detect_simd_level()) {
+        generic.level = max_level == SIMD_NEON ? SIMD_NEON : SIMD_GENERIC;
+        FAISS_GO_EXT_FILL_TABLES(simd_generic, generic);
+#if defined(__x86_64__) || defined(_M_X64)
+        avx2.level = SIMD_AVX2;
+        FAISS_GO_EXT_FILL_TABLES(simd_avx2, avx2);
+        avx512.level = SIMD_AVX512;
+        FAISS_GO_EXT_FILL_TABLES(simd_avx512, avx512);
+#endif
+        current = tables(max_level);
+        int forced = env_simd_level();
+        if (forced >= 0 && supported((SIMDLevel)forced)) {
+            current = tables((SIMDLevel)forced);
+        }
+    }
+
+    bool supported(SIMDLevel level) const {
+        switch (level) {
+            case SIMD_GENERIC:
+                return true;
+            case SIMD_AVX2:
+                return max_level == SIMD_AVX2 || max_level == SIMD_AVX512;
+            case SIMD_AVX512:
+                return max_level == SIMD_AVX512;
+            case SIMD_NEON:
+                return max_level == SIMD_NEON;
+        }
+        return false;
+    }
+
+    const KernelTables* tables(SIMDLevel level) const {
+        switch (level) {
+#if defined(__x86_64__) || defined(_M_X64)
+            case SIMD_AVX512:
+                return &avx512;
+            case SIMD_AVX2:
+                return &avx2;
+#endif
+            default:
+                return &generic;
+        }
+    }
+};
+
+#undef FAISS_GO_EXT_FILL_TABLES
+
+Dispatch& dispatch() {
+    static Dispatch instance;
+    return instance;
+}
+
+} // namespace
+
+SIMDLevel simd_level() {
+    return kernels().level;
+}
+
+SIMDLevel simd_max_level() {
+    return dispatch().max_level;
+}
+
+bool simd_level_supported(SIMDLevel level) {
+    return dispatch().supported(level);
+}
+
+bool set_simd_level(SIMDLevel level) {
+    Dispatch& d = dispatch();
+    if (!d.supported(level)) {
+        return false;
+    }
+    d.current.store(d.tables(level), std::memory_order_release);
+    return true;
+}
+
+const char* simd_level_name(SIMDLevel level) {
+    switch (level) {
+        case SIMD_GENERIC:
+            return "generic";
+        case SIMD_AVX2:
+            return "avx2";
+        case SIMD_AVX512:
+            return "avx512";
+        case SIMD_NEON:
+            return "neon";
+    }
+    return "unknown";
+}
+
+const KernelTables& kernels() {
+    return *dispatch().current.load(std::memory_order_acquire);
+}
+
+const SQKernels& sq_kernels() {
+    return kernels().sq;
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,245 @@
+/**
+ * FAISS Go Extensions - runtime SIMD dispatch
+ *
+ * The kernel translation units (*_kernels.cpp) are compiled once per
+ * instruction set level, each time into a different namespace
+ * (simd_generic, simd_avx2, simd_avx512). At startup the dispatcher
+ * checks the host CPU and selects one set of kernel tables, so a single
+ * static archive runs at the best level the machine supports. The
+ * FAISS_OPT_LEVEL environment variable or set_simd_level() can force a
+ * lower level.
+ *
+ * This header is included by the kernel translation units, so it must only
+ * contain plain declarations: no STL, no FAISS headers and no inline code
+ * that could be instantiated with wider instructions than the caller.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SIMD_DISPATCH_H
+#define FAISS_GO_EXT_SIMD_DISPATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace faiss_go_ext {
+
+/// Instruction set levels the kernels are compiled for. The values are
+/// part of the C API (see FaissSIMDLevel in faiss_go_ext.h).
+enum SIMDLevel {
+    SIMD_GENERIC = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2,
+    SIMD_NEON = 3,
+};
+
+/* ============================================================
+ * Scalar quantizer kernels
+ * ============================================================ */
+
+/// Code layouts handled by the SQ kernels. The uniform quantizer types use
+/// the codec of their non-uniform counterpart, with the trained range
+/// expanded to one (vmin, vdiff) pair per dimension.
+enum SQCodec {
+    SQ_CODEC_8BIT = 0,
+    SQ_CODEC_4BIT,
+    SQ_CODEC_6BIT,
+    SQ_CODEC_FP16,
+    SQ_CODEC_BF16,
+    SQ_CODEC_8BIT_DIRECT,
+    SQ_CODEC_8BIT_DIRECT_SIGNED,
+    SQ_CODEC_COUNT
+};
+
+/// Query-side state shared by all codes scanned for one query.
+struct SQKernelArgs {
+    const float* query; ///< query vector (or residual), size d
+    size_t d;           ///< vector dimension
+    size_t code_size;   ///< bytes per code
+    const float* vmin;  ///< per-dimension range start (scaled codecs only)
+    const float* vdiff; ///< per-dimension range width (scaled codecs only)
+};
+
+/// Compute the distances between the query and n consecutive codes.
+typedef void (*sq_distances_fn)(
+        const SQKernelArgs* args,
+        const uint8_t* codes,
+        size_t n,
+        float* distances);
+
+struct SQKernels {
+    sq_distances_fn l2[SQ_CODEC_COUNT]; ///< squared L2 distances
+    sq_distances_fn ip[SQ_CODEC_COUNT]; ///< inner products
+};
+
+/* ============================================================
+ * Float vector distance kernels
+ * ============================================================ */
+
+/// One tile of the fused dot product + top-k search: the nx x ny inner
+/// products are accumulated in registers and merged straight into the
+/// per-query heaps (faiss/utils/Heap.h layout), without a distance matrix.
+struct KnnTileArgs {
+    const float* x;       ///< nx queries
+    const float* y;       ///< ny database vectors
+    const float* y_norms; ///< squared norms of y (L2 only)
+    size_t d;
+    size_t nx;
+    size_t ny;
+    int64_t y0;        ///< label of y[0]
+    size_t k;          ///< heap size
+    float* heap_dis;   ///< nx heaps of k distances
+    int64_t* heap_ids; ///< nx heaps of k labels
+};
+
+struct DistanceKernels {
+    float (*L2sqr)(const float* x, const float* y, size_t d);
+    float (*inner_product)(const float* x, const float* y, size_t d);
+
+    /// distances between x and ny consecutive vectors of y
+    void (*L2sqr_ny)(float* dis, const float* x, const float* y, size_t d, size_t ny);
+    void (*inner_products_ny)(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+    /// nearest neighbor in y of each of the nx vectors of x, given the
+    /// squared norms of y (fused search without a distance matrix)
+    void (*L2sqr_nn)(
+            const float* x,
+            const float* y,
+            const float* y_norms,
+            size_t d,
+            size_t nx,
+            size_t ny,
+            float* distances,
+            int64_t* labels);
+
+    /// fused top-k over one tile. L2 keeps the k smallest ||y||^2 - 2 <x, y>
+    /// in max-heaps (the caller adds ||x||^2), IP the k largest <x, y> in
+    /// min-heaps.
+    void (*knn_tile_L2)(const KnnTileArgs* args);
+    void (*knn_tile_IP)(const KnnTileArgs* args);
+};
+
+/* ============================================================
+ * Binary code kernels
+ * ============================================================ */
+
+struct HammingKernels {
+    /// Hamming distances between code a and nb consecutive codes of b
+    void (*hamming_ny)(
+            int32_t* distances,
+            const uint8_t* a,
+            const uint8_t* b,
+            size_t code_size,
+            size_t nb);
+};
+
+/* ============================================================
+ * Product quantizer kernels
+ * ============================================================ */
+
+/// Sum the look-up table entries selected by n consecutive codes of M
+/// sub-quantizers each.
+typedef void (*pq_distances_fn)(
+        const float* lut,
+        const uint8_t* codes,
+        size_t M,
+        size_t n,
+        float* distances);
+
+struct PQKernels {
+    pq_distances_fn pq8; ///< 8-bit codes, lut is M x 256
+    pq_distances_fn pq4; ///< 4-bit packed codes, lut is M x 16
+};
+
+/* ============================================================
+ * Approximate top-k kernels
+ * ============================================================ */
+
+/// Number of ApproxTopK_mode_t values (faiss/utils/approx_topk/mode.h),
+/// EXACT_TOPK included.
+#define FAISS_GO_EXT_APPROX_TOPK_MODES 5
+
+/// Bucket pass of faiss/utils/approx_topk: value j of dis goes to bucket
+/// j % nbuckets, each bucket keeps its depth best values. The bucket state
+/// is bucket_dis / bucket_pos, depth rows of nbuckets entries, best row
+/// first, and is updated in place, so consecutive calls continue the same
+/// pass; value j is recorded with position pos0 + j.
+typedef void (*bucket_topk_fn)(
+        const float* dis,
+        size_t n,
+        int32_t pos0,
+        float* bucket_dis,
+        int32_t* bucket_pos);
+
+struct TopKKernels {
+    /// indexed by ApproxTopK_mode_t, NULL for EXACT_TOPK
+    bucket_topk_fn min[FAISS_GO_EXT_APPROX_TOPK_MODES]; ///< smallest values
+    bucket_topk_fn max[FAISS_GO_EXT_APPROX_TOPK_MODES]; ///< largest values
+};
+
+/* ============================================================
+ * Dispatch
+ * ============================================================ */
+
+/// All kernel tables for one level.
+struct KernelTables {
+    SIMDLevel level;
+    SQKernels sq;
+    DistanceKernels distances;
+    HammingKernels hamming;
+    PQKernels pq;
+    TopKKernels topk;
+};
+
+/// Level currently in use (detected on first use).
+SIMDLevel simd_level();
+
+/// Highest level supported by the host CPU.
+SIMDLevel simd_max_level();
+
+/// True if kernels for this level are built in and the CPU can run them.
+bool simd_level_supported(SIMDLevel level);
+
+/// Switch all subsequent kernel lookups to another level. Searches that
+/// already fetched their tables finish with the previous level.
+/// @return false if the level is not supported
+bool set_simd_level(SIMDLevel level);
+
+/// Human readable name of a level ("generic", "avx2", "avx512", "neon").
+const char* simd_level_name(SIMDLevel level);
+
+/// Kernel tables for the current level.
+const KernelTables& kernels();
+
+/// SQ kernel table for the current level.
+const SQKernels& sq_kernels();
+
+/* Per-level kernel table getters, defined in the kernel translation units */
+
+#define FAISS_GO_EXT_DECLARE_KERNEL_GETTERS              \
+    void get_sq_kernels(SQKernels* kernels);             \
+    void get_distance_kernels(DistanceKernels* kernels); \
+    void get_hamming_kernels(HammingKernels* kernels);   \
+    void get_pq_kernels(PQKernels* kernels);             \
+    void get_topk_kernels(TopKKernels* kernels);
+
+namespace simd_generic {
+FAISS_GO_EXT_DECLARE_KERNEL_GETTERS
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+namespace simd_avx2 {
+FAISS_GO_EXT_DECLARE_KERNEL_GETTERS
+}
+
+namespace simd_avx512 {
+FAISS_GO_EXT_DECLARE_KERNEL_GETTERS
+}
+#endif
+
+#undef FAISS_GO_EXT_DECLARE_KERNEL_GETTERS
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SIMD_DISPATCH_H */
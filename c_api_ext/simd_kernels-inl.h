@@ -0,0 +1,138 @@
+/**
+ * FAISS Go Extensions - SIMD register abstraction for the kernel files
+ *
+ * Only included by the *_kernels.cpp translation units, after
+ * FAISS_GO_EXT_SIMD_NS is set. Everything here lives in an anonymous
+ * namespace so each ISA build keeps its own internal copy.
+ *
+ * SIMD_W is the number of floats per register: 16 (AVX-512), 8 (AVX2,
+ * NEON as a pair of q registers) or 1 (generic scalar code).
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SIMD_KERNELS_INL_H
+#define FAISS_GO_EXT_SIMD_KERNELS_INL_H
+
+#include "simd_dispatch.h"
+
+#include <string.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#ifndef FAISS_GO_EXT_SIMD_NS
+#define FAISS_GO_EXT_SIMD_NS simd_generic
+#endif
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+namespace {
+
+#if defined(__AVX512F__)
+
+#define SIMD_W 16
+typedef __m512 simd_t;
+
+inline simd_t vzero() {
+    return _mm512_setzero_ps();
+}
+inline simd_t vset1(float x) {
+    return _mm512_set1_ps(x);
+}
+inline simd_t vload(const float* p) {
+    return _mm512_loadu_ps(p);
+}
+inline simd_t vadd(simd_t a, simd_t b) {
+    return _mm512_add_ps(a, b);
+}
+inline simd_t vsub(simd_t a, simd_t b) {
+    return _mm512_sub_ps(a, b);
+}
+inline simd_t vfmadd(simd_t a, simd_t b, simd_t c) {
+    return _mm512_fmadd_ps(a, b, c);
+}
+inline float vreduce(simd_t v) {
+    return _mm512_reduce_add_ps(v);
+}
+
+#elif defined(__AVX2__)
+
+#define SIMD_W 8
+typedef __m256 simd_t;
+
+inline simd_t vzero() {
+    return _mm256_setzero_ps();
+}
+inline simd_t vset1(float x) {
+    return _mm256_set1_ps(x);
+}
+inline simd_t vload(const float* p) {
+    return _mm256_loadu_ps(p);
+}
+inline simd_t vadd(simd_t a, simd_t b) {
+    return _mm256_add_ps(a, b);
+}
+inline simd_t vsub(simd_t a, simd_t b) {
+    return _mm256_sub_ps(a, b);
+}
+inline simd_t vfmadd(simd_t a, simd_t b, simd_t c) {
+    return _mm256_fmadd_ps(a, b, c);
+}
+inline float vreduce(simd_t v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_hadd_ps(s, s);
+    s = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+#elif defined(__aarch64__)
+
+#define SIMD_W 8
+struct simd_t {
+    float32x4_t lo, hi;
+};
+
+inline simd_t vzero() {
+    return {vdupq_n_f32(0), vdupq_n_f32(0)};
+}
+inline simd_t vset1(float x) {
+    return {vdupq_n_f32(x), vdupq_n_f32(x)};
+}
+inline simd_t vload(const float* p) {
+    return {vld1q_f32(p), vld1q_f32(p + 4)};
+}
+inline simd_t vadd(simd_t a, simd_t b) {
+    return {vaddq_f32(a.lo, b.lo), vaddq_f32(a.hi, b.hi)};
+}
+inline simd_t vsub(simd_t a, simd_t b) {
+    return {vsubq_f32(a.lo, b.lo), vsubq_f32(a.hi, b.hi)};
+}
+inline simd_t vfmadd(simd_t a, simd_t b, simd_t c) {
+    return {vfmaq_f32(c.lo, a.lo, b.lo), vfmaq_f32(c.hi, a.hi, b.hi)};
+}
+inline float vreduce(simd_t v) {
+    return vaddvq_f32(vaddq_f32(v.lo, v.hi));
+}
+
+#else
+
+#define SIMD_W 1
+
+#endif
+
+inline float bits_to_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+} // namespace
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SIMD_KERNELS_INL_H */
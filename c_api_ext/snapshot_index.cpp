@@ -0,0 +1,315 @@
+/**
+ * FAISS Go Extensions - copy-on-write snapshots for concurrent add and search
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "snapshot_index.h"
+#include "idmap_sorted.h"
+#include "search_params.h"
+
+#include <faiss/IndexFlat.h>
+#include <faiss/IndexFlatCodes.h>
+#include <faiss/IndexIDMap.h>
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexIVFFlat.h>
+#include <faiss/IndexIVFPQ.h>
+#include <faiss/IndexIVFPQR.h>
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/invlists/InvertedLists.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <typeinfo>
+
+namespace faiss_go_ext {
+
+template <typename T>
+void AppendBuffer<T>::append(const T* x, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    size_t capacity = chunk ? chunk->data.size() : 0;
+    if (size + n > capacity) {
+        // the published views keep the old chunk
+        auto bigger = std::make_shared<Chunk>();
+        bigger->data.resize(std::max(std::max(2 * capacity, size + n), (size_t)64));
+        if (size > 0) {
+            memcpy(bigger->data.data(), chunk->data.data(), size * sizeof(T));
+        }
+        chunk = bigger;
+    }
+    memcpy(chunk->data.data() + size, x, n * sizeof(T));
+    size += n;
+}
+
+template <typename T>
+faiss::MaybeOwnedVector<T> AppendBuffer<T>::view() const {
+    if (size == 0) {
+        return faiss::MaybeOwnedVector<T>();
+    }
+    return faiss::MaybeOwnedVector<T>::create_view(chunk->data.data(), size, chunk);
+}
+
+template struct AppendBuffer<uint8_t>;
+template struct AppendBuffer<idx_t>;
+
+namespace {
+
+/// exchanges the storage of two tables (AlignedTable has no move, so
+/// std::swap would copy and reallocate them)
+void swap_tables(faiss::AlignedTable<float>& a, faiss::AlignedTable<float>& b) {
+    std::swap(a.tab.ptr, b.tab.ptr);
+    std::swap(a.tab.numel, b.tab.numel);
+    std::swap(a.numel, b.numel);
+}
+
+/// Copy of an empty IVF template that shares its quantizer and, for
+/// IVFPQ, its precomputed table, which can take more memory than the
+/// lists. Delete it with delete_ivf_copy.
+faiss::IndexIVF* copy_ivf(faiss::IndexIVF* tmpl) {
+    auto* pq = dynamic_cast<faiss::IndexIVFPQ*>(tmpl);
+    faiss::AlignedTable<float> table;
+    if (pq) {
+        swap_tables(table, pq->precomputed_table);
+    }
+    faiss::IndexIVF* res = nullptr;
+    try {
+        ClonerExt cloner;
+        res = cloner.clone_IndexIVF(tmpl);
+    } catch (...) {
+        if (pq) {
+            swap_tables(table, pq->precomputed_table);
+        }
+        throw;
+    }
+    // the copy is shallow: it points to the template lists and quantizer
+    res->invlists = nullptr;
+    res->own_invlists = false;
+    res->own_fields = false;
+    if (pq) {
+        swap_tables(table, pq->precomputed_table);
+        // aliased, released by delete_ivf_copy
+        auto* res_pq = static_cast<faiss::IndexIVFPQ*>(res);
+        res_pq->precomputed_table.tab.ptr = pq->precomputed_table.tab.ptr;
+        res_pq->precomputed_table.tab.numel = pq->precomputed_table.tab.numel;
+        res_pq->precomputed_table.numel = pq->precomputed_table.numel;
+    }
+    return res;
+}
+
+void delete_ivf_copy(const faiss::Index* index) {
+    auto* ivf = const_cast<faiss::IndexIVF*>(static_cast<const faiss::IndexIVF*>(index));
+    if (auto* pq = dynamic_cast<faiss::IndexIVFPQ*>(ivf)) {
+        faiss::AlignedTable<float> none;
+        swap_tables(none, pq->precomputed_table);
+        none.tab.ptr = nullptr;
+    }
+    delete ivf;
+}
+
+void check_supported(const faiss::Index* index) {
+    if (auto* ivf = dynamic_cast<const faiss::IndexIVF*>(index)) {
+        FAISS_THROW_IF_NOT_MSG(
+                ivf->invlists && typeid(*ivf->invlists) == typeid(faiss::ArrayInvertedLists),
+                "snapshots need IVF indexes on ArrayInvertedLists");
+        FAISS_THROW_IF_NOT_MSG(
+                !dynamic_cast<const faiss::IndexIVFPQR*>(ivf) && !dynamic_cast<const faiss::IndexIVFFlatDedup*>(ivf),
+                "IVFPQR and IVFFlatDedup keep data outside the inverted lists");
+        return;
+    }
+    FAISS_THROW_IF_NOT_MSG(
+            dynamic_cast<const faiss::IndexFlatCodes*>(index) && !dynamic_cast<const faiss::IndexFlat1D*>(index) &&
+                    !dynamic_cast<const faiss::IndexFlatPanorama*>(index),
+            "snapshots are supported for IndexFlatCodes, IVF and IDMap indexes");
+}
+
+} // namespace
+
+void IndexSnapshot::search(
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels,
+        const faiss::SearchParameters* params) const {
+    if (!has_ids) {
+        inner->search(n, x, k, distances, labels, params);
+        return;
+    }
+    PositionParams pp(params, ids.data());
+    inner->search(n, x, k, distances, labels, pp.params);
+    for (idx_t i = 0; i < n * k; i++) {
+        labels[i] = labels[i] < 0 ? labels[i] : ids[labels[i]];
+    }
+}
+
+void IndexSnapshot::range_search(
+        idx_t n,
+        const float* x,
+        float radius,
+        faiss::RangeSearchResult* result,
+        const faiss::SearchParameters* params) const {
+    if (!has_ids) {
+        inner->range_search(n, x, radius, result, params);
+        return;
+    }
+    PositionParams pp(params, ids.data());
+    inner->range_search(n, x, radius, result, pp.params);
+    for (size_t i = 0; i < result->lims[result->nq]; i++) {
+        result->labels[i] = result->labels[i] < 0 ? result->labels[i] : ids[result->labels[i]];
+    }
+}
+
+void IndexSnapshot::reconstruct(idx_t key, float* recons) const {
+    FAISS_THROW_IF_NOT_MSG(!has_ids, "snapshots with ids have no reverse map");
+    inner->reconstruct(key, recons);
+}
+
+void IndexSnapshot::add(idx_t, const float*) {
+    FAISS_THROW_MSG("snapshots are read-only, add to the SnapshotIndex");
+}
+
+void IndexSnapshot::reset() {
+    FAISS_THROW_MSG("snapshots are read-only");
+}
+
+SnapshotIndex::SnapshotIndex(const faiss::Index* index) {
+    FAISS_THROW_IF_NOT(index);
+    FAISS_THROW_IF_NOT_MSG(index->is_trained, "the index must be trained");
+    d = index->d;
+    metric_type = index->metric_type;
+
+    const faiss::Index* sub = index;
+    const idx_t* src_ids = nullptr;
+    if (auto* idmap = dynamic_cast<const faiss::IndexIDMap*>(index)) {
+        sub = idmap->index;
+        src_ids = idmap->id_map.data();
+        with_ids = true;
+    } else if (auto* idmap3 = dynamic_cast<const IndexIDMap3*>(index)) {
+        sub = idmap3->index;
+        src_ids = idmap3->id_map.data();
+        with_ids = true;
+    }
+    check_supported(sub);
+
+    tmpl.reset(clone_index_ext(sub));
+    if (auto* ivf = dynamic_cast<const faiss::IndexIVF*>(sub)) {
+        is_ivf = true;
+        list_codes.resize(ivf->nlist);
+        list_ids.resize(ivf->nlist);
+        for (size_t l = 0; l < ivf->nlist; l++) {
+            size_t ls = ivf->invlists->list_size(l);
+            faiss::InvertedLists::ScopedCodes lc(ivf->invlists, l);
+            faiss::InvertedLists::ScopedIds li(ivf->invlists, l);
+            list_codes[l].append(lc.get(), ls * ivf->code_size);
+            list_ids[l].append(li.get(), ls);
+        }
+    } else {
+        auto* flat = dynamic_cast<const faiss::IndexFlatCodes*>(sub);
+        codes.append(flat->codes.data(), flat->ntotal * flat->code_size);
+    }
+    if (with_ids) {
+        ids.append(src_ids, sub->ntotal);
+    }
+    n_added = sub->ntotal;
+    tmpl->reset();
+    if (auto* ivf = dynamic_cast<faiss::IndexIVF*>(tmpl.get())) {
+        // snapshots do not maintain a direct map
+        ivf->set_direct_map_type(faiss::DirectMap::NoMap);
+    }
+    publish();
+}
+
+void SnapshotIndex::add(idx_t n, const float* x) {
+    FAISS_THROW_IF_NOT_MSG(!with_ids, "add_with_ids is required for IDMap indexes");
+    std::lock_guard<std::mutex> lock(write_mutex);
+    append(n, x, nullptr);
+    publish();
+}
+
+void SnapshotIndex::add_with_ids(idx_t n, const float* x, const idx_t* xids) {
+    FAISS_THROW_IF_NOT_MSG(with_ids || is_ivf, "add_with_ids is not supported for flat indexes");
+    FAISS_THROW_IF_NOT(xids || n == 0);
+    std::lock_guard<std::mutex> lock(write_mutex);
+    append(n, x, xids);
+    if (with_ids) {
+        ids.append(xids, n);
+    }
+    publish();
+}
+
+void SnapshotIndex::append(idx_t n, const float* x, const idx_t* xids) {
+    FAISS_THROW_IF_NOT(n >= 0 && (x || n == 0));
+    if (is_ivf) {
+        auto* ivf = static_cast<faiss::IndexIVF*>(tmpl.get());
+        std::vector<idx_t> list_nos(n);
+        ivf->quantizer->assign(n, x, list_nos.data());
+        std::vector<uint8_t> enc(n * ivf->code_size);
+        ivf->encode_vectors(n, x, list_nos.data(), enc.data());
+        for (idx_t i = 0; i < n; i++) {
+            idx_t l = list_nos[i];
+            if (l < 0) {
+                continue;
+            }
+            // IDMap ids stay in ids, the lists hold positions
+            idx_t id = xids && !with_ids ? xids[i] : n_added + i;
+            list_codes[l].append(enc.data() + i * ivf->code_size, ivf->code_size);
+            list_ids[l].append(&id, 1);
+        }
+    } else {
+        auto* flat = static_cast<faiss::IndexFlatCodes*>(tmpl.get());
+        std::vector<uint8_t> enc(n * flat->code_size);
+        flat->sa_encode(n, x, enc.data());
+        codes.append(enc.data(), enc.size());
+    }
+    n_added += n;
+    n_adds++;
+}
+
+void SnapshotIndex::publish() {
+    auto snap = std::make_shared<IndexSnapshot>();
+    snap->d = d;
+    snap->metric_type = metric_type;
+    snap->is_trained = true;
+    snap->ntotal = n_added;
+    snap->version = n_adds;
+    if (is_ivf) {
+        auto* ivf_tmpl = static_cast<faiss::IndexIVF*>(tmpl.get());
+        std::shared_ptr<faiss::IndexIVF> ivf(copy_ivf(ivf_tmpl), delete_ivf_copy);
+        auto* lists = new faiss::ArrayInvertedLists(ivf_tmpl->nlist, ivf_tmpl->code_size);
+        ivf->replace_invlists(lists, true);
+        for (size_t l = 0; l < ivf_tmpl->nlist; l++) {
+            lists->codes[l] = list_codes[l].view();
+            lists->ids[l] = list_ids[l].view();
+        }
+        ivf->ntotal = n_added;
+        snap->shared = tmpl;
+        snap->inner = ivf;
+    } else {
+        std::unique_ptr<faiss::Index> flat(clone_index_ext(tmpl.get()));
+        auto* fc = static_cast<faiss::IndexFlatCodes*>(flat.get());
+        fc->codes = codes.view();
+        fc->ntotal = n_added;
+        snap->inner.reset(flat.release());
+    }
+    if (with_ids) {
+        snap->has_ids = true;
+        snap->ids = ids.view();
+    }
+    std::atomic_store(&current, std::shared_ptr<const IndexSnapshot>(std::move(snap)));
+}
+
+std::shared_ptr<const IndexSnapshot> SnapshotIndex::snapshot() const {
+    return std::atomic_load(&current);
+}
+
+idx_t SnapshotIndex::ntotal() const {
+    return snapshot()->ntotal;
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,138 @@
+/**
+ * FAISS Go Extensions - copy-on-write snapshots for concurrent add and search
+ *
+ * FAISS indexes cannot be searched while vectors are added to them, so a
+ * caller has to put a reader-writer lock around each index and ingestion
+ * stalls searches. A SnapshotIndex keeps the vectors of an index in
+ * append-only segments and publishes immutable IndexSnapshot views of
+ * them:
+ *
+ *  - a segment is a buffer with spare capacity. An add writes past the
+ *    end seen by the published snapshots, then publishes a new snapshot
+ *    whose MaybeOwnedVector views cover the new end. A full segment is
+ *    copied once into one twice as large; older snapshots keep the old
+ *    one alive through the view owner;
+ *  - the current snapshot is a shared_ptr swapped atomically. Readers
+ *    take a reference and search it without any lock held, writers are
+ *    serialized among themselves only. A snapshot and the segments only
+ *    it references are freed when its last reader lets go.
+ *
+ * Supported indexes: IndexFlatCodes (Flat, SQ, PQ, LSH, RaBitQ, ...), IVF
+ * indexes on ArrayInvertedLists (the IVF quantizer is shared by all
+ * snapshots, it is not modified by adds), and IndexIDMap / IndexIDMap2 /
+ * IndexIDMap3 over either one. Snapshots are faiss::Index objects that
+ * search and range_search; they are read-only.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SNAPSHOT_INDEX_H
+#define FAISS_GO_EXT_SNAPSHOT_INDEX_H
+
+#include <faiss/Index.h>
+#include <faiss/impl/maybe_owned_vector.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// Append-only array in chunks of growing capacity. Appends never move
+/// the elements that views already cover.
+template <typename T>
+struct AppendBuffer {
+    struct Chunk : faiss::MaybeOwnedVectorOwner {
+        std::vector<T> data; ///< fixed capacity
+    };
+
+    std::shared_ptr<Chunk> chunk;
+    size_t size = 0;
+
+    void append(const T* x, size_t n);
+
+    /// the first size elements, valid as long as the view lives
+    faiss::MaybeOwnedVector<T> view() const;
+};
+
+/// An immutable view of the contents of a SnapshotIndex.
+struct IndexSnapshot : faiss::Index {
+    /// writer structures used by inner (the IVF quantizer)
+    std::shared_ptr<const faiss::Index> shared;
+    /// flat or IVF index whose storage are views of the segments
+    std::shared_ptr<const faiss::Index> inner;
+    bool has_ids = false;
+    faiss::MaybeOwnedVector<idx_t> ids; ///< position -> id if has_ids
+    uint64_t version = 0;               ///< number of adds before this snapshot
+
+    IndexSnapshot() {}
+
+    void search(
+            idx_t n,
+            const float* x,
+            idx_t k,
+            float* distances,
+            idx_t* labels,
+            const faiss::SearchParameters* params = nullptr) const override;
+
+    void range_search(
+            idx_t n,
+            const float* x,
+            float radius,
+            faiss::RangeSearchResult* result,
+            const faiss::SearchParameters* params = nullptr) const override;
+
+    /// by position, only without ids
+    void reconstruct(idx_t key, float* recons) const override;
+
+    /// snapshots are read-only, these throw
+    void add(idx_t n, const float* x) override;
+    void reset() override;
+};
+
+struct SnapshotIndex {
+    int d;
+    faiss::MetricType metric_type;
+
+    /// Copies index (trained, possibly not empty) into segments, index is
+    /// not modified and not kept.
+    explicit SnapshotIndex(const faiss::Index* index);
+
+    /// encode, append and publish. Serialized with other adds.
+    void add(idx_t n, const float* x);
+
+    /// ids are required for IDMap indexes and IVF indexes, not allowed for
+    /// flat indexes
+    void add_with_ids(idx_t n, const float* x, const idx_t* xids);
+
+    /// the current snapshot, never blocks on adds
+    std::shared_ptr<const IndexSnapshot> snapshot() const;
+
+    idx_t ntotal() const;
+
+    /// trained, empty: encodes added vectors; its quantizer is shared
+    std::shared_ptr<faiss::Index> tmpl;
+    bool with_ids = false; ///< an IndexIDMap* was wrapped
+    bool is_ivf = false;
+
+    AppendBuffer<uint8_t> codes;                  ///< flat
+    std::vector<AppendBuffer<uint8_t>> list_codes; ///< IVF
+    std::vector<AppendBuffer<idx_t>> list_ids;     ///< IVF
+    AppendBuffer<idx_t> ids;                       ///< IDMap
+    idx_t n_added = 0;
+    uint64_t n_adds = 0;
+
+    std::mutex write_mutex;
+    std::shared_ptr<const IndexSnapshot> current; ///< atomic access only
+
+    void append(idx_t n, const float* x, const idx_t* xids);
+    void publish();
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SNAPSHOT_INDEX_H */
@@ -0,0 +1,350 @@
+/**
+ * FAISS Go Extensions - scalar quantizer search with runtime SIMD dispatch
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "sq_dispatch.h"
+
+#include <faiss/impl/AuxIndexStructures.h>
+#include <faiss/impl/FaissAssert.h>
+#include <faiss/impl/IDSelector.h>
+#include <faiss/invlists/InvertedLists.h>
+#include <faiss/utils/Heap.h>
+#include <faiss/utils/distances.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace faiss_go_ext {
+
+namespace {
+
+typedef faiss::ScalarQuantizer ScalarQuantizer;
+
+/// codes are scored in blocks of this size before touching the heap
+constexpr size_t kScanBlock = 256;
+
+bool sq_codec(const ScalarQuantizer& sq, SQCodec* codec, bool* uniform) {
+    *uniform = false;
+    switch (sq.qtype) {
+        case ScalarQuantizer::QT_8bit:
+            *codec = SQ_CODEC_8BIT;
+            return true;
+        case ScalarQuantizer::QT_8bit_uniform:
+            *codec = SQ_CODEC_8BIT;
+            *uniform = true;
+            return true;
+        case ScalarQuantizer::QT_4bit:
+            *codec = SQ_CODEC_4BIT;
+            return true;
+        case ScalarQuantizer::QT_4bit_uniform:
+            *codec = SQ_CODEC_4BIT;
+            *uniform = true;
+            return true;
+        case ScalarQuantizer::QT_6bit:
+            *codec = SQ_CODEC_6BIT;
+            return true;
+        case ScalarQuantizer::QT_fp16:
+            *codec = SQ_CODEC_FP16;
+            return true;
+        case ScalarQuantizer::QT_bf16:
+            *codec = SQ_CODEC_BF16;
+            return true;
+        case ScalarQuantizer::QT_8bit_direct:
+            *codec = SQ_CODEC_8BIT_DIRECT;
+            return true;
+        case ScalarQuantizer::QT_8bit_direct_signed:
+            *codec = SQ_CODEC_8BIT_DIRECT_SIGNED;
+            return true;
+    }
+    return false;
+}
+
+/// heap scan of one block of precomputed distances
+template <class C>
+size_t update_heap(
+        const float* dis,
+        size_t n,
+        size_t j0,
+        const idx_t* ids,
+        idx_t list_no,
+        bool store_pairs,
+        const faiss::IDSelector* sel,
+        float* heap_dis,
+        idx_t* heap_ids,
+        size_t k) {
+    size_t nup = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (C::cmp(heap_dis[0], dis[j])) {
+            size_t jj = j0 + j;
+            if (sel && !sel->is_member(ids ? ids[jj] : (idx_t)jj)) {
+                continue;
+            }
+            idx_t id = store_pairs ? (list_no << 32 | (idx_t)jj) : (ids ? ids[jj] : (idx_t)jj);
+            faiss::heap_replace_top<C>(k, heap_dis, heap_ids, dis[j], id);
+            nup++;
+        }
+    }
+    return nup;
+}
+
+template <class C>
+void search_sq_flat_impl(
+        const faiss::IndexScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    const uint8_t* codes = index.codes.data();
+    const size_t code_size = index.code_size;
+    const size_t ntotal = index.ntotal;
+
+#pragma omp parallel if (n > 1)
+    {
+        DispatchSQDistanceComputer dc(index.sq, index.metric_type);
+        float dis[kScanBlock];
+
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            float* heap_dis = distances + i * k;
+            idx_t* heap_ids = labels + i * k;
+            faiss::heap_heapify<C>(k, heap_dis, heap_ids);
+            dc.set_query(x + i * index.d);
+
+            for (size_t j0 = 0; j0 < ntotal; j0 += kScanBlock) {
+                size_t nb = std::min(kScanBlock, ntotal - j0);
+                dc.distances_to_codes(codes + j0 * code_size, nb, dis);
+                update_heap<C>(dis, nb, j0, nullptr, 0, false, nullptr, heap_dis, heap_ids, k);
+            }
+            faiss::heap_reorder<C>(k, heap_dis, heap_ids);
+        }
+    }
+}
+
+} // namespace
+
+/* ============================================================
+ * DispatchSQDistanceComputer
+ * ============================================================ */
+
+DispatchSQDistanceComputer::DispatchSQDistanceComputer(
+        const faiss::ScalarQuantizer& sq,
+        faiss::MetricType metric)
+        : sq(sq), metric(metric) {
+    SQCodec codec = SQ_CODEC_8BIT;
+    bool uniform = false;
+    FAISS_THROW_IF_NOT_MSG(sq_dispatch_supported(sq, metric), "unsupported quantizer or metric");
+    sq_codec(sq, &codec, &uniform);
+
+    const SQKernels& kernels = sq_kernels();
+    fn = metric == faiss::METRIC_L2 ? kernels.l2[codec] : kernels.ip[codec];
+
+    if (codec == SQ_CODEC_8BIT || codec == SQ_CODEC_4BIT || codec == SQ_CODEC_6BIT) {
+        if (uniform) {
+            vmin.assign(sq.d, sq.trained[0]);
+            vdiff.assign(sq.d, sq.trained[1]);
+        } else {
+            vmin.assign(sq.trained.begin(), sq.trained.begin() + sq.d);
+            vdiff.assign(sq.trained.begin() + sq.d, sq.trained.begin() + 2 * sq.d);
+        }
+    }
+
+    code_size = sq.code_size;
+    args.query = nullptr;
+    args.d = sq.d;
+    args.code_size = sq.code_size;
+    args.vmin = vmin.data();
+    args.vdiff = vdiff.data();
+}
+
+void DispatchSQDistanceComputer::set_query(const float* x) {
+    q = x;
+    args.query = x;
+}
+
+float DispatchSQDistanceComputer::query_to_code(const uint8_t* code) const {
+    float dis;
+    fn(&args, code, 1, &dis);
+    return dis;
+}
+
+float DispatchSQDistanceComputer::symmetric_dis(idx_t i, idx_t j) {
+    std::vector<float> xi(sq.d), xj(sq.d);
+    sq.decode(codes + i * code_size, xi.data(), 1);
+    sq.decode(codes + j * code_size, xj.data(), 1);
+    if (metric == faiss::METRIC_L2) {
+        return faiss::fvec_L2sqr(xi.data(), xj.data(), sq.d);
+    }
+    return faiss::fvec_inner_product(xi.data(), xj.data(), sq.d);
+}
+
+/* ============================================================
+ * DispatchIVFSQScanner
+ * ============================================================ */
+
+DispatchIVFSQScanner::DispatchIVFSQScanner(
+        const faiss::IndexIVFScalarQuantizer& index,
+        bool store_pairs,
+        const faiss::IDSelector* sel)
+        : faiss::InvertedListScanner(store_pairs, sel),
+          dc(index.sq, index.metric_type),
+          by_residual(index.by_residual),
+          quantizer(index.quantizer),
+          residual(index.d) {
+    code_size = index.code_size;
+    keep_max = index.metric_type == faiss::METRIC_INNER_PRODUCT;
+}
+
+void DispatchIVFSQScanner::set_query(const float* query) {
+    x = query;
+    if (keep_max || !by_residual) {
+        dc.set_query(query);
+    }
+}
+
+void DispatchIVFSQScanner::set_list(idx_t list_no, float coarse_dis) {
+    this->list_no = list_no;
+    if (keep_max) {
+        accu0 = by_residual ? coarse_dis : 0;
+    } else if (by_residual) {
+        // shift of the query wrt the centroid
+        quantizer->compute_residual(x, residual.data(), list_no);
+        dc.set_query(residual.data());
+    }
+}
+
+float DispatchIVFSQScanner::distance_to_code(const uint8_t* code) const {
+    return accu0 + dc.query_to_code(code);
+}
+
+size_t DispatchIVFSQScanner::scan_codes(
+        size_t list_size,
+        const uint8_t* codes,
+        const idx_t* ids,
+        float* distances,
+        idx_t* labels,
+        size_t k) const {
+    float dis[kScanBlock];
+    size_t nup = 0;
+    for (size_t j0 = 0; j0 < list_size; j0 += kScanBlock) {
+        size_t nb = std::min(kScanBlock, list_size - j0);
+        dc.distances_to_codes(codes + j0 * code_size, nb, dis);
+        if (keep_max) {
+            for (size_t j = 0; j < nb; j++) {
+                dis[j] += accu0;
+            }
+            nup += update_heap<faiss::CMin<float, idx_t>>(
+                    dis, nb, j0, ids, list_no, store_pairs, sel, distances, labels, k);
+        } else {
+            nup += update_heap<faiss::CMax<float, idx_t>>(
+                    dis, nb, j0, ids, list_no, store_pairs, sel, distances, labels, k);
+        }
+    }
+    return nup;
+}
+
+void DispatchIVFSQScanner::scan_codes_range(
+        size_t list_size,
+        const uint8_t* codes,
+        const idx_t* ids,
+        float radius,
+        faiss::RangeQueryResult& result) const {
+    float dis[kScanBlock];
+    for (size_t j0 = 0; j0 < list_size; j0 += kScanBlock) {
+        size_t nb = std::min(kScanBlock, list_size - j0);
+        dc.distances_to_codes(codes + j0 * code_size, nb, dis);
+        for (size_t j = 0; j < nb; j++) {
+            float d = accu0 + dis[j];
+            if (keep_max ? d > radius : d < radius) {
+                size_t jj = j0 + j;
+                if (sel && !sel->is_member(ids ? ids[jj] : (idx_t)jj)) {
+                    continue;
+                }
+                result.add(d, store_pairs ? (list_no << 32 | (idx_t)jj) : ids[jj]);
+            }
+        }
+    }
+}
+
+/* ============================================================
+ * Search drivers
+ * ============================================================ */
+
+bool sq_dispatch_supported(const faiss::ScalarQuantizer& sq, faiss::MetricType metric) {
+    SQCodec codec;
+    bool uniform;
+    return (metric == faiss::METRIC_L2 || metric == faiss::METRIC_INNER_PRODUCT) &&
+            sq_codec(sq, &codec, &uniform);
+}
+
+void search_sq_flat(
+        const faiss::IndexScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    if (index.metric_type == faiss::METRIC_L2) {
+        search_sq_flat_impl<faiss::CMax<float, idx_t>>(index, n, x, k, distances, labels);
+    } else {
+        search_sq_flat_impl<faiss::CMin<float, idx_t>>(index, n, x, k, distances, labels);
+    }
+}
+
+void search_ivf_sq(
+        const faiss::IndexIVFScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels) {
+    const size_t nprobe = std::min(index.nprobe, index.nlist);
+    std::vector<idx_t> assign(n * nprobe);
+    std::vector<float> coarse_dis(n * nprobe);
+    index.quantizer->search(n, x, nprobe, coarse_dis.data(), assign.data());
+
+    const bool keep_max = index.metric_type == faiss::METRIC_INNER_PRODUCT;
+
+#pragma omp parallel if (n > 1)
+    {
+        DispatchIVFSQScanner scanner(index, false, nullptr);
+
+#pragma omp for
+        for (idx_t i = 0; i < n; i++) {
+            float* heap_dis = distances + i * k;
+            idx_t* heap_ids = labels + i * k;
+            if (keep_max) {
+                faiss::minheap_heapify(k, heap_dis, heap_ids);
+            } else {
+                faiss::maxheap_heapify(k, heap_dis, heap_ids);
+            }
+            scanner.set_query(x + i * index.d);
+
+            for (size_t p = 0; p < nprobe; p++) {
+                idx_t list_no = assign[i * nprobe + p];
+                if (list_no < 0) {
+                    continue;
+                }
+                size_t list_size = index.invlists->list_size(list_no);
+                if (list_size == 0) {
+                    continue;
+                }
+                scanner.set_list(list_no, coarse_dis[i * nprobe + p]);
+                faiss::InvertedLists::ScopedCodes codes(index.invlists, list_no);
+                faiss::InvertedLists::ScopedIds ids(index.invlists, list_no);
+                scanner.scan_codes(list_size, codes.get(), ids.get(), heap_dis, heap_ids, k);
+            }
+
+            if (keep_max) {
+                faiss::minheap_reorder(k, heap_dis, heap_ids);
+            } else {
+                faiss::maxheap_reorder(k, heap_dis, heap_ids);
+            }
+        }
+    }
+}
+
+} // namespace faiss_go_ext
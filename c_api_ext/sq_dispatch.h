@@ -0,0 +1,112 @@
+/**
+ * FAISS Go Extensions - scalar quantizer search with runtime SIMD dispatch
+ *
+ * Distance computer and inverted list scanner that evaluate ScalarQuantizer
+ * codes with the kernels selected by simd_dispatch.h, plus search drivers
+ * for IndexScalarQuantizer and IndexIVFScalarQuantizer built on them.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_SQ_DISPATCH_H
+#define FAISS_GO_EXT_SQ_DISPATCH_H
+
+#include "simd_dispatch.h"
+
+#include <faiss/IndexIVF.h>
+#include <faiss/IndexScalarQuantizer.h>
+#include <faiss/impl/ScalarQuantizer.h>
+
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+/// SQ distance computer backed by the dispatched kernels. codes and
+/// code_size must be set by the caller for operator() / symmetric_dis.
+struct DispatchSQDistanceComputer : faiss::ScalarQuantizer::SQDistanceComputer {
+    const faiss::ScalarQuantizer& sq;
+    faiss::MetricType metric;
+    sq_distances_fn fn;
+    SQKernelArgs args;
+
+    /// trained range expanded to one entry per dimension
+    std::vector<float> vmin, vdiff;
+
+    DispatchSQDistanceComputer(const faiss::ScalarQuantizer& sq, faiss::MetricType metric);
+
+    void set_query(const float* x) override;
+
+    float query_to_code(const uint8_t* code) const override;
+
+    /// distances from the current query to n consecutive codes
+    void distances_to_codes(const uint8_t* codes, size_t n, float* distances) const {
+        fn(&args, codes, n, distances);
+    }
+
+    float symmetric_dis(idx_t i, idx_t j) override;
+};
+
+/// IVF-SQ inverted list scanner backed by the dispatched kernels.
+struct DispatchIVFSQScanner : faiss::InvertedListScanner {
+    DispatchSQDistanceComputer dc;
+    bool by_residual;
+    const faiss::Index* quantizer;
+    const float* x = nullptr; ///< current query
+    float accu0 = 0;          ///< added to all distances (IP by residual)
+    std::vector<float> residual;
+
+    DispatchIVFSQScanner(
+            const faiss::IndexIVFScalarQuantizer& index,
+            bool store_pairs,
+            const faiss::IDSelector* sel);
+
+    void set_query(const float* query) override;
+
+    void set_list(idx_t list_no, float coarse_dis) override;
+
+    float distance_to_code(const uint8_t* code) const override;
+
+    size_t scan_codes(
+            size_t list_size,
+            const uint8_t* codes,
+            const idx_t* ids,
+            float* distances,
+            idx_t* labels,
+            size_t k) const override;
+
+    void scan_codes_range(
+            size_t list_size,
+            const uint8_t* codes,
+            const idx_t* ids,
+            float radius,
+            faiss::RangeQueryResult& result) const override;
+};
+
+/// True if the dispatched kernels handle this quantizer / metric pair.
+bool sq_dispatch_supported(const faiss::ScalarQuantizer& sq, faiss::MetricType metric);
+
+/// k-NN search over an IndexScalarQuantizer with the dispatched kernels.
+void search_sq_flat(
+        const faiss::IndexScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels);
+
+/// k-NN search over an IndexIVFScalarQuantizer with the dispatched
+/// scanner, probing index.nprobe lists per query.
+void search_ivf_sq(
+        const faiss::IndexIVFScalarQuantizer& index,
+        idx_t n,
+        const float* x,
+        idx_t k,
+        float* distances,
+        idx_t* labels);
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_SQ_DISPATCH_H */
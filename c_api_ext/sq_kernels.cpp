@@ -0,0 +1,320 @@
+/**
+ * FAISS Go Extensions - scalar quantizer distance kernels
+ *
+ * This file is compiled once per SIMD level with FAISS_GO_EXT_SIMD_NS set to
+ * the target namespace (see Makefile / build.sh). The codecs mirror the code
+ * layouts of faiss/impl/ScalarQuantizer.cpp so the kernels can scan codes
+ * produced by the bundled libfaiss.
+ *
+ * Keep this file free of STL and FAISS headers: anything inline that gets
+ * instantiated here is compiled with the wide instruction set and could be
+ * picked by the linker for generic callers.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_kernels-inl.h"
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+
+namespace {
+
+/* ============================================================
+ * Scalar helpers
+ * ============================================================ */
+
+inline uint16_t load_u16(const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline float fp16_to_float(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    if (exp == 0) {
+        if (mant == 0) {
+            return bits_to_float(sign);
+        }
+        // subnormal: renormalize the mantissa
+        exp = 1;
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            exp--;
+        }
+        mant &= 0x3ff;
+    } else if (exp == 31) {
+        return bits_to_float(sign | 0x7f800000 | (mant << 13));
+    }
+    return bits_to_float(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+#if SIMD_W > 1
+/// fallback for codecs without a vectorized decoder
+template <class Codec>
+inline simd_t decode_via_scalar(const uint8_t* code, size_t i) {
+    float tmp[SIMD_W];
+    for (size_t j = 0; j < SIMD_W; j++) {
+        tmp[j] = Codec::decode(code, i + j);
+    }
+    return vload(tmp);
+}
+#endif
+
+/* ============================================================
+ * Codecs. Scaled codecs decode to [0, 1], the others decode the value.
+ * ============================================================ */
+
+struct Codec8bit {
+    static constexpr bool scaled = true;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        return (code[i] + 0.5f) / 255.0f;
+    }
+
+#if defined(__AVX512F__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m512i i32 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(code + i)));
+        return _mm512_fmadd_ps(
+                _mm512_cvtepi32_ps(i32), _mm512_set1_ps(1.f / 255.f), _mm512_set1_ps(0.5f / 255.f));
+    }
+#elif defined(__AVX2__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m256i i32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(code + i)));
+        return _mm256_fmadd_ps(
+                _mm256_cvtepi32_ps(i32), _mm256_set1_ps(1.f / 255.f), _mm256_set1_ps(0.5f / 255.f));
+    }
+#elif defined(__aarch64__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        uint16x8_t w = vmovl_u8(vld1_u8(code + i));
+        float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(w)));
+        float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(w)));
+        float32x4_t scale = vdupq_n_f32(1.f / 255.f);
+        float32x4_t bias = vdupq_n_f32(0.5f / 255.f);
+        return {vfmaq_f32(bias, lo, scale), vfmaq_f32(bias, hi, scale)};
+    }
+#endif
+};
+
+struct Codec4bit {
+    static constexpr bool scaled = true;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        return (((code[i / 2] >> ((i & 1) << 2)) & 0xf) + 0.5f) / 15.0f;
+    }
+
+#if defined(__AVX512F__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        uint64_t c8;
+        memcpy(&c8, code + (i >> 1), sizeof(c8));
+        const uint64_t mask = 0x0f0f0f0f0f0f0f0fULL;
+        __m128i c16 = _mm_unpacklo_epi8(
+                _mm_set1_epi64x(c8 & mask), _mm_set1_epi64x((c8 >> 4) & mask));
+        __m512i i16 = _mm512_cvtepu8_epi32(c16);
+        return _mm512_fmadd_ps(
+                _mm512_cvtepi32_ps(i16), _mm512_set1_ps(1.f / 15.f), _mm512_set1_ps(0.5f / 15.f));
+    }
+#elif defined(__AVX2__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        uint32_t c4;
+        memcpy(&c4, code + (i >> 1), sizeof(c4));
+        const uint32_t mask = 0x0f0f0f0f;
+        __m128i c8 = _mm_unpacklo_epi8(_mm_set1_epi32(c4 & mask), _mm_set1_epi32((c4 >> 4) & mask));
+        __m256i i8 = _mm256_cvtepu8_epi32(c8);
+        return _mm256_fmadd_ps(
+                _mm256_cvtepi32_ps(i8), _mm256_set1_ps(1.f / 15.f), _mm256_set1_ps(0.5f / 15.f));
+    }
+#elif defined(__aarch64__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        return decode_via_scalar<Codec4bit>(code, i);
+    }
+#endif
+};
+
+struct Codec6bit {
+    static constexpr bool scaled = true;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        uint8_t bits = 0;
+        code += (i >> 2) * 3;
+        switch (i & 3) {
+            case 0:
+                bits = code[0] & 0x3f;
+                break;
+            case 1:
+                bits = code[0] >> 6;
+                bits |= (code[1] & 0xf) << 2;
+                break;
+            case 2:
+                bits = code[1] >> 4;
+                bits |= (code[2] & 3) << 4;
+                break;
+            case 3:
+                bits = code[2] >> 2;
+                break;
+        }
+        return (bits + 0.5f) / 63.0f;
+    }
+
+#if SIMD_W > 1
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        return decode_via_scalar<Codec6bit>(code, i);
+    }
+#endif
+};
+
+struct CodecFP16 {
+    static constexpr bool scaled = false;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        return fp16_to_float(load_u16(code + 2 * i));
+    }
+
+#if defined(__AVX512F__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        return _mm512_cvtph_ps(_mm256_loadu_si256((const __m256i*)(code + 2 * i)));
+    }
+#elif defined(__AVX2__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        return _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(code + 2 * i)));
+    }
+#elif defined(__aarch64__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        const uint16_t* p = (const uint16_t*)(code + 2 * i);
+        return {vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))),
+                vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p + 4)))};
+    }
+#endif
+};
+
+struct CodecBF16 {
+    static constexpr bool scaled = false;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        return bits_to_float((uint32_t)load_u16(code + 2 * i) << 16);
+    }
+
+#if defined(__AVX512F__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m512i i32 = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i*)(code + 2 * i)));
+        return _mm512_castsi512_ps(_mm512_slli_epi32(i32, 16));
+    }
+#elif defined(__AVX2__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m256i i32 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(code + 2 * i)));
+        return _mm256_castsi256_ps(_mm256_slli_epi32(i32, 16));
+    }
+#elif defined(__aarch64__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        const uint16_t* p = (const uint16_t*)(code + 2 * i);
+        return {vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p), 16)),
+                vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(p + 4), 16))};
+    }
+#endif
+};
+
+template <int BIAS>
+struct Codec8bitDirect {
+    static constexpr bool scaled = false;
+
+    static inline float decode(const uint8_t* code, size_t i) {
+        return (float)((int)code[i] - BIAS);
+    }
+
+#if defined(__AVX512F__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m512i i32 = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*)(code + i)));
+        return _mm512_cvtepi32_ps(_mm512_sub_epi32(i32, _mm512_set1_epi32(BIAS)));
+    }
+#elif defined(__AVX2__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        __m256i i32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(code + i)));
+        return _mm256_cvtepi32_ps(_mm256_sub_epi32(i32, _mm256_set1_epi32(BIAS)));
+    }
+#elif defined(__aarch64__)
+    static inline simd_t decode_simd(const uint8_t* code, size_t i) {
+        uint16x8_t w = vmovl_u8(vld1_u8(code + i));
+        float32x4_t bias = vdupq_n_f32((float)BIAS);
+        return {vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(w))), bias),
+                vsubq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(w))), bias)};
+    }
+#endif
+};
+
+/* ============================================================
+ * Kernels
+ * ============================================================ */
+
+template <class Codec, bool IP>
+inline float query_to_code(const SQKernelArgs* args, const uint8_t* code) {
+    const size_t d = args->d;
+    const float* q = args->query;
+    const float* vmin = args->vmin;
+    const float* vdiff = args->vdiff;
+    size_t i = 0;
+    float accu = 0;
+
+#if SIMD_W > 1
+    simd_t acc = vzero();
+    for (; i + SIMD_W <= d; i += SIMD_W) {
+        simd_t x = Codec::decode_simd(code, i);
+        if constexpr (Codec::scaled) {
+            x = vfmadd(x, vload(vdiff + i), vload(vmin + i));
+        }
+        simd_t qi = vload(q + i);
+        if constexpr (IP) {
+            acc = vfmadd(qi, x, acc);
+        } else {
+            simd_t t = vsub(qi, x);
+            acc = vfmadd(t, t, acc);
+        }
+    }
+    accu = vreduce(acc);
+#endif
+
+    for (; i < d; i++) {
+        float x = Codec::decode(code, i);
+        if constexpr (Codec::scaled) {
+            x = vmin[i] + x * vdiff[i];
+        }
+        if constexpr (IP) {
+            accu += q[i] * x;
+        } else {
+            float t = q[i] - x;
+            accu += t * t;
+        }
+    }
+    return accu;
+}
+
+template <class Codec, bool IP>
+void sq_distances(const SQKernelArgs* args, const uint8_t* codes, size_t n, float* distances) {
+    const size_t code_size = args->code_size;
+    for (size_t j = 0; j < n; j++) {
+        distances[j] = query_to_code<Codec, IP>(args, codes + j * code_size);
+    }
+}
+
+template <class Codec>
+void set_codec(SQKernels* kernels, SQCodec codec) {
+    kernels->l2[codec] = sq_distances<Codec, false>;
+    kernels->ip[codec] = sq_distances<Codec, true>;
+}
+
+} // namespace
+
+void get_sq_kernels(SQKernels* kernels) {
+    set_codec<Codec8bit>(kernels, SQ_CODEC_8BIT);
+    set_codec<Codec4bit>(kernels, SQ_CODEC_4BIT);
+    set_codec<Codec6bit>(kernels, SQ_CODEC_6BIT);
+    set_codec<CodecFP16>(kernels, SQ_CODEC_FP16);
+    set_codec<CodecBF16>(kernels, SQ_CODEC_BF16);
+    set_codec<Codec8bitDirect<0>>(kernels, SQ_CODEC_8BIT_DIRECT);
+    set_codec<Codec8bitDirect<128>>(kernels, SQ_CODEC_8BIT_DIRECT_SIGNED);
+}
+
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
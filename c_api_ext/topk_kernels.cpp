@@ -0,0 +1,84 @@
+/**
+ * FAISS Go Extensions - approximate top-k bucket kernels
+ *
+ * Counterpart of HeapWithBuckets in faiss/utils/approx_topk, for both
+ * directions and with a bucket state that persists across calls, compiled
+ * once per SIMD level (see simd_dispatch.h). The loops over the buckets
+ * are written as selects so the compiler turns each row of nbuckets
+ * values into compare / blend instructions.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "simd_kernels-inl.h"
+
+namespace faiss_go_ext {
+namespace FAISS_GO_EXT_SIMD_NS {
+
+namespace {
+
+/// insert one row of NB values (positions pos) into the buckets
+template <size_t NB, size_t BD, bool KEEP_MAX>
+inline void bucket_row(float* v, int32_t* pos, float* bucket_dis, int32_t* bucket_pos) {
+    for (size_t p = 0; p < BD; p++) {
+        float* bd = bucket_dis + p * NB;
+        int32_t* bp = bucket_pos + p * NB;
+        for (size_t j = 0; j < NB; j++) {
+            bool better = KEEP_MAX ? v[j] > bd[j] : v[j] < bd[j];
+            float tv = bd[j];
+            int32_t tp = bp[j];
+            bd[j] = better ? v[j] : tv;
+            bp[j] = better ? pos[j] : tp;
+            v[j] = better ? tv : v[j];
+            pos[j] = better ? tp : pos[j];
+        }
+    }
+}
+
+template <size_t NB, size_t BD, bool KEEP_MAX>
+void bucket_topk(
+        const float* dis,
+        size_t n,
+        int32_t pos0,
+        float* bucket_dis,
+        int32_t* bucket_pos) {
+    float v[NB];
+    int32_t pos[NB];
+    size_t i = 0;
+    for (; i + NB <= n; i += NB) {
+        for (size_t j = 0; j < NB; j++) {
+            v[j] = dis[i + j];
+            pos[j] = pos0 + (int32_t)(i + j);
+        }
+        bucket_row<NB, BD, KEEP_MAX>(v, pos, bucket_dis, bucket_pos);
+    }
+    if (i < n) {
+        // pad the last row with values that never enter a bucket
+        for (size_t j = 0; j < NB; j++) {
+            v[j] = i + j < n ? dis[i + j] : bucket_dis[(BD - 1) * NB + j];
+            pos[j] = i + j < n ? pos0 + (int32_t)(i + j) : bucket_pos[(BD - 1) * NB + j];
+        }
+        bucket_row<NB, BD, KEEP_MAX>(v, pos, bucket_dis, bucket_pos);
+    }
+}
+
+template <bool KEEP_MAX>
+void fill(bucket_topk_fn* table) {
+    // order of ApproxTopK_mode_t
+    table[0] = nullptr;
+    table[1] = bucket_topk<32, 2, KEEP_MAX>;
+    table[2] = bucket_topk<8, 3, KEEP_MAX>;
+    table[3] = bucket_topk<16, 2, KEEP_MAX>;
+    table[4] = bucket_topk<8, 2, KEEP_MAX>;
+}
+
+} // namespace
+
+void get_topk_kernels(TopKKernels* kernels) {
+    fill<false>(kernels->min);
+    fill<true>(kernels->max);
+}
+
+} // namespace FAISS_GO_EXT_SIMD_NS
+} // namespace faiss_go_ext
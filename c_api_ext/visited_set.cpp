@@ -0,0 +1,58 @@
+/**
+ * FAISS Go Extensions - sparse visited set for graph search
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#include "visited_set.h"
+
+#include <algorithm>
+
+namespace faiss_go_ext {
+
+SparseVisitedSet::SparseVisitedSet(size_t expected) {
+    size_t n = 16;
+    int log2n = 4;
+    while (n < 2 * expected) {
+        n *= 2;
+        log2n++;
+    }
+    keys.resize(n);
+    stamps.assign(n, 0);
+    shift = 64 - log2n;
+}
+
+void SparseVisitedSet::clear() {
+    count = 0;
+    if (++stamp == 0) {
+        // once every 2^32 queries
+        std::fill(stamps.begin(), stamps.end(), 0);
+        stamp = 1;
+    }
+}
+
+void SparseVisitedSet::grow() {
+    std::vector<idx_t> old_keys(keys.size() * 2);
+    std::vector<uint32_t> old_stamps(stamps.size() * 2, 0);
+    old_keys.swap(keys);
+    old_stamps.swap(stamps);
+    shift--;
+    const uint32_t old_stamp = stamp;
+    stamp = 1;
+    count = 0;
+    for (size_t i = 0; i < old_keys.size(); i++) {
+        if (old_stamps[i] == old_stamp) {
+            insert(old_keys[i]);
+        }
+    }
+}
+
+void DenseVisitedSet::clear() {
+    if (++stamp == 0) {
+        std::fill(flags.begin(), flags.end(), 0);
+        stamp = 1;
+    }
+}
+
+} // namespace faiss_go_ext
@@ -0,0 +1,116 @@
+/**
+ * FAISS Go Extensions - sparse visited set for graph search
+ *
+ * faiss::VisitedTable holds one byte per database vector, so every search
+ * thread allocates and clears ntotal bytes: gigabytes for a billion-node
+ * graph, of which a search touches a few thousand entries. SparseVisitedSet
+ * is an open-addressing hash set of node ids sized by the number of nodes
+ * visited. Slots carry the generation they were written in, so clearing
+ * the set between queries is a counter increment. DenseVisitedSet is the
+ * VisitedTable layout (one generation byte per node) behind the same
+ * interface, for graphs small enough that the byte array stays cached;
+ * graph_search.h picks one or the other per search.
+ *
+ * Copyright (c) 2024 faiss-go contributors
+ * Licensed under MIT License
+ */
+
+#ifndef FAISS_GO_EXT_VISITED_SET_H
+#define FAISS_GO_EXT_VISITED_SET_H
+
+#include <faiss/MetricType.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace faiss_go_ext {
+
+using faiss::idx_t;
+
+struct SparseVisitedSet {
+    std::vector<idx_t> keys;
+    std::vector<uint32_t> stamps; ///< slot is used if it holds stamp
+    uint32_t stamp = 1;
+    int shift = 64; ///< 64 - log2(number of slots)
+    size_t count = 0;
+
+    /// room for about expected ids before the first rehash
+    explicit SparseVisitedSet(size_t expected = 1024);
+
+    /// mark id as visited, returns true if it was not yet
+    bool insert(idx_t id) {
+        if (2 * (count + 1) > keys.size()) {
+            grow();
+        }
+        const size_t mask = keys.size() - 1;
+        for (size_t h = slot_of(id);; h = (h + 1) & mask) {
+            if (stamps[h] != stamp) {
+                stamps[h] = stamp;
+                keys[h] = id;
+                count++;
+                return true;
+            }
+            if (keys[h] == id) {
+                return false;
+            }
+        }
+    }
+
+    bool contains(idx_t id) const {
+        const size_t mask = keys.size() - 1;
+        for (size_t h = slot_of(id);; h = (h + 1) & mask) {
+            if (stamps[h] != stamp) {
+                return false;
+            }
+            if (keys[h] == id) {
+                return true;
+            }
+        }
+    }
+
+    /// forget all ids
+    void clear();
+
+    size_t slot_of(idx_t id) const {
+        // Fibonacci hashing, the high bits mix all bits of the id
+        return (size_t)(((uint64_t)id * 0x9e3779b97f4a7c15ULL) >> shift);
+    }
+
+    /// double the slots, keeping the current ids
+    void grow();
+
+    size_t memory_usage() const {
+        return keys.size() * (sizeof(idx_t) + sizeof(uint32_t));
+    }
+};
+
+/// one generation byte per node, as faiss::VisitedTable
+struct DenseVisitedSet {
+    std::vector<uint8_t> flags;
+    uint8_t stamp = 1;
+
+    explicit DenseVisitedSet(size_t ntotal) : flags(ntotal, 0) {}
+
+    bool insert(idx_t id) {
+        if (flags[id] == stamp) {
+            return false;
+        }
+        flags[id] = stamp;
+        return true;
+    }
+
+    bool contains(idx_t id) const {
+        return flags[id] == stamp;
+    }
+
+    /// forget all ids, a memset every 255 calls
+    void clear();
+
+    size_t memory_usage() const {
+        return flags.size();
+    }
+};
+
+} // namespace faiss_go_ext
+
+#endif /* FAISS_GO_EXT_VISITED_SET_H */
@@ -1,8 +1,9 @@
 /**
- * FAISS Go Extensions - Additional C API functions for faiss-go
+ * FAISS Go Extensions - C API Header
  *
- * This header declares functions missing from the standard FAISS C API
- * that are needed for full faiss-go functionality.
+ * This header declares additional C API functions for faiss-go that are either:
+ * 1. Missing from the standard FAISS C API
+ * 2. Have ABI issues in the standard C API
  *
  * Copyright (c) 2024 faiss-go contributors
  * Licensed under MIT License
@@ -18,32 +19,39 @@
 extern "C" {
 #endif
 
-/* Forward declarations - these match FAISS C API types */
+/* Opaque pointer types - match FAISS C API */
 typedef void* FaissIndex;
 typedef void* FaissIndexBinary;
 typedef void* FaissRangeSearchResult;
+typedef void* FaissVectorTransform;
+typedef void* FaissSearchParameters;
+typedef void* FaissReplicaRouter;
+typedef void* FaissIVFIdTable;
+typedef void* FaissIVFTombstones;
+typedef void* FaissRangeSearchArena;
+typedef void* FaissSearchContext;
+typedef void* FaissParameterSpace;
+typedef void* FaissOperatingPoints;
+typedef void* FaissSearchController;
+typedef void* FaissCompiledFactory;
+typedef void* FaissSnapshotIndex;
+typedef void* FaissSegmentedIndex;
 
 /* ============================================================
  * Index Assign Extension
  * ============================================================ */
 
 /**
- * Assign vectors to their nearest neighbors.
- * This is a custom wrapper that works reliably with all index types.
+ * Assign vectors to their nearest neighbors (cluster assignment for IVF).
  *
- * @param index   The index pointer
+ * @param index   The index
  * @param n       Number of vectors
  * @param x       Input vectors (n * d floats)
  * @param labels  Output labels (n * k int64_t)
  * @param k       Number of nearest neighbors to find
  * @return 0 on success, -1 on error
  */
-int faiss_Index_assign_ext(
-    FaissIndex index,
-    int64_t n,
-    const float* x,
-    int64_t* labels,
-    int64_t k);
+int faiss_Index_assign_ext(FaissIndex index, int64_t n, const float* x, int64_t* labels, int64_t k);
 
 /* ============================================================
  * Range Search Result Extensions
@@ -56,13 +64,10 @@ int faiss_Index_assign_ext(
  * @param distances Output pointer to the distances array
  * @return 0 on success, -1 on error
  */
-int faiss_RangeSearchResult_distances(
-    FaissRangeSearchResult result,
-    float** distances);
+int faiss_RangeSearchResult_distances(FaissRangeSearchResult result, float** distances);
 
 /**
  * Get all arrays from a RangeSearchResult at once.
- * This is more efficient than calling individual accessors.
  *
  * @param result    The RangeSearchResult pointer
  * @param lims      Output: array of size nq+1 with result offsets
@@ -70,14 +75,10 @@ int faiss_RangeSearchResult_distances(
  * @param distances Output: array of result distances
  * @return 0 on success, -1 on error
  */
-int faiss_RangeSearchResult_get(
-    FaissRangeSearchResult result,
-    int64_t** lims,
-    int64_t** labels,
-    float** distances);
+int faiss_RangeSearchResult_get(FaissRangeSearchResult result, int64_t** lims, int64_t** labels, float** distances);
 
 /* ============================================================
- * Binary Index Constructors
+ * Binary Index Constructor
  * ============================================================ */
 
 /**
@@ -87,177 +88,2015 @@ int faiss_RangeSearchResult_get(
  * @param d       Dimension of binary vectors (in bits, must be multiple of 8)
  * @return 0 on success, -1 on error
  */
-int faiss_IndexBinaryFlat_new(
-    FaissIndexBinary* p_index,
-    int64_t d);
+int faiss_IndexBinaryFlat_new(FaissIndexBinary* p_index, int64_t d);
 
 /**
- * Create a new IndexBinaryIVF.
+ * Create a new IndexBinaryIVF. The quantizer is borrowed: it must outlive
+ * the index.
  *
  * @param p_index   Output pointer to the new index
- * @param quantizer The quantizer index (must be a binary index)
- * @param d         Dimension of binary vectors (in bits)
+ * @param quantizer Binary coarse quantizer (usually an IndexBinaryFlat)
+ * @param d         Dimension in bits (multiple of 8)
  * @param nlist     Number of inverted lists
  * @return 0 on success, -1 on error
  */
-int faiss_IndexBinaryIVF_new(
-    FaissIndexBinary* p_index,
-    FaissIndexBinary quantizer,
-    int64_t d,
-    int64_t nlist);
+int faiss_IndexBinaryIVF_new(FaissIndexBinary* p_index, FaissIndexBinary quantizer, int64_t d, int64_t nlist);
 
 /**
- * Create a new IndexBinaryHash.
+ * Create a new IndexBinaryHNSW over an IndexBinaryFlat storage.
  *
  * @param p_index Output pointer to the new index
- * @param d       Dimension of binary vectors (in bits)
- * @param b       Number of hash bits
+ * @param d       Dimension in bits (multiple of 8)
+ * @param M       Number of neighbors per node
  * @return 0 on success, -1 on error
  */
-int faiss_IndexBinaryHash_new(
-    FaissIndexBinary* p_index,
-    int64_t d,
-    int64_t b);
+int faiss_IndexBinaryHNSW_new(FaissIndexBinary* p_index, int64_t d, int M);
+
+/**
+ * Create a new IndexBinaryHNSWCagra (an IndexBinaryHNSW whose base level
+ * can be filled from a CAGRA graph).
+ */
+int faiss_IndexBinaryHNSWCagra_new(FaissIndexBinary* p_index, int64_t d, int M);
+
+/**
+ * Create a new IndexBinaryHash: codes are bucketed by their first b bits.
+ *
+ * @param p_index Output pointer to the new index
+ * @param d       Dimension in bits (multiple of 8)
+ * @param b       Bits of the hash key
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexBinaryHash_new(FaissIndexBinary* p_index, int64_t d, int b);
+
+/**
+ * Create a new IndexBinaryMultiHash: nhash hash tables keyed by
+ * consecutive b-bit slices of the codes.
+ *
+ * @param p_index Output pointer to the new index
+ * @param d       Dimension in bits (multiple of 8)
+ * @param nhash   Number of hash tables (nhash * b <= d)
+ * @param b       Bits of each hash key
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexBinaryMultiHash_new(FaissIndexBinary* p_index, int64_t d, int nhash, int b);
+
+/**
+ * Create a new IndexBinaryFromFloat: a float index searched with codes
+ * turned into +-1 vectors.
+ *
+ * @param p_index   Output pointer to the new index
+ * @param index     Float index of dimension d bits
+ * @param own_index If non-zero the binary index frees index
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexBinaryFromFloat_new(FaissIndexBinary* p_index, FaissIndex index, int own_index);
+
+/**
+ * Build a binary index from a description ("BFlat", "BIVF1024",
+ * "BHNSW32", "BHash16", "BHash4x16", "IDMap,BIVF1024", ...).
+ *
+ * @param p_index     Output pointer to the new index
+ * @param d           Dimension in bits (multiple of 8)
+ * @param description Factory string
+ * @return 0 on success, -1 on error
+ */
+int faiss_index_binary_factory_ext(FaissIndexBinary* p_index, int d, const char* description);
+
+/* ============================================================
+ * Binary Index Extensions (property accessors)
+ * ============================================================ */
+
+/*
+ * libfaiss_c already provides faiss_IndexBinaryIVF_nprobe and the void
+ * setters faiss_IndexBinaryIVF_set_nprobe / _set_max_codes (see
+ * IndexBinaryIVF_c.h). The _ext variants below check the index type and
+ * the value and return an error code instead.
+ */
+
+/**
+ * Set the number of lists probed per query by an IndexBinaryIVF.
+ *
+ * @return 0 on success, -1 if index is not an IndexBinaryIVF or nprobe <= 0
+ */
+int faiss_IndexBinaryIVF_set_nprobe_ext(FaissIndexBinary index, int64_t nprobe);
+
+/**
+ * Get the nprobe of an IndexBinaryIVF.
+ */
+int faiss_IndexBinaryIVF_get_nprobe(FaissIndexBinary index, int64_t* nprobe);
+
+/**
+ * Set the max number of codes an IndexBinaryIVF visits per query, 0 for
+ * no limit.
+ *
+ * @return 0 on success, -1 if index is not an IndexBinaryIVF or max_codes < 0
+ */
+int faiss_IndexBinaryIVF_set_max_codes_ext(FaissIndexBinary index, int64_t max_codes);
+
+/**
+ * Set efSearch of an IndexBinaryHNSW.
+ */
+int faiss_IndexBinaryHNSW_set_efSearch(FaissIndexBinary index, int ef);
+
+/**
+ * Get efSearch of an IndexBinaryHNSW.
+ */
+int faiss_IndexBinaryHNSW_get_efSearch(FaissIndexBinary index, int* ef);
+
+/**
+ * Set efConstruction of an IndexBinaryHNSW, before vectors are added.
+ */
+int faiss_IndexBinaryHNSW_set_efConstruction(FaissIndexBinary index, int ef);
+
+/**
+ * Set the number of bits flipped in hash keys at search time, for
+ * IndexBinaryHash and IndexBinaryMultiHash.
+ */
+int faiss_IndexBinaryHash_set_nflip(FaissIndexBinary index, int nflip);
+
+/**
+ * Get nflip of an IndexBinaryHash or IndexBinaryMultiHash.
+ */
+int faiss_IndexBinaryHash_get_nflip(FaissIndexBinary index, int* nflip);
+
+/** First k of the k-NN searches that emulate a binary range search. */
+#define FAISS_BINARY_RANGE_SEARCH_MIN_K 16
+
+/** Results per query kept by an emulated binary range search when max_k is 0. */
+#define FAISS_BINARY_RANGE_SEARCH_DEFAULT_MAX_K 4096
+
+/**
+ * Hamming range search: results at distance < radius. Flat, IVF, Hash and
+ * MultiHash indexes use their own range search and return every result.
+ * HNSW and FromFloat indexes have none: they run k-NN searches starting at
+ * k = FAISS_BINARY_RANGE_SEARCH_MIN_K and doubling while the k-th result
+ * is within radius, up to k = max_k. A query still having max_k results
+ * within radius then gets its max_k nearest only and is counted in
+ * n_truncated.
+ *
+ * @param index       The binary index
+ * @param n           Number of queries
+ * @param x           Query codes (n * d / 8 bytes)
+ * @param radius      Hamming radius (exclusive)
+ * @param max_k       Max results per query of the k-NN emulation, 0 for
+ *                    FAISS_BINARY_RANGE_SEARCH_DEFAULT_MAX_K, raised to
+ *                    FAISS_BINARY_RANGE_SEARCH_MIN_K if smaller
+ * @param result      RangeSearchResult created for n queries
+ * @param n_truncated Output: number of queries cut at max_k (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexBinary_range_search_ext(FaissIndexBinary index, int64_t n, const uint8_t* x, int radius, int64_t max_k, FaissRangeSearchResult result, int64_t* n_truncated);
+
+/* ============================================================
+ * HNSW Index Extensions (property accessors)
+ * ============================================================ */
+
+/**
+ * Set efConstruction parameter for HNSW index.
+ */
+int faiss_IndexHNSW_set_efConstruction(FaissIndex index, int ef);
+
+/**
+ * Set efSearch parameter for HNSW index.
+ */
+int faiss_IndexHNSW_set_efSearch(FaissIndex index, int ef);
+
+/**
+ * Get efConstruction parameter from HNSW index.
+ */
+int faiss_IndexHNSW_get_efConstruction(FaissIndex index, int* ef);
+
+/**
+ * Get efSearch parameter from HNSW index.
+ */
+int faiss_IndexHNSW_get_efSearch(FaissIndex index, int* ef);
 
 /* ============================================================
- * Serialization Extensions
+ * VectorTransform Extensions
  * ============================================================ */
 
 /**
- * Serialize an index to a byte buffer.
+ * Train the VectorTransform.
  *
- * @param index The index to serialize
- * @param data  Output: pointer to allocated buffer (caller must free)
- * @param size  Output: size of the buffer in bytes
+ * @param vt The VectorTransform
+ * @param n  Number of vectors
+ * @param x  Input vectors (n * d_in floats)
  * @return 0 on success, -1 on error
  */
-int faiss_serialize_index(
-    FaissIndex index,
-    uint8_t** data,
-    size_t* size);
+int faiss_VectorTransform_train_ext(FaissVectorTransform vt, int64_t n, const float* x);
 
 /**
- * Deserialize an index from a byte buffer.
+ * Check if VectorTransform is trained.
  *
- * @param data       Input buffer containing serialized index
- * @param size       Size of the input buffer
- * @param p_index    Output: pointer to the deserialized index
- * @param index_type Output: string buffer for index type (min 64 chars)
- * @param d          Output: dimension of the index
- * @param metric     Output: metric type
- * @param ntotal     Output: number of vectors in the index
+ * @param vt      The VectorTransform
+ * @param trained Output: 1 if trained, 0 if not
  * @return 0 on success, -1 on error
  */
-int faiss_deserialize_index(
-    const uint8_t* data,
-    size_t size,
-    FaissIndex* p_index,
-    char* index_type,
-    int* d,
-    int* metric,
-    int64_t* ntotal);
+int faiss_VectorTransform_is_trained_ext(FaissVectorTransform vt, int* trained);
 
 /**
- * Free a buffer allocated by faiss_serialize_index.
+ * Apply VectorTransform without allocating output.
  *
- * @param data The buffer to free
+ * @param vt The VectorTransform
+ * @param n  Number of vectors
+ * @param x  Input vectors (n * d_in floats)
+ * @param xt Output vectors (n * d_out floats, must be pre-allocated)
+ * @return 0 on success, -1 on error
+ */
+int faiss_VectorTransform_apply_noalloc_ext(FaissVectorTransform vt, int64_t n, const float* x, float* xt);
+
+/**
+ * Reverse transform vectors.
+ *
+ * @param vt The VectorTransform
+ * @param n  Number of vectors
+ * @param xt Transformed vectors (n * d_out floats)
+ * @param x  Output original vectors (n * d_in floats, must be pre-allocated)
+ * @return 0 on success, -1 on error
  */
-void faiss_serialize_free(uint8_t* data);
+int faiss_VectorTransform_reverse_transform_ext(FaissVectorTransform vt, int64_t n, const float* xt, float* x);
 
 /* ============================================================
- * HNSW Index Extensions (for direct creation, not via factory)
+ * SIMD Dispatch Extensions
  * ============================================================ */
 
+/** Instruction set levels the extension kernels are compiled for */
+typedef enum FaissSIMDLevel {
+    FAISS_SIMD_GENERIC = 0,
+    FAISS_SIMD_AVX2 = 1,
+    FAISS_SIMD_AVX512 = 2,
+    FAISS_SIMD_NEON = 3,
+} FaissSIMDLevel;
+
 /**
- * Create a new IndexHNSWFlat.
+ * Get the SIMD level currently used by the extension kernels. It is the
+ * best level of the host CPU unless lowered by the FAISS_OPT_LEVEL
+ * environment variable ("generic", "avx2", "avx512") or by
+ * faiss_set_simd_level.
  *
- * @param p_index     Output pointer to the new index
- * @param d           Dimension of vectors
- * @param M           Number of connections per layer
- * @param metric_type Metric type (0=IP, 1=L2)
+ * @param level Output: one of FaissSIMDLevel
  * @return 0 on success, -1 on error
  */
-int faiss_IndexHNSWFlat_new(
-    FaissIndex* p_index,
-    int64_t d,
-    int M,
-    int metric_type);
+int faiss_get_simd_level(int* level);
 
 /**
- * Set efConstruction parameter for HNSW index.
+ * Force the SIMD level of the extension kernels for the whole process.
+ * Searches already running finish with the previous level.
+ *
+ * @param level One of FaissSIMDLevel, must be supported by the host CPU
+ * @return 0 on success, -1 if the level is not supported
+ */
+int faiss_set_simd_level(int level);
+
+/**
+ * Check whether kernels for a SIMD level can run on the host CPU.
  *
- * @param index The HNSW index
- * @param ef    The efConstruction value
+ * @param level     One of FaissSIMDLevel
+ * @param supported Output: 1 if supported, 0 otherwise
  * @return 0 on success, -1 on error
  */
-int faiss_IndexHNSW_set_efConstruction(FaissIndex index, int ef);
+int faiss_simd_level_supported(int level, int* supported);
 
 /**
- * Set efSearch parameter for HNSW index.
+ * Get the name of a SIMD level ("generic", "avx2", "avx512", "neon").
+ *
+ * @param level One of FaissSIMDLevel
+ * @return static string, "unknown" for invalid levels
+ */
+const char* faiss_simd_level_name(int level);
+
+/**
+ * Search an IndexScalarQuantizer with the runtime-dispatched SQ kernels.
+ * Falls back to the regular search for metrics other than L2 and IP.
  *
- * @param index The HNSW index
- * @param ef    The efSearch value
+ * @param index     The IndexScalarQuantizer
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
  * @return 0 on success, -1 on error
  */
-int faiss_IndexHNSW_set_efSearch(FaissIndex index, int ef);
+int faiss_IndexScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
 
 /**
- * Get efConstruction parameter from HNSW index.
+ * Search an IndexIVFScalarQuantizer with the runtime-dispatched IVF-SQ
+ * scanner, probing nprobe lists per query.
+ * Falls back to the regular search for metrics other than L2 and IP.
  *
- * @param index The HNSW index
- * @param ef    Output: the efConstruction value
+ * @param index     The IndexIVFScalarQuantizer
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
  * @return 0 on success, -1 on error
  */
-int faiss_IndexHNSW_get_efConstruction(FaissIndex index, int* ef);
+int faiss_IndexIVFScalarQuantizer_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
 
 /**
- * Get efSearch parameter from HNSW index.
+ * Search an IndexPQ with the runtime-dispatched PQ code distance kernels.
+ * Falls back to the regular search for codes other than 8 or 4 bits,
+ * metrics other than L2 and IP, or polysemous search types.
  *
- * @param index The HNSW index
- * @param ef    Output: the efSearch value
+ * @param index     The IndexPQ
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
  * @return 0 on success, -1 on error
  */
-int faiss_IndexHNSW_get_efSearch(FaissIndex index, int* ef);
+int faiss_IndexPQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Squared L2 distances between one vector and ny vectors, with the
+ * runtime-dispatched kernels.
+ *
+ * @param dis Output distances (ny floats)
+ * @param x   Query vector (d floats)
+ * @param y   Database vectors (ny * d floats)
+ * @param d   Vector dimension
+ * @param ny  Number of database vectors
+ * @return 0 on success, -1 on error
+ */
+int faiss_fvec_L2sqr_ny_ext(float* dis, const float* x, const float* y, size_t d, size_t ny);
+
+/**
+ * Inner products between one vector and ny vectors, with the
+ * runtime-dispatched kernels.
+ *
+ * @param ip Output inner products (ny floats)
+ * @param x  Query vector (d floats)
+ * @param y  Database vectors (ny * d floats)
+ * @param d  Vector dimension
+ * @param ny Number of database vectors
+ * @return 0 on success, -1 on error
+ */
+int faiss_fvec_inner_products_ny_ext(float* ip, const float* x, const float* y, size_t d, size_t ny);
+
+/**
+ * L2 nearest neighbor in y of each vector of x, computed in a single
+ * fused pass (no nx * ny distance matrix) with the runtime-dispatched
+ * kernels.
+ *
+ * @param x         Query vectors (nx * d floats)
+ * @param y         Database vectors (ny * d floats)
+ * @param d         Vector dimension
+ * @param nx        Number of query vectors
+ * @param ny        Number of database vectors
+ * @param distances Output squared L2 distances (nx floats)
+ * @param labels    Output indices into y (nx int64_t, -1 if ny == 0)
+ * @return 0 on success, -1 on error
+ */
+int faiss_fvec_L2sqr_nn_ext(const float* x, const float* y, size_t d, size_t nx, size_t ny, float* distances, int64_t* labels);
+
+/**
+ * Hamming distances between na binary codes and nb binary codes, with
+ * the runtime-dispatched kernels.
+ *
+ * @param a         Query codes (na * code_size bytes)
+ * @param b         Database codes (nb * code_size bytes)
+ * @param na        Number of query codes
+ * @param nb        Number of database codes
+ * @param code_size Bytes per code
+ * @param distances Output distances (na * nb int32_t, row-major)
+ * @return 0 on success, -1 on error
+ */
+int faiss_hamming_distances_ext(const uint8_t* a, const uint8_t* b, size_t na, size_t nb, size_t code_size, int32_t* distances);
+
+/* ============================================================
+ * Fast-Scan Extensions
+ *
+ * Apply to IndexFastScan (IndexPQFastScan, IndexAdditiveQuantizerFastScan)
+ * and IndexIVFFastScan (IndexIVFPQFastScan, ...) indexes. implem selects
+ * the search implementation (0 = auto; 12/13 block queries by qbs, 14/15
+ * do not, 10/11 are IVF only; odd values collect results in a reservoir
+ * instead of a heap). qbs controls query blocking, 0 = default:
+ *   - IndexFastScan, implem 12/13: block sizes as base-16 digits,
+ *     e.g. 0x33 for two blocks of 3 queries
+ *   - IndexFastScan, implem 14/15: number of queries per block
+ *   - IndexIVFFastScan: queries grouped per block (the qbs2 field)
+ * Combinations the index cannot run are rejected with -1.
+ *
+ * Both are fields of the index, written by the setters and by the
+ * autotuner with apply. faiss_IndexFastScan_search_ext and the autotuner
+ * search a per-call copy of the index instead: IVF copies share its
+ * quantizer and inverted lists, flat copies copy its codes. They can run
+ * concurrently with other searches of the index.
+ * ============================================================ */
+
+/**
+ * Set the search implementation of a fast-scan index.
+ */
+int faiss_IndexFastScan_set_implem(FaissIndex index, int implem);
+
+/**
+ * Get the search implementation of a fast-scan index.
+ */
+int faiss_IndexFastScan_get_implem(FaissIndex index, int* implem);
+
+/**
+ * Set the query block size of a fast-scan index.
+ */
+int faiss_IndexFastScan_set_qbs(FaissIndex index, int qbs);
+
+/**
+ * Get the query block size of a fast-scan index.
+ */
+int faiss_IndexFastScan_get_qbs(FaissIndex index, int* qbs);
+
+/**
+ * Get the database block size of a fast-scan index (fixed at build time).
+ */
+int faiss_IndexFastScan_get_bbs(FaissIndex index, int* bbs);
+
+/**
+ * Search a fast-scan index with implem and qbs overridden for this call,
+ * on a per-call copy. The index is not modified.
+ *
+ * @param index     The fast-scan index
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param implem    Search implementation for this call
+ * @param qbs       Query block size for this call
+ * @param params    Optional search parameters (e.g. SearchParametersIVF), may be NULL
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexFastScan_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int implem, int qbs, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/**
+ * Time every valid implem / qbs combination on a sample batch of queries
+ * and report the fastest. Tune with a batch of the size used in
+ * production, the best choice depends on n and k.
+ *
+ * @param index       The fast-scan index
+ * @param n           Number of sample queries
+ * @param x           Sample queries (n * d floats)
+ * @param k           Number of nearest neighbors
+ * @param nrep        Runs per combination, the fastest run is kept
+ * @param apply       If non-zero, store the best implem / qbs on the index
+ * @param best_implem Output: fastest implem
+ * @param best_qbs    Output: fastest qbs
+ * @param best_ms     Output: search time with the best combination (may be NULL)
+ * @param default_ms  Output: search time with the index's current settings (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexFastScan_autotune_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int nrep, int apply, int* best_implem, int* best_qbs, double* best_ms, double* default_ms);
 
 /* ============================================================
- * PQ Index Extensions
+ * RaBitQ Extensions
+ *
+ * IndexRaBitQ, IndexIVFRaBitQ, IndexRaBitQFastScan and
+ * IndexIVFRaBitQFastScan store 1 bit per dimension (nb_bits = 1) or 1 sign
+ * bit plus nb_bits - 1 extra bits (multi-bit, nb_bits 2 to 9). Queries are
+ * quantized to qb bits (0 = full precision, fast-scan variants need
+ * qb > 0), optionally with a zero-centered quantizer.
+ *
+ * The fast-scan variants read qb / centered from the index only, so
+ * faiss_RaBitQ_search_ext searches a per-call copy of them with its
+ * values set, as faiss_IndexFastScan_search_ext does.
  * ============================================================ */
 
+/** Per-call RaBitQ search parameters, negative / zero values keep the
+ *  setting stored on the index. Initialize with faiss_RaBitQSearchParams_init. */
+typedef struct FaissRaBitQSearchParams {
+    int qb;         /* bits per query component (0-8), -1 = index default */
+    int centered;   /* 0 / 1, -1 = index default */
+    size_t nprobe;  /* IVF variants, 0 = index default */
+    float k_factor; /* IndexRefine over a RaBitQ index, 0 = index default */
+} FaissRaBitQSearchParams;
+
+/**
+ * Reset search parameters to "use the index defaults".
+ */
+void faiss_RaBitQSearchParams_init(FaissRaBitQSearchParams* params);
+
+/**
+ * Create a new IndexRaBitQ.
+ *
+ * @param p_index     Output pointer to the new index
+ * @param d           Vector dimension
+ * @param metric_type METRIC_L2 or METRIC_INNER_PRODUCT
+ * @param nb_bits     Bits per dimension (1 to 9)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexRaBitQ_new(FaissIndex* p_index, int64_t d, int metric_type, int nb_bits);
+
+/**
+ * Create a new IndexIVFRaBitQ. The quantizer is not owned, use
+ * faiss_IndexIVF_set_own_fields to transfer it.
+ *
+ * @param p_index     Output pointer to the new index
+ * @param quantizer   Coarse quantizer
+ * @param d           Vector dimension
+ * @param nlist       Number of inverted lists
+ * @param metric_type METRIC_L2 or METRIC_INNER_PRODUCT
+ * @param nb_bits     Bits per dimension (1 to 9)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIVFRaBitQ_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int metric_type, int nb_bits);
+
+/**
+ * Create a new IndexRaBitQFastScan.
+ *
+ * @param p_index     Output pointer to the new index
+ * @param d           Vector dimension
+ * @param metric_type METRIC_L2 or METRIC_INNER_PRODUCT
+ * @param bbs         Database block size (multiple of 32)
+ * @param nb_bits     Bits per dimension (1 to 9)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexRaBitQFastScan_new(FaissIndex* p_index, int64_t d, int metric_type, int bbs, int nb_bits);
+
+/**
+ * Build an IndexRaBitQFastScan from a trained IndexRaBitQ, repacking its
+ * codes. The original index must outlive the new one.
+ *
+ * @param p_index Output pointer to the new index
+ * @param orig    The IndexRaBitQ
+ * @param bbs     Database block size (multiple of 32)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexRaBitQFastScan_new_from(FaissIndex* p_index, FaissIndex orig, int bbs);
+
 /**
- * Create a new IndexPQ.
+ * Create a new IndexIVFRaBitQFastScan. The quantizer is not owned, use
+ * faiss_IndexIVF_set_own_fields to transfer it.
  *
  * @param p_index     Output pointer to the new index
- * @param d           Dimension of vectors
- * @param M           Number of subquantizers
- * @param nbits       Number of bits per subquantizer code
- * @param metric_type Metric type (0=IP, 1=L2)
+ * @param quantizer   Coarse quantizer
+ * @param d           Vector dimension
+ * @param nlist       Number of inverted lists
+ * @param metric_type METRIC_L2 or METRIC_INNER_PRODUCT
+ * @param bbs         Database block size (multiple of 32)
+ * @param nb_bits     Bits per dimension (1 to 9)
  * @return 0 on success, -1 on error
  */
-int faiss_IndexPQ_new(
-    FaissIndex* p_index,
-    int64_t d,
-    int64_t M,
-    int64_t nbits,
-    int metric_type);
+int faiss_IndexIVFRaBitQFastScan_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int metric_type, int bbs, int nb_bits);
 
 /**
- * Create a new IndexIVFPQ.
+ * Get the bits per dimension of a RaBitQ index (or of the base of an
+ * IndexRefine over one).
+ */
+int faiss_RaBitQ_get_nb_bits(FaissIndex index, int* nb_bits);
+
+/**
+ * Get the default query parameters of a RaBitQ index.
+ *
+ * @param index    The RaBitQ index, or an IndexRefine over one
+ * @param qb       Output: bits per query component
+ * @param centered Output: 1 if queries use the zero-centered quantizer
+ * @return 0 on success, -1 on error
+ */
+int faiss_RaBitQ_get_query_params(FaissIndex index, int* qb, int* centered);
+
+/**
+ * Set the default query parameters of a RaBitQ index. Negative values
+ * keep the current setting. IndexIVFRaBitQ only accepts centered per
+ * search. Plain searches of the index must not run concurrently with
+ * this call.
+ *
+ * @param index    The RaBitQ index, or an IndexRefine over one
+ * @param qb       Bits per query component (0-8)
+ * @param centered 0 / 1
+ * @return 0 on success, -1 on error
+ */
+int faiss_RaBitQ_set_query_params(FaissIndex index, int qb, int centered);
+
+/**
+ * Search a RaBitQ index, or an IndexRefine / IndexRefineFlat whose base
+ * is one, with per-call parameters. The fast-scan variants, which read
+ * qb / centered from the index only, are searched through a per-call
+ * copy, so the call can run concurrently with other searches.
+ *
+ * @param index     The index
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param params    Search parameters, NULL for the index defaults
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_RaBitQ_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissRaBitQSearchParams* params, float* distances, int64_t* labels);
+
+/**
+ * Get the global RaBitQ statistics. They are only collected by multi-bit
+ * indexes and are not exact under concurrent searches.
+ *
+ * @param n_1bit_evaluations     Output: candidates scored with the 1-bit bound
+ * @param n_multibit_evaluations Output: candidates that needed the full distance
+ * @param skip_percentage        Output: percentage filtered by the 1-bit bound
+ * @return 0 on success, -1 on error
+ */
+int faiss_RaBitQStats_get(size_t* n_1bit_evaluations, size_t* n_multibit_evaluations, double* skip_percentage);
+
+/**
+ * Reset the global RaBitQ statistics.
+ */
+void faiss_RaBitQStats_reset(void);
+
+/* ============================================================
+ * Panorama Extensions
+ *
+ * Panorama indexes split the dimensions into n_levels contiguous levels
+ * and prune candidates level by level with Cauchy-Schwarz bounds on the
+ * remaining energy. They pay off with an orthogonal transform (PCA, ...)
+ * upstream that concentrates the energy in the first dimensions. L2 only.
+ * ============================================================ */
+
+/**
+ * Create a new IndexIVFFlatPanorama. The quantizer is not owned, use
+ * faiss_IndexIVF_set_own_fields to transfer it.
  *
  * @param p_index   Output pointer to the new index
- * @param quantizer The quantizer index
- * @param d         Dimension of vectors
+ * @param quantizer Coarse quantizer
+ * @param d         Vector dimension
  * @param nlist     Number of inverted lists
- * @param M         Number of subquantizers
- * @param nbits     Number of bits per subquantizer code
+ * @param n_levels  Number of Panorama levels
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIVFFlatPanorama_new(FaissIndex* p_index, FaissIndex quantizer, int64_t d, int64_t nlist, int n_levels);
+
+/**
+ * Create a new IndexHNSWFlatPanorama.
+ *
+ * @param p_index  Output pointer to the new index
+ * @param d        Vector dimension
+ * @param M        Number of neighbors per node
+ * @param n_levels Number of Panorama levels
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexHNSWFlatPanorama_new(FaissIndex* p_index, int d, int M, int n_levels);
+
+/**
+ * Create a new IndexFlatL2Panorama, usable as the refine index of an
+ * IndexRefinePanorama.
+ *
+ * @param p_index    Output pointer to the new index
+ * @param d          Vector dimension
+ * @param n_levels   Number of Panorama levels
+ * @param batch_size Vectors per level-major storage batch
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexFlatL2Panorama_new(FaissIndex* p_index, int64_t d, int n_levels, int64_t batch_size);
+
+/**
+ * Create a new IndexRefinePanorama, which reranks the base results with
+ * the refine index's search_subset (Panorama pruning for
+ * IndexFlatL2Panorama, which must then use batch_size 1). Neither index
+ * is owned.
+ *
+ * @param p_index      Output pointer to the new index
+ * @param base_index   Index producing the candidates
+ * @param refine_index Index used to rerank them
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexRefinePanorama_new(FaissIndex* p_index, FaissIndex base_index, FaissIndex refine_index);
+
+/**
+ * Get the number of Panorama levels of an IVFFlat, HNSWFlat or FlatL2
+ * Panorama index.
+ */
+int faiss_Panorama_get_n_levels(FaissIndex index, int* n_levels);
+
+/**
+ * Get the storage batch size of an IVFFlat or FlatL2 Panorama index. It is
+ * fixed at construction (a FAISS constant for IVFFlat); HNSW Panorama
+ * indexes have no batches and return -1.
+ */
+int faiss_Panorama_get_batch_size(FaissIndex index, int64_t* batch_size);
+
+/**
+ * Convert an L2 IndexIVFFlat or IndexHNSWFlat to its Panorama variant,
+ * taking over the quantizer or graph and the stored vectors instead of
+ * re-adding raw data; the cumulative sums are computed in parallel. IVF
+ * lists are copied before the source ones are released, so the peak
+ * memory is two copies of the vectors.
+ * On success *p_index is replaced by the new index and the old one is
+ * freed, so it must not be referenced elsewhere (shards, replicas, ...).
+ * On failure *p_index is left unchanged.
+ *
+ * @param p_index  In: the index to convert; out: the Panorama index
+ * @param n_levels Number of Panorama levels
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_to_panorama_ext(FaissIndex* p_index, int n_levels);
+
+/**
+ * Get the global Panorama statistics, updated by the IVFFlat and FlatL2
+ * Panorama searches (FAISS does not count the HNSW ones). They are not
+ * exact under concurrent searches.
+ *
+ * @param total_dims_scanned Output: dimensions actually scanned
+ * @param total_dims         Output: dimensions a full scan would touch
+ * @param ratio_dims_scanned Output: total_dims_scanned / total_dims
+ * @return 0 on success, -1 on error
+ */
+int faiss_PanoramaStats_get(uint64_t* total_dims_scanned, uint64_t* total_dims, float* ratio_dims_scanned);
+
+/**
+ * Reset the global Panorama statistics.
+ */
+void faiss_PanoramaStats_reset(void);
+
+/* ============================================================
+ * Flat Search Extensions
+ * ============================================================ */
+
+/**
+ * Search an IndexFlat (L2 or IP, d <= 2048) with the fused kernels: dot
+ * products are register-blocked and merged straight into the per-query
+ * top-k heaps instead of going through BLAS distance tiles. Falls back to
+ * the regular search for other metrics, larger d or Panorama storage.
+ *
+ * @param index     The IndexFlat
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param query_bs  Queries per task, 0 for automatic
+ * @param db_bs     Database vectors per cache tile, 0 for automatic
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexFlat_search_fused_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int64_t query_bs, int64_t db_bs, float* distances, int64_t* labels);
+
+/** Per-call counterpart of the FAISS distance_compute_* globals (BLAS /
+ *  SIMD crossover and tile sizes), negative values use the process
+ *  default. Initialize with faiss_BlasParams_init. */
+typedef struct FaissBlasParams {
+    int blas_threshold;  /* queries from which BLAS tiles are used */
+    int query_bs;        /* queries per BLAS tile */
+    int database_bs;     /* database vectors per BLAS tile */
+    int min_k_reservoir; /* k from which a reservoir replaces the heap */
+} FaissBlasParams;
+
+/**
+ * Reset BLAS parameters to "use the process defaults".
+ */
+void faiss_BlasParams_init(FaissBlasParams* params);
+
+/**
+ * Get the process defaults (the FAISS globals used by all searches that
+ * do not override them).
+ */
+int faiss_get_blas_params(FaissBlasParams* params);
+
+/**
+ * Set the process defaults from the non-negative fields of params. This
+ * affects every search in the process, including concurrent ones.
+ */
+int faiss_set_blas_params(const FaissBlasParams* params);
+
+/**
+ * Search an IndexFlatL2 / IndexFlatIP with explicit BLAS parameters
+ * instead of the process defaults. Other metrics use the regular search.
+ *
+ * @param index     The IndexFlat
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param blas      BLAS parameters, NULL for the process defaults
+ * @param params    Optional search parameters (only the selector is used), may be NULL
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexFlat_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/**
+ * Search an IndexIVF whose coarse assignment uses explicit BLAS
+ * parameters when the quantizer is a flat L2 / IP index.
+ *
+ * @param index     The IndexIVF
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param blas      BLAS parameters for the coarse assignment, NULL for the process defaults
+ * @param params    Optional SearchParametersIVF, may be NULL
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIVF_search_blas_ext(FaissIndex index, int64_t n, const float* x, int64_t k, const FaissBlasParams* blas, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/**
+ * Measure the BLAS / SIMD crossover, the fastest tile sizes and the
+ * heap / reservoir crossover on the host CPU for vectors of dimension d
+ * (a few seconds of work). Meant to run once at startup.
+ *
+ * @param d       Vector dimension to calibrate for
+ * @param install If non-zero, make the result the process default
+ * @param result  Output: the measured parameters (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_blas_calibrate_ext(int64_t d, int install, FaissBlasParams* result);
+
+/* ============================================================
+ * IndexShards Extensions
+ * ============================================================ */
+
+/**
+ * Search an IndexShards with a shared thread budget: at most n_threads
+ * shards run at once, each with its share of the OpenMP threads, and the
+ * sorted per-shard results are merged pairwise. With a deadline, the
+ * results of the shards completed in time are returned and *partial is
+ * set. Deadline searches run on a persistent pool of the index, capped at
+ * the largest budget requested; the late shards finish there and, until
+ * they do, new searches of the index fail. Call faiss_IndexShards_wait_ext
+ * before freeing an index searched with a deadline.
+ *
+ * @param index       The IndexShards
+ * @param n           Number of query vectors
+ * @param x           Query vectors (n * d floats)
+ * @param k           Number of nearest neighbors
+ * @param n_threads   Total thread budget, 0 for the OpenMP default
+ * @param deadline_ms Time limit in milliseconds, 0 to wait for all shards
+ * @param distances   Output distances (n * k floats)
+ * @param labels      Output labels (n * k int64_t)
+ * @param n_completed Output: number of shards merged (may be NULL)
+ * @param partial     Output: 1 if some shards missed the deadline (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexShards_search_ext(FaissIndex index, int64_t n, const float* x, int64_t k, int n_threads, double deadline_ms, float* distances, int64_t* labels, int* n_completed, int* partial);
+
+/**
+ * Wait until the shard searches left running by a deadline are done and
+ * stop the worker pool of the index.
+ *
+ * @param index The IndexShards
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexShards_wait_ext(FaissIndex index);
+
+/* ============================================================
+ * Replica Routing Extensions
+ * ============================================================ */
+
+/**
+ * Get the number of NUMA nodes with CPUs (1 on non-NUMA hosts). Setting
+ * FAISS_GO_EXT_NUMA_NODES=N in the environment emulates N nodes.
+ *
+ * @param n_nodes Output: number of nodes
+ * @return 0 on success, -1 on error
+ */
+int faiss_numa_num_nodes(int* n_nodes);
+
+/**
+ * Create a load-aware router over the replicas of an IndexReplicas. Each
+ * replica gets a worker thread and a queue: batches of up to small_batch
+ * queries go to the replica with the fewest queued requests, larger ones
+ * are split in proportion to how idle each replica is. The IndexReplicas
+ * is not owned and must outlive the router.
+ *
+ * @param p_router    Output pointer to the new router
+ * @param replicas    The IndexReplicas
+ * @param small_batch Largest batch sent to a single replica
+ * @param nodes       NUMA node to pin each replica's worker and OpenMP
+ *                    team to (one entry per replica, -1 = not pinned), may be NULL
+ * @return 0 on success, -1 on error
+ */
+int faiss_ReplicaRouter_new(FaissReplicaRouter* p_router, FaissIndex replicas, int64_t small_batch, const int* nodes);
+
+/**
+ * Search through the router. Safe to call from several threads.
+ *
+ * @param router    The router
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_ReplicaRouter_search(FaissReplicaRouter router, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Get the number of requests queued or running on a replica.
+ */
+int faiss_ReplicaRouter_queue_depth(FaissReplicaRouter router, int replica, int* depth);
+
+/**
+ * Stop the worker threads and free the router. Pending searches finish first.
+ */
+void faiss_ReplicaRouter_free(FaissReplicaRouter router);
+
+/* ============================================================
+ * NUMA Placement Extensions
+ * ============================================================ */
+
+/** How index memory is spread over NUMA nodes */
+typedef enum FaissNumaPolicy {
+    FAISS_NUMA_BIND = 0,       /**< all pages on the first listed node */
+    FAISS_NUMA_INTERLEAVE = 1, /**< pages round-robin over the listed nodes */
+} FaissNumaPolicy;
+
+/**
+ * Move the memory of an index (IVF inverted lists and quantizer, flat
+ * codes, HNSW storage and graph, through IDMap / PreTransform / Refine
+ * wrappers) to NUMA nodes. Pages are moved with mbind(2); where it is not
+ * available the buffers are copied from a thread pinned to the target
+ * node instead. The index must not be searched during the call.
+ *
+ * @param index      The index
+ * @param policy     One of FaissNumaPolicy
+ * @param nodes      Nodes to use (0 .. faiss_numa_num_nodes() - 1), may be NULL for all nodes
+ * @param n_nodes    Number of entries in nodes
+ * @param n_bytes    Output: bytes of index data placed (may be NULL)
+ * @param used_mbind Output: 1 if mbind was used, 0 for the copy fallback (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_numa_place_ext(FaissIndex index, int policy, const int* nodes, int n_nodes, int64_t* n_bytes, int* used_mbind);
+
+/**
+ * Count the resident pages of the index data per OS NUMA node number.
+ *
+ * @param index          The index
+ * @param pages_per_node Output: page counts, max_nodes entries
+ * @param max_nodes      Size of pages_per_node
+ * @param n_nodes        Output: number of entries filled (highest node + 1)
+ * @return 0 on success, -1 on error or if the host cannot report page locations
+ */
+int faiss_Index_numa_pages_ext(FaissIndex index, int64_t* pages_per_node, int max_nodes, int* n_nodes);
+
+/**
+ * Search from a worker thread pinned to a NUMA node, so the OpenMP team of
+ * the search runs on that node's CPUs. Calls for the same node are
+ * serialized.
+ *
+ * @param index     The index
+ * @param node      Node to run on (0 .. faiss_numa_num_nodes() - 1)
+ * @param n         Number of query vectors
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of nearest neighbors
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_search_on_node_ext(FaissIndex index, int node, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Build an IndexReplicas holding one copy of index per NUMA node, each
+ * cloned on and bound to its node: replica i lives on node i. Pass nodes
+ * {0, 1, ...} to faiss_ReplicaRouter_new to search each replica from its
+ * own node. The source index is not modified.
+ *
+ * @param index      The index to replicate
+ * @param p_replicas Output pointer to the new IndexReplicas (owns the copies)
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_replicate_per_node_ext(FaissIndex index, FaissIndex* p_replicas);
+
+/**
+ * Read an index file once and replicate it per NUMA node as
+ * faiss_Index_replicate_per_node_ext does.
+ *
+ * @param fname      Index file
+ * @param io_flags   FAISS IO flags
+ * @param p_replicas Output pointer to the new IndexReplicas (owns the copies)
+ * @return 0 on success, -1 on error
+ */
+int faiss_read_index_per_node_ext(const char* fname, int io_flags, FaissIndex* p_replicas);
+
+/* ============================================================
+ * IDMap3 Extensions
+ * ============================================================ */
+
+/**
+ * Create an IndexIDMap3: an IDMap whose reverse lookup (reconstruct by id)
+ * uses sorted id arrays instead of a hash map, 24 bytes per vector in
+ * total. Same semantics as IndexIDMap2. Use faiss_write_index_ext /
+ * faiss_read_index_ext to store it; with IO_FLAG_MMAP_IFC the arrays are
+ * mapped from the file instead of loaded. Adds keep the new ids in sorted
+ * runs merged geometrically into the arrays, O(log ntotal) amortized per
+ * id; the first add to a mapped index copies its id arrays.
+ *
+ * @param p_index    Output pointer to the new index
+ * @param base_index The sub-index (must be empty), not owned unless
+ *                   faiss_IndexIDMap3_set_own_fields is called
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIDMap3_new(FaissIndex* p_index, FaissIndex base_index);
+
+/**
+ * Set whether the IndexIDMap3 deletes its sub-index.
+ */
+int faiss_IndexIDMap3_set_own_fields(FaissIndex index, int own_fields);
+
+/**
+ * Get the sub-index of an IndexIDMap3.
+ */
+int faiss_IndexIDMap3_get_index(FaissIndex index, FaissIndex* p_sub_index);
+
+/**
+ * Look up the positions of ids in the sub-index.
+ *
+ * @param index     The IndexIDMap3
+ * @param n         Number of ids
+ * @param ids       Ids to look up
+ * @param positions Output positions (n int64_t, -1 for absent ids)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIDMap3_find(FaissIndex index, int64_t n, const int64_t* ids, int64_t* positions);
+
+/**
+ * Convert an IndexIDMap / IndexIDMap2 to an IndexIDMap3 in place. The sub-index
+ * is taken over (and owned if it was), and the old wrapper is freed.
+ *
+ * @param p_index In: the IDMap, out: the new IndexIDMap3
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIDMap3_from_idmap_ext(FaissIndex* p_index);
+
+/**
+ * Same as faiss_index_factory, but also accepts a leading "IDMap3,"
+ * component (for example "IDMap3,IVF1024,Flat").
+ *
+ * @return 0 on success, -1 on error
+ */
+int faiss_index_factory_ext(FaissIndex* p_index, int d, const char* description, int metric_type);
+
+/**
+ * Same as faiss_write_index_fname, also for IndexIDMap3 and IndexHNSWWide.
+ *
+ * @return 0 on success, -1 on error
+ */
+int faiss_write_index_ext(FaissIndex index, const char* fname);
+
+/**
+ * Same as faiss_read_index_fname, also for IndexIDMap3 and IndexHNSWWide.
+ * With IO_FLAG_MMAP_IFC their id arrays and graph links are views of the
+ * file, copied when the index is next added to.
+ *
+ * @param fname    Index file
+ * @param io_flags FAISS IO flags
+ * @param p_index  Output pointer to the index
+ * @return 0 on success, -1 on error
+ */
+int faiss_read_index_ext(const char* fname, int io_flags, FaissIndex* p_index);
+
+/* ============================================================
+ * IVF Id Table Extensions
+ * ============================================================ */
+
+/**
+ * Build an id table for an IVF index: an open-addressing hash table from
+ * ids to inverted list entries, the compact alternative to
+ * DirectMap::Hashtable for reconstruct and update by id. The table is not
+ * attached to the index: use the faiss_IVFIdTable_* functions to add and
+ * update vectors, and rebuild it after any other change to the index.
+ *
+ * @param p_table Output pointer to the new table
+ * @param index   The IVF index
+ * @param build_ms Output: build time in milliseconds (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFIdTable_new(FaissIVFIdTable* p_table, FaissIndex index, double* build_ms);
+
+/**
+ * Look up the inverted list entries of ids.
+ *
+ * @param table    The table
+ * @param n        Number of ids
+ * @param ids      Ids to look up
+ * @param list_nos Output list numbers (n int64_t, -1 for absent ids)
+ * @param offsets  Output offsets in the lists (n int64_t, -1 for absent ids)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFIdTable_lookup(FaissIVFIdTable table, int64_t n, const int64_t* ids, int64_t* list_nos, int64_t* offsets);
+
+/**
+ * Reconstruct vectors by id.
+ *
+ * @param table  The table
+ * @param index  The IVF index the table was built from
+ * @param n      Number of ids
+ * @param ids    Ids to reconstruct
+ * @param recons Output vectors (n * d floats)
+ * @return 0 on success, -1 on error (including unknown ids)
+ */
+int faiss_IVFIdTable_reconstruct(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, float* recons);
+
+/**
+ * Add vectors to the IVF index and record them in the table.
+ *
+ * @param table The table
+ * @param index The IVF index
+ * @param n     Number of vectors
+ * @param x     Vectors (n * d floats)
+ * @param ids   Ids of the vectors (NULL for sequential ids)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFIdTable_add_with_ids(FaissIVFIdTable table, FaissIndex index, int64_t n, const float* x, const int64_t* ids);
+
+/**
+ * Replace the vectors of existing ids (IndexIVF::update_vectors without a
+ * DirectMap on the index).
+ *
+ * @param table The table
+ * @param index The IVF index
+ * @param n     Number of vectors
+ * @param ids   Ids of the vectors to replace
+ * @param x     New vectors (n * d floats)
+ * @return 0 on success, -1 on error (including unknown ids)
+ */
+int faiss_IVFIdTable_update_vectors(FaissIVFIdTable table, FaissIndex index, int64_t n, const int64_t* ids, const float* x);
+
+/**
+ * Get the size and memory usage of the table.
+ *
+ * @param table    The table
+ * @param size     Output: number of ids
+ * @param capacity Output: number of slots
+ * @param bytes    Output: memory used by the slots
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFIdTable_stats(FaissIVFIdTable table, int64_t* size, int64_t* capacity, int64_t* bytes);
+
+/**
+ * Write the table to a file.
+ */
+int faiss_IVFIdTable_write(FaissIVFIdTable table, const char* fname);
+
+/**
+ * Read a table file. With mmap set the slots are a view of the file,
+ * copied on the first add or update.
+ *
+ * @param p_table Output pointer to the table
+ * @param fname   Table file
+ * @param mmap    1 to map the file instead of reading it
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFIdTable_read(FaissIVFIdTable* p_table, const char* fname, int mmap);
+
+/**
+ * Free an id table.
+ */
+void faiss_IVFIdTable_free(FaissIVFIdTable table);
+
+/**
+ * Set the DirectMap type of an IVF index (0 = NoMap, 1 = Array,
+ * 2 = Hashtable), reporting how long the build took.
+ *
+ * @param index    The IVF index
+ * @param type     DirectMap type
+ * @param build_ms Output: build time in milliseconds (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIVF_make_direct_map_ext(FaissIndex index, int type, double* build_ms);
+
+/**
+ * Get the type and estimated heap usage of the DirectMap of an IVF index.
+ *
+ * @param index The IVF index
+ * @param type  Output: DirectMap type
+ * @param bytes Output: estimated bytes used by the map
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexIVF_direct_map_stats_ext(FaissIndex index, int* type, int64_t* bytes);
+
+/* ============================================================
+ * IVF Tombstone Extensions
+ * ============================================================ */
+
+/**
+ * Create a deferred-delete wrapper for an IVF index (not owned). Deletes
+ * through it only mark ids, searches through it skip the marked ids, and
+ * faiss_IVFTombstones_compact removes them from the inverted lists. With
+ * a Hashtable DirectMap on the index only the lists holding deleted ids
+ * are visited; Array DirectMaps are not supported.
+ *
+ * @param p_ts  Output pointer to the wrapper
+ * @param index The IVF index
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_new(FaissIVFTombstones* p_ts, FaissIndex index);
+
+/**
+ * Mark ids as deleted.
+ *
+ * @param ts        The wrapper
+ * @param n         Number of ids
+ * @param ids       Ids to delete
+ * @param n_deleted Output: number of ids newly deleted (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_delete(FaissIVFTombstones ts, int64_t n, const int64_t* ids, int64_t* n_deleted);
+
+/**
+ * Search the index, skipping deleted ids.
+ *
+ * @param ts        The wrapper
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param params    IVF search parameters (may be NULL); a selector in them
+ *                  is combined with the deletes
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_search(FaissIVFTombstones ts, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/**
+ * Range search the index, skipping deleted ids.
+ *
+ * @param ts     The wrapper
+ * @param n      Number of queries
+ * @param x      Query vectors (n * d floats)
+ * @param radius Search radius
+ * @param params IVF search parameters (may be NULL)
+ * @param result Range search result for n queries
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_range_search(FaissIVFTombstones ts, int64_t n, const float* x, float radius, FaissSearchParameters params, FaissRangeSearchResult result);
+
+/**
+ * Add vectors to the index. Pending deletes are compacted first if one of
+ * the ids is deleted but not compacted yet.
+ *
+ * @param ts  The wrapper
+ * @param n   Number of vectors
+ * @param x   Vectors (n * d floats)
+ * @param ids Ids of the vectors (NULL for sequential ids)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_add_with_ids(FaissIVFTombstones ts, int64_t n, const float* x, const int64_t* ids);
+
+/**
+ * Remove the deleted entries from the inverted lists, lists_per_batch
+ * lists at a time; searches run between batches.
+ *
+ * @param ts              The wrapper
+ * @param lists_per_batch Lists rewritten per batch (<= 0 for the default, 64)
+ * @param n_removed       Output: number of entries removed (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_compact(FaissIVFTombstones ts, int64_t lists_per_batch, int64_t* n_removed);
+
+/**
+ * Get the deletion counters.
+ *
+ * @param ts              The wrapper
+ * @param n_pending       Output: deleted ids not compacted yet
+ * @param n_dirty_lists   Output: lists holding them, -1 if unknown (no DirectMap)
+ * @param n_compacted     Output: entries removed by compaction so far
+ * @param last_compact_ms Output: duration of the last compaction
+ * @return 0 on success, -1 on error
+ */
+int faiss_IVFTombstones_stats(FaissIVFTombstones ts, int64_t* n_pending, int64_t* n_dirty_lists, int64_t* n_compacted, double* last_compact_ms);
+
+/**
+ * Free the wrapper (the index is not freed).
+ */
+void faiss_IVFTombstones_free(FaissIVFTombstones ts);
+
+/* ============================================================
+ * Range Search Arena Extensions
+ * ============================================================ */
+
+/**
+ * Create a range search arena: result arrays kept between range searches
+ * and grown only when a larger result arrives.
+ *
+ * @param p_arena Output pointer to the arena
+ * @return 0 on success, -1 on error
+ */
+int faiss_RangeSearchArena_new(FaissRangeSearchArena* p_arena);
+
+/**
+ * Grow the arena to hold n results ahead of the searches.
+ *
+ * @param arena The arena
+ * @param n     Number of results
+ * @return 0 on success, -1 on error
+ */
+int faiss_RangeSearchArena_reserve(FaissRangeSearchArena arena, int64_t n);
+
+/**
+ * Range search into caller buffers or, when the results do not fit, into
+ * the arena. The results are written once, with no allocation once the
+ * arena is large enough. With max_per_query > 0 only the closest
+ * max_per_query results of each query are kept; IVF indexes stop scanning
+ * a query once it has that many (the closest among those scanned).
+ *
+ * For count-then-fill, call with capacity 0, size the buffers from total
+ * and copy the results with faiss_RangeSearchArena_copy_to.
+ *
+ * @param index         The index
+ * @param n             Number of queries
+ * @param x             Query vectors (n * d floats)
+ * @param radius        Search radius
+ * @param params        Search parameters (may be NULL)
+ * @param max_per_query Cap on results per query (0 = none)
+ * @param arena         The arena; holds lims and, if not in_output, the results
+ * @param labels        Caller labels buffer (may be NULL)
+ * @param distances     Caller distances buffer (may be NULL)
+ * @param capacity      Entries of the caller buffers
+ * @param total         Output: number of results
+ * @param in_output     Output: 1 if the results were written to the caller buffers
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_range_search_arena_ext(FaissIndex index, int64_t n, const float* x, float radius, FaissSearchParameters params, int64_t max_per_query, FaissRangeSearchArena arena, int64_t* labels, float* distances, int64_t capacity, int64_t* total, int* in_output);
+
+/**
+ * Get the results of the last search in place (valid until the next
+ * search with the arena). labels and distances are NULL if the results
+ * went to the caller buffers.
+ *
+ * @param arena     The arena
+ * @param nq        Output: number of queries
+ * @param lims      Output: result offsets (nq + 1)
+ * @param labels    Output: labels
+ * @param distances Output: distances
+ * @return 0 on success, -1 on error
+ */
+int faiss_RangeSearchArena_get(FaissRangeSearchArena arena, int64_t* nq, int64_t** lims, int64_t** labels, float** distances);
+
+/**
+ * Copy the results of the last search out. Each output may be NULL.
+ *
+ * @param arena     The arena
+ * @param lims      Output offsets (nq + 1 int64_t)
+ * @param labels    Output labels (total int64_t)
+ * @param distances Output distances (total floats)
+ * @return 0 on success, -1 on error
+ */
+int faiss_RangeSearchArena_copy_to(FaissRangeSearchArena arena, int64_t* lims, int64_t* labels, float* distances);
+
+/**
+ * Get the arena size and how often it grew.
+ *
+ * @param arena         The arena
+ * @param capacity      Output: results the arena holds
+ * @param n_allocations Output: times the arena storage grew
+ * @return 0 on success, -1 on error
+ */
+int faiss_RangeSearchArena_stats(FaissRangeSearchArena arena, int64_t* capacity, int64_t* n_allocations);
+
+/**
+ * Free an arena.
+ */
+void faiss_RangeSearchArena_free(FaissRangeSearchArena arena);
+
+/* ============================================================
+ * Search Context Extensions
+ * ============================================================ */
+
+/**
+ * Create a search context: the HNSW visited table and IVF coarse buffers
+ * kept between searches, so that steady-state searches do not allocate
+ * or clear them. A context serves one thread at a time.
+ *
+ * @param p_ctx Output pointer to the context
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchContext_new(FaissSearchContext* p_ctx);
+
+/**
+ * Search with the scratch of a context. HNSW queries run on the calling
+ * thread; IVF batches still use the OpenMP threads. Other indexes search
+ * as usual.
+ *
+ * @param index     The index
+ * @param ctx       The context, or NULL for the calling thread's own
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param params    Search parameters (may be NULL)
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_search_ctx_ext(FaissIndex index, FaissSearchContext ctx, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/**
+ * Get the memory held by a context and how often its buffers grew.
+ *
+ * @param ctx        The context, or NULL for the calling thread's own
+ * @param bytes      Output: bytes held by the buffers
+ * @param n_grows    Output: times a buffer was allocated or grown
+ * @param n_searches Output: searches made with the context
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchContext_stats(FaissSearchContext ctx, int64_t* bytes, int64_t* n_grows, int64_t* n_searches);
+
+/**
+ * Release the buffers of a context (NULL for the calling thread's own).
+ */
+int faiss_SearchContext_reset(FaissSearchContext ctx);
+
+/**
+ * Free a search context.
+ */
+void faiss_SearchContext_free(FaissSearchContext ctx);
+
+/* ============================================================
+ * HNSW Wide Extensions
+ * ============================================================ */
+
+/**
+ * Create an IndexHNSWWide: an HNSW graph with 64-bit node ids, chunked
+ * link storage and a sparse visited set per search, for graphs past 2^31
+ * nodes. Search, add, write_index_ext/read_index_ext work as for other
+ * indexes; "HNSWWide32,Flat" builds one with faiss_index_factory_ext.
+ *
+ * @param p_index Output pointer to the new index
+ * @param storage Empty index holding the vectors (e.g. IndexFlat); not
+ *                owned unless faiss_IndexHNSWWide_set_own_fields is called
+ * @param M       Links per node on the upper levels (2 * M on level 0)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexHNSWWide_new(FaissIndex* p_index, FaissIndex storage, int M);
+
+/**
+ * Set whether the IndexHNSWWide deletes its storage.
+ */
+int faiss_IndexHNSWWide_set_own_fields(FaissIndex index, int own_fields);
+
+/**
+ * Set the beam widths of an IndexHNSWWide.
+ *
+ * @param index           The IndexHNSWWide
+ * @param ef_construction Beam width when adding (<= 0 keeps the current)
+ * @param ef_search       Default beam width when searching (<= 0 keeps the current)
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexHNSWWide_set_ef(FaissIndex index, int ef_construction, int ef_search);
+
+/**
+ * Get the graph size of an IndexHNSWWide.
+ *
+ * @param index       The IndexHNSWWide
+ * @param graph_bytes Output: bytes of links and level table, storage excluded
+ * @param max_level   Output: top level of the graph (-1 if empty)
+ * @param n_upper     Output: nodes with links above level 0
+ * @return 0 on success, -1 on error
+ */
+int faiss_IndexHNSWWide_stats(FaissIndex index, int64_t* graph_bytes, int* max_level, int64_t* n_upper);
+
+/* ============================================================
+ * Graph Search Extensions
+ * ============================================================ */
+
+/**
+ * Create search parameters for faiss_Index_search_graph_ext.
+ *
+ * @param p_params     Output pointer to the parameters
+ * @param ef           Beam width; 0 keeps efSearch (HNSW) or search_L (NSG, NNDescent)
+ * @param visited_mode Visited set: 0 = chosen from ntotal and ef,
+ *                     1 = dense (one byte per node), 2 = sparse (hash set)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchParametersGraph_new(FaissSearchParameters* p_params, int ef, int visited_mode);
+
+/**
+ * Free parameters made by faiss_SearchParametersGraph_new.
+ */
+void faiss_SearchParametersGraph_free(FaissSearchParameters params);
+
+/**
+ * Search an IndexHNSW, IndexNSG or IndexNNDescent with a visited set sized
+ * for the search rather than one byte per node; the set is sparse on large
+ * graphs unless params say otherwise. Other indexes search as usual.
+ *
+ * @param index     The index
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param params    SearchParametersGraph, SearchParametersHNSW or NULL
+ * @param distances Output distances (n * k floats)
+ * @param labels    Output labels (n * k int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_search_graph_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
+
+/* ============================================================
+ * Parallel Explore Extensions
+ * ============================================================ */
+
+/**
+ * Create a ParameterSpace.
+ *
+ * @param p_space Output pointer to the space
+ * @param index   Index whose default ranges are filled in (ParameterSpace::initialize), or NULL for none
+ * @return 0 on success, -1 on error
+ */
+int faiss_ParameterSpace_new_ext(FaissParameterSpace* p_space, FaissIndex index);
+
+/**
+ * Set the values of a parameter range, adding the range if needed.
+ * Values go from the cheapest to the most accurate.
+ *
+ * @param space  The space
+ * @param name   Parameter name ("nprobe", "efSearch", "k_factor_rf", "quantizer_efSearch", ...)
+ * @param values The values
+ * @param n      Number of values (> 0)
+ * @return 0 on success, -1 on error
+ */
+int faiss_ParameterSpace_set_range_ext(FaissParameterSpace space, const char* name, const double* values, size_t n);
+
+/**
+ * Free a ParameterSpace made by faiss_ParameterSpace_new_ext.
+ */
+void faiss_ParameterSpace_free_ext(FaissParameterSpace space);
+
+/**
+ * Explore the combinations of a space, n_threads combinations at a time,
+ * each searching on one thread with SearchParameters (the index is not
+ * modified). Combinations beaten on the first n_subset queries by a
+ * faster one are not run on the full set. Spaces with parameters that
+ * have no SearchParameters form are explored one combination at a time
+ * with set_index_parameters, as ParameterSpace::explore does.
+ *
+ * @param space     The space
+ * @param index     The index
+ * @param nq        Number of queries
+ * @param xq        Query vectors (nq * d floats)
+ * @param gt_k      Ground-truth neighbors per query
+ * @param gt_I      Ground-truth labels (nq * gt_k int64_t)
+ * @param criterion 0 = 1-recall@R, 1 = intersection@R (needs gt_k >= R)
+ * @param R         Neighbors searched and evaluated
+ * @param n_threads Combinations run at once (0 = all threads)
+ * @param n_subset  Queries of the pruning pass (0 = nq / 10, -1 = no pruning)
+ * @param p_ops     Output: the operating points, free with faiss_OperatingPoints_free
+ * @param n_pruned  Output: combinations not run on all queries (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_ParameterSpace_explore_ext(FaissParameterSpace space, FaissIndex index, int64_t nq, const float* xq, int64_t gt_k, const int64_t* gt_I, int criterion, int64_t R, int n_threads, int64_t n_subset, FaissOperatingPoints* p_ops, int64_t* n_pruned);
+
+/**
+ * Number of operating points, all of them or the Pareto-optimal ones.
+ *
+ * @param ops          The operating points
+ * @param only_optimal 1 for the Pareto frontier (sorted by perf), 0 for all
+ * @param n            Output: the number of points
+ * @return 0 on success, -1 on error
+ */
+int faiss_OperatingPoints_size(FaissOperatingPoints ops, int only_optimal, size_t* n);
+
+/**
+ * Get one operating point.
+ *
+ * @param ops          The operating points
+ * @param only_optimal As for faiss_OperatingPoints_size
+ * @param i            Point number
+ * @param perf         Output: criterion value in [0, 1]
+ * @param t            Output: search time of the query set (ms)
+ * @param cno          Output: combination number
+ * @param key          Output: combination name, NUL-terminated and truncated to key_size (may be NULL)
+ * @param key_size     Size of key
+ * @return 0 on success, -1 on error
+ */
+int faiss_OperatingPoints_get(FaissOperatingPoints ops, int only_optimal, size_t i, double* perf, double* t, int64_t* cno, char* key, size_t key_size);
+
+/**
+ * Free operating points.
+ */
+void faiss_OperatingPoints_free(FaissOperatingPoints ops);
+
+/* ============================================================
+ * Search Controller Extensions
+ * ============================================================ */
+
+/**
+ * Create a controller that picks the search effort of each call so that
+ * the p95 latency of the calls stays under a target. The ladder of effort
+ * levels comes from the Pareto-optimal points of ops (which need the space
+ * they were explored on), from the values of a one-range space, or, with
+ * neither, from powers of two of nprobe (IVF) or efSearch (HNSW).
+ * The index is not modified and must outlive the controller.
+ *
+ * @param p_ctrl        Output pointer to the controller
+ * @param index         The index
+ * @param target_p95_ms Latency target of one search call (ms)
+ * @param space         Parameter space, or NULL for the default ladder
+ * @param ops           Operating points explored on space, or NULL
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_new(FaissSearchController* p_ctrl, FaissIndex index, double target_p95_ms, FaissParameterSpace space, FaissOperatingPoints ops);
+
+/**
+ * Search with the parameters of the current level and time the call.
+ *
+ * @param ctrl      The controller
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param distances Output distances (n * k)
+ * @param labels    Output labels (n * k)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_search(FaissSearchController ctrl, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Current state of the controller.
+ *
+ * @param ctrl     The controller
+ * @param level    Output: current level, 0 is the cheapest
+ * @param n_levels Output: number of levels
+ * @param p95_ms   Output: p95 of the calls at the current level, -1 if none (may be NULL)
+ * @param key      Output: parameters of the level, NUL-terminated and truncated to key_size (may be NULL)
+ * @param key_size Size of key
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_get_state(FaissSearchController ctrl, int* level, int* n_levels, double* p95_ms, char* key, size_t key_size);
+
+/**
+ * Change the latency target.
+ *
+ * @param ctrl          The controller
+ * @param target_p95_ms New target (ms, > 0)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_set_target(FaissSearchController ctrl, double target_p95_ms);
+
+/**
+ * Number of level changes kept in the history (the last 1024).
+ *
+ * @param ctrl The controller
+ * @param n    Output: number of changes
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_history_size(FaissSearchController ctrl, size_t* n);
+
+/**
+ * Get one level change, oldest first.
+ *
+ * @param ctrl    The controller
+ * @param i       Change number
+ * @param call    Output: search calls before the change
+ * @param time_ms Output: time of the change since the controller was created
+ * @param from    Output: level before
+ * @param to      Output: level after
+ * @param p95_ms  Output: p95 that triggered the change
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchController_get_history(FaissSearchController ctrl, size_t i, int64_t* call, double* time_ms, int* from, int* to, double* p95_ms);
+
+/**
+ * Free a controller.
+ */
+void faiss_SearchController_free(FaissSearchController ctrl);
+
+/* ============================================================
+ * Compiled Factory Extensions
+ *
+ * A compiled factory parses an index_factory description once and
+ * creates indexes by cloning the parsed, empty prototype.
+ * ============================================================ */
+
+/** One node of an index tree, see faiss_Index_describe_ext. */
+typedef struct FaissIndexNode {
+    int parent;        /* node number of the parent, -1 for the root */
+    char role[16];     /* relation to the parent: index, quantizer, storage, base, refine, transform, shard, replica */
+    char type[48];     /* class name, e.g. IndexIVFPQ */
+    int64_t d;         /* output dimension for transforms */
+    int64_t ntotal;
+    size_t code_size;  /* bytes per stored vector, 0 if not a codec */
+    int metric_type;
+    int is_trained;
+    int owned;         /* deleted with the parent */
+    size_t nlist;      /* IVF lists, 0 otherwise */
+    int M;             /* graph degree (HNSW M, NSG R, NNDescent K) or PQ sub-quantizers */
+    int nbits;         /* PQ / LSH / RaBitQ bits */
+    char qtype[24];    /* scalar quantizer type, e.g. SQ8 */
+} FaissIndexNode;
+
+/**
+ * Parse a description with faiss_index_factory_ext.
+ *
+ * @param p_factory   Output pointer to the factory
+ * @param d           Vector dimension
+ * @param description Factory string
+ * @param metric_type METRIC_L2 or METRIC_INNER_PRODUCT
+ * @return 0 on success, -1 on error
+ */
+int faiss_CompiledFactory_new(FaissCompiledFactory* p_factory, int d, const char* description, int metric_type);
+
+/**
+ * Use a copy of an index, without its vectors, as the prototype. Indexes
+ * created from it share its training (quantizer, codebooks, transforms).
+ *
+ * @param p_factory Output pointer to the factory
+ * @param index     The index, not modified
+ * @return 0 on success, -1 on error
+ */
+int faiss_CompiledFactory_from_index(FaissCompiledFactory* p_factory, FaissIndex index);
+
+/**
+ * Create an empty index. Safe to call from several threads.
+ *
+ * @param factory The factory
+ * @param p_index Output pointer to the new index, free with faiss_Index_free
+ * @return 0 on success, -1 on error
+ */
+int faiss_CompiledFactory_instantiate(FaissCompiledFactory factory, FaissIndex* p_index);
+
+/**
+ * Free a compiled factory.
+ */
+void faiss_CompiledFactory_free(FaissCompiledFactory factory);
+
+/**
+ * Factory string that rebuilds the structure of an index.
+ *
+ * @param index       The index
+ * @param description Output: the string, NUL-terminated and truncated to size (may be NULL)
+ * @param size        Size of description
+ * @param length      Output: length of the full string (may be NULL)
+ * @return 0 on success, -1 on error or if a component has no factory form
+ */
+int faiss_reverse_index_factory_ext(FaissIndex index, char* description, size_t size, size_t* length);
+
+/**
+ * Describe the tree of an index, parents before their children.
+ *
+ * @param index     The index
+ * @param nodes     Output nodes (may be NULL if max_nodes is 0)
+ * @param max_nodes Size of nodes
+ * @param n_nodes   Output: number of nodes of the tree, may exceed max_nodes
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_describe_ext(FaissIndex index, FaissIndexNode* nodes, size_t max_nodes, size_t* n_nodes);
+
+/* ============================================================
+ * Snapshot Index Extensions
+ *
+ * A snapshot index takes adds while it is searched: each add publishes
+ * a new read-only snapshot, searches use the snapshot current when they
+ * start and never wait for adds.
+ * ============================================================ */
+
+/**
+ * Create a snapshot index from a trained index: IndexFlatCodes, IVF on
+ * array inverted lists, or IDMap / IDMap2 / IDMap3 over either. The
+ * vectors of the index are copied, the index is not modified or kept.
+ *
+ * @param p_snap Output pointer to the snapshot index
+ * @param index  The index
+ * @return 0 on success, -1 on error
+ */
+int faiss_SnapshotIndex_new(FaissSnapshotIndex* p_snap, FaissIndex index);
+
+/**
+ * Add vectors and publish a new snapshot. Adds are serialized.
+ *
+ * @param snap The snapshot index
+ * @param n    Number of vectors
+ * @param x    Vectors (n * d floats)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SnapshotIndex_add(FaissSnapshotIndex snap, int64_t n, const float* x);
+
+/**
+ * Add vectors with ids (IDMap and IVF indexes) and publish a new snapshot.
+ *
+ * @param snap The snapshot index
+ * @param n    Number of vectors
+ * @param x    Vectors (n * d floats)
+ * @param ids  Ids (n int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SnapshotIndex_add_with_ids(FaissSnapshotIndex snap, int64_t n, const float* x, const int64_t* ids);
+
+/**
+ * Search the current snapshot.
+ *
+ * @param snap      The snapshot index
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param distances Output distances (n * k)
+ * @param labels    Output labels (n * k)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SnapshotIndex_search(FaissSnapshotIndex snap, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Take a reference to the current snapshot, as a read-only index that
+ * stays valid (and unchanged) until freed with faiss_Index_free, even
+ * after the snapshot index is freed.
+ *
+ * @param snap    The snapshot index
+ * @param p_index Output: the snapshot
+ * @param version Output: number of adds it includes (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SnapshotIndex_acquire(FaissSnapshotIndex snap, FaissIndex* p_index, uint64_t* version);
+
+/**
+ * Number of vectors in the current snapshot.
+ */
+int faiss_SnapshotIndex_ntotal(FaissSnapshotIndex snap, int64_t* ntotal);
+
+/**
+ * Free a snapshot index. Acquired snapshots stay valid.
+ */
+void faiss_SnapshotIndex_free(FaissSnapshotIndex snap);
+
+/* ============================================================
+ * Segmented Index Extensions
+ *
+ * A segmented index takes upserts and deletes while it is searched. Adds
+ * go to a small Flat or HNSW write segment; full write segments are
+ * sealed into IVF segments and merged in the background, deletes are
+ * tombstones applied at search time and purged by the merges.
+ * ============================================================ */
+
+/** One segment of a segmented index, see faiss_SegmentedIndex_segments. */
+typedef struct FaissSegmentInfo {
+    uint64_t number;
+    int state;          /* 0 write, 1 frozen (waiting to be sealed), 2 sealed */
+    int64_t ntotal;     /* vectors stored, deleted ones included */
+    int64_t n_deleted;  /* tombstones */
+} FaissSegmentInfo;
+
+/**
+ * Create a segmented index. Both templates are copied and emptied.
+ *
+ * @param p_index          Output pointer to the segmented index
+ * @param write_template   IndexFlat or IndexHNSW for the write segments
+ * @param segment_template Trained IndexIVF (array or fast-scan lists), possibly under an IndexPreTransform
+ * @param write_capacity   Vectors in the write segment before it is sealed
+ * @param max_segments     Sealed segments before the smallest ones are merged
+ * @param merge_factor     Segments merged at once (>= 2)
+ * @param purge_fraction   Deleted fraction that makes a segment be rewritten
+ * @param background       Seal and merge on a background thread (1) or in the add and remove calls (0)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SegmentedIndex_new(FaissSegmentedIndex* p_index, FaissIndex write_template, FaissIndex segment_template, int64_t write_capacity, size_t max_segments, size_t merge_factor, double purge_fraction, int background);
+
+/**
+ * Add vectors with ids (>= 0). Ids already in the index are replaced.
+ *
+ * @param index The segmented index
+ * @param n     Number of vectors
+ * @param x     Vectors (n * d floats)
+ * @param ids   Ids (n int64_t)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SegmentedIndex_add_with_ids(FaissSegmentedIndex index, int64_t n, const float* x, const int64_t* ids);
+
+/**
+ * Delete ids.
+ *
+ * @param index     The segmented index
+ * @param n         Number of ids
+ * @param ids       Ids (n int64_t)
+ * @param n_removed Output: ids that were in the index (may be NULL)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SegmentedIndex_remove(FaissSegmentedIndex index, int64_t n, const int64_t* ids, size_t* n_removed);
+
+/**
+ * Search all segments.
+ *
+ * @param index     The segmented index
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param distances Output distances (n * k)
+ * @param labels    Output labels (n * k)
+ * @return 0 on success, -1 on error
+ */
+int faiss_SegmentedIndex_search(FaissSegmentedIndex index, int64_t n, const float* x, int64_t k, float* distances, int64_t* labels);
+
+/**
+ * Search-time nprobe of the IVF segments and efSearch of HNSW write
+ * segments, 0 for the values of the templates.
+ */
+int faiss_SegmentedIndex_set_search_params(FaissSegmentedIndex index, int nprobe, int efSearch);
+
+/**
+ * Seal the write segment and wait for the pending seals and merges.
+ * Fails if a background seal or merge failed since the last flush.
+ */
+int faiss_SegmentedIndex_flush(FaissSegmentedIndex index);
+
+/**
+ * Number of vectors that are not deleted.
+ */
+int faiss_SegmentedIndex_ntotal(FaissSegmentedIndex index, int64_t* ntotal);
+
+/**
+ * List the segments, oldest first, the write segment last.
+ *
+ * @param index      The segmented index
+ * @param infos      Output segments (may be NULL if max_infos is 0)
+ * @param max_infos  Size of infos
+ * @param n_segments Output: number of segments, may exceed max_infos
+ * @return 0 on success, -1 on error
+ */
+int faiss_SegmentedIndex_segments(FaissSegmentedIndex index, FaissSegmentInfo* infos, size_t max_infos, size_t* n_segments);
+
+/**
+ * Free a segmented index, after the running background task is done.
+ */
+void faiss_SegmentedIndex_free(FaissSegmentedIndex index);
+
+/* ============================================================
+ * Parallel Clone Extensions
+ *
+ * Alternatives to faiss_clone_index and faiss_merge_into for IVF indexes
+ * that avoid serialize/deserialize round trips: a clone whose inverted
+ * lists are copied in parallel, a copy-on-write clone that shares them,
+ * and a merge of several shards in one parallel pass over the lists.
+ * ============================================================ */
+
+/**
+ * Deep copy of an index, the inverted lists of IVF indexes are copied by
+ * several threads. Other indexes are copied as by faiss_clone_index.
+ *
+ * @param index     Index to copy
+ * @param p_out     Output: the copy
+ * @param n_threads Threads copying the lists (0 for the default)
+ * @return 0 on success, -1 on error
+ */
+int faiss_clone_index_parallel(FaissIndex index, FaissIndex* p_out, int n_threads);
+
+/**
+ * Copy of an index that shares the list codes of its IVF index on array
+ * lists (the ids are copied). Each index copies the codes of a list the
+ * first time it modifies the list. index must own its inverted lists and
+ * must not be used by other threads during the call. Copy either index
+ * with faiss_clone_index_parallel or faiss_clone_index_shallow afterwards,
+ * not faiss_clone_index.
+ *
+ * @param index     Index to copy
+ * @param p_out     Output: the copy
+ * @return 0 on success, -1 on error
+ */
+int faiss_clone_index_shallow(FaissIndex index, FaissIndex* p_out);
+
+/**
+ * Merge n IVF indexes into dst in one pass over the inverted lists, the
+ * sources are left empty and their lists freed as they are merged.
+ *
+ * @param dst       Index merged into
+ * @param srcs      Indexes to merge (n), compatible with dst
+ * @param n         Number of indexes to merge
+ * @param shift_ids Shift the ids of each source by the vectors merged before it
+ * @param n_threads Threads merging the lists (0 for the default)
+ * @return 0 on success, -1 on error
+ */
+int faiss_merge_into_parallel(FaissIndex dst, const FaissIndex* srcs, size_t n, int shift_ids, int n_threads);
+
+/* ============================================================
+ * Approximate Top-k Extensions
+ *
+ * Bucketed approximate top-k (ApproxTopK_mode_t of
+ * faiss/utils/approx_topk) for IndexFlat, IndexScalarQuantizer,
+ * IndexIVFFlat and IndexIVFScalarQuantizer scans, selected per call.
+ * ============================================================ */
+
+/**
+ * Create search parameters for faiss_Index_search_approx_topk_ext.
+ *
+ * @param p_params         Output pointer to the parameters
+ * @param approx_topk_mode 0 = exact, 1 = B32_D2, 2 = B8_D3, 3 = B16_D2, 4 = B8_D2
+ * @param nprobe           Lists probed by IVF indexes, 0 keeps index->nprobe
+ * @param segment_size     Vectors scanned between two heap merges, 0 to
+ *                         choose it from k
+ * @return 0 on success, -1 on error
+ */
+int faiss_SearchParametersApproxTopK_new(FaissSearchParameters* p_params, int approx_topk_mode, int64_t nprobe, int64_t segment_size);
+
+/**
+ * Free parameters made by faiss_SearchParametersApproxTopK_new.
+ */
+void faiss_SearchParametersApproxTopK_free(FaissSearchParameters params);
+
+/**
+ * Check whether an index supports the approximate modes.
+ *
+ * @param index     The index
+ * @param supported Output: 1 for IndexFlat, IndexScalarQuantizer,
+ *                  IndexIVFFlat and IndexIVFScalarQuantizer, 0 otherwise
+ * @return 0 on success, -1 on error
+ */
+int faiss_Index_approx_topk_supported_ext(FaissIndex index, int* supported);
+
+/**
+ * Search with the top-k mode of params. Exact mode, or params that are not
+ * SearchParametersApproxTopK (or NULL), search as usual; approximate modes
+ * fail on unsupported indexes.
+ *
+ * @param index     The index
+ * @param n         Number of queries
+ * @param x         Query vectors (n * d floats)
+ * @param k         Number of neighbors
+ * @param params    SearchParametersApproxTopK or NULL
+ * @param distances Output distances (n * k)
+ * @param labels    Output labels (n * k), -1 where fewer than k were found
  * @return 0 on success, -1 on error
  */
-int faiss_IndexIVFPQ_new(
-    FaissIndex* p_index,
-    FaissIndex quantizer,
-    int64_t d,
-    int64_t nlist,
-    int64_t M,
-    int64_t nbits);
+int faiss_Index_search_approx_topk_ext(FaissIndex index, int64_t n, const float* x, int64_t k, FaissSearchParameters params, float* distances, int64_t* labels);
 
 #ifdef __cplusplus
 }
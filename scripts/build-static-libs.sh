@@ -165,9 +165,12 @@ build_faiss() {
     mkdir -p build
     cd build
 
-    # Configure FAISS with static linking
+    # Configure FAISS with static linking. libfaiss stays at the generic
+    # ISA level so the archive runs on any x86-64 host; the hot kernels in
+    # c_api_ext are built for generic/avx2/avx512 and picked at runtime.
     cmake .. \
         -DCMAKE_BUILD_TYPE=Release \
+        -DFAISS_OPT_LEVEL=generic \
         -DFAISS_ENABLE_GPU=OFF \
         -DFAISS_ENABLE_PYTHON=OFF \
         -DFAISS_ENABLE_C_API=ON \